@@ -1151,7 +1151,7 @@ static void CL_SendConnectPacket( connprotocol_t proto, int challenge )
 	else
 	{
 		const char *qport = Cvar_VariableString( "net_qport" );
-		int extensions = NET_EXT_SPLITSIZE;
+		int extensions = NET_EXT_SPLITSIZE|NET_EXT_LZ4;
 
 		// reset nickname from cvar value
 		Info_SetValueForKey( cls.userinfo, "name", name.string, sizeof( cls.userinfo ));
@@ -1605,10 +1605,15 @@ void CL_SetupNetchanForProtocol( connprotocol_t proto )
 		}
 		break;
 	default:
+		cls.extensions = Q_atoi( Info_ValueForKey( Cmd_Argv( 1 ), "ext" ));
+
 		if( !Host_IsLocalClient( ))
+		{
 			SetBits( flags, NETCHAN_USE_LZSS );
 
-		cls.extensions = Q_atoi( Info_ValueForKey( Cmd_Argv( 1 ), "ext" ));
+			if( FBitSet( cls.extensions, NET_EXT_LZ4 ))
+				SetBits( flags, NETCHAN_USE_LZ4 );
+		}
 
 		if( FBitSet( cls.extensions, NET_EXT_SPLITSIZE ))
 			Con_Reportf( "^2NET_EXT_SPLITSIZE enabled^7 (packet size is %d)\n", (int)cl_dlmax.value );
@@ -3150,9 +3155,43 @@ static qboolean CL_ShouldRescanFilesystem( void )
 	return retval;
 }
 
+/*
+=================
+CL_PrefetchResources
+
+read files of models and sounds that are going to be loaded,
+so loaders don't wait for disk one file at a time
+=================
+*/
+static qboolean CL_PrefetchResources( void )
+{
+	resource_t	*pRes;
+
+	if( !FS_PrefetchBegin( ))
+		return false;
+
+	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
+	{
+		if( FBitSet( pRes->ucFlags, RES_PRECACHED|RES_WASMISSING ))
+			continue;
+
+		if( pRes->type == t_sound )
+			S_PrefetchSound( pRes->szFileName );
+		else if( pRes->type == t_model && pRes->nIndex >= 0 && pRes->szFileName[0] != '*' && !Mod_IsLoaded( pRes->szFileName ))
+			FS_PrefetchFile( pRes->szFileName );
+	}
+
+	FS_PrefetchRun();
+
+	return true;
+}
+
 qboolean CL_PrecacheResources( void )
 {
 	resource_t	*pRes;
+	double		start = Sys_DoubleTime();
+	double		worldtime;
+	qboolean		prefetched;
 
 	// if we downloaded new WAD files or any other archives they must be added to searchpath
 	if( CL_ShouldRescanFilesystem( ))
@@ -3201,6 +3240,9 @@ qboolean CL_PrecacheResources( void )
 	if( cls.state != ca_active )
 		S_BeginRegistration();
 
+	worldtime = Sys_DoubleTime() - start;
+	prefetched = CL_PrefetchResources();
+
 	// precache all the remaining resources where order is doesn't matter
 	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
 	{
@@ -3228,6 +3270,7 @@ qboolean CL_PrecacheResources( void )
 						if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 						{
 							S_EndRegistration();
+							FS_ClearPrefetch();
 							CL_Disconnect_f();
 							return false;
 						}
@@ -3257,6 +3300,7 @@ qboolean CL_PrecacheResources( void )
 							if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 							{
 								S_EndRegistration();
+								FS_ClearPrefetch();
 								CL_Disconnect_f();
 								return false;
 							}
@@ -3301,6 +3345,16 @@ qboolean CL_PrecacheResources( void )
 	if( cls.state != ca_active )
 		S_EndRegistration();
 
+	// sounds are loaded by S_EndRegistration, so staged data is needed until here
+	if( prefetched )
+		FS_ClearPrefetch();
+
+	if( Sys_CheckParm( "-benchload" ))
+	{
+		Con_Printf( "benchload: world %.1f ms, resources %.1f ms\n", worldtime * 1000.0, ( Sys_DoubleTime() - start - worldtime ) * 1000.0 );
+		FS_PrintPrefetchInfo();
+	}
+
 	return true;
 }
 
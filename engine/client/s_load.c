@@ -358,6 +358,34 @@ sound_t S_RegisterSound( const char *name )
 	return sfx - s_knownSfx;
 }
 
+/*
+==================
+S_PrefetchSound
+
+queue file of sound that will be loaded by registration,
+see FS_PrefetchBegin
+==================
+*/
+void S_PrefetchSound( const char *name )
+{
+	sfx_t	*sfx;
+	int	incache;
+	string	path;
+
+	if( !COM_CheckString( name ) || !dma.initialized || S_TestSoundChar( name, '!' ))
+		return;
+
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+
+	sfx = S_FindName( name, &incache );
+	if( !sfx || incache ) return;
+
+	// same path FS_LoadSound tries first
+	Q_snprintf( path, sizeof( path ), DEFAULT_SOUNDPATH "%s", sfx->name[0] == '*' ? sfx->name + 1 : sfx->name );
+	FS_PrefetchFile( path );
+}
+
 sfx_t *S_GetSfxByHandle( sound_t handle )
 {
 	if( !dma.initialized )
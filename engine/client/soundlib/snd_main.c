@@ -61,7 +61,8 @@ wavdata_t *FS_LoadSound( const char *filename, const byte *buffer, size_t size )
 	qboolean		anyformat = true;
 	fs_offset_t		filesize = 0;
 	const loadwavfmt_t	*format;
-	byte		*f;
+	const byte	*f;
+	byte		*staged;
 
 	Sound_Reset(); // clear old sounddata
 	Q_strncpy( loadname, filename, sizeof( loadname ));
@@ -93,15 +94,18 @@ wavdata_t *FS_LoadSound( const char *filename, const byte *buffer, size_t size )
 			Q_snprintf( path, sizeof( path ),
 				format->formatstring, loadname, "", format->ext );
 
-			f = FS_LoadFile( path, &filesize, false );
-			if( f && filesize > 0 )
+			staged = FS_TakePrefetched( path, &filesize );
+			f = staged ? staged : FS_MapFile( path, &filesize, false );
+			if( f )
 			{
-				if( format->loadfunc( path, f, filesize ))
-				{
-					Mem_Free(f); // release buffer
+				qboolean loaded = filesize > 0 && format->loadfunc( path, f, filesize );
+
+				// release buffer
+				if( staged ) Mem_Free( staged );
+				else FS_UnmapFile( f );
+
+				if( loaded )
 					return SoundPack(); // loaded
-				}
-				else Mem_Free(f); // release buffer
 			}
 		}
 	}
@@ -188,6 +188,10 @@ char *va( const char *format, ... )
 #define LZSS_LOOKSHIFT	4
 #define LZSS_WINDOW_SIZE	4096
 #define LZSS_LOOKAHEAD	BIT( LZSS_LOOKSHIFT )
+#define LZSS_MIN_MATCH	3
+#define LZSS_HASH_BITS	12
+#define LZSS_HASH_SIZE	BIT( LZSS_HASH_BITS )
+#define LZSS_MAX_CHAIN	32	// default search depth
 
 
 typedef struct
@@ -196,26 +200,12 @@ typedef struct
 	unsigned int	size;
 } lzss_header_t;
 
-// expected to be sixteen bytes
-typedef struct lzss_node_s
-{
-	const byte	*data;
-	struct lzss_node_s	*prev;
-	struct lzss_node_s	*next;
-	char		pad[4];
-} lzss_node_t;
-
 typedef struct
 {
-	lzss_node_t	*start;
-	lzss_node_t	*end;
-} lzss_list_t;
-
-typedef struct
-{
-	lzss_list_t	*hash_table;
-	lzss_node_t	*hash_node;
-	int		window_size;
+	int		head[LZSS_HASH_SIZE];	// newest position for each hash, -1 if none
+	int		prev[LZSS_WINDOW_SIZE];	// older position with the same hash
+	int		max_chain;		// how many candidates to check per position
+	qboolean		lazy;		// defer match if next position has a longer one
 } lzss_state_t;
 
 qboolean LZSS_IsCompressed( const byte *source, size_t input_len )
@@ -247,49 +237,83 @@ uint LZSS_GetActualSize( const byte *source, size_t input_len )
 	return 0;
 }
 
-static void LZSS_BuildHash( lzss_state_t *state, const byte *source )
+static uint LZSS_Hash( const byte *p )
 {
-	lzss_list_t	*list;
-	lzss_node_t	*node;
-	unsigned int	targetindex = (uint)source & ( state->window_size - 1 );
+	uint	v = ( p[0] << 16 ) | ( p[1] << 8 ) | p[2];
 
-	node = &state->hash_node[targetindex];
+	return ( v * 2654435761U ) >> ( 32 - LZSS_HASH_BITS );
+}
 
-	if( node->data )
+static void LZSS_InsertHash( lzss_state_t *state, const byte *pInput, int pos, int input_length )
+{
+	uint	h;
+
+	if( pos + LZSS_MIN_MATCH > input_length )
+		return;
+
+	h = LZSS_Hash( pInput + pos );
+	state->prev[pos & ( LZSS_WINDOW_SIZE - 1 )] = state->head[h];
+	state->head[h] = pos;
+}
+
+/*
+==============
+LZSS_FindMatch
+
+walks hash chain for the longest match, prev[] slots are
+reused after window size positions so walk must stop at
+the first candidate outside of the window
+==============
+*/
+static int LZSS_FindMatch( const lzss_state_t *state, const byte *pInput, int pos, int input_length, int *matchpos )
+{
+	int		maxlen = Q_min( input_length - pos, LZSS_LOOKAHEAD );
+	int		limit = pos - LZSS_WINDOW_SIZE;
+	int		chain = state->max_chain;
+	int		best = 0, candidate;
+	const byte	*p = pInput + pos;
+
+	if( maxlen < LZSS_MIN_MATCH )
+		return 0;
+
+	candidate = state->head[LZSS_Hash( p )];
+
+	while( candidate >= 0 && candidate >= limit && chain-- > 0 )
 	{
-		list = &state->hash_table[*node->data];
-		if( node->prev )
-		{
-			list->end = node->prev;
-			node->prev->next = NULL;
-		}
-		else
+		const byte	*c = pInput + candidate;
+
+		// byte that would make this candidate better than current best
+		if( c[best] == p[best] && c[0] == p[0] )
 		{
-			list->start = NULL;
-			list->end = NULL;
+			int	len = 1;
+
+			while( len < maxlen && c[len] == p[len] )
+				len++;
+
+			if( len > best )
+			{
+				best = len;
+				*matchpos = candidate;
+
+				if( len == maxlen )
+					break;
+			}
 		}
+
+		candidate = state->prev[candidate & ( LZSS_WINDOW_SIZE - 1 )];
 	}
 
-	list = &state->hash_table[*source];
-	node->data = source;
-	node->prev = NULL;
-	node->next = list->start;
-	if( list->start )
-		list->start->prev = node;
-	else list->end = node;
-	list->start = node;
+	return best >= LZSS_MIN_MATCH ? best : 0;
 }
 
 static byte *LZSS_CompressNoAlloc( lzss_state_t *state, byte *pInput, int input_length, byte *pOutputBuf, uint *pOutputSize )
 {
-	byte		*pStart = pOutputBuf; // allocate the output buffer, compressed buffer is expected to be less, caller will free
+	byte		*pStart = pOutputBuf; // compressed buffer is expected to be less, caller will free
 	byte		*pEnd = pStart + input_length - sizeof( lzss_header_t ) - 8; // prevent compression failure
 	lzss_header_t	*header = (lzss_header_t *)pStart;
 	byte		*pOutput = pStart + sizeof( lzss_header_t );
-	const byte	*pEncodedPosition = NULL;
-	byte		*pLookAhead = pInput;
-	byte		*pWindow = pInput;
-	int		i, putCmdByte = 0;
+	int		i, pos = 0, putCmdByte = 0;
+	int		matchlen, matchpos = 0;
 	byte		*pCmdByte = NULL;
 
 	if( input_length <= sizeof( lzss_header_t ) + 8 )
@@ -299,22 +323,26 @@ static byte *LZSS_CompressNoAlloc( lzss_state_t *state, byte *pInput, int input_
 	header->id = LZSS_ID;
 	header->size = input_length;
 
-	// create the compression work buffers, small enough (~64K) for stack
-	state->hash_table = (lzss_list_t *)alloca( 256 * sizeof( lzss_list_t ));
-	memset( state->hash_table, 0, 256 * sizeof( lzss_list_t ));
-	state->hash_node = (lzss_node_t *)alloca( state->window_size * sizeof( lzss_node_t ));
-	memset( state->hash_node, 0, state->window_size * sizeof( lzss_node_t ));
+	memset( state->head, 0xff, sizeof( state->head ));
 
-	while( input_length > 0 )
+	matchlen = LZSS_FindMatch( state, pInput, pos, input_length, &matchpos );
+
+	while( pos < input_length )
 	{
-		int		lookAheadLength = input_length < LZSS_LOOKAHEAD ? input_length : LZSS_LOOKAHEAD;
-		lzss_node_t	*hash = state->hash_table[pLookAhead[0]].start;
-		int		encoded_length = 0;
+		int	nextlen = 0, nextpos = 0;
 
-		pWindow = pLookAhead - state->window_size;
+		LZSS_InsertHash( state, pInput, pos, input_length );
 
-		if( pWindow < pInput )
-			pWindow = pInput;
+		// if next position starts a longer match, emit current byte as literal,
+		// literal costs 9 bits so one more matched byte doesn't pay for it
+		if( state->lazy && matchlen && matchlen < LZSS_LOOKAHEAD - 1 )
+		{
+			nextlen = LZSS_FindMatch( state, pInput, pos + 1, input_length, &nextpos );
+
+			if( nextlen > matchlen + 1 )
+				matchlen = 0;
+			else nextlen = 0;
+		}
 
 		if( !putCmdByte )
 		{
@@ -324,64 +352,41 @@ static byte *LZSS_CompressNoAlloc( lzss_state_t *state, byte *pInput, int input_
 
 		putCmdByte = ( putCmdByte + 1 ) & 0x07;
 
-		while( hash != NULL )
+		if( matchlen )
 		{
-			int	length = lookAheadLength;
-			int	match_length = 0;
-
-			while( length-- && hash->data[match_length] == pLookAhead[match_length] )
-				match_length++;
+			int	offset = pos - matchpos - 1;
 
-			if( match_length > encoded_length )
-			{
-				encoded_length = match_length;
-				pEncodedPosition = hash->data;
-			}
-
-			if( match_length == lookAheadLength )
-				break;
+			*pCmdByte = ( *pCmdByte >> 1 ) | 0x80;
+			*pOutput++ = ( offset >> LZSS_LOOKSHIFT );
+			*pOutput++ = ( offset << LZSS_LOOKSHIFT ) | ( matchlen - 1 );
 
-			hash = hash->next;
-		}
+			for( i = 1; i < matchlen; i++ )
+				LZSS_InsertHash( state, pInput, pos + i, input_length );
 
-		if ( encoded_length >= 3 )
-		{
-			*pCmdByte = (*pCmdByte >> 1) | 0x80;
-			*pOutput++ = (( pLookAhead - pEncodedPosition - 1 ) >> LZSS_LOOKSHIFT );
-			*pOutput++ = (( pLookAhead - pEncodedPosition - 1 ) << LZSS_LOOKSHIFT ) | ( encoded_length - 1 );
+			pos += matchlen;
+			matchlen = LZSS_FindMatch( state, pInput, pos, input_length, &matchpos );
 		}
 		else
 		{
 			*pCmdByte = ( *pCmdByte >> 1 );
-			*pOutput++ = *pLookAhead;
-			encoded_length = 1;
-		}
+			*pOutput++ = pInput[pos++];
 
-		for( i = 0; i < encoded_length; i++ )
-		{
-			LZSS_BuildHash( state, pLookAhead++ );
+			if( nextlen )
+			{
+				// deferred match, already searched
+				matchlen = nextlen;
+				matchpos = nextpos;
+			}
+			else matchlen = LZSS_FindMatch( state, pInput, pos, input_length, &matchpos );
 		}
 
-		input_length -= encoded_length;
-
 		if( pOutput >= pEnd )
 		{
 			// compression is worse, abandon
-			state->hash_table = NULL;
-			state->hash_node = NULL;
 			return NULL;
 		}
 	}
 
-	if( input_length != 0 )
-	{
-		// unexpected failure
-		Assert( 0 );
-		state->hash_table = NULL;
-		state->hash_node = NULL;
-		return NULL;
-	}
-
 	if( !putCmdByte )
 	{
 		pCmdByte = pOutput++;
@@ -402,18 +407,31 @@ static byte *LZSS_CompressNoAlloc( lzss_state_t *state, byte *pInput, int input_
 	return pStart;
 }
 
-byte *LZSS_Compress( byte *pInput, int inputLength, uint *pOutputSize )
+/*
+==============
+LZSS_CompressEx
+
+max_chain trades speed for ratio, lazy matching gives
+slightly better ratio on real data for about 40% of speed
+==============
+*/
+byte *LZSS_CompressEx( byte *pInput, int inputLength, uint *pOutputSize, int max_chain, qboolean lazy )
 {
-	byte *pStart = (byte *)malloc( inputLength );
-	byte *pFinal = NULL;
-	lzss_state_t state = { .window_size = LZSS_WINDOW_SIZE };
+	lzss_state_t	state;
+	byte		*pStart;
+
+	if( inputLength <= sizeof( lzss_header_t ) + 8 )
+		return NULL;
+
+	pStart = (byte *)malloc( inputLength );
 
 	if( !pStart )
 		return NULL;
 
-	pFinal = LZSS_CompressNoAlloc( &state, pInput, inputLength, pStart, pOutputSize );
+	state.max_chain = Q_max( max_chain, 1 );
+	state.lazy = lazy;
 
-	if( !pFinal )
+	if( !LZSS_CompressNoAlloc( &state, pInput, inputLength, pStart, pOutputSize ))
 	{
 		free( pStart );
 		return NULL;
@@ -422,6 +440,11 @@ byte *LZSS_Compress( byte *pInput, int inputLength, uint *pOutputSize )
 	return pStart;
 }
 
+byte *LZSS_Compress( byte *pInput, int inputLength, uint *pOutputSize )
+{
+	return LZSS_CompressEx( pInput, inputLength, pOutputSize, LZSS_MAX_CHAIN, false );
+}
+
 uint LZSS_Decompress( const byte *pInput, byte *pOutput, size_t input_len, size_t output_len )
 {
 	uint	totalBytes = 0;
@@ -485,15 +508,337 @@ uint LZSS_Decompress( const byte *pInput, byte *pOutput, size_t input_len, size_
 			*pOutput++ = *pInput++;
 			totalBytes++;
 		}
-		cmdByte = cmdByte >> 1;
+		cmdByte = cmdByte >> 1;
+	}
+
+	if( totalBytes != actualSize )
+	{
+		Assert( 0 );
+		return 0;
+	}
+	return totalBytes;
+}
+
+/*
+===============================================================================
+
+	LZ4 Compression
+
+	block format of reference LZ4 with a single-pass greedy matcher,
+	several times faster than LZSS at compression and decompression
+===============================================================================
+*/
+#define LZ4_ID		(('4'<<24)|('Z'<<16)|('L'<<8)|('X'))
+#define LZ4_HASH_LOG	12
+#define LZ4_MINMATCH	4
+#define LZ4_MFLIMIT		12	// last match must start this far from the end
+#define LZ4_LASTLITERALS	5	// last bytes are always literals
+#define LZ4_MAX_DISTANCE	65535
+#define LZ4_SKIP_TRIGGER	6	// search step grows after 64 failed probes
+
+typedef lzss_header_t lz4_header_t;
+
+qboolean LZ4_IsCompressed( const byte *source, size_t input_len )
+{
+	const lz4_header_t *phdr;
+
+	if( input_len <= sizeof( lz4_header_t ))
+		return false;
+
+	phdr = (const lz4_header_t *)source;
+
+	if( phdr->id == LZ4_ID )
+		return true;
+	return false;
+}
+
+uint LZ4_GetActualSize( const byte *source, size_t input_len )
+{
+	const lz4_header_t *phdr;
+
+	if( input_len <= sizeof( lz4_header_t ))
+		return 0;
+
+	phdr = (const lz4_header_t *)source;
+
+	if( phdr->id == LZ4_ID )
+		return phdr->size;
+
+	return 0;
+}
+
+static uint LZ4_Read32( const byte *p )
+{
+	uint	v;
+
+	memcpy( &v, p, sizeof( v ));
+	return v;
+}
+
+static uint LZ4_Hash( uint sequence )
+{
+	return ( sequence * 2654435761U ) >> ( 32 - LZ4_HASH_LOG );
+}
+
+static byte *LZ4_WriteLength( byte *pOutput, size_t length )
+{
+	while( length >= 255 )
+	{
+		*pOutput++ = 255;
+		length -= 255;
+	}
+
+	*pOutput++ = length;
+
+	return pOutput;
+}
+
+/*
+==============
+LZ4_WriteSequence
+
+returns NULL when output would grow past the limit
+==============
+*/
+static byte *LZ4_WriteSequence( byte *pOutput, const byte *pLimit, const byte *pLiterals, size_t literals, uint offset, size_t matchlen )
+{
+	byte	*pToken = pOutput++;
+
+	// token, length bytes, literals, offset and match length bytes
+	if( pOutput + literals + literals / 255 + 2 + matchlen / 255 + 2 > pLimit )
+		return NULL;
+
+	if( literals >= 15 )
+	{
+		*pToken = 15 << 4;
+		pOutput = LZ4_WriteLength( pOutput, literals - 15 );
+	}
+	else *pToken = literals << 4;
+
+	memcpy( pOutput, pLiterals, literals );
+	pOutput += literals;
+
+	// literals-only sequence ends the block
+	if( !offset )
+		return pOutput;
+
+	*pOutput++ = offset & 0xff;
+	*pOutput++ = offset >> 8;
+
+	matchlen -= LZ4_MINMATCH;
+
+	if( matchlen >= 15 )
+	{
+		*pToken |= 15;
+		pOutput = LZ4_WriteLength( pOutput, matchlen - 15 );
+	}
+	else *pToken |= matchlen;
+
+	return pOutput;
+}
+
+/*
+==============
+LZ4_Compress
+
+returns malloc'ed buffer or NULL if data can't be
+compressed to less than input length, caller will free
+==============
+*/
+byte *LZ4_Compress( const byte *pInput, int inputLength, uint *pOutputSize )
+{
+	int		table[1 << LZ4_HASH_LOG];
+	const byte	*ip = pInput, *anchor = pInput;
+	const byte	*iend = pInput + inputLength;
+	const byte	*mflimit = iend - LZ4_MFLIMIT;
+	const byte	*matchlimit = iend - LZ4_LASTLITERALS;
+	byte		*pStart, *pOutput, *pLimit;
+	lz4_header_t	*header;
+
+	if( inputLength <= sizeof( lz4_header_t ) + 8 )
+		return NULL;
+
+	pStart = (byte *)malloc( inputLength );
+
+	if( !pStart )
+		return NULL;
+
+	header = (lz4_header_t *)pStart;
+	header->id = LZ4_ID;
+	header->size = inputLength;
+
+	pOutput = pStart + sizeof( lz4_header_t );
+	pLimit = pStart + inputLength;
+
+	// stale entries are harmless, every candidate is verified
+	memset( table, 0, sizeof( table ));
+
+	while( ip < mflimit )
+	{
+		const byte	*match;
+		uint		step = 1, attempts = 1 << LZ4_SKIP_TRIGGER;
+		size_t		matchlen;
+
+		// find four matching bytes, skipping faster over incompressible data
+		while( 1 )
+		{
+			uint	h = LZ4_Hash( LZ4_Read32( ip ));
+
+			match = pInput + table[h];
+			table[h] = ip - pInput;
+
+			if( match < ip && ip - match <= LZ4_MAX_DISTANCE && LZ4_Read32( match ) == LZ4_Read32( ip ))
+				break;
+
+			ip += step;
+			step = attempts++ >> LZ4_SKIP_TRIGGER;
+
+			if( ip >= mflimit )
+				goto last_literals;
+		}
+
+		// extend backwards into pending literals
+		while( ip > anchor && match > pInput && ip[-1] == match[-1] )
+		{
+			ip--;
+			match--;
+		}
+
+		matchlen = LZ4_MINMATCH;
+
+		while( ip + matchlen + 4 <= matchlimit && LZ4_Read32( ip + matchlen ) == LZ4_Read32( match + matchlen ))
+			matchlen += 4;
+
+		while( ip + matchlen < matchlimit && ip[matchlen] == match[matchlen] )
+			matchlen++;
+
+		pOutput = LZ4_WriteSequence( pOutput, pLimit, anchor, ip - anchor, ip - match, matchlen );
+
+		if( !pOutput )
+		{
+			// compression is worse, abandon
+			free( pStart );
+			return NULL;
+		}
+
+		ip += matchlen;
+		anchor = ip;
+
+		// remember position inside the match, helps on repetitive data
+		if( ip < mflimit )
+			table[LZ4_Hash( LZ4_Read32( ip - 2 ))] = ip - 2 - pInput;
+	}
+
+last_literals:
+	pOutput = LZ4_WriteSequence( pOutput, pLimit, anchor, iend - anchor, 0, 0 );
+
+	if( !pOutput )
+	{
+		free( pStart );
+		return NULL;
+	}
+
+	if( pOutputSize )
+		*pOutputSize = pOutput - pStart;
+
+	return pStart;
+}
+
+static qboolean LZ4_ReadLength( const byte **ip, const byte *iend, size_t *length )
+{
+	byte	s;
+
+	do
+	{
+		if( *ip >= iend )
+			return false;
+		s = *(*ip)++;
+		*length += s;
+	} while( s == 255 );
+
+	return true;
+}
+
+/*
+==============
+LZ4_Decompress
+
+returns decompressed size or 0 on malformed input
+==============
+*/
+uint LZ4_Decompress( const byte *pInput, byte *pOutput, size_t input_len, size_t output_len )
+{
+	const byte	*ip = pInput + sizeof( lz4_header_t );
+	const byte	*iend = pInput + input_len;
+	byte		*op = pOutput, *oend;
+	uint		actualSize;
+
+	actualSize = LZ4_GetActualSize( pInput, input_len );
+
+	if( !actualSize || actualSize > output_len )
+		return 0;
+
+	oend = pOutput + actualSize;
+
+	while( ip < iend )
+	{
+		uint		token = *ip++;
+		size_t		length = token >> 4;
+		size_t		offset;
+		const byte	*match;
+
+		if( length == 15 && !LZ4_ReadLength( &ip, iend, &length ))
+			return 0;
+
+		if( length > (size_t)( iend - ip ) || length > (size_t)( oend - op ))
+			return 0;
+
+		memcpy( op, ip, length );
+		op += length;
+		ip += length;
+
+		// last sequence has no match
+		if( ip == iend )
+			break;
+
+		if( iend - ip < 2 )
+			return 0;
+
+		offset = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+
+		if( !offset || offset > (size_t)( op - pOutput ))
+			return 0;
+
+		length = token & 15;
+
+		if( length == 15 && !LZ4_ReadLength( &ip, iend, &length ))
+			return 0;
+
+		length += LZ4_MINMATCH;
+
+		if( length > (size_t)( oend - op ))
+			return 0;
+
+		match = op - offset;
+
+		if( offset >= length )
+		{
+			memcpy( op, match, length );
+			op += length;
+		}
+		else
+		{
+			// overlapped copy repeats the pattern
+			while( length-- )
+				*op++ = *match++;
+		}
 	}
 
-	if( totalBytes != actualSize )
-	{
-		Assert( 0 );
+	if( op != oend )
 		return 0;
-	}
-	return totalBytes;
+
+	return actualSize;
 }
 
 /*
@@ -1070,6 +1415,319 @@ void GAME_EXPORT pfnResetTutorMessageDecayData( void )
 #include <sanitizer/asan_interface.h>
 #endif
 
+// previous compressor with per-byte lists, kept to compare against
+// expected to be sixteen bytes
+typedef struct lzss_legacy_node_s
+{
+	const byte	*data;
+	struct lzss_legacy_node_s	*prev;
+	struct lzss_legacy_node_s	*next;
+	char		pad[4];
+} lzss_legacy_node_t;
+
+typedef struct
+{
+	lzss_legacy_node_t	*start;
+	lzss_legacy_node_t	*end;
+} lzss_legacy_list_t;
+
+typedef struct
+{
+	lzss_legacy_list_t	*hash_table;
+	lzss_legacy_node_t	*hash_node;
+	int		window_size;
+} lzss_legacy_state_t;
+
+static void Test_LZSS_LegacyBuildHash( lzss_legacy_state_t *state, const byte *source )
+{
+	lzss_legacy_list_t	*list;
+	lzss_legacy_node_t	*node;
+	unsigned int	targetindex = (uint)source & ( state->window_size - 1 );
+
+	node = &state->hash_node[targetindex];
+
+	if( node->data )
+	{
+		list = &state->hash_table[*node->data];
+		if( node->prev )
+		{
+			list->end = node->prev;
+			node->prev->next = NULL;
+		}
+		else
+		{
+			list->start = NULL;
+			list->end = NULL;
+		}
+	}
+
+	list = &state->hash_table[*source];
+	node->data = source;
+	node->prev = NULL;
+	node->next = list->start;
+	if( list->start )
+		list->start->prev = node;
+	else list->end = node;
+	list->start = node;
+}
+
+static byte *Test_LZSS_LegacyCompressNoAlloc( lzss_legacy_state_t *state, byte *pInput, int input_length, byte *pOutputBuf, uint *pOutputSize )
+{
+	byte		*pStart = pOutputBuf; // allocate the output buffer, compressed buffer is expected to be less, caller will free
+	byte		*pEnd = pStart + input_length - sizeof( lzss_header_t ) - 8; // prevent compression failure
+	lzss_header_t	*header = (lzss_header_t *)pStart;
+	byte		*pOutput = pStart + sizeof( lzss_header_t );
+	const byte	*pEncodedPosition = NULL;
+	byte		*pLookAhead = pInput;
+	byte		*pWindow = pInput;
+	int		i, putCmdByte = 0;
+	byte		*pCmdByte = NULL;
+
+	if( input_length <= sizeof( lzss_header_t ) + 8 )
+		return NULL;
+
+	// set LZSS header
+	header->id = LZSS_ID;
+	header->size = input_length;
+
+	// create the compression work buffers, small enough (~64K) for stack
+	state->hash_table = (lzss_legacy_list_t *)alloca( 256 * sizeof( lzss_legacy_list_t ));
+	memset( state->hash_table, 0, 256 * sizeof( lzss_legacy_list_t ));
+	state->hash_node = (lzss_legacy_node_t *)alloca( state->window_size * sizeof( lzss_legacy_node_t ));
+	memset( state->hash_node, 0, state->window_size * sizeof( lzss_legacy_node_t ));
+
+	while( input_length > 0 )
+	{
+		int		lookAheadLength = input_length < LZSS_LOOKAHEAD ? input_length : LZSS_LOOKAHEAD;
+		lzss_legacy_node_t	*hash = state->hash_table[pLookAhead[0]].start;
+		int		encoded_length = 0;
+
+		pWindow = pLookAhead - state->window_size;
+
+		if( pWindow < pInput )
+			pWindow = pInput;
+
+		if( !putCmdByte )
+		{
+			pCmdByte = pOutput++;
+			*pCmdByte = 0;
+		}
+
+		putCmdByte = ( putCmdByte + 1 ) & 0x07;
+
+		while( hash != NULL )
+		{
+			int	length = lookAheadLength;
+			int	match_length = 0;
+
+			while( length-- && hash->data[match_length] == pLookAhead[match_length] )
+				match_length++;
+
+			if( match_length > encoded_length )
+			{
+				encoded_length = match_length;
+				pEncodedPosition = hash->data;
+			}
+
+			if( match_length == lookAheadLength )
+				break;
+
+			hash = hash->next;
+		}
+
+		if ( encoded_length >= 3 )
+		{
+			*pCmdByte = (*pCmdByte >> 1) | 0x80;
+			*pOutput++ = (( pLookAhead - pEncodedPosition - 1 ) >> LZSS_LOOKSHIFT );
+			*pOutput++ = (( pLookAhead - pEncodedPosition - 1 ) << LZSS_LOOKSHIFT ) | ( encoded_length - 1 );
+		}
+		else
+		{
+			*pCmdByte = ( *pCmdByte >> 1 );
+			*pOutput++ = *pLookAhead;
+			encoded_length = 1;
+		}
+
+		for( i = 0; i < encoded_length; i++ )
+		{
+			Test_LZSS_LegacyBuildHash( state, pLookAhead++ );
+		}
+
+		input_length -= encoded_length;
+
+		if( pOutput >= pEnd )
+		{
+			// compression is worse, abandon
+			state->hash_table = NULL;
+			state->hash_node = NULL;
+			return NULL;
+		}
+	}
+
+	if( input_length != 0 )
+	{
+		// unexpected failure
+		Assert( 0 );
+		state->hash_table = NULL;
+		state->hash_node = NULL;
+		return NULL;
+	}
+
+	if( !putCmdByte )
+	{
+		pCmdByte = pOutput++;
+		*pCmdByte = 0x01;
+	}
+	else
+	{
+		*pCmdByte = (( *pCmdByte >> 1 ) | 0x80 ) >> ( 7 - putCmdByte );
+	}
+
+	// put two ints at end of buffer
+	*pOutput++ = 0;
+	*pOutput++ = 0;
+
+	if( pOutputSize )
+		*pOutputSize = pOutput - pStart;
+
+	return pStart;
+}
+
+static byte *Test_LZSS_LegacyCompress( byte *pInput, int inputLength, uint *pOutputSize )
+{
+	byte *pStart = (byte *)malloc( inputLength );
+	byte *pFinal = NULL;
+	lzss_legacy_state_t state = { .window_size = LZSS_WINDOW_SIZE };
+
+	if( !pStart )
+		return NULL;
+
+	pFinal = Test_LZSS_LegacyCompressNoAlloc( &state, pInput, inputLength, pStart, pOutputSize );
+
+	if( !pFinal )
+	{
+		free( pStart );
+		return NULL;
+	}
+
+	return pStart;
+}
+
+
+#define TEST_COMPRESS_SIZE	0x40000
+
+/*
+==============
+Test_GenerateResourceList
+
+text that looks like precache and resource lists
+==============
+*/
+static int Test_GenerateResourceList( byte *out, int size )
+{
+	static const char *dirs[] = { "models/", "sound/weapons/", "sound/player/", "sprites/", "maps/", "gfx/env/", "models/player/" };
+	static const char *names[] = { "shell", "gib_skull", "grenade", "w_9mmclip", "pl_step", "explode", "reload", "glass", "hgrunt", "crowbar" };
+	static const char *exts[] = { ".mdl", ".wav", ".spr", ".bsp", ".tga" };
+	int	len = 0;
+
+	while( len < size - MAX_QPATH )
+	{
+		len += Q_snprintf( (char *)out + len, size - len, "%s%s%d%s\n",
+			dirs[COM_RandomLong( 0, ARRAYSIZE( dirs ) - 1 )],
+			names[COM_RandomLong( 0, ARRAYSIZE( names ) - 1 )],
+			COM_RandomLong( 0, 9 ),
+			exts[COM_RandomLong( 0, ARRAYSIZE( exts ) - 1 )] );
+	}
+
+	return len;
+}
+
+/*
+==============
+Test_GenerateLumps
+
+binary data that looks like BSP lumps: grid-snapped
+vertices, planes, and some lightmap-like noise
+==============
+*/
+static int Test_GenerateLumps( byte *out, int size )
+{
+	int	len = 0;
+
+	while( len < size - 16 )
+	{
+		switch( COM_RandomLong( 0, 2 ))
+		{
+		case 0:
+		{
+			float	v = COM_RandomLong( -256, 256 ) * 16.0f;
+			memcpy( out + len, &v, sizeof( v ));
+			len += sizeof( v );
+			break;
+		}
+		case 1:
+		{
+			int	type = COM_RandomLong( 0, 5 );
+			memcpy( out + len, &type, sizeof( type ));
+			len += sizeof( type );
+			break;
+		}
+		default:
+		{
+			int	i, base = COM_RandomLong( 0, 255 );
+			for( i = 0; i < 16; i++ )
+				out[len++] = bound( 0, base + COM_RandomLong( -4, 4 ), 255 );
+			break;
+		}
+		}
+	}
+
+	return len;
+}
+
+static void Test_LZSS_Sample( const char *name, byte *data, int size, byte *out )
+{
+	static const struct
+	{
+		const char	*name;
+		int		max_chain;
+		qboolean		lazy;
+	} modes[] =
+	{
+		{ "legacy", 0, false },
+		{ "chain 8", 8, false },
+		{ "chain 32", 32, false },
+		{ "chain 32 lazy", 32, true },
+	};
+	int	i;
+
+	for( i = 0; i < ARRAYSIZE( modes ); i++ )
+	{
+		double	start = Sys_DoubleTime();
+		uint	csize = 0;
+		byte	*packed;
+		double	time;
+
+		if( !modes[i].max_chain )
+			packed = Test_LZSS_LegacyCompress( data, size, &csize );
+		else packed = LZSS_CompressEx( data, size, &csize, modes[i].max_chain, modes[i].lazy );
+
+		time = Sys_DoubleTime() - start;
+
+		TASSERT( packed != NULL );
+		if( !packed )
+			continue;
+
+		memset( out, 0, size );
+		TASSERT_EQi( LZSS_Decompress( packed, out, csize, size ), size );
+		TASSERT( !memcmp( out, data, size ));
+		free( packed );
+
+		Con_Printf( "Test_LZSS: %s, %s: %.1f%%, %.1f MB/s\n", name, modes[i].name,
+			csize * 100.0 / size, size / ( time * 1048576.0 ));
+	}
+}
+
 static void Test_LZSS( void )
 {
 	char poison1[8192];
@@ -1080,6 +1738,9 @@ static void Test_LZSS( void )
 
 	lzss_header_t *hdr = (lzss_header_t *)in;
 	uint result;
+	byte *data, *unpacked, *packed;
+	uint csize;
+	int size;
 
 	const byte compressed[] =
 	{
@@ -1125,6 +1786,136 @@ static void Test_LZSS( void )
 	result = LZSS_Decompress( compressed, out, sizeof( compressed ), sizeof( out ));
 	TASSERT_EQi( result, 26 );
 	TASSERT_STR( out, decompressed );
+
+	// compressor output must round trip, matches may overlap
+	memset( in, 'a', sizeof( in ));
+	packed = LZSS_Compress( in, sizeof( in ), &csize );
+	TASSERT( packed != NULL );
+	TASSERT_EQi( LZSS_Decompress( packed, out, csize, sizeof( out )), sizeof( in ));
+	TASSERT( !memcmp( in, out, sizeof( in )));
+	free( packed );
+
+	data = Z_Malloc( TEST_COMPRESS_SIZE );
+	unpacked = Z_Malloc( TEST_COMPRESS_SIZE );
+
+	size = Test_GenerateResourceList( data, TEST_COMPRESS_SIZE );
+	Test_LZSS_Sample( "resource list", data, size, unpacked );
+
+	size = Test_GenerateLumps( data, TEST_COMPRESS_SIZE );
+	Test_LZSS_Sample( "lumps", data, size, unpacked );
+
+	Z_Free( unpacked );
+	Z_Free( data );
+}
+
+static void Test_LZ4_Sample( const char *name, const byte *data, int size, byte *out )
+{
+	double	start, ctime[2], dtime[2];
+	uint	csize[2] = { 0 };
+	byte	*packed;
+	uint	result;
+
+	start = Sys_DoubleTime();
+	packed = LZSS_Compress( (byte *)data, size, &csize[0] );
+	ctime[0] = Sys_DoubleTime() - start;
+	dtime[0] = 0.0;
+
+	// LZSS gives up when output isn't smaller
+	if( packed )
+	{
+		start = Sys_DoubleTime();
+		result = LZSS_Decompress( packed, out, csize[0], size );
+		dtime[0] = Sys_DoubleTime() - start;
+		TASSERT_EQi( result, size );
+		free( packed );
+	}
+	else csize[0] = size;
+
+	start = Sys_DoubleTime();
+	packed = LZ4_Compress( data, size, &csize[1] );
+	ctime[1] = Sys_DoubleTime() - start;
+	TASSERT( packed != NULL );
+
+	memset( out, 0, size );
+	start = Sys_DoubleTime();
+	result = LZ4_Decompress( packed, out, csize[1], size );
+	dtime[1] = Sys_DoubleTime() - start;
+	TASSERT_EQi( result, size );
+	TASSERT( !memcmp( out, data, size ));
+
+	// truncated stream must be rejected
+	TASSERT_EQi( LZ4_Decompress( packed, out, csize[1] - 1, size ), 0 );
+	free( packed );
+
+	Con_Printf( "Test_LZ4: %s %i bytes, lzss %.1f%% %.1f/%.1f MB/s, lz4 %.1f%% %.1f/%.1f MB/s\n",
+		name, size,
+		csize[0] * 100.0 / size, size / ( ctime[0] * 1048576.0 ), size / ( dtime[0] * 1048576.0 ),
+		csize[1] * 100.0 / size, size / ( ctime[1] * 1048576.0 ), size / ( dtime[1] * 1048576.0 ));
+}
+
+static void Test_LZ4( void )
+{
+	byte	in[64], out[64];
+	byte	*data = Z_Malloc( TEST_COMPRESS_SIZE );
+	byte	*unpacked = Z_Malloc( TEST_COMPRESS_SIZE );
+	lz4_header_t *hdr = (lz4_header_t *)in;
+	int	i, size;
+	byte	*packed;
+	uint	csize;
+
+	// literal run pointing past the input
+	hdr->id = LZ4_ID;
+	hdr->size = 32;
+	memset( in + sizeof( *hdr ), 0xff, sizeof( in ) - sizeof( *hdr ));
+	TASSERT_EQi( LZ4_Decompress( in, out, sizeof( in ), sizeof( out )), 0 );
+
+	// match offset before start of output
+	in[8] = 0x10;
+	in[9] = 'a';
+	in[10] = 0x02;
+	in[11] = 0x00;
+	TASSERT_EQi( LZ4_Decompress( in, out, 12, sizeof( out )), 0 );
+
+	// overlapped match, "a" followed by 31 copies
+	in[8] = 0x1f;
+	in[10] = 0x01;
+	in[12] = 31 - LZ4_MINMATCH - 15;
+	TASSERT_EQi( LZ4_Decompress( in, out, 13, sizeof( out )), 32 );
+	for( i = 0; i < 32 && out[i] == 'a'; i++ );
+	TASSERT_EQi( i, 32 );
+
+	// too big for output
+	hdr->size = 999;
+	TASSERT_EQi( LZ4_Decompress( in, out, 13, sizeof( out )), 0 );
+
+	hdr->size = 32;
+	hdr->id = 0xa1ba;
+	TASSERT_EQi( LZ4_Decompress( in, out, 13, sizeof( out )), 0 );
+
+	// random data must not compress
+	for( i = 0; i < 4096; i++ )
+		data[i] = COM_RandomLong( 0, 255 );
+	TASSERT( LZ4_Compress( data, 4096, &csize ) == NULL );
+
+	// short inputs all round trip
+	for( size = 32; size < 256; size++ )
+	{
+		memset( data, 'x', size );
+		packed = LZ4_Compress( data, size, &csize );
+		TASSERT( packed != NULL );
+		TASSERT_EQi( LZ4_Decompress( packed, unpacked, csize, size ), size );
+		TASSERT( !memcmp( data, unpacked, size ));
+		free( packed );
+	}
+
+	size = Test_GenerateResourceList( data, TEST_COMPRESS_SIZE );
+	Test_LZ4_Sample( "resource list", data, size, unpacked );
+
+	size = Test_GenerateLumps( data, TEST_COMPRESS_SIZE );
+	Test_LZ4_Sample( "lumps", data, size, unpacked );
+
+	Z_Free( unpacked );
+	Z_Free( data );
 }
 
 void Test_RunCommon( void )
@@ -1140,5 +1931,8 @@ void Test_RunCommon( void )
 
 	Msg( "Checking LZSS_Decompress...\n" );
 	Test_LZSS();
+
+	Msg( "Checking LZ4 compression...\n" );
+	Test_LZ4();
 }
 #endif
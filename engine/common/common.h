@@ -417,6 +417,20 @@ byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr )
 	MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
 void FS_Rescan_f( void );
 void FS_CheckConfig( void );
+void FS_CheckZipCache( void );
+
+//
+// prefetch.c
+//
+void FS_InitPrefetch( void );
+void FS_ShutdownPrefetch( void );
+qboolean FS_PrefetchBegin( void );
+void FS_PrefetchFile( const char *path );
+void FS_PrefetchFromArchive( const char *name, searchpath_t *sp, const char *path, int pack_ind );
+void FS_PrefetchRun( void );
+byte *FS_TakePrefetched( const char *name, fs_offset_t *filesizeptr );
+void FS_ClearPrefetch( void );
+void FS_PrintPrefetchInfo( void );
 
 //
 // cmd.c
@@ -601,6 +615,7 @@ void SV_Shutdown( const char *finalmsg );
 void SV_ShutdownFilter( void );
 void Host_ServerFrame( void );
 qboolean SV_Active( void );
+void SV_RunReplay( const char *filename ) NORETURN;
 
 /*
 ==============================================================
@@ -806,7 +821,12 @@ float COM_RandomFloat( float fMin, float fMax );
 qboolean LZSS_IsCompressed( const byte *source, size_t input_len );
 uint LZSS_GetActualSize( const byte *source, size_t input_len );
 byte *LZSS_Compress( byte *pInput, int inputLength, uint *pOutputSize );
+byte *LZSS_CompressEx( byte *pInput, int inputLength, uint *pOutputSize, int max_chain, qboolean lazy );
 uint LZSS_Decompress( const byte *pInput, byte *pOutput, size_t input_len, size_t output_len );
+qboolean LZ4_IsCompressed( const byte *source, size_t input_len );
+uint LZ4_GetActualSize( const byte *source, size_t input_len );
+byte *LZ4_Compress( const byte *pInput, int inputLength, uint *pOutputSize );
+uint LZ4_Decompress( const byte *pInput, byte *pOutput, size_t input_len, size_t output_len );
 void GL_FreeImage( const char *name );
 void VID_InitDefaultResolution( void );
 void VID_Init( void );
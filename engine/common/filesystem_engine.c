@@ -30,6 +30,7 @@ CVAR_DEFINE_AUTO( fs_mount_lv, "0", FCVAR_ARCHIVE|FCVAR_PRIVILEGED|FCVAR_LATCH,
 CVAR_DEFINE_AUTO( fs_mount_addon, "0", FCVAR_ARCHIVE|FCVAR_PRIVILEGED|FCVAR_LATCH, "mount addon content folder" );
 CVAR_DEFINE_AUTO( fs_mount_l10n, "0", FCVAR_ARCHIVE|FCVAR_PRIVILEGED|FCVAR_LATCH, "mount localization content folder" );
 CVAR_DEFINE_AUTO( ui_language, "english", FCVAR_ARCHIVE|FCVAR_PRIVILEGED|FCVAR_LATCH, "selected game language" );
+static CVAR_DEFINE_AUTO( fs_zipcache, "32", FCVAR_ARCHIVE|FCVAR_PRIVILEGED, "size of decompressed zip entries cache in megabytes, 0 disables" );
 
 fs_api_t g_fsapi;
 fs_globals_t *FI;
@@ -54,6 +55,12 @@ file_t *FS_Open( const char *filepath, const char *mode, qboolean gamedironly )
 
 byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
 {
+	byte *data;
+
+	// map resources could be already read, see prefetch.c
+	if( !gamedironly && ( data = FS_TakePrefetched( path, filesizeptr )) != NULL )
+		return data;
+
 	return g_fsapi.LoadFile( path, filesizeptr, gamedironly );
 }
 
@@ -266,6 +273,101 @@ void FS_CheckConfig( void )
 		FS_Rescan_f();
 }
 
+/*
+================
+FS_CheckZipCache
+
+pass new cache budget to filesystem
+================
+*/
+void FS_CheckZipCache( void )
+{
+	if( !FBitSet( fs_zipcache.flags, FCVAR_CHANGED ))
+		return;
+
+	g_fsapi.SetZipCacheSize( fs_zipcache.value > 0.0f ? (size_t)( fs_zipcache.value * 1024.0f * 1024.0f ) : 0 );
+	ClearBits( fs_zipcache.flags, FCVAR_CHANGED );
+}
+
+/*
+================
+FS_SeekBench_f
+
+fs_seekbench <map> [passes] - read BSP lumps in reverse order,
+like random lump access does, and compare with loading
+the whole file. Meant for maps packed deflated in pk3
+================
+*/
+static void FS_SeekBench_f( void )
+{
+	double		start, seektime = 0.0, loadtime = 0.0;
+	char		path[MAX_QPATH];
+	fs_offset_t	size = 0;
+	int		i, j, passes;
+	dheader_t		hdr;
+	byte		*data;
+	file_t		*f;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "fs_seekbench <map> [passes]\n" );
+		return;
+	}
+
+	passes = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 4;
+	passes = passes < 1 ? 1 : passes;
+	Q_snprintf( path, sizeof( path ), "maps/%s.bsp", Cmd_Argv( 1 ));
+
+	// cached entries are read from memory, that's not what we measure
+	g_fsapi.SetZipCacheSize( 0 );
+
+	for( i = 0; i < passes; i++ )
+	{
+		start = Sys_DoubleTime();
+		f = FS_Open( path, "rb", false );
+
+		if( !f || FS_Read( f, &hdr, sizeof( hdr )) != sizeof( hdr ))
+		{
+			Con_Printf( S_ERROR "fs_seekbench: couldn't read %s\n", path );
+			if( f ) FS_Close( f );
+			break;
+		}
+
+		for( j = HEADER_LUMPS - 1; j >= 0; j-- )
+		{
+			const dlump_t *l = &hdr.lumps[j];
+
+			if( l->filelen <= 0 )
+				continue;
+
+			data = Mem_Malloc( host.mempool, l->filelen );
+
+			if( FS_Seek( f, l->fileofs, SEEK_SET ) < 0 || FS_Read( f, data, l->filelen ) != l->filelen )
+				Con_Printf( S_WARN "fs_seekbench: lump %i is out of file\n", j );
+
+			Mem_Free( data );
+		}
+
+		FS_Close( f );
+		seektime += Sys_DoubleTime() - start;
+
+		start = Sys_DoubleTime();
+		data = FS_LoadFile( path, &size, false );
+		loadtime += Sys_DoubleTime() - start;
+
+		if( data ) Mem_Free( data );
+	}
+
+	SetBits( fs_zipcache.flags, FCVAR_CHANGED );
+	FS_CheckZipCache();
+
+	if( i < passes )
+		return;
+
+	Con_Printf( "%s, %s: lumps %.2f ms, whole file %.2f ms per pass\n", path, Q_memprint( size ),
+		seektime * 1000.0 / passes, loadtime * 1000.0 / passes );
+}
+
 /*
 ================
 FS_Init
@@ -317,11 +419,18 @@ void FS_Init( const char *basedir )
 	Cmd_AddRestrictedCommand( "fs_path", FS_Path_f_, "show filesystem search pathes" );
 	Cmd_AddRestrictedCommand( "fs_clearpaths", FS_ClearPaths_f, "clear filesystem search pathes" );
 	Cmd_AddRestrictedCommand( "fs_make_gameinfo", FS_MakeGameInfo_f, "create gameinfo.txt for current running game" );
+	Cmd_AddRestrictedCommand( "fs_seekbench", FS_SeekBench_f, "measure random lump access in map file against loading it whole" );
 
 	Cvar_RegisterVariable( &fs_mount_hd );
 	Cvar_RegisterVariable( &fs_mount_lv );
 	Cvar_RegisterVariable( &fs_mount_addon );
 	Cvar_RegisterVariable( &fs_mount_l10n );
+	Cvar_RegisterVariable( &fs_zipcache );
+
+	SetBits( fs_zipcache.flags, FCVAR_CHANGED );
+	FS_CheckZipCache();
+
+	FS_InitPrefetch();
 
 	if( !Sys_GetParmFromCmdLine( "-dll", host.gamedll ))
 		host.gamedll[0] = 0;
@@ -337,6 +446,8 @@ FS_Shutdown
 */
 void FS_Shutdown( void )
 {
+	FS_ShutdownPrefetch();
+
 	if( g_fsapi.ShutdownStdio )
 		g_fsapi.ShutdownStdio();
 
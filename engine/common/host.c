@@ -171,6 +171,8 @@ static void Sys_PrintUsage( const char *exename )
 #endif
 	O("-clockwindow <cw>  ", "adjust clockwindow used to ignore client commands")
 	O("                   ", "to prevent speed hacks")
+	O("-replay <file>     ", "replay sv_capture file without sockets and exit")
+	O("                   ", "prints server frame time percentiles, dedicated only")
 
 "\nGame options:\n"
 	O("-game <directory>  ", "set game directory to start engine with")
@@ -804,6 +806,7 @@ void Host_Frame( double time )
 	Host_ServerFrame (); // server frame
 	Host_ClientFrame (); // client frame
 	HTTP_Run();			 // both server and client
+	FS_CheckZipCache();
 
 	host.framecount++;
 	host.pureframetime = Sys_DoubleTime() - t1;
@@ -1202,7 +1205,7 @@ Host_Main
 int EXPORT Host_Main( int argc, char **argv, const char *progname, int bChangeGame, pfnChangeGame func )
 {
 	static double	oldtime, newtime;
-	string demoname, exename;
+	string demoname, exename, replayname;
 
 	host.starttime = Sys_DoubleTime();
 
@@ -1348,6 +1351,9 @@ int EXPORT Host_Main( int argc, char **argv, const char *progname, int bChangeGa
 	// check after all configs were executed
 	HPAK_CheckIntegrity( hpk_custom_file.string );
 
+	if( Host_IsDedicated( ) && Sys_GetParmFromCmdLine( "-replay", replayname ))
+		SV_RunReplay( replayname );
+
 #if XASH_ANDROID
 	if( setjmp( return_from_main_buf ))
 		return error_on_exit;
@@ -254,16 +254,16 @@ static qboolean Image_ProbeLoad_( const loadpixformat_t *fmt, const char *name,
 	qboolean success = false;
 	fs_offset_t filesize;
 	string path;
-	byte *f;
+	const byte *f;
 
 	Q_snprintf( path, sizeof( path ), fmt->formatstring, name, suffix, fmt->ext );
-	f = FS_LoadFile( path, &filesize, false );
+	f = FS_MapFile( path, &filesize, false );
 
 	if( f )
 	{
 		success = Image_ProbeLoadBuffer( fmt, path, f, filesize, override_hint );
 
-		Mem_Free( f );
+		FS_UnmapFile( f );
 	}
 
 	return success;
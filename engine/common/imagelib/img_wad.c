@@ -289,13 +289,16 @@ qboolean Image_LoadLMP( const char *name, const byte *buffer, fs_offset_t filesi
 	// id software trick (image without header)
 	if( Q_stristr( name, "conchars" ) && filesize == 16384 )
 	{
+		static byte	conchars[16384];
+
 		image.width = image.height = 128;
 		rendermode = LUMP_QUAKE1;
 		filesize += sizeof( lmp );
-		fin = (byte *)buffer;
+		fin = conchars;
 
-		// need to remap transparent color from first to last entry
-		for( i = 0; i < 16384; i++ ) if( !fin[i] ) fin[i] = 0xFF;
+		// need to remap transparent color from first to last entry,
+		// file buffer may be read-only so remap into a copy
+		for( i = 0; i < 16384; i++ ) fin[i] = buffer[i] ? buffer[i] : 0xFF;
 	}
 	else
 	{
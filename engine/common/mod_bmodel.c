@@ -24,6 +24,7 @@ GNU General Public License for more details.
 #include "client.h"
 #include "server.h"			// LUMP_ error codes
 #include "ref_common.h"
+#include "pm_local.h"
 #if defined( HAVE_OPENMP )
 #include <omp.h>
 #endif // HAVE_OPENMP
@@ -434,52 +435,66 @@ static mip_t *Mod_GetMipTexForTexture( dbspmodel_t *bmod, int i )
 }
 
 // Returns index of WAD that texture was found in, or -1 if not found.
-static int Mod_LoadTextureFromWadList( wadlist_t *list, const char *name, rgbdata_t **pic, char *texpath, size_t texpathlen )
+static int Mod_FindTextureInWadList( wadlist_t *list, const char *name, searchpath_t **sp, char *file, size_t filelen, int *pack_ind )
 {
 	int i;
 
 	if( !list || !COM_CheckString( name ))
 		return -1;
 
+	Q_snprintf( file, filelen, "%s.mip", name );
+
 	// check wads in reverse order
 	for( i = list->count - 1; i >= 0; i-- )
 	{
-		searchpath_t *sp = NULL;
+		*sp = NULL;
 
-		while(( sp = g_fsapi.GetArchiveByName( list->wadnames[i], sp )))
+		while(( *sp = g_fsapi.GetArchiveByName( list->wadnames[i], *sp )))
 		{
-			fs_offset_t len;
-			byte *buf;
-			char file[MAX_VA_STRING];
-			int pack_ind;
+			*pack_ind = g_fsapi.FindFileInArchive( *sp, file, NULL, 0 );
+
+			if( *pack_ind >= 0 )
+				return i;
+		}
+	}
 
-			Q_snprintf( file, sizeof( file ), "%s.mip", name );
-			pack_ind = g_fsapi.FindFileInArchive( sp, file, NULL, 0 );
+	return -1;
+}
 
-			if( pack_ind < 0 )
-				continue;
+// Returns index of WAD that texture was found in, or -1 if not found.
+static int Mod_LoadTextureFromWadList( wadlist_t *list, const char *name, rgbdata_t **pic, char *texpath, size_t texpathlen )
+{
+	searchpath_t *sp;
+	fs_offset_t len;
+	byte *buf;
+	char file[MAX_VA_STRING];
+	char staged[MAX_VA_STRING];
+	int i, pack_ind;
+
+	i = Mod_FindTextureInWadList( list, name, &sp, file, sizeof( file ), &pack_ind );
 
-			if( texpath != NULL )
-				Q_snprintf( texpath, texpathlen, "%s/%s.mip", list->wadnames[i], name );
+	if( i < 0 )
+		return -1;
 
-			if( pic == NULL )
-				return i; // dedicated server don't want to load the textures (why?)
+	if( texpath != NULL )
+		Q_snprintf( texpath, texpathlen, "%s/%s.mip", list->wadnames[i], name );
 
-			if( !( buf = g_fsapi.LoadFileFromArchive( sp, file, pack_ind, &len, false )))
-			{
-				*pic = NULL;
-				return i; // corrupted file, don't ignore it
-			}
+	if( pic == NULL )
+		return i; // dedicated server don't want to load the textures (why?)
 
-			// tell imagelib to directly load this texture to save time
-			Q_snprintf( file, sizeof( file ), "#%s/%s.mip", list->wadnames[i], name );
-			*pic = FS_LoadImage( file, buf, len );
-			Mem_Free( buf );
-			return i; // if file is corrupted, it's fine, we want to tell the user about it
-		}
+	Q_snprintf( staged, sizeof( staged ), "%s/%s", list->wadnames[i], file );
+
+	if( !( buf = FS_TakePrefetched( staged, &len )) && !( buf = g_fsapi.LoadFileFromArchive( sp, file, pack_ind, &len, false )))
+	{
+		*pic = NULL;
+		return i; // corrupted file, don't ignore it
 	}
 
-	return -1;
+	// tell imagelib to directly load this texture to save time
+	Q_snprintf( file, sizeof( file ), "#%s/%s.mip", list->wadnames[i], name );
+	*pic = FS_LoadImage( file, buf, len );
+	Mem_Free( buf );
+	return i; // if file is corrupted, it's fine, we want to tell the user about it
 }
 
 static fs_offset_t Mod_CalculateMipTexSize( const mip_t *mt, qboolean palette )
@@ -1653,6 +1668,160 @@ static int RemapClipNodes_r( dbspmodel_t *bmod, dclipnode32_t *srcnodes, hull_t
 	return c;
 }
 
+/*
+===============================================================================
+
+			HULL NODES
+
+compact copies of bsp clipnodes with planes inlined, traced by
+PM_RecursiveHullCheck. Hull layout is exported to game dlls so
+nodes are found by clipnodes pointer instead of living in hull_t
+===============================================================================
+*/
+#define HULLNODES_HASH_SIZE	4096	// must be power of two
+
+typedef struct
+{
+	const void	*clipnodes;
+	mhullnode_t	*nodes;
+	poolhandle_t	mempool;
+} hullnodes_entry_t;
+
+static hullnodes_entry_t	mod_hullnodes[HULLNODES_HASH_SIZE];
+static int		mod_numhullnodes;
+
+static uint Mod_HullNodesHash( const void *clipnodes )
+{
+	return ((uint)((size_t)clipnodes >> 4 ) * 2654435761u ) & ( HULLNODES_HASH_SIZE - 1 );
+}
+
+static void Mod_InsertHullNodes( const hullnodes_entry_t *entry )
+{
+	uint	i = Mod_HullNodesHash( entry->clipnodes );
+
+	while( mod_hullnodes[i].clipnodes != NULL && mod_hullnodes[i].clipnodes != entry->clipnodes )
+		i = ( i + 1 ) & ( HULLNODES_HASH_SIZE - 1 );
+
+	if( mod_hullnodes[i].clipnodes == NULL )
+		mod_numhullnodes++;
+
+	mod_hullnodes[i] = *entry;
+}
+
+/*
+=================
+Mod_MakeHullNodes
+
+hull must have clipnodes and planes already set,
+numclipnodes is a size of clipnodes array
+=================
+*/
+void Mod_MakeHullNodes( hull_t *hull, int numclipnodes, qboolean clipnodes32, poolhandle_t mempool )
+{
+	hullnodes_entry_t	entry;
+	int		i;
+
+	if( !hull->clipnodes16 || !hull->planes || numclipnodes <= 0 )
+		return;
+
+	// keep probing short, traces will just use clipnodes
+	if( mod_numhullnodes >= HULLNODES_HASH_SIZE * 3 / 4 )
+		return;
+
+	entry.clipnodes = hull->clipnodes16;
+	entry.mempool = mempool;
+	entry.nodes = Mem_Malloc( mempool, sizeof( *entry.nodes ) * numclipnodes );
+
+	for( i = 0; i < numclipnodes; i++ )
+	{
+		mhullnode_t	*out = &entry.nodes[i];
+		const mplane_t	*plane;
+
+		if( clipnodes32 )
+		{
+			plane = hull->planes + hull->clipnodes32[i].planenum;
+			out->children[0] = hull->clipnodes32[i].children[0];
+			out->children[1] = hull->clipnodes32[i].children[1];
+		}
+		else
+		{
+			plane = hull->planes + hull->clipnodes16[i].planenum;
+			out->children[0] = hull->clipnodes16[i].children[0];
+			out->children[1] = hull->clipnodes16[i].children[1];
+		}
+
+		VectorCopy( plane->normal, out->normal );
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->pad = 0;
+	}
+
+	Mod_InsertHullNodes( &entry );
+}
+
+/*
+=================
+Mod_HullNodes
+
+returns NULL for hulls without compact nodes (box and hitbox hulls)
+=================
+*/
+const mhullnode_t *Mod_HullNodes( const hull_t *hull )
+{
+	uint	i;
+
+	if( !mod_numhullnodes || !hull->clipnodes16 || !hull->planes )
+		return NULL;
+
+	i = Mod_HullNodesHash( hull->clipnodes16 );
+
+	while( mod_hullnodes[i].clipnodes != NULL )
+	{
+		if( mod_hullnodes[i].clipnodes == hull->clipnodes16 )
+			return mod_hullnodes[i].nodes;
+
+		i = ( i + 1 ) & ( HULLNODES_HASH_SIZE - 1 );
+	}
+
+	return NULL;
+}
+
+/*
+=================
+Mod_FreeHullNodes
+
+forget nodes allocated in this pool, pool itself frees memory
+=================
+*/
+void Mod_FreeHullNodes( poolhandle_t mempool )
+{
+	hullnodes_entry_t	*entries;
+	int		i, count = 0;
+
+	if( !mod_numhullnodes )
+		return;
+
+	// rehash survivors, removal only happens on model unload
+	entries = Z_Malloc( sizeof( *entries ) * mod_numhullnodes );
+
+	for( i = 0; i < HULLNODES_HASH_SIZE; i++ )
+	{
+		if( mod_hullnodes[i].clipnodes != NULL && mod_hullnodes[i].mempool != mempool )
+			entries[count++] = mod_hullnodes[i];
+	}
+
+	memset( mod_hullnodes, 0, sizeof( mod_hullnodes ));
+	mod_numhullnodes = 0;
+
+	for( i = 0; i < count; i++ )
+		Mod_InsertHullNodes( &entries[i] );
+
+	Z_Free( entries );
+
+	// recorded traces may point to freed hulls
+	PM_ClearHullTraces();
+}
+
 /*
 =================
 Mod_MakeHull0
@@ -1718,6 +1887,7 @@ static void Mod_MakeHull0( model_t *mod, const dbspmodel_t *bmod )
 		}
 	}
 
+	Mod_MakeHullNodes( hull, mod->numnodes, bmod->version == QBSP2_VERSION, mod->mempool );
 }
 
 /*
@@ -1773,6 +1943,8 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, poolhandle_t mempool
 	hull->lastclipnode = 0; // restart counting
 
 	RemapClipNodes_r( bmod, bmod->clipnodes_out, hull, headnode ); // remap clipnodes to 16-bit indexes
+
+	Mod_MakeHullNodes( hull, hull->lastclipnode, bmod->version == QBSP2_VERSION, mempool );
 }
 
 static qboolean Mod_LoadLitfile( model_t *mod, const char *ext, size_t expected_size, color24 **out, size_t *outsize )
@@ -2688,12 +2860,57 @@ static void Mod_LoadTexture( model_t *mod, dbspmodel_t *bmod, int textureIndex )
 	Mod_LoadTextureData( mod, bmod, textureIndex );
 }
 
+/*
+=================
+Mod_PrefetchWadTextures
+
+read WAD lumps of world textures in parallel, before they are loaded one by one
+=================
+*/
+static qboolean Mod_PrefetchWadTextures( model_t *mod, dbspmodel_t *bmod )
+{
+	char file[MAX_VA_STRING];
+	char staged[MAX_VA_STRING];
+	searchpath_t *sp;
+	int i, wadIndex, pack_ind;
+
+	if( !bmod->isworld || !world.wadlist.count || Host_IsDedicated( ))
+		return false;
+
+	if( !FS_PrefetchBegin( ))
+		return false;
+
+	for( i = 0; i < mod->numtextures; i++ )
+	{
+		const mip_t *mipTex = Mod_GetMipTexForTexture( bmod, i );
+
+		// same condition as in Mod_LoadTextureData
+		if( !mipTex || !COM_CheckStringEmpty( mipTex->name ) || ( !r_wadtextures.value && mipTex->offsets[0] > 0 ))
+			continue;
+
+		wadIndex = Mod_FindTextureInWadList( &world.wadlist, mipTex->name, &sp, file, sizeof( file ), &pack_ind );
+
+		if( wadIndex < 0 )
+			continue;
+
+		Q_snprintf( staged, sizeof( staged ), "%s/%s", world.wadlist.wadnames[wadIndex], file );
+		FS_PrefetchFromArchive( staged, sp, file, pack_ind );
+	}
+
+	FS_PrefetchRun();
+	return true;
+}
+
 static void Mod_LoadAllTextures( model_t *mod, dbspmodel_t *bmod )
 {
+	qboolean prefetched = Mod_PrefetchWadTextures( mod, bmod );
 	int i;
 
 	for( i = 0; i < mod->numtextures; i++ )
 		Mod_LoadTexture( mod, bmod, i );
+
+	if( prefetched )
+		FS_ClearPrefetch();
 }
 
 static void Mod_SequenceAnimatedTexture( model_t *mod, int baseTextureIndex )
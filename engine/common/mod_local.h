@@ -83,6 +83,16 @@ typedef struct
 	uint		num_polys;
 } hull_model_t;
 
+// clipnode with plane inlined, built for bsp hulls at load time
+typedef struct mhullnode_s
+{
+	vec3_t		normal;
+	float		dist;
+	int		type;		// same as mplane_t type
+	int		children[2];	// negative numbers are contents
+	int		pad;		// two nodes per cache line
+} mhullnode_t;
+
 typedef struct wadlist_s
 {
 	char wadnames[MAX_MAP_WADS][36]; // including .wad extension
@@ -153,6 +163,7 @@ void Mod_LoadCacheFile( const char *path, struct cache_user_s *cu );
 void *Mod_AliasExtradata( model_t *mod );
 void *Mod_StudioExtradata( model_t *mod );
 model_t *Mod_FindName( const char *name, qboolean trackCRC );
+qboolean Mod_IsLoaded( const char *name );
 model_t *Mod_LoadModel( model_t *mod, qboolean crash );
 model_t *Mod_ForName( const char *name, qboolean crash, qboolean trackCRC );
 qboolean Mod_ValidateCRC( const char *name, CRC32_t crc );
@@ -179,6 +190,9 @@ int Mod_SampleSizeForFace( const msurface_t *surf );
 byte *Mod_GetPVSForPoint( const vec3_t p );
 void Mod_UnloadBrushModel( model_t *mod );
 void Mod_PrintWorldStats_f( void );
+void Mod_MakeHullNodes( hull_t *hull, int numclipnodes, qboolean clipnodes32, poolhandle_t mempool );
+const mhullnode_t *Mod_HullNodes( const hull_t *hull );
+void Mod_FreeHullNodes( poolhandle_t mempool );
 
 //
 // mod_dbghulls.c
@@ -23,10 +23,19 @@ GNU General Public License for more details.
 #include "enginefeatures.h"
 #include "client.h"
 #include "server.h"
+#include "pm_local.h"
+
+#define MODEL_HASH_SIZE	( MAX_MODELS >> 2 )
 
 static model_info_t	mod_crcinfo[MAX_MODELS];
 static model_t	mod_known[MAX_MODELS];
 static int	mod_numknown = 0;
+
+// model_t layout is shared with renderers and game dlls, so name lookup data is kept aside
+static int	mod_hash[MODEL_HASH_SIZE];	// first slot in bucket + 1, zero terminates
+static int	mod_hashnext[MAX_MODELS];	// next slot in bucket + 1
+static uint	mod_hashvalue[MAX_MODELS];
+static uint32_t	mod_freeslots[MAX_MODELS / 32];	// free slots below mod_numknown
 poolhandle_t      com_studiocache;		// cache for submodels
 CVAR_DEFINE( mod_studiocache, "r_studiocache", "1", FCVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
 CVAR_DEFINE_AUTO( r_wadtextures, "0", 0, "completely ignore textures in the bsp-file if enabled" );
@@ -65,6 +74,78 @@ static void Mod_Modellist_f( void )
 	Con_Printf( "\n" );
 }
 
+/*
+================
+Mod_LinkSlot
+
+put just named model slot into the hash
+================
+*/
+static void Mod_LinkSlot( int i )
+{
+	uint hash = COM_HashKey( mod_known[i].name, MODEL_HASH_SIZE );
+
+	ClearBits( mod_freeslots[i >> 5], BIT( i & 31 ));
+	mod_hashvalue[i] = hash;
+	mod_hashnext[i] = mod_hash[hash];
+	mod_hash[hash] = i + 1;
+}
+
+/*
+================
+Mod_ReleaseSlot
+
+remove cleared model slot from the hash and mark it as free
+================
+*/
+static void Mod_ReleaseSlot( model_t *mod )
+{
+	int i = mod - mod_known;
+	int *prev;
+
+	// might be a temporary model, like in fuzzer
+	if( i < 0 || i >= mod_numknown )
+		return;
+
+	for( prev = &mod_hash[mod_hashvalue[i]]; *prev; prev = &mod_hashnext[*prev - 1] )
+	{
+		if( *prev == i + 1 )
+		{
+			*prev = mod_hashnext[i];
+			break;
+		}
+	}
+
+	mod_hashnext[i] = 0;
+	SetBits( mod_freeslots[i >> 5], BIT( i & 31 ));
+}
+
+/*
+================
+Mod_FindFreeSlot
+
+returns lowest free slot, so world always gets slot #0
+================
+*/
+static int Mod_FindFreeSlot( void )
+{
+	int i, j;
+
+	for( i = 0; i < ( mod_numknown + 31 ) >> 5; i++ )
+	{
+		if( !mod_freeslots[i] )
+			continue;
+
+		for( j = 0; j < 32; j++ )
+		{
+			if( FBitSet( mod_freeslots[i], BIT( j )))
+				return ( i << 5 ) + j;
+		}
+	}
+
+	return mod_numknown;
+}
+
 /*
 ================
 Mod_FreeUserData
@@ -106,6 +187,10 @@ void Mod_FreeModel( model_t *mod )
 	if( mod->type != mod_brush || mod->name[0] != '*' )
 	{
 		Mod_FreeUserData( mod );
+
+		if( mod->type == mod_brush )
+			Mod_FreeHullNodes( mod->mempool );
+
 		Mem_FreePool( &mod->mempool );
 	}
 
@@ -122,6 +207,7 @@ void Mod_FreeModel( model_t *mod )
 	}
 
 	memset( mod, 0, sizeof( *mod ));
+	Mod_ReleaseSlot( mod );
 }
 
 /*
@@ -145,6 +231,7 @@ void Mod_Init( void )
 
 	Cmd_AddCommand( "mapstats", Mod_PrintWorldStats_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
+	Cmd_AddCommand( "hullbench", PM_HullBench_f, "record hull traces and replay them against recursive and compact traversal" );
 
 	Mod_ResetStudioAPI ();
 	Mod_InitStudioHull ();
@@ -165,6 +252,9 @@ void Mod_FreeAll( void )
 	for( i = 0; i < mod_numknown; i++ )
 		Mod_FreeModel( &mod_known[i] );
 	mod_numknown = 0;
+
+	memset( mod_hash, 0, sizeof( mod_hash ));
+	memset( mod_freeslots, 0, sizeof( mod_freeslots ));
 }
 
 /*
@@ -214,8 +304,10 @@ model_t *Mod_FindName( const char *filename, qboolean trackCRC )
 	Q_strncpy( modname, filename, sizeof( modname ));
 
 	// search the currently loaded models
-	for( i = 0, mod = mod_known; i < mod_numknown; i++, mod++ )
+	for( i = mod_hash[COM_HashKey( modname, MODEL_HASH_SIZE )]; i != 0; i = mod_hashnext[i - 1] )
 	{
+		mod = &mod_known[i - 1];
+
 		if( !Q_stricmp( mod->name, modname ))
 		{
 			if( mod->mempool || mod->name[0] == '*' )
@@ -227,8 +319,7 @@ model_t *Mod_FindName( const char *filename, qboolean trackCRC )
 	}
 
 	// find a free model slot spot
-	for( i = 0, mod = mod_known; i < mod_numknown; i++, mod++ )
-		if( !COM_CheckStringEmpty( mod->name ) ) break; // this is a valid spot
+	i = Mod_FindFreeSlot();
 
 	if( i == mod_numknown )
 	{
@@ -238,7 +329,10 @@ model_t *Mod_FindName( const char *filename, qboolean trackCRC )
 	}
 
 	// copy name, so model loader can find model file
+	mod = &mod_known[i];
 	Q_strncpy( mod->name, modname, sizeof( mod->name ));
+	Mod_LinkSlot( i );
+
 	if( trackCRC ) mod_crcinfo[i].flags = FCRC_SHOULD_CHECKSUM;
 	else mod_crcinfo[i].flags = 0;
 	mod->needload = NL_NEEDS_LOADED;
@@ -247,6 +341,31 @@ model_t *Mod_FindName( const char *filename, qboolean trackCRC )
 	return mod;
 }
 
+/*
+==================
+Mod_IsLoaded
+
+unlike Mod_FindName, doesn't take a slot for unknown model
+==================
+*/
+qboolean Mod_IsLoaded( const char *filename )
+{
+	char	modname[MAX_QPATH];
+	int	i;
+
+	Q_strncpy( modname, filename, sizeof( modname ));
+
+	for( i = mod_hash[COM_HashKey( modname, MODEL_HASH_SIZE )]; i != 0; i = mod_hashnext[i - 1] )
+	{
+		const model_t *mod = &mod_known[i - 1];
+
+		if( !Q_stricmp( mod->name, modname ))
+			return mod->mempool || mod->name[0] == '*';
+	}
+
+	return false;
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -282,6 +401,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	if( !buf || length < sizeof( uint ))
 	{
 		memset( mod, 0, sizeof( model_t ));
+		Mod_ReleaseSlot( mod );
 
 		if( crash ) Host_Error( "Could not load model %s from disk\n", tempname );
 		else Con_Printf( S_ERROR "Could not load model %s from disk\n", tempname );
@@ -18,176 +18,180 @@ GNU General Public License for more details.
 #include "net_buffer.h"
 #include "xash3d_mathlib.h"
 
-static const uint32_t BitWriteMasks[32][32] =
-{ {
-	0xfffffffe, 0xfffffffc, 0xfffffff8, 0xfffffff0, 0xffffffe0, 0xffffffc0, 0xffffff80, 0xffffff00,
-	0xfffffe00, 0xfffffc00, 0xfffff800, 0xfffff000, 0xffffe000, 0xffffc000, 0xffff8000, 0xffff0000,
-	0xfffe0000, 0xfffc0000, 0xfff80000, 0xfff00000, 0xffe00000, 0xffc00000, 0xff800000, 0xff000000,
-	0xfe000000, 0xfc000000, 0xf8000000, 0xf0000000, 0xe0000000, 0xc0000000, 0x80000000, 0x00000000,
-}, {
-	0xfffffffd, 0xfffffff9, 0xfffffff1, 0xffffffe1, 0xffffffc1, 0xffffff81, 0xffffff01, 0xfffffe01,
-	0xfffffc01, 0xfffff801, 0xfffff001, 0xffffe001, 0xffffc001, 0xffff8001, 0xffff0001, 0xfffe0001,
-	0xfffc0001, 0xfff80001, 0xfff00001, 0xffe00001, 0xffc00001, 0xff800001, 0xff000001, 0xfe000001,
-	0xfc000001, 0xf8000001, 0xf0000001, 0xe0000001, 0xc0000001, 0x80000001, 0x00000001, 0x00000001,
-}, {
-	0xfffffffb, 0xfffffff3, 0xffffffe3, 0xffffffc3, 0xffffff83, 0xffffff03, 0xfffffe03, 0xfffffc03,
-	0xfffff803, 0xfffff003, 0xffffe003, 0xffffc003, 0xffff8003, 0xffff0003, 0xfffe0003, 0xfffc0003,
-	0xfff80003, 0xfff00003, 0xffe00003, 0xffc00003, 0xff800003, 0xff000003, 0xfe000003, 0xfc000003,
-	0xf8000003, 0xf0000003, 0xe0000003, 0xc0000003, 0x80000003, 0x00000003, 0x00000003, 0x00000003,
-}, {
-	0xfffffff7, 0xffffffe7, 0xffffffc7, 0xffffff87, 0xffffff07, 0xfffffe07, 0xfffffc07, 0xfffff807,
-	0xfffff007, 0xffffe007, 0xffffc007, 0xffff8007, 0xffff0007, 0xfffe0007, 0xfffc0007, 0xfff80007,
-	0xfff00007, 0xffe00007, 0xffc00007, 0xff800007, 0xff000007, 0xfe000007, 0xfc000007, 0xf8000007,
-	0xf0000007, 0xe0000007, 0xc0000007, 0x80000007, 0x00000007, 0x00000007, 0x00000007, 0x00000007,
-}, {
-	0xffffffef, 0xffffffcf, 0xffffff8f, 0xffffff0f, 0xfffffe0f, 0xfffffc0f, 0xfffff80f, 0xfffff00f,
-	0xffffe00f, 0xffffc00f, 0xffff800f, 0xffff000f, 0xfffe000f, 0xfffc000f, 0xfff8000f, 0xfff0000f,
-	0xffe0000f, 0xffc0000f, 0xff80000f, 0xff00000f, 0xfe00000f, 0xfc00000f, 0xf800000f, 0xf000000f,
-	0xe000000f, 0xc000000f, 0x8000000f, 0x0000000f, 0x0000000f, 0x0000000f, 0x0000000f, 0x0000000f,
-}, {
-	0xffffffdf, 0xffffff9f, 0xffffff1f, 0xfffffe1f, 0xfffffc1f, 0xfffff81f, 0xfffff01f, 0xffffe01f,
-	0xffffc01f, 0xffff801f, 0xffff001f, 0xfffe001f, 0xfffc001f, 0xfff8001f, 0xfff0001f, 0xffe0001f,
-	0xffc0001f, 0xff80001f, 0xff00001f, 0xfe00001f, 0xfc00001f, 0xf800001f, 0xf000001f, 0xe000001f,
-	0xc000001f, 0x8000001f, 0x0000001f, 0x0000001f, 0x0000001f, 0x0000001f, 0x0000001f, 0x0000001f,
-}, {
-	0xffffffbf, 0xffffff3f, 0xfffffe3f, 0xfffffc3f, 0xfffff83f, 0xfffff03f, 0xffffe03f, 0xffffc03f,
-	0xffff803f, 0xffff003f, 0xfffe003f, 0xfffc003f, 0xfff8003f, 0xfff0003f, 0xffe0003f, 0xffc0003f,
-	0xff80003f, 0xff00003f, 0xfe00003f, 0xfc00003f, 0xf800003f, 0xf000003f, 0xe000003f, 0xc000003f,
-	0x8000003f, 0x0000003f, 0x0000003f, 0x0000003f, 0x0000003f, 0x0000003f, 0x0000003f, 0x0000003f,
-}, {
-	0xffffff7f, 0xfffffe7f, 0xfffffc7f, 0xfffff87f, 0xfffff07f, 0xffffe07f, 0xffffc07f, 0xffff807f,
-	0xffff007f, 0xfffe007f, 0xfffc007f, 0xfff8007f, 0xfff0007f, 0xffe0007f, 0xffc0007f, 0xff80007f,
-	0xff00007f, 0xfe00007f, 0xfc00007f, 0xf800007f, 0xf000007f, 0xe000007f, 0xc000007f, 0x8000007f,
-	0x0000007f, 0x0000007f, 0x0000007f, 0x0000007f, 0x0000007f, 0x0000007f, 0x0000007f, 0x0000007f,
-}, {
-	0xfffffeff, 0xfffffcff, 0xfffff8ff, 0xfffff0ff, 0xffffe0ff, 0xffffc0ff, 0xffff80ff, 0xffff00ff,
-	0xfffe00ff, 0xfffc00ff, 0xfff800ff, 0xfff000ff, 0xffe000ff, 0xffc000ff, 0xff8000ff, 0xff0000ff,
-	0xfe0000ff, 0xfc0000ff, 0xf80000ff, 0xf00000ff, 0xe00000ff, 0xc00000ff, 0x800000ff, 0x000000ff,
-	0x000000ff, 0x000000ff, 0x000000ff, 0x000000ff, 0x000000ff, 0x000000ff, 0x000000ff, 0x000000ff,
-}, {
-	0xfffffdff, 0xfffff9ff, 0xfffff1ff, 0xffffe1ff, 0xffffc1ff, 0xffff81ff, 0xffff01ff, 0xfffe01ff,
-	0xfffc01ff, 0xfff801ff, 0xfff001ff, 0xffe001ff, 0xffc001ff, 0xff8001ff, 0xff0001ff, 0xfe0001ff,
-	0xfc0001ff, 0xf80001ff, 0xf00001ff, 0xe00001ff, 0xc00001ff, 0x800001ff, 0x000001ff, 0x000001ff,
-	0x000001ff, 0x000001ff, 0x000001ff, 0x000001ff, 0x000001ff, 0x000001ff, 0x000001ff, 0x000001ff,
-}, {
-	0xfffffbff, 0xfffff3ff, 0xffffe3ff, 0xffffc3ff, 0xffff83ff, 0xffff03ff, 0xfffe03ff, 0xfffc03ff,
-	0xfff803ff, 0xfff003ff, 0xffe003ff, 0xffc003ff, 0xff8003ff, 0xff0003ff, 0xfe0003ff, 0xfc0003ff,
-	0xf80003ff, 0xf00003ff, 0xe00003ff, 0xc00003ff, 0x800003ff, 0x000003ff, 0x000003ff, 0x000003ff,
-	0x000003ff, 0x000003ff, 0x000003ff, 0x000003ff, 0x000003ff, 0x000003ff, 0x000003ff, 0x000003ff,
-}, {
-	0xfffff7ff, 0xffffe7ff, 0xffffc7ff, 0xffff87ff, 0xffff07ff, 0xfffe07ff, 0xfffc07ff, 0xfff807ff,
-	0xfff007ff, 0xffe007ff, 0xffc007ff, 0xff8007ff, 0xff0007ff, 0xfe0007ff, 0xfc0007ff, 0xf80007ff,
-	0xf00007ff, 0xe00007ff, 0xc00007ff, 0x800007ff, 0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff,
-	0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff, 0x000007ff,
-}, {
-	0xffffefff, 0xffffcfff, 0xffff8fff, 0xffff0fff, 0xfffe0fff, 0xfffc0fff, 0xfff80fff, 0xfff00fff,
-	0xffe00fff, 0xffc00fff, 0xff800fff, 0xff000fff, 0xfe000fff, 0xfc000fff, 0xf8000fff, 0xf0000fff,
-	0xe0000fff, 0xc0000fff, 0x80000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff,
-	0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff, 0x00000fff,
-}, {
-	0xffffdfff, 0xffff9fff, 0xffff1fff, 0xfffe1fff, 0xfffc1fff, 0xfff81fff, 0xfff01fff, 0xffe01fff,
-	0xffc01fff, 0xff801fff, 0xff001fff, 0xfe001fff, 0xfc001fff, 0xf8001fff, 0xf0001fff, 0xe0001fff,
-	0xc0001fff, 0x80001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff,
-	0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff, 0x00001fff,
-}, {
-	0xffffbfff, 0xffff3fff, 0xfffe3fff, 0xfffc3fff, 0xfff83fff, 0xfff03fff, 0xffe03fff, 0xffc03fff,
-	0xff803fff, 0xff003fff, 0xfe003fff, 0xfc003fff, 0xf8003fff, 0xf0003fff, 0xe0003fff, 0xc0003fff,
-	0x80003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff,
-	0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff, 0x00003fff,
-}, {
-	0xffff7fff, 0xfffe7fff, 0xfffc7fff, 0xfff87fff, 0xfff07fff, 0xffe07fff, 0xffc07fff, 0xff807fff,
-	0xff007fff, 0xfe007fff, 0xfc007fff, 0xf8007fff, 0xf0007fff, 0xe0007fff, 0xc0007fff, 0x80007fff,
-	0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff,
-	0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff, 0x00007fff,
-}, {
-	0xfffeffff, 0xfffcffff, 0xfff8ffff, 0xfff0ffff, 0xffe0ffff, 0xffc0ffff, 0xff80ffff, 0xff00ffff,
-	0xfe00ffff, 0xfc00ffff, 0xf800ffff, 0xf000ffff, 0xe000ffff, 0xc000ffff, 0x8000ffff, 0x0000ffff,
-	0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff,
-	0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0x0000ffff,
-}, {
-	0xfffdffff, 0xfff9ffff, 0xfff1ffff, 0xffe1ffff, 0xffc1ffff, 0xff81ffff, 0xff01ffff, 0xfe01ffff,
-	0xfc01ffff, 0xf801ffff, 0xf001ffff, 0xe001ffff, 0xc001ffff, 0x8001ffff, 0x0001ffff, 0x0001ffff,
-	0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff,
-	0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff, 0x0001ffff,
-}, {
-	0xfffbffff, 0xfff3ffff, 0xffe3ffff, 0xffc3ffff, 0xff83ffff, 0xff03ffff, 0xfe03ffff, 0xfc03ffff,
-	0xf803ffff, 0xf003ffff, 0xe003ffff, 0xc003ffff, 0x8003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff,
-	0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff,
-	0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff, 0x0003ffff,
-}, {
-	0xfff7ffff, 0xffe7ffff, 0xffc7ffff, 0xff87ffff, 0xff07ffff, 0xfe07ffff, 0xfc07ffff, 0xf807ffff,
-	0xf007ffff, 0xe007ffff, 0xc007ffff, 0x8007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff,
-	0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff,
-	0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff, 0x0007ffff,
-}, {
-	0xffefffff, 0xffcfffff, 0xff8fffff, 0xff0fffff, 0xfe0fffff, 0xfc0fffff, 0xf80fffff, 0xf00fffff,
-	0xe00fffff, 0xc00fffff, 0x800fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff,
-	0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff,
-	0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff, 0x000fffff,
-}, {
-	0xffdfffff, 0xff9fffff, 0xff1fffff, 0xfe1fffff, 0xfc1fffff, 0xf81fffff, 0xf01fffff, 0xe01fffff,
-	0xc01fffff, 0x801fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff,
-	0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff,
-	0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff, 0x001fffff,
-}, {
-	0xffbfffff, 0xff3fffff, 0xfe3fffff, 0xfc3fffff, 0xf83fffff, 0xf03fffff, 0xe03fffff, 0xc03fffff,
-	0x803fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff,
-	0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff,
-	0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff, 0x003fffff,
-}, {
-	0xff7fffff, 0xfe7fffff, 0xfc7fffff, 0xf87fffff, 0xf07fffff, 0xe07fffff, 0xc07fffff, 0x807fffff,
-	0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff,
-	0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff,
-	0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff, 0x007fffff,
-}, {
-	0xfeffffff, 0xfcffffff, 0xf8ffffff, 0xf0ffffff, 0xe0ffffff, 0xc0ffffff, 0x80ffffff, 0x00ffffff,
-	0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff,
-	0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff,
-	0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff, 0x00ffffff,
-}, {
-	0xfdffffff, 0xf9ffffff, 0xf1ffffff, 0xe1ffffff, 0xc1ffffff, 0x81ffffff, 0x01ffffff, 0x01ffffff,
-	0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff,
-	0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff,
-	0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff, 0x01ffffff,
-}, {
-	0xfbffffff, 0xf3ffffff, 0xe3ffffff, 0xc3ffffff, 0x83ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff,
-	0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff,
-	0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff,
-	0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff, 0x03ffffff,
-}, {
-	0xf7ffffff, 0xe7ffffff, 0xc7ffffff, 0x87ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff,
-	0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff,
-	0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff,
-	0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff, 0x07ffffff,
-}, {
-	0xefffffff, 0xcfffffff, 0x8fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff,
-	0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff,
-	0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff,
-	0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff, 0x0fffffff,
-}, {
-	0xdfffffff, 0x9fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff,
-	0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff,
-	0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff,
-	0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff, 0x1fffffff,
-}, {
-	0xbfffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff,
-	0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff,
-	0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff,
-	0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff, 0x3fffffff,
-}, {
-	0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
-	0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
-	0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
-	0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
-} };
-
-static const uint32_t ExtraMasks[32] =
-{
-	0x00000000, 0x00000001, 0x00000003, 0x00000007, 0x0000000f, 0x0000001f, 0x0000003f, 0x0000007f,
-	0x000000ff, 0x000001ff, 0x000003ff, 0x000007ff, 0x00000fff, 0x00001fff, 0x00003fff, 0x00007fff,
-	0x0000ffff, 0x0001ffff, 0x0003ffff, 0x0007ffff, 0x000fffff, 0x001fffff, 0x003fffff, 0x007fffff,
-	0x00ffffff, 0x01ffffff, 0x03ffffff, 0x07ffffff, 0x0fffffff, 0x1fffffff, 0x3fffffff, 0x7fffffff,
-};
+/*
+=============================================================================
+
+BIT WINDOW
+
+Fields are read and written through a 64-bit little endian window
+that starts at byte holding the first bit, so any field up to 32 bits
+is a single load and store. Near the end of the buffer window is
+built from the bytes that field actually covers
+
+=============================================================================
+*/
+#define MSG_WINDOW_BYTES	sizeof( uint64_t )
+
+static inline uint64_t MSG_LoadWindow( const byte *p )
+{
+#if XASH_BIG_ENDIAN
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+		| (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+#else
+	uint64_t	window;
+
+	memcpy( &window, p, sizeof( window ));
+	return window;
+#endif
+}
+
+static inline void MSG_StoreWindow( byte *p, uint64_t window )
+{
+#if XASH_BIG_ENDIAN
+	int	i;
+
+	for( i = 0; i < MSG_WINDOW_BYTES; i++, window >>= 8 )
+		p[i] = (byte)window;
+#else
+	memcpy( p, &window, sizeof( window ));
+#endif
+}
+
+/*
+=======================
+MSG_PutBits
+
+writes numbits low bits of data at bit position,
+caller checks that they fit into the buffer. Words
+are aligned, so stores of consecutive fields to the
+same word are forwarded to the next load
+=======================
+*/
+static inline void MSG_PutBits( sizebuf_t *sb, int bitpos, uint data, int numbits )
+{
+	int	offset = ( bitpos >> 6 ) << 3;
+	int	shift = bitpos & 63;
+	byte	*p = sb->pData + offset;
+	uint64_t	mask = ( (uint64_t)1 << numbits ) - 1;
+	uint64_t	value = data & mask;
+	int	size = BitByte( sb->nDataBits );
+
+	if( likely( offset + 16 <= size || ( offset + 8 <= size && shift + numbits <= 64 )))
+	{
+		uint64_t	word = MSG_LoadWindow( p );
+
+		MSG_StoreWindow( p, ( word & ~( mask << shift )) | ( value << shift ));
+
+		// spans two words
+		if( shift + numbits > 64 )
+		{
+			word = MSG_LoadWindow( p + 8 );
+			MSG_StoreWindow( p + 8, ( word & ~( mask >> ( 64 - shift ))) | ( value >> ( 64 - shift )));
+		}
+	}
+	else
+	{
+		int	i, numbytes;
+
+		// byte by byte near the end of buffer
+		p = sb->pData + ( bitpos >> 3 );
+		shift = bitpos & 7;
+		numbytes = ( shift + numbits + 7 ) >> 3;
+		mask <<= shift;
+		value <<= shift;
+
+		for( i = 0; i < numbytes; i++ )
+		{
+			byte	bytemask = (byte)( mask >> ( i << 3 ));
+
+			p[i] = ( p[i] & ~bytemask ) | ( (byte)( value >> ( i << 3 )) & bytemask );
+		}
+	}
+}
+
+/*
+=======================
+MSG_GetBits
+
+reads numbits from bit position,
+caller checks that they are inside the buffer
+=======================
+*/
+static inline uint MSG_GetBits( const sizebuf_t *sb, int bitpos, int numbits )
+{
+	const byte	*p = sb->pData + ( bitpos >> 3 );
+	int		shift = bitpos & 7;
+	uint64_t		window = 0;
+
+	if( likely(( bitpos >> 3 ) + MSG_WINDOW_BYTES <= BitByte( sb->nDataBits )))
+	{
+		window = MSG_LoadWindow( p );
+	}
+	else
+	{
+		int	i, numbytes = ( shift + numbits + 7 ) >> 3;
+
+		for( i = 0; i < numbytes; i++ )
+			window |= (uint64_t)p[i] << ( i << 3 );
+	}
+
+	return (uint)(( window >> shift ) & ((( (uint64_t)1 << numbits ) - 1 )));
+}
+
+/*
+=======================
+MSG_CopyToBits
+
+copies whole bytes to bit position that isn't byte aligned,
+bits of the destination around copied ones are kept
+=======================
+*/
+static void MSG_CopyToBits( byte *dst, int shift, const byte *src, int numbytes )
+{
+	uint64_t	carry = dst[0] & ( BIT( shift ) - 1 );
+
+	for( ; numbytes >= MSG_WINDOW_BYTES; numbytes -= MSG_WINDOW_BYTES )
+	{
+		uint64_t	value = MSG_LoadWindow( src );
+
+		MSG_StoreWindow( dst, ( value << shift ) | carry );
+		carry = value >> ( 64 - shift );
+		dst += MSG_WINDOW_BYTES;
+		src += MSG_WINDOW_BYTES;
+	}
+
+	for( ; numbytes > 0; numbytes-- )
+	{
+		*dst++ = (byte)(( *src << shift ) | carry );
+		carry = *src++ >> ( 8 - shift );
+	}
+
+	*dst = ( *dst & ~( BIT( shift ) - 1 )) | (byte)carry;
+}
+
+/*
+=======================
+MSG_CopyFromBits
+
+copies whole bytes from bit position that isn't byte aligned,
+source must have one more byte after them
+=======================
+*/
+static void MSG_CopyFromBits( byte *dst, const byte *src, int shift, int numbytes )
+{
+	for( ; numbytes >= MSG_WINDOW_BYTES; numbytes -= MSG_WINDOW_BYTES )
+	{
+		uint64_t	value = MSG_LoadWindow( src ) >> shift;
+
+		value |= (uint64_t)src[MSG_WINDOW_BYTES] << ( 64 - shift );
+		MSG_StoreWindow( dst, value );
+		dst += MSG_WINDOW_BYTES;
+		src += MSG_WINDOW_BYTES;
+	}
+
+	for( ; numbytes > 0; numbytes--, src++ )
+		*dst++ = (byte)(( src[0] >> shift ) | ( src[1] << ( 8 - shift )));
+}
 
 const char *const svc_strings[svc_lastmsg+1] =
 {
@@ -300,12 +304,6 @@ const char *const svc_quake_strings[svc_lastmsg+1] =
 
 void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
 {
-	int	nBitsLeft = numbits;
-	int	iCurBit = sb->iCurBit;
-	uint	iDWord = iCurBit >> 5;	// Mask in a dword.
-	uint32_t	iCurBitMasked;
-	int	nBitsWritten;
-
 	Assert( numbits >= 1 && numbits <= 32 );
 
 	// bounds checking..
@@ -315,23 +313,7 @@ void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
 		return;
 	}
 
-	iCurBitMasked = iCurBit & 31;
-	((uint32_t *)sb->pData)[iDWord] &= BitWriteMasks[iCurBitMasked][nBitsLeft-1];
-	((uint32_t *)sb->pData)[iDWord] |= curData << iCurBitMasked;
-
-	// did it span a dword?
-	nBitsWritten = 32 - iCurBitMasked;
-
-	if( nBitsWritten < nBitsLeft )
-	{
-		nBitsLeft -= nBitsWritten;
-		iCurBit += nBitsWritten;
-		curData >>= nBitsWritten;
-
-		iCurBitMasked = iCurBit & 31;
-		((uint32_t *)sb->pData)[iDWord+1] &= BitWriteMasks[iCurBitMasked][nBitsLeft-1];
-		((uint32_t *)sb->pData)[iDWord+1] |= curData << iCurBitMasked;
-	}
+	MSG_PutBits( sb, sb->iCurBit, curData, numbits );
 	sb->iCurBit += numbits;
 }
 
@@ -376,46 +358,55 @@ void MSG_WriteBitLong( sizebuf_t *sb, uint data, int numbits, qboolean bSigned )
 
 qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 {
-	byte	*pOut = (byte *)pData;
-	int	nBitsLeft = nBits;
+	const byte	*pOut = (const byte *)pData;
+	int		nBitsLeft = nBits;
 
-	// get output dword-aligned.
-	while((( uintptr_t )pOut & 3 ) != 0 && nBitsLeft >= 8 )
+	if( nBitsLeft <= 0 )
+		return !sb->bOverflow;
+
+	// doesn't fit, write what we can field by field
+	if( sb->bOverflow || sb->iCurBit + nBitsLeft > sb->nDataBits )
 	{
-		MSG_WriteUBitLong( sb, *pOut, 8 );
+		while( nBitsLeft >= 8 )
+		{
+			MSG_WriteUBitLong( sb, *pOut, 8 );
+			nBitsLeft -= 8;
+			++pOut;
+		}
 
-		nBitsLeft -= 8;
-		++pOut;
+		if( nBitsLeft )
+			MSG_WriteUBitLong( sb, *pOut, nBitsLeft );
+
+		return !sb->bOverflow;
 	}
 
-	// read dwords.
-	while( nBitsLeft >= 32 )
+	if(( sb->iCurBit & 7 ) == 0 )
 	{
-		MSG_WriteUBitLong( sb, *(( uint32_t *)pOut ), 32 );
-
-		pOut += sizeof( uint32_t );
-		nBitsLeft -= 32;
+		// byte aligned, plain copy
+		memcpy( sb->pData + ( sb->iCurBit >> 3 ), pOut, nBitsLeft >> 3 );
+		sb->iCurBit += nBitsLeft & ~7;
+		pOut += nBitsLeft >> 3;
+		nBitsLeft &= 7;
 	}
-
-	// read the remaining bytes.
-	while( nBitsLeft >= 8 )
+	else if( nBitsLeft >= 8 )
 	{
-		MSG_WriteUBitLong( sb, *pOut, 8 );
-
-		nBitsLeft -= 8;
-		++pOut;
+		MSG_CopyToBits( sb->pData + ( sb->iCurBit >> 3 ), sb->iCurBit & 7, pOut, nBitsLeft >> 3 );
+		sb->iCurBit += nBitsLeft & ~7;
+		pOut += nBitsLeft >> 3;
+		nBitsLeft &= 7;
 	}
 
-	// Read the remaining bits.
+	// write the remaining bits
 	if( nBitsLeft )
 	{
-		MSG_WriteUBitLong( sb, *pOut, nBitsLeft );
+		MSG_PutBits( sb, sb->iCurBit, *pOut, nBitsLeft );
+		sb->iCurBit += nBitsLeft;
 	}
 
 	return !sb->bOverflow;
 }
 
-void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits )
+uint MSG_BitAngle( float fAngle, int numbits )
 {
 	const uint shift = ( 1 << numbits );
 	const uint mask = shift - 1;
@@ -428,7 +419,12 @@ void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits )
 	d = (int)(( fAngle * shift ) / 360.0f );
 	d &= mask;
 
-	MSG_WriteUBitLong( sb, (uint)d, numbits );
+	return (uint)d;
+}
+
+void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits )
+{
+	MSG_WriteUBitLong( sb, MSG_BitAngle( fAngle, numbits ), numbits );
 }
 
 void MSG_WriteCoord( sizebuf_t *sb, float val )
@@ -567,8 +563,7 @@ int MSG_ReadOneBit( sizebuf_t *sb )
 
 uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
 {
-	int	idword1;
-	uint	dword1, ret;
+	uint	ret;
 
 	if( numbits == 8 )
 	{
@@ -586,29 +581,9 @@ uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
 
 	Assert( numbits > 0 && numbits <= 32 );
 
-	// Read the current dword.
-	idword1 = sb->iCurBit >> 5;
-	dword1 = ((uint *)sb->pData)[idword1];
-	dword1 >>= ( sb->iCurBit & 31 );	// get the bits we're interested in.
-
+	ret = MSG_GetBits( sb, sb->iCurBit, numbits );
 	sb->iCurBit += numbits;
-	ret = dword1;
 
-	// Does it span this dword?
-	if(( sb->iCurBit - 1 ) >> 5 == idword1 )
-	{
-		if( numbits != 32 )
-			ret &= ExtraMasks[numbits];
-	}
-	else
-	{
-		int	nExtraBits = sb->iCurBit & 31;
-		uint	dword2 = ((uint *)sb->pData)[idword1+1] & ExtraMasks[nExtraBits];
-
-		// no need to mask since we hit the end of the dword.
-		// shift the second dword's part into the high bits.
-		ret |= (dword2 << ( numbits - nExtraBits ));
-	}
 	return ret;
 }
 
@@ -617,34 +592,46 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	byte	*pOut = (byte *)pOutData;
 	int	nBitsLeft = nBits;
 
-	// get output dword-aligned.
-	while((( uint32_t )pOut & 3) != 0 && nBitsLeft >= 8 )
+	if( nBitsLeft <= 0 )
+		return !sb->bOverflow;
+
+	// message is truncated, read what we can field by field
+	if( sb->bOverflow || sb->iCurBit + nBitsLeft > sb->nDataBits )
 	{
-		*pOut = (byte)MSG_ReadUBitLong( sb, 8 );
-		++pOut;
-		nBitsLeft -= 8;
+		while( nBitsLeft >= 8 )
+		{
+			*pOut = MSG_ReadUBitLong( sb, 8 );
+			++pOut;
+			nBitsLeft -= 8;
+		}
+
+		if( nBitsLeft )
+			*pOut = MSG_ReadUBitLong( sb, nBitsLeft );
+
+		return !sb->bOverflow;
 	}
 
-	// read dwords.
-	while( nBitsLeft >= 32 )
+	if(( sb->iCurBit & 7 ) == 0 )
 	{
-		*((uint32_t *)pOut) = MSG_ReadUBitLong( sb, 32 );
-		pOut += sizeof( uint32_t );
-		nBitsLeft -= 32;
+		// byte aligned, plain copy
+		memcpy( pOut, sb->pData + ( sb->iCurBit >> 3 ), nBitsLeft >> 3 );
+		sb->iCurBit += nBitsLeft & ~7;
+		pOut += nBitsLeft >> 3;
+		nBitsLeft &= 7;
 	}
-
-	// read the remaining bytes.
-	while( nBitsLeft >= 8 )
+	else if( nBitsLeft >= 8 )
 	{
-		*pOut = MSG_ReadUBitLong( sb, 8 );
-		++pOut;
-		nBitsLeft -= 8;
+		MSG_CopyFromBits( pOut, sb->pData + ( sb->iCurBit >> 3 ), sb->iCurBit & 7, nBitsLeft >> 3 );
+		sb->iCurBit += nBitsLeft & ~7;
+		pOut += nBitsLeft >> 3;
+		nBitsLeft &= 7;
 	}
 
-	// read the remaining bits.
+	// read the remaining bits
 	if( nBitsLeft )
 	{
-		*pOut = MSG_ReadUBitLong( sb, nBitsLeft );
+		*pOut = MSG_GetBits( sb, sb->iCurBit, nBitsLeft );
+		sb->iCurBit += nBitsLeft;
 	}
 
 	return !sb->bOverflow;
@@ -996,12 +983,193 @@ static void Test_Buffer_ExciseBits( void )
 	TASSERT_EQi( MSG_ReadUBitLong( &sb, 4 ), 0xa );
 }
 
+#define TEST_BUFFER_FIELDS	0x10000
+#define TEST_BUFFER_PASSES	32
+
+static uint	g_fieldvalues[TEST_BUFFER_FIELDS];
+static byte	g_fieldbits[TEST_BUFFER_FIELDS];
+static byte	g_fieldbuf[TEST_BUFFER_FIELDS * 4 + 8];
+static int	g_fieldtotal;
+
+static void Test_Buffer_GenerateFields( void )
+{
+	int	i;
+
+	g_fieldtotal = 0;
+
+	for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+	{
+		uint	value = ((uint)COM_RandomLong( 0, 0xffff ) << 16 ) | COM_RandomLong( 0, 0xffff );
+
+		// mostly short fields, like in delta messages
+		g_fieldbits[i] = ( i & 3 ) ? COM_RandomLong( 1, 16 ) : COM_RandomLong( 1, 32 );
+		g_fieldvalues[i] = g_fieldbits[i] < 32 ? value & ( BIT( g_fieldbits[i] ) - 1 ) : value;
+		g_fieldtotal += g_fieldbits[i];
+	}
+}
+
+static void Test_Buffer_Fields( void )
+{
+	sizebuf_t	sb;
+	int	i, j, errors = 0;
+
+	memset( g_fieldbuf, 0xa5, sizeof( g_fieldbuf ));
+	MSG_Init( &sb, __func__, g_fieldbuf, sizeof( g_fieldbuf ));
+
+	for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+		MSG_WriteUBitLong( &sb, g_fieldvalues[i], g_fieldbits[i] );
+
+	TASSERT_EQi( MSG_GetNumBitsWritten( &sb ), g_fieldtotal );
+	TASSERT( !MSG_CheckOverflow( &sb ));
+
+	// bit by bit reader as reference
+	MSG_StartReading( &sb, g_fieldbuf, -1, 0, g_fieldtotal );
+
+	for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+	{
+		uint	value = 0;
+
+		for( j = 0; j < g_fieldbits[i]; j++ )
+			value |= (uint)MSG_ReadOneBit( &sb ) << j;
+
+		if( value != g_fieldvalues[i] )
+			errors++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+
+	MSG_SeekToBit( &sb, 0, SEEK_SET );
+
+	for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+	{
+		if( MSG_ReadUBitLong( &sb, g_fieldbits[i] ) != g_fieldvalues[i] )
+			errors++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+	TASSERT_EQi( MSG_GetNumBitsRead( &sb ), g_fieldtotal );
+	TASSERT( !MSG_CheckOverflow( &sb ));
+}
+
+static void Test_Buffer_CopyBits( void )
+{
+	byte	src[64], dst[sizeof( src ) + 8], out[sizeof( src )];
+	int	ofs, len, i, errors = 0;
+	sizebuf_t	sb;
+
+	for( i = 0; i < sizeof( src ); i++ )
+		src[i] = COM_RandomLong( 0, 255 );
+
+	for( ofs = 0; ofs < 16; ofs++ )
+	{
+		for( len = 0; len <= sizeof( src ) * 8; len += 7 )
+		{
+			memset( dst, 0xa5, sizeof( dst ));
+			MSG_Init( &sb, __func__, dst, sizeof( dst ));
+
+			for( i = 0; i < ofs; i++ )
+				MSG_WriteOneBit( &sb, i & 1 );
+
+			MSG_WriteBits( &sb, src, len );
+			MSG_WriteUBitLong( &sb, 0x15, 5 );
+
+			if( MSG_GetNumBitsWritten( &sb ) != ofs + len + 5 )
+				errors++;
+
+			MSG_SeekToBit( &sb, 0, SEEK_SET );
+
+			for( i = 0; i < ofs; i++ )
+				errors += MSG_ReadOneBit( &sb ) != ( i & 1 );
+
+			for( i = 0; i < len; i++ )
+				errors += MSG_ReadOneBit( &sb ) != (( src[i >> 3] >> ( i & 7 )) & 1 );
+
+			errors += MSG_ReadUBitLong( &sb, 5 ) != 0x15;
+
+			MSG_SeekToBit( &sb, ofs, SEEK_SET );
+			memset( out, 0, sizeof( out ));
+			MSG_ReadBits( &sb, out, len );
+
+			errors += memcmp( out, src, len >> 3 ) != 0;
+			if( len & 7 ) errors += out[len >> 3] != ( src[len >> 3] & ( BIT( len & 7 ) - 1 ));
+		}
+	}
+
+	TASSERT_EQi( errors, 0 );
+}
+
+static void Test_Buffer_Throughput( void )
+{
+	static byte	payload[1400];
+	double	start, write_time, read_time, copy_time[2];
+	sizebuf_t	sb;
+	uint	expected = 0, mismatches = 0;
+	int	pass, i;
+
+	for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+		expected += g_fieldvalues[i];
+
+	start = Sys_DoubleTime();
+	for( pass = 0; pass < TEST_BUFFER_PASSES; pass++ )
+	{
+		MSG_Init( &sb, __func__, g_fieldbuf, sizeof( g_fieldbuf ));
+
+		for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+			MSG_WriteUBitLong( &sb, g_fieldvalues[i], g_fieldbits[i] );
+	}
+	write_time = Sys_DoubleTime() - start;
+
+	start = Sys_DoubleTime();
+	for( pass = 0; pass < TEST_BUFFER_PASSES; pass++ )
+	{
+		uint	sum = 0;
+
+		MSG_StartReading( &sb, g_fieldbuf, -1, 0, g_fieldtotal );
+
+		for( i = 0; i < TEST_BUFFER_FIELDS; i++ )
+			sum += MSG_ReadUBitLong( &sb, g_fieldbits[i] );
+
+		// keeps reads from being optimized out, must be same as written
+		if( sum != expected )
+			mismatches++;
+	}
+	read_time = Sys_DoubleTime() - start;
+
+	TASSERT_EQi( mismatches, 0 );
+
+	// datagram sized copies, like snapshot trailers and memo deltas
+	for( i = 0; i < 2; i++ )
+	{
+		start = Sys_DoubleTime();
+		for( pass = 0; pass < TEST_BUFFER_PASSES; pass++ )
+		{
+			MSG_Init( &sb, __func__, g_fieldbuf, sizeof( g_fieldbuf ));
+			MSG_SeekToBit( &sb, i * 3, SEEK_SET );
+
+			while( MSG_GetNumBytesLeft( &sb ) > sizeof( payload ) + 1 )
+				MSG_WriteBits( &sb, payload, sizeof( payload ) * 8 );
+		}
+		copy_time[i] = Sys_DoubleTime() - start;
+	}
+
+	Con_Printf( "%s: write %.2f ns, read %.2f ns per field, copy %.0f MB/s aligned, %.0f MB/s unaligned\n", __func__,
+		write_time * 1e9 / ( TEST_BUFFER_FIELDS * TEST_BUFFER_PASSES ),
+		read_time * 1e9 / ( TEST_BUFFER_FIELDS * TEST_BUFFER_PASSES ),
+		sizeof( g_fieldbuf ) * TEST_BUFFER_PASSES / copy_time[0] / ( 1 << 20 ),
+		sizeof( g_fieldbuf ) * TEST_BUFFER_PASSES / copy_time[1] / ( 1 << 20 ));
+}
+
 void Test_RunBuffer( void )
 {
 	TRUN( Test_Buffer_BitByte( ));
 	TRUN( Test_Buffer_Write( ));
 	TRUN( Test_Buffer_Read( ));
 	TRUN( Test_Buffer_ExciseBits( ));
+
+	Test_Buffer_GenerateFields();
+	TRUN( Test_Buffer_Fields( ));
+	TRUN( Test_Buffer_CopyBits( ));
+	TRUN( Test_Buffer_Throughput( ));
 }
 
 #endif // XASH_ENGINE_TESTS
@@ -212,6 +212,84 @@ void MSG_WriteSBitLong( sizebuf_t *sb, int data, int numbits );
 void MSG_WriteBitLong( sizebuf_t *sb, uint data, int numbits, qboolean bSigned );
 qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits );
 void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits );
+uint MSG_BitAngle( float fAngle, int numbits );
+
+// collects bits in a register and stores them 32 at a time, for long
+// runs of small fields. Sizebuf is only up to date after MSG_FlushBitWriter
+typedef struct bitwriter_s
+{
+	sizebuf_t	*sb;
+	uint64_t	bits;	// pending bits, first one is the lowest
+	int	numbits;	// always less than 32 between calls
+} bitwriter_t;
+
+static inline void MSG_BeginBitWriter( bitwriter_t *bw, sizebuf_t *sb )
+{
+	bw->sb = sb;
+	bw->bits = 0;
+	bw->numbits = 0;
+}
+
+static inline void MSG_PutUBitLong( bitwriter_t *bw, uint data, int numbits )
+{
+	Assert( numbits >= 1 && numbits <= 32 );
+
+	bw->bits |= (uint64_t)( data & ( 0xffffffffU >> ( 32 - numbits ))) << bw->numbits;
+	bw->numbits += numbits;
+
+	if( bw->numbits >= 32 )
+	{
+		MSG_WriteUBitLong( bw->sb, (uint)bw->bits, 32 );
+		bw->bits >>= 32;
+		bw->numbits -= 32;
+	}
+}
+
+// same encoding as MSG_WriteSBitLong
+static inline void MSG_PutSBitLong( bitwriter_t *bw, int data, int numbits )
+{
+	if( bw->sb->iAlternateSign )
+	{
+		MSG_PutUBitLong( bw, data < 0 ? 1 : 0, 1 );
+		MSG_PutUBitLong( bw, (uint)abs( data ), numbits - 1 );
+	}
+	else if( data < 0 )
+	{
+		MSG_PutUBitLong( bw, (uint)( 0x80000000 + data ), numbits - 1 );
+		MSG_PutUBitLong( bw, 1, 1 );
+	}
+	else
+	{
+		MSG_PutUBitLong( bw, (uint)data, numbits - 1 );
+		MSG_PutUBitLong( bw, 0, 1 );
+	}
+}
+
+static inline void MSG_PutBitLong( bitwriter_t *bw, uint data, int numbits, qboolean bSigned )
+{
+	if( bSigned )
+		MSG_PutSBitLong( bw, (int)data, numbits );
+	else MSG_PutUBitLong( bw, data, numbits );
+}
+
+static inline void MSG_PutOneBit( bitwriter_t *bw, int nValue )
+{
+	MSG_PutUBitLong( bw, nValue ? 1 : 0, 1 );
+}
+
+static inline void MSG_PutBitAngle( bitwriter_t *bw, float fAngle, int numbits )
+{
+	MSG_PutUBitLong( bw, MSG_BitAngle( fAngle, numbits ), numbits );
+}
+
+static inline void MSG_FlushBitWriter( bitwriter_t *bw )
+{
+	if( bw->numbits > 0 )
+		MSG_WriteUBitLong( bw->sb, (uint)bw->bits, bw->numbits );
+
+	bw->bits = 0;
+	bw->numbits = 0;
+}
 
 // Byte-write functions
 #define MSG_BeginServerCmd( sb, cmd ) MSG_WriteCmdExt( sb, cmd, NS_SERVER, NULL )
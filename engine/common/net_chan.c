@@ -34,7 +34,6 @@ GNU General Public License for more details.
 
 // forward declarations
 void Netchan_FlushIncoming( netchan_t *chan, int stream );
-void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf );
 
 /*
 packet header ( size in bits )
@@ -93,11 +92,39 @@ static CVAR_DEFINE_AUTO( net_showdrop, "0", 0, "show packets that are dropped" )
 static CVAR_DEFINE_AUTO( net_qport, "0", FCVAR_READ_ONLY, "current quake netport" );
 CVAR_DEFINE_AUTO( net_send_debug, "0", FCVAR_PRIVILEGED, "enable debugging output for outgoing messages" );
 CVAR_DEFINE_AUTO( net_recv_debug, "0", FCVAR_PRIVILEGED, "enable debugging output for incoming messages" );
+static CVAR_DEFINE_AUTO( net_filebuffer, "1048576", FCVAR_ARCHIVE, "maximum bytes of file fragments read ahead for all file transfers" );
 
 int	net_drop;
 netadr_t	net_from;
 sizebuf_t	net_message;
 static poolhandle_t net_mempool;
+
+#define FRAGBUF_MIN_SHIFT	9	// smallest pooled buffer is 512 bytes
+#define FRAGBUF_CLASSES	8	// up to 64k, enough for NET_MAX_FRAGMENT
+#define FRAGBUF_MAX_SIZE	BIT( FRAGBUF_MIN_SHIFT + FRAGBUF_CLASSES - 1 )
+#define FRAGBUF_SLAB_SIZE	0x10000	// bytes of buffers allocated at once
+#define FRAGFILE_WINDOW	8	// fragments read ahead per file transfer
+
+// block of equally sized fragment buffers
+typedef struct fragslab_s
+{
+	struct fragslab_s	*prev, *next;	// slabs of same class with free buffers
+	fragbuf_t		*free;
+	int		used;
+	int		count;
+	int		cls;
+} fragslab_t;
+
+#define FRAGSLAB_HEADER	(( sizeof( fragslab_t ) + 15 ) & ~15 )
+
+static struct
+{
+	fragslab_t	*partial[FRAGBUF_CLASSES];	// slabs that have free buffers
+	fragslab_t	*cached[FRAGBUF_CLASSES];	// one unused slab is kept to not thrash
+	int	numslabs;
+	int	filebuffered;	// bytes of file fragments read ahead
+	int	numfiles;		// file transfers in progress
+} fragpool;
 byte	net_message_buffer[NET_MAX_MESSAGE];
 
 static const char *const ns_strings[NS_COUNT] =
@@ -249,6 +276,188 @@ qboolean NetSplit_GetLong( netsplit_t *ns, netadr_t *from, byte *data, size_t *l
 	return false;
 }
 
+typedef enum
+{
+	NET_COMPRESS_LZSS = 0,
+	NET_COMPRESS_LZ4,
+#if !XASH_DEDICATED
+	NET_COMPRESS_BZ2,
+#endif
+	NET_COMPRESS_COUNT
+} net_compressor_t;
+
+static const char *const net_compressor_names[NET_COMPRESS_COUNT] =
+{
+	"lzss",
+	"lz4",
+#if !XASH_DEDICATED
+	"bz2",
+#endif
+};
+
+typedef struct
+{
+	double	ctime;
+	double	dtime;
+	size_t	insize;
+	size_t	outsize;
+} net_compressstat_t;
+
+/*
+===============
+Netchan_CompressBenchFile
+
+compress and decompress one buffer with given method,
+incompressible data counts as stored
+===============
+*/
+static void Netchan_CompressBenchFile( net_compressor_t method, byte *data, int size, byte *out, net_compressstat_t *stat )
+{
+	double	start = Sys_DoubleTime();
+	uint	outsize = 0;
+	byte	*packed = NULL;
+	uint	result = 0;
+
+	switch( method )
+	{
+	case NET_COMPRESS_LZSS:
+		packed = LZSS_Compress( data, size, &outsize );
+		break;
+	case NET_COMPRESS_LZ4:
+		packed = LZ4_Compress( data, size, &outsize );
+		break;
+#if !XASH_DEDICATED
+	case NET_COMPRESS_BZ2:
+		outsize = size;
+		packed = malloc( size );
+		if( packed && BZ2_bzBuffToBuffCompress( (char *)packed, &outsize, (char *)data, size, 9, 0, 30 ) != BZ_OK )
+		{
+			free( packed );
+			packed = NULL;
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+
+	stat->ctime += Sys_DoubleTime() - start;
+	stat->insize += size;
+
+	if( !packed )
+	{
+		stat->outsize += size;
+		return;
+	}
+
+	start = Sys_DoubleTime();
+
+	switch( method )
+	{
+	case NET_COMPRESS_LZSS:
+		result = LZSS_Decompress( packed, out, outsize, size );
+		break;
+	case NET_COMPRESS_LZ4:
+		result = LZ4_Decompress( packed, out, outsize, size );
+		break;
+#if !XASH_DEDICATED
+	case NET_COMPRESS_BZ2:
+		result = size;
+		if( BZ2_bzBuffToBuffDecompress( (char *)out, &result, (char *)packed, outsize, 0, 0 ) != BZ_OK )
+			result = 0;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	stat->dtime += Sys_DoubleTime() - start;
+	stat->outsize += outsize;
+
+	if( result != size || memcmp( data, out, size ))
+		Con_Printf( S_ERROR "%s: %s round trip failed\n", __func__, net_compressor_names[method] );
+
+	free( packed );
+}
+
+/*
+===============
+Netchan_CompressBench_f
+
+net_compressbench [wildcard] - compare netchan compressors on
+game files, by default on map resource lists and BSPs
+===============
+*/
+static void Netchan_CompressBench_f( void )
+{
+	static const char *const defaults[] = { "maps/*.res", "maps/*.bsp" };
+	net_compressstat_t	stats[NET_COMPRESS_COUNT];
+	const char	*const *patterns = defaults;
+	int		numpatterns = ARRAYSIZE( defaults );
+	const char	*arg;
+	int		i, j, method, numfiles = 0;
+
+	if( Cmd_Argc() > 1 )
+	{
+		arg = Cmd_Argv( 1 );
+		patterns = &arg;
+		numpatterns = 1;
+	}
+
+	memset( stats, 0, sizeof( stats ));
+
+	for( i = 0; i < numpatterns; i++ )
+	{
+		search_t	*t = FS_Search( patterns[i], true, false );
+
+		if( !t )
+			continue;
+
+		for( j = 0; j < t->numfilenames; j++ )
+		{
+			fs_offset_t	size;
+			byte		*data, *out;
+
+			data = FS_LoadFile( t->filenames[j], &size, false );
+
+			if( !data || size <= 0 || size > 0x4000000 )
+			{
+				if( data ) Mem_Free( data );
+				continue;
+			}
+
+			out = Mem_Malloc( net_mempool, size );
+
+			for( method = 0; method < NET_COMPRESS_COUNT; method++ )
+				Netchan_CompressBenchFile( method, data, size, out, &stats[method] );
+
+			Mem_Free( out );
+			Mem_Free( data );
+			numfiles++;
+		}
+
+		Mem_Free( t );
+	}
+
+	if( !numfiles )
+	{
+		Con_Printf( "Usage: net_compressbench [wildcard], no files found\n" );
+		return;
+	}
+
+	Con_Printf( "%i files, %s\n", numfiles, Q_memprint( stats[0].insize ));
+
+	for( method = 0; method < NET_COMPRESS_COUNT; method++ )
+	{
+		const net_compressstat_t *st = &stats[method];
+
+		Con_Printf( "%5s: %5.1f%%, compress %.1f ms (%.1f MB/s), decompress %.1f ms (%.1f MB/s)\n",
+			net_compressor_names[method], st->outsize * 100.0 / st->insize,
+			st->ctime * 1000.0, st->insize / ( Q_max( st->ctime, 0.000001 ) * 1048576.0 ),
+			st->dtime * 1000.0, st->insize / ( Q_max( st->dtime, 0.000001 ) * 1048576.0 ));
+	}
+}
+
 /*
 ===============
 Netchan_Init
@@ -269,7 +478,9 @@ void Netchan_Init( void )
 	Cvar_RegisterVariable( &net_qport );
 	Cvar_RegisterVariable( &net_send_debug );
 	Cvar_RegisterVariable( &net_recv_debug );
+	Cvar_RegisterVariable( &net_filebuffer );
 	Cvar_FullSet( net_qport.name, buf, net_qport.flags );
+	Cmd_AddCommand( "net_compressbench", Netchan_CompressBench_f, "compare netchan compressors on game files" );
 
 	net_mempool = Mem_AllocPool( "Network Pool" );
 }
@@ -277,6 +488,7 @@ void Netchan_Init( void )
 void Netchan_Shutdown( void )
 {
 	Mem_FreePool( &net_mempool );
+	memset( &fragpool, 0, sizeof( fragpool ));
 }
 
 void Netchan_ReportFlow( netchan_t *chan )
@@ -342,6 +554,7 @@ void Netchan_Setup( netsrc_t sock, netchan_t *chan, netadr_t adr, int qport, voi
 	chan->use_munge = FBitSet( flags, NETCHAN_USE_MUNGE ) ? true : false;
 	chan->use_bz2 = FBitSet( flags, NETCHAN_USE_BZIP2 ) ? true : false;
 	chan->use_lzss = FBitSet( flags, NETCHAN_USE_LZSS ) ? true : false;
+	chan->use_lz4 = FBitSet( flags, NETCHAN_USE_LZ4 ) ? true : false;
 	chan->gs_netchan = FBitSet( flags, NETCHAN_GOLDSRC ) ? true : false;
 
 	MSG_Init( &chan->message, "NetData", chan->message_buf, sizeof( chan->message_buf ));
@@ -385,6 +598,182 @@ qboolean Netchan_CanPacket( netchan_t *chan, qboolean choke )
 	return chan->cleartime < host.realtime ? true : false;
 }
 
+/*
+==============================
+Netchan_ByteTime
+
+seconds it takes to send one byte at channel rate
+==============================
+*/
+static double Netchan_ByteTime( netchan_t *chan )
+{
+	if( SV_Active() && sv_lan.value && sv_lan_rate.value > 1000.0f )
+		return 1.0 / sv_lan_rate.value;
+	return 1.0 / chan->rate;
+}
+
+/*
+==============================
+Netchan_AvailableBytes
+
+bytes that can be sent right now so that channel is clear again
+by nexttime, host.realtime allows no debt. Negative while choked
+==============================
+*/
+int Netchan_AvailableBytes( netchan_t *chan, double nexttime )
+{
+	double	cleartime, bytes;
+
+	// loopback is never choked
+	if( !net_chokeloop.value && NET_IsLocalAddress( chan->remote_address ))
+		return NET_MAX_MESSAGE;
+
+	// same burst limit as Netchan_TransmitBits, idle time isn't saved up beyond it
+	cleartime = Q_max( chan->cleartime, host.realtime - chan->rateburst );
+	bytes = ( Q_max( nexttime, host.realtime ) - cleartime ) / Netchan_ByteTime( chan );
+
+	return (int)bound( -NET_MAX_MESSAGE, bytes, NET_MAX_MESSAGE );
+}
+
+/*
+==============================
+Netchan_NextFragmentSize
+
+size of fragment that will be sent next on the stream, zero if none
+==============================
+*/
+int Netchan_NextFragmentSize( netchan_t *chan, int stream )
+{
+	fragbufwaiting_t	*wait = chan->waitlist[stream];
+
+	if( chan->fragbufs[stream] )
+		return MSG_GetNumBytesWritten( &chan->fragbufs[stream]->frag_message );
+
+	if( stream == FRAG_FILE_STREAM && chan->fragfile && chan->fragfile->remaining > 0 )
+		return chan->fragfile->chunksize;
+
+	if( !wait )
+		return 0;
+
+	if( wait->fragbufs )
+		return MSG_GetNumBytesWritten( &wait->fragbufs->frag_message );
+
+	return wait->file ? wait->file->chunksize : 0;
+}
+
+static int Netchan_FragbufClass( int fragment_size )
+{
+	int	c = 0;
+
+	while( c < FRAGBUF_CLASSES - 1 && BIT( FRAGBUF_MIN_SHIFT + c ) < fragment_size )
+		c++;
+
+	return c;
+}
+
+static void Netchan_LinkSlab( fragslab_t *slab )
+{
+	slab->prev = NULL;
+	slab->next = fragpool.partial[slab->cls];
+
+	if( slab->next )
+		slab->next->prev = slab;
+	fragpool.partial[slab->cls] = slab;
+}
+
+static void Netchan_UnlinkSlab( fragslab_t *slab )
+{
+	if( slab->prev )
+		slab->prev->next = slab->next;
+	else fragpool.partial[slab->cls] = slab->next;
+
+	if( slab->next )
+		slab->next->prev = slab->prev;
+	slab->prev = slab->next = NULL;
+}
+
+/*
+==============================
+Netchan_AllocSlab
+
+carves new block into buffers of given class
+==============================
+*/
+static fragslab_t *Netchan_AllocSlab( int c )
+{
+	size_t	stride = sizeof( fragbuf_t ) + BIT( FRAGBUF_MIN_SHIFT + c );
+	int	i, count = Q_max( 1, FRAGBUF_SLAB_SIZE / stride );
+	fragslab_t	*slab;
+	byte	*p;
+
+	slab = (fragslab_t *)Mem_Malloc( net_mempool, FRAGSLAB_HEADER + stride * count );
+	memset( slab, 0, sizeof( *slab ));
+	slab->count = count;
+	slab->cls = c;
+
+	p = (byte *)slab + FRAGSLAB_HEADER + stride * ( count - 1 );
+
+	for( i = 0; i < count; i++, p -= stride )
+	{
+		fragbuf_t	*buf = (fragbuf_t *)p;
+
+		buf->next = slab->free;
+		slab->free = buf;
+	}
+
+	fragpool.numslabs++;
+
+	return slab;
+}
+
+/*
+==============================
+Netchan_FreeFragbuf
+
+returns buffer to the pool
+==============================
+*/
+static void Netchan_FreeFragbuf( fragbuf_t *buf )
+{
+	fragslab_t	*slab = buf->slab;
+
+	// streamed file fragments count against read ahead limit
+	if( buf->isfile && !buf->isbuffer )
+		fragpool.filebuffered -= MSG_GetMaxBytes( &buf->frag_message );
+
+	// slab was full, make it available again
+	if( !slab->free )
+		Netchan_LinkSlab( slab );
+
+	buf->next = slab->free;
+	slab->free = buf;
+
+	if( --slab->used > 0 )
+		return;
+
+	Netchan_UnlinkSlab( slab );
+
+	if( !fragpool.cached[slab->cls] )
+	{
+		fragpool.cached[slab->cls] = slab;
+		return;
+	}
+
+	Mem_Free( slab );
+	fragpool.numslabs--;
+}
+
+static void Netchan_FreeFragfile( fragfile_t *ff )
+{
+	if( ff->file )
+	{
+		FS_Close( ff->file );
+		fragpool.numfiles--;
+	}
+
+	Mem_Free( ff );
+}
+
 /*
 ==============================
 Netchan_UnlinkFragment
@@ -404,7 +793,7 @@ static void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 		*list = buf->next;
 
 		// destroy remnant
-		Mem_Free( buf );
+		Netchan_FreeFragbuf( buf );
 		return;
 	}
 
@@ -416,7 +805,7 @@ static void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 			search->next = buf->next;
 
 			// destroy remnant
-			Mem_Free( buf );
+			Netchan_FreeFragbuf( buf );
 			return;
 		}
 		search = search->next;
@@ -441,13 +830,37 @@ static void Netchan_ClearFragbufs( fragbuf_t **ppbuf )
 	while( buf )
 	{
 		n = buf->next;
-		Mem_Free( buf );
+		Netchan_FreeFragbuf( buf );
 		buf = n;
 	}
 
 	*ppbuf = NULL;
 }
 
+/*
+==============================
+Netchan_ReleaseIncoming
+
+frees partially received message
+==============================
+*/
+static void Netchan_ReleaseIncoming( netchan_t *chan, int stream )
+{
+	int	i;
+
+	for( i = 1; i <= chan->incomingtotal[stream]; i++ )
+	{
+		if( chan->incomingbufs[stream][i] )
+		{
+			Netchan_FreeFragbuf( chan->incomingbufs[stream][i] );
+			chan->incomingbufs[stream][i] = NULL;
+		}
+	}
+
+	chan->incomingtotal[stream] = 0;
+	chan->incomingcount[stream] = 0;
+}
+
 /*
 ==============================
 Netchan_ClearFragments
@@ -467,6 +880,8 @@ static void Netchan_ClearFragments( netchan_t *chan )
 		{
 			next = wait->next;
 			Netchan_ClearFragbufs( &wait->fragbufs );
+			if( wait->file )
+				Netchan_FreeFragfile( wait->file );
 			Mem_Free( wait );
 			wait = next;
 		}
@@ -475,6 +890,12 @@ static void Netchan_ClearFragments( netchan_t *chan )
 		Netchan_ClearFragbufs( &chan->fragbufs[i] );
 		Netchan_FlushIncoming( chan, i );
 	}
+
+	if( chan->fragfile )
+	{
+		Netchan_FreeFragfile( chan->fragfile );
+		chan->fragfile = NULL;
+	}
 }
 
 /*
@@ -500,6 +921,13 @@ void Netchan_Clear( netchan_t *chan )
 		chan->frag_startpos[i] = 0;
 		chan->frag_length[i] = 0;
 		chan->incomingready[i] = false;
+
+		if( chan->incomingbufs[i] )
+		{
+			Mem_Free( chan->incomingbufs[i] );
+			chan->incomingbufs[i] = NULL;
+		}
+		chan->incomingsize[i] = 0;
 	}
 
 	if( chan->tempbuffer )
@@ -569,13 +997,42 @@ void Netchan_OutOfBandPrint( int net_socket, netadr_t adr, const char *fmt, ...
 ==============================
 Netchan_AllocFragbuf
 
+takes buffer of matching size class from the pool,
+returns NULL if fragment doesn't fit into the biggest class
 ==============================
 */
 static fragbuf_t *Netchan_AllocFragbuf( int fragment_size )
 {
+	int	c = Netchan_FragbufClass( fragment_size );
+	fragslab_t	*slab = fragpool.partial[c];
 	fragbuf_t	*buf;
 
-	buf = (fragbuf_t *)Mem_Calloc( net_mempool, sizeof( fragbuf_t ) + fragment_size );
+	if( fragment_size < 0 || fragment_size > FRAGBUF_MAX_SIZE )
+		return NULL;
+
+	if( !slab )
+	{
+		if( fragpool.cached[c] )
+		{
+			slab = fragpool.cached[c];
+			fragpool.cached[c] = NULL;
+		}
+		else slab = Netchan_AllocSlab( c );
+
+		Netchan_LinkSlab( slab );
+	}
+
+	buf = slab->free;
+	slab->free = buf->next;
+	slab->used++;
+
+	// slab is full, don't look at it until something is freed
+	if( !slab->free )
+		Netchan_UnlinkSlab( slab );
+
+	memset( buf, 0, sizeof( *buf ));
+	buf->slab = slab;
+
 	MSG_Init( &buf->frag_message, "Frag Message", buf->frag_message_buf, fragment_size );
 
 	return buf;
@@ -589,19 +1046,14 @@ Netchan_AddFragbufToTail
 */
 static void Netchan_AddFragbufToTail( fragbufwaiting_t *wait, fragbuf_t *buf )
 {
-	fragbuf_t *p;
-
 	buf->next = NULL;
 	wait->fragbufcount++;
-	p = wait->fragbufs;
 
-	if( p )
-	{
-		while( p->next )
-			p = p->next;
-		p->next = buf;
-	}
+	if( wait->lastbuf )
+		wait->lastbuf->next = buf;
 	else wait->fragbufs = buf;
+
+	wait->lastbuf = buf;
 }
 
 /*
@@ -645,84 +1097,131 @@ static void Netchan_UpdateFlow( netchan_t *chan )
 
 /*
 ==============================
-Netchan_FragSend
+Netchan_ReadFileFragments
 
-Fragmentation buffer is full and user is prepared to send
+reads next fragments of the file being sent, each transfer
+may keep fair share of net_filebuffer bytes read ahead but
+always gets at least one fragment to not stall
 ==============================
 */
-void Netchan_FragSend( netchan_t *chan )
+static void Netchan_ReadFileFragments( netchan_t *chan )
 {
-	fragbufwaiting_t	*wait;
-	int		i;
+	fragfile_t	*ff = chan->fragfile;
+	fragbuf_t		**tail = &chan->fragbufs[FRAG_FILE_STREAM];
+	int		window, buffered = 0;
 
-	if( !chan ) return;
+	if( !ff->file )
+	{
+		ff->file = FS_Open( ff->diskname, "rb", false );
 
-	for( i = 0; i < MAX_STREAMS; i++ )
+		if( ff->file )
+			fragpool.numfiles++;
+		else Con_Printf( S_ERROR "%s: unable to open %s, sending zeroes\n", __func__, ff->diskname );
+	}
+
+	for( ; *tail; tail = &(*tail)->next )
+		buffered += MSG_GetMaxBytes( &(*tail)->frag_message );
+
+	window = net_filebuffer.value / Q_max( fragpool.numfiles, 1 );
+	window = bound( ff->chunksize, window, ff->chunksize * FRAGFILE_WINDOW );
+
+	while( ff->remaining > 0 && buffered < window )
 	{
-		// already something queued up, just leave in waitlist
-		if( chan->fragbufs[i] ) continue;
+		int		namelen = 0, send, size, got = 0;
+		fragbuf_t		*buf;
 
-		wait = chan->waitlist[i];
+		// first fragment starts with file name
+		if( ff->bufferid == 1 )
+			namelen = Q_strlen( ff->filename ) + 1;
 
-		// nothing to queue?
-		if( !wait ) continue;
+		send = Q_min( ff->remaining, ff->chunksize - namelen );
+		size = namelen + send;
 
-		chan->waitlist[i] = wait->next;
+		if( buffered && fragpool.filebuffered + size > net_filebuffer.value )
+			break;
 
-		wait->next = NULL;
+		buf = Netchan_AllocFragbuf( size );
+		buf->bufferid = ff->bufferid++;
+		buf->isfile = true;
 
-		// copy in to fragbuf
-		chan->fragbufs[i] = wait->fragbufs;
-		chan->fragbufcount[i] = wait->fragbufcount;
+		if( namelen )
+			MSG_WriteString( &buf->frag_message, ff->filename );
 
-		// throw away wait list
-		Mem_Free( wait );
+		if( ff->file )
+			got = (int)FS_Read( ff->file, buf->frag_message_buf + namelen, send );
+
+		if( got < 0 ) got = 0;
+
+		// file was changed or removed, fragment count is already sent
+		if( got < send )
+			memset( buf->frag_message_buf + namelen + got, 0, send - got );
+
+		MSG_SeekToBit( &buf->frag_message, size << 3, SEEK_SET );
+
+		ff->remaining -= send;
+		fragpool.filebuffered += size;
+		buffered += size;
+
+		*tail = buf;
+		tail = &buf->next;
 	}
 }
 
 /*
 ==============================
-Netchan_AddBufferToList
+Netchan_FragSend
 
+Fragmentation buffer is full and user is prepared to send
 ==============================
 */
-void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf )
+void Netchan_FragSend( netchan_t *chan )
 {
-	// Find best slot
-	fragbuf_t	*pprev, *n;
-	int	id1, id2;
+	fragbufwaiting_t	*wait;
+	int		i;
 
-	pbuf->next = NULL;
+	if( !chan ) return;
 
-	if( !pplist )
-		return;
+	for( i = 0; i < MAX_STREAMS; i++ )
+	{
+		// top up read ahead of the file being sent
+		if( i == FRAG_FILE_STREAM && chan->fragfile )
+		{
+			if( chan->fragfile->remaining > 0 )
+			{
+				Netchan_ReadFileFragments( chan );
+			}
+			else if( !chan->fragbufs[i] )
+			{
+				Netchan_FreeFragfile( chan->fragfile );
+				chan->fragfile = NULL;
+			}
+		}
+
+		// already something queued up, just leave in waitlist
+		if( chan->fragbufs[i] ) continue;
+
+		wait = chan->waitlist[i];
+
+		// nothing to queue?
+		if( !wait ) continue;
+
+		chan->waitlist[i] = wait->next;
 
-	if( !*pplist )
-	{
-		pbuf->next = *pplist;
-		*pplist = pbuf;
-		return;
-	}
+		wait->next = NULL;
 
-	pprev = *pplist;
-	while( pprev->next )
-	{
-		n = pprev->next; // next item in list
-		id1 = FRAG_GETID( n->bufferid );
-		id2 = FRAG_GETID( pbuf->bufferid );
+		// copy in to fragbuf
+		chan->fragbufs[i] = wait->fragbufs;
+		chan->fragbufcount[i] = wait->fragbufcount;
 
-		if( id1 > id2 )
+		if( wait->file )
 		{
-			// insert here
-			pbuf->next = n->next;
-			pprev->next = pbuf;
-			return;
+			chan->fragfile = wait->file;
+			Netchan_ReadFileFragments( chan );
 		}
-		pprev = pprev->next;
-	}
 
-	// insert at end
-	pprev->next = pbuf;
+		// throw away wait list
+		Mem_Free( wait );
+	}
 }
 
 /*
@@ -767,6 +1266,20 @@ static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
 		Host_Error( "%s: BZ2 compression is not supported for server", __func__ );
 #endif
 	}
+	else if( chan->use_lz4 && !LZ4_IsCompressed( MSG_GetData( msg ), MSG_GetMaxBytes( msg )))
+	{
+		uint uCompressedSize = 0;
+		uint uSourceSize = MSG_GetNumBytesWritten( msg );
+		byte *pbOut = LZ4_Compress( msg->pData, uSourceSize, &uCompressedSize );
+
+		if( pbOut )
+		{
+			Con_Reportf( "Compressing split packet with LZ4 (%d -> %d bytes)\n", uSourceSize, uCompressedSize );
+			memcpy( msg->pData, pbOut, uCompressedSize );
+			MSG_SeekToBit( msg, uCompressedSize << 3, SEEK_SET );
+			free( pbOut );
+		}
+	}
 	else if( chan->use_lzss && !LZSS_IsCompressed( MSG_GetData( msg ), MSG_GetMaxBytes( msg )))
 	{
 		uint uCompressedSize = 0;
@@ -836,32 +1349,61 @@ void Netchan_CreateFragments( netchan_t *chan, sizebuf_t *msg )
 
 /*
 ==============================
-Netchan_FindBufferById
+Netchan_AllocIncoming
 
+stores fragment in reassembly map of the stream
 ==============================
 */
-static fragbuf_t *Netchan_FindBufferById( fragbuf_t **pplist, int id, qboolean allocate )
+static fragbuf_t *Netchan_AllocIncoming( netchan_t *chan, int stream, uint fragid, int size )
 {
-	fragbuf_t	*list = *pplist;
-	fragbuf_t	*pnewbuf;
+	int	id = FRAG_GETID( fragid );
+	int	total = FRAG_GETCOUNT( fragid );
+	fragbuf_t	*buf;
 
-	while( list )
+	if( id < 1 || id > total || size < 0 || size > NET_MAX_FRAGMENT )
+		return NULL;
+
+	// fragment of another message
+	if( chan->incomingtotal[stream] != total )
 	{
-		if( list->bufferid == id )
-			return list;
+		if( chan->incomingcount[stream] )
+		{
+			if( chan->sock == NS_CLIENT )
+			{
+				Con_DPrintf( S_ERROR "Lost/dropped fragment would cause stall, retrying connection\n" );
+				Cbuf_AddText( "reconnect\n" );
+			}
 
-		list = list->next;
+			Netchan_ReleaseIncoming( chan, stream );
+		}
+
+		if( chan->incomingsize[stream] <= total )
+		{
+			chan->incomingsize[stream] = total + 1;
+			chan->incomingbufs[stream] = Mem_Realloc( net_mempool, chan->incomingbufs[stream], sizeof( fragbuf_t * ) * chan->incomingsize[stream] );
+		}
+
+		chan->incomingtotal[stream] = total;
+	}
+
+	// retransmitted, replace the old copy
+	if(( buf = chan->incomingbufs[stream][id] ))
+	{
+		Netchan_FreeFragbuf( buf );
+		chan->incomingcount[stream]--;
 	}
 
-	if( !allocate )
+	if( !( buf = Netchan_AllocFragbuf( size )))
+	{
+		chan->incomingbufs[stream][id] = NULL;
 		return NULL;
+	}
 
-	// create new entry
-	pnewbuf = Netchan_AllocFragbuf( NET_MAX_FRAGMENT );
-	pnewbuf->bufferid = id;
-	Netchan_AddBufferToList( pplist, pnewbuf );
+	buf->bufferid = fragid;
+	chan->incomingbufs[stream][id] = buf;
+	chan->incomingcount[stream]++;
 
-	return pnewbuf;
+	return buf;
 }
 
 /*
@@ -870,38 +1412,39 @@ Netchan_CheckForCompletion
 
 ==============================
 */
-static void Netchan_CheckForCompletion( netchan_t *chan, int stream, int intotalbuffers )
+static void Netchan_CheckForCompletion( netchan_t *chan, int stream )
 {
-	int	c, id;
-	int	size;
-	fragbuf_t	*p;
+	// received final message
+	if( chan->incomingtotal[stream] && chan->incomingcount[stream] == chan->incomingtotal[stream] )
+		chan->incomingready[stream] = true;
+}
 
-	size = 0;
-	c = 0;
+/*
+==============================
+Netchan_CompressFile
 
-	p = chan->incomingbufs[stream];
-	if( !p ) return;
+picks the best compressor remote side supports
+==============================
+*/
+static byte *Netchan_CompressFile( const netchan_t *chan, byte *pbuf, int size, uint *pCompressedSize )
+{
+	if( chan->use_lz4 )
+		return LZ4_Compress( pbuf, size, pCompressedSize );
 
-	while( p )
-	{
-		size += MSG_GetNumBytesWritten( &p->frag_message );
-		c++;
+	// files are compressed once and cached, so spend more time on ratio
+	return LZSS_CompressEx( pbuf, size, pCompressedSize, 128, true );
+}
 
-		id = FRAG_GETID( p->bufferid );
-		if( id != c )
-		{
-			if( chan->sock == NS_CLIENT )
-			{
-				Con_DPrintf( S_ERROR "Lost/dropped fragment would cause stall, retrying connection\n" );
-				Cbuf_AddText( "reconnect\n" );
-			}
-		}
-		p = p->next;
-	}
+/*
+==============================
+Netchan_CompressedFileName
 
-	// received final message
-	if( c == intotalbuffers )
-		chan->incomingready[stream] = true;
+cached files of both compressors can live side by side
+==============================
+*/
+static void Netchan_CompressedFileName( const netchan_t *chan, const char *filename, char *out, size_t size )
+{
+	Q_snprintf( out, size, "%s.%s", filename, chan->use_lz4 ? "z4tmp" : "ztmp" );
 }
 
 /*
@@ -924,10 +1467,10 @@ void Netchan_CreateFileFragmentsFromBuffer( netchan_t *chan, const char *filenam
 
 	chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
 
-	if( !LZSS_IsCompressed( pbuf, size ))
+	if( !LZSS_IsCompressed( pbuf, size ) && !LZ4_IsCompressed( pbuf, size ))
 	{
 		uint	uCompressedSize = 0;
-		byte	*pbOut = LZSS_Compress( pbuf, size, &uCompressedSize );
+		byte	*pbOut = Netchan_CompressFile( chan, pbuf, size, &uCompressedSize );
 
 		if( pbOut && uCompressedSize > 0 && uCompressedSize < size )
 		{
@@ -965,8 +1508,6 @@ void Netchan_CreateFileFragmentsFromBuffer( netchan_t *chan, const char *filenam
 
 		buf->isbuffer = true;
 		buf->isfile = true;
-		buf->size = send;
-		buf->foffset = pos;
 
 		MSG_WriteBits( &buf->frag_message, pbuf + pos, send << 3 );
 
@@ -999,21 +1540,17 @@ Netchan_CreateFileFragments
 */
 int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 {
-	int		chunksize;
-	int		send, pos;
-	int		remaining;
-	int		bufferid = 1;
+	int		chunksize, firstsize;
 	fs_offset_t	filesize = 0;
 	int		compressedFileTime;
 	int		fileTime;
-	qboolean		firstfragment = true;
 	qboolean		bCompressed = false;
 	fragbufwaiting_t	*wait, *p;
-	fragbuf_t		*buf;
-	char		compressedfilename[sizeof( buf->filename ) + 5];
+	fragfile_t	*ff;
+	char		compressedfilename[sizeof( ff->diskname )];
 
 	// shouldn't be critical, but just in case
-	if( Q_strlen( filename ) > sizeof( buf->filename ) - 1 )
+	if( Q_strlen( filename ) > sizeof( ff->filename ) - 1 )
 	{
 		Con_Printf( S_WARN "Unable to transfer %s due to path length overflow\n", filename );
 		return 0;
@@ -1027,7 +1564,7 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 
 	chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
 
-	Q_snprintf( compressedfilename, sizeof( compressedfilename ), "%s.ztmp", filename );
+	Netchan_CompressedFileName( chan, filename, compressedfilename, sizeof( compressedfilename ));
 	compressedFileTime = FS_FileTime( compressedfilename, false );
 	fileTime = FS_FileTime( filename, false );
 
@@ -1047,8 +1584,9 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 		byte	*uncompressed;
 		byte	*compressed;
 
+		// whole file is compressed once, later transfers stream from the cache
 		uncompressed = FS_LoadFile( filename, &filesize, false );
-		compressed = LZSS_Compress( uncompressed, filesize, &uCompressedSize );
+		compressed = Netchan_CompressFile( chan, uncompressed, filesize, &uCompressedSize );
 
 		if( compressed )
 		{
@@ -1061,42 +1599,23 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 		Mem_Free( uncompressed );
 	}
 
-	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
-	remaining = filesize;
-	pos = 0;
-
-	while( remaining > 0 )
-	{
-		send = Q_min( remaining, chunksize );
-
-		buf = Netchan_AllocFragbuf( send );
-		buf->bufferid = bufferid++;
-
-		// copy in data
-		MSG_Clear( &buf->frag_message );
-
-		if( firstfragment )
-		{
-			// Write filename
-			MSG_WriteString( &buf->frag_message, filename );
-
-			// Send a bit less on first package
-			send -= MSG_GetNumBytesWritten( &buf->frag_message );
-
-			firstfragment = false;
-		}
+	// fragments are read from disk when they are about to be sent
+	ff = (fragfile_t *)Mem_Calloc( net_mempool, sizeof( fragfile_t ));
+	Q_strncpy( ff->filename, filename, sizeof( ff->filename ));
+	Q_strncpy( ff->diskname, bCompressed ? compressedfilename : filename, sizeof( ff->diskname ));
+	ff->remaining = filesize;
+	ff->chunksize = chunksize;
+	ff->bufferid = 1;
 
-		buf->isfile = true;
-		buf->size = send;
-		buf->foffset = pos;
-		buf->iscompressed = bCompressed;
-		Q_strncpy( buf->filename, filename, sizeof( buf->filename ));
+	// every fragment carries the total count, so it must be known now
+	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
+	wait->file = ff;
+	wait->fragbufcount = 1;
 
-		pos += send;
-		remaining -= send;
+	firstsize = chunksize - ( Q_strlen( filename ) + 1 );
 
-		Netchan_AddFragbufToTail( wait, buf );
-	}
+	if( filesize > firstsize )
+		wait->fragbufcount += ( filesize - firstsize + chunksize - 1 ) / chunksize;
 
 	// now add waiting list item to end of buffer queue
 	if( !chan->waitlist[FRAG_FILE_STREAM] )
@@ -1122,19 +1641,9 @@ Netchan_FlushIncoming
 */
 void Netchan_FlushIncoming( netchan_t *chan, int stream )
 {
-	fragbuf_t	*p, *n;
-
 	MSG_Clear( &net_message );
 
-	p = chan->incomingbufs[ stream ];
-
-	while( p )
-	{
-		n = p->next;
-		Mem_Free( p );
-		p = n;
-	}
-	chan->incomingbufs[stream] = NULL;
+	Netchan_ReleaseIncoming( chan, stream );
 	chan->incomingready[stream] = false;
 }
 
@@ -1147,33 +1656,31 @@ Netchan_CopyNormalFragments
 qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *length )
 {
 	size_t	size = 0;
-	fragbuf_t	*p, *n;
+	fragbuf_t	*p;
+	int	i;
 
 	if( !chan->incomingready[FRAG_NORMAL_STREAM] )
 		return false;
 
-	if( !chan->incomingbufs[FRAG_NORMAL_STREAM] )
+	if( !chan->incomingcount[FRAG_NORMAL_STREAM] )
 	{
 		chan->incomingready[FRAG_NORMAL_STREAM] = false;
 		return false;
 	}
 
-	p = chan->incomingbufs[FRAG_NORMAL_STREAM];
-
 	MSG_Init( msg, "NetMessage", net_message_buffer, sizeof( net_message_buffer ));
 
-	while( p )
+	for( i = 1; i <= chan->incomingtotal[FRAG_NORMAL_STREAM]; i++ )
 	{
-		n = p->next;
+		p = chan->incomingbufs[FRAG_NORMAL_STREAM][i];
 
 		// copy it in
 		MSG_WriteBytes( msg, MSG_GetData( &p->frag_message ), MSG_GetNumBytesWritten( &p->frag_message ));
 		size += MSG_GetNumBytesWritten( &p->frag_message );
-
-		Mem_Free( p );
-		p = n;
 	}
 
+	Netchan_ReleaseIncoming( chan, FRAG_NORMAL_STREAM );
+
 	if( chan->use_bz2 && !memcmp( MSG_GetData( msg ), "BZ2", 4 ))
 	{
 #if !XASH_DEDICATED
@@ -1195,6 +1702,20 @@ qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *l
 		Host_Error( "%s: BZ2 compression is not supported for server\n", __func__ );
 #endif
 	}
+	else if( chan->use_lz4 && LZ4_IsCompressed( MSG_GetData( msg ), size ))
+	{
+		byte	buf[NET_MAX_MESSAGE];
+
+		size = LZ4_Decompress( MSG_GetData( msg ), buf, size, sizeof( buf ));
+
+		if( !size )
+		{
+			Con_Printf( S_ERROR "%s: LZ4 decompression failed\n", __func__ );
+			return false;
+		}
+
+		memcpy( msg->pData, buf, size );
+	}
 	else if( chan->use_lzss && LZSS_IsCompressed( MSG_GetData( msg ), size ))
 	{
 		uint	uDecompressedLen = LZSS_GetActualSize( MSG_GetData( msg ), size );
@@ -1213,8 +1734,6 @@ qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *l
 		}
 	}
 
-	chan->incomingbufs[FRAG_NORMAL_STREAM] = NULL;
-
 	// reset flag
 	chan->incomingready[FRAG_NORMAL_STREAM] = false;
 
@@ -1234,20 +1753,21 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 {
 	char	filename[MAX_OSPATH], compressor[32];
 	uint	uncompressedSize;
-	int	nsize, pos;
+	int	nsize, pos, i;
+	fragbuf_t	**bufs = chan->incomingbufs[FRAG_FILE_STREAM];
 	byte	*buffer;
-	fragbuf_t	*p, *n;
+	fragbuf_t	*p;
 
 	if( !chan->incomingready[FRAG_FILE_STREAM] )
 		return false;
 
-	if( !chan->incomingbufs[FRAG_FILE_STREAM] )
+	if( !chan->incomingcount[FRAG_FILE_STREAM] )
 	{
 		chan->incomingready[FRAG_FILE_STREAM] = false;
 		return false;
 	}
 
-	p = chan->incomingbufs[FRAG_FILE_STREAM];
+	p = bufs[1];
 
 	MSG_Init( msg, "NetMessage", net_message_buffer, sizeof( net_message_buffer ));
 
@@ -1293,30 +1813,23 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 	}
 
 	// create file from buffers
-	nsize = 0;
-	while ( p )
-	{
-		nsize += MSG_GetNumBytesWritten( &p->frag_message ); // Size will include a bit of slop, oh well
-		if( p == chan->incomingbufs[FRAG_FILE_STREAM] )
-			nsize -= MSG_GetNumBytesRead( msg );
-		p = p->next;
-	}
+	nsize = -MSG_GetNumBytesRead( msg );
+	for( i = 1; i <= chan->incomingtotal[FRAG_FILE_STREAM]; i++ )
+		nsize += MSG_GetNumBytesWritten( &bufs[i]->frag_message ); // Size will include a bit of slop, oh well
 
 	buffer = Mem_Calloc( net_mempool, nsize + 1 );
-	p = chan->incomingbufs[FRAG_FILE_STREAM];
 	pos = 0;
 
-	while( p )
+	for( i = 1; i <= chan->incomingtotal[FRAG_FILE_STREAM]; i++ )
 	{
 		int	cursize;
 
-		n = p->next;
-
+		p = bufs[i];
 		cursize = MSG_GetNumBytesWritten( &p->frag_message );
 
 		// first message has the file name, don't write that into the data stream,
 		// just write the rest of the actual data
-		if( p == chan->incomingbufs[FRAG_FILE_STREAM] )
+		if( i == 1 )
 		{
 			// copy it in
 			cursize -= MSG_GetNumBytesRead( msg );
@@ -1328,10 +1841,10 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 		}
 
 		pos += cursize;
-		Mem_Free( p );
-		p = n;
 	}
 
+	Netchan_ReleaseIncoming( chan, FRAG_FILE_STREAM );
+
 	if( chan->gs_netchan && chan->use_bz2 && !Q_stricmp( compressor, "bz2" ))
 	{
 #if !XASH_DEDICATED
@@ -1346,6 +1859,18 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 		Host_Error( "%s: BZ2 compression is not supported for server", __func__ );
 #endif
 	}
+	else if( chan->use_lz4 && LZ4_IsCompressed( buffer, nsize ))
+	{
+		byte	*uncompressedBuffer;
+
+		uncompressedSize = LZ4_GetActualSize( buffer, nsize ) + 1;
+		uncompressedBuffer = Mem_Calloc( net_mempool, uncompressedSize );
+
+		Con_DPrintf( "Decompressing file %s (%d -> %d bytes)\n", filename, nsize, uncompressedSize - 1 );
+		nsize = LZ4_Decompress( buffer, uncompressedBuffer, nsize, uncompressedSize );
+		Mem_Free( buffer );
+		buffer = uncompressedBuffer;
+	}
 	else if( chan->use_lzss && LZSS_IsCompressed( buffer, nsize + 1 ))
 	{
 		byte	*uncompressedBuffer;
@@ -1376,7 +1901,6 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 	// clear remnants
 	MSG_Clear( msg );
 
-	chan->incomingbufs[FRAG_FILE_STREAM] = NULL;
 	chan->incomingready[FRAG_FILE_STREAM] = false;
 
 	return true;
@@ -1408,6 +1932,13 @@ static qboolean Netchan_Validate( netchan_t *chan, sizebuf_t *sb, qboolean *frag
 
 		if( offset < 0 || offset > ( FRAGMENT_MAX_SIZE << 3 ))
 			return false;
+
+		// fragment must be inside of this packet, it's copied into pooled buffer
+		if( frag_offset[i] < 0 || frag_length[i] < 0 || length > NET_MAX_FRAGMENT )
+			return false;
+
+		if( frag_offset[i] + frag_length[i] > MSG_GetNumBitsLeft( sb ))
+			return false;
 	}
 
 	return true;
@@ -1423,8 +1954,7 @@ void Netchan_UpdateProgress( netchan_t *chan )
 {
 #if !XASH_DEDICATED
 	fragbuf_t *p;
-	int	i, c = 0;
-	int	total = 0;
+	int	i;
 	float	bestpercent = 0.0;
 
 	if( host.downloadcount == 0 )
@@ -1434,35 +1964,22 @@ void Netchan_UpdateProgress( netchan_t *chan )
 	}
 
 	// do show slider for file downloads.
-	if( !chan->incomingbufs[FRAG_FILE_STREAM] )
+	if( !chan->incomingcount[FRAG_FILE_STREAM] )
 		return;
 
 	for( i = MAX_STREAMS - 1; i >= 0; i-- )
 	{
 		// receiving data
-		if( chan->incomingbufs[i] )
+		if( chan->incomingcount[i] )
 		{
-			p = chan->incomingbufs[i];
-
-			total = FRAG_GETCOUNT( p->bufferid );
-
-			while( p )
-			{
-				c++;
-				p = p->next;
-			}
-
-			if( total )
-			{
-				float	percent = 100.0f * (float)c / (float)total;
+			float	percent = 100.0f * (float)chan->incomingcount[i] / (float)chan->incomingtotal[i];
 
-				if( percent > bestpercent )
-					bestpercent = percent;
-			}
+			if( percent > bestpercent )
+				bestpercent = percent;
 
-			p = chan->incomingbufs[i];
+			p = chan->incomingbufs[i][1];
 
-			if( i == FRAG_FILE_STREAM )
+			if( i == FRAG_FILE_STREAM && p )
 			{
 				char	sz[MAX_SYSPATH];
 				char	*in, *out;
@@ -1519,7 +2036,6 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 	qboolean	send_reliable;
 	sizebuf_t	send;
 	int	i, j;
-	float	fRate;
 
 	// check for message overflow
 	if( MSG_CheckOverflow( &chan->message ))
@@ -1566,6 +2082,10 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 				send_from_frag[i] = 1;
 		}
 
+		// sender wants this packet for more important data
+		if( chan->hold_files )
+			send_from_frag[FRAG_FILE_STREAM] = 0;
+
 		// stall reliable payloads if sending from frag buffer
 		if( send_from_regular && ( send_from_frag[FRAG_NORMAL_STREAM] ))
 		{
@@ -1626,16 +2146,8 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 			fragment_size = 0;
 
 			if( pbuf )
-			{
 				fragment_size = MSG_GetNumBytesWritten( &pbuf->frag_message );
 
-				// files set size a bit differently.
-				if( pbuf->isfile && !pbuf->isbuffer )
-				{
-					fragment_size = pbuf->size;
-				}
-			}
-
 			newpayloadsize = (( chan->reliable_length + ( fragment_size << 3 )) + 7 ) >> 3;
 
 			// make sure we have enought space left
@@ -1646,28 +2158,6 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 				// which buffer are we sending ?
 				chan->reliable_fragid[i] = MAKE_FRAGID( pbuf->bufferid, chan->fragbufcount[i] );
 
-				// if it's not in-memory, then we'll need to copy it in frame the file handle.
-				if( pbuf->isfile && !pbuf->isbuffer )
-				{
-					byte	filebuffer[NET_MAX_FRAGMENT];
-					file_t	*file;
-
-					if( pbuf->iscompressed )
-					{
-						char	compressedfilename[sizeof( pbuf->filename ) + 5];
-
-						Q_snprintf( compressedfilename, sizeof( compressedfilename ), "%s.ztmp", pbuf->filename );
-						file = FS_Open( compressedfilename, "rb", false );
-					}
-					else file = FS_Open( pbuf->filename, "rb", false );
-
-					FS_Seek( file, pbuf->foffset, SEEK_SET );
-					FS_Read( file, filebuffer, pbuf->size );
-
-					MSG_WriteBits( &pbuf->frag_message, filebuffer, pbuf->size << 3 );
-					FS_Close( file );
-				}
-
 				// copy frag stuff on top of current buffer
 				MSG_StartWriting( &temp, chan->reliable_buf, sizeof( chan->reliable_buf ), chan->reliable_length, -1 );
 				MSG_WriteBits( &temp, MSG_GetData( &pbuf->frag_message ), MSG_GetNumBitsWritten( &pbuf->frag_message ));
@@ -1744,11 +2234,27 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 		}
 	}
 
+	chan->sent_message = chan->sent_unreliable = 0;
+	chan->sent_frag[FRAG_NORMAL_STREAM] = chan->sent_frag[FRAG_FILE_STREAM] = 0;
+
 	// copy the reliable message to the packet first
 	if( send_reliable )
 	{
+		int	bits = chan->reliable_length;
+
 		MSG_WriteBits( &send, chan->reliable_buf, chan->reliable_length );
 		chan->last_reliable_sequence = chan->outgoing_sequence - 1;
+
+		for( i = 0; i < MAX_STREAMS; i++ )
+		{
+			if( !chan->reliable_fragment[i] )
+				continue;
+
+			chan->sent_frag[i] = BitByte( chan->frag_length[i] );
+			bits -= chan->frag_length[i];
+		}
+
+		chan->sent_message = BitByte( bits );
 	}
 
 	if( length )
@@ -1756,7 +2262,10 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 		int maxsize = chan->pfnBlockSize( chan->client, FRAGSIZE_UNRELIABLE );
 
 		if( (( MSG_GetNumBytesWritten( &send ) + length ) >> 3) <= maxsize )
+		{
 			MSG_WriteBits( &send, data, length );
+			chan->sent_unreliable = BitByte( length );
+		}
 		else Con_Printf( S_WARN "%s: unreliable message overflow: %d\n", __func__, MSG_GetNumBytesWritten( &send ) );
 	}
 
@@ -1795,14 +2304,13 @@ void Netchan_TransmitBits( netchan_t *chan, int length, const byte *data )
 		NET_SendPacketEx( chan->sock, MSG_GetNumBytesWritten( &send ), MSG_GetData( &send ), chan->remote_address, splitsize );
 	}
 
-	if( SV_Active() && sv_lan.value && sv_lan_rate.value > 1000.0f )
-		fRate = 1.0f / sv_lan_rate.value;
-	else fRate = 1.0f / chan->rate;
-
-	if( chan->cleartime < host.realtime )
-		chan->cleartime = host.realtime;
+	// unused bandwidth is kept for a short burst
+	if( chan->cleartime < host.realtime - chan->rateburst )
+		chan->cleartime = host.realtime - chan->rateburst;
 
-	chan->cleartime += ( MSG_GetNumBytesWritten( &send ) + UDP_HEADER_SIZE ) * fRate;
+	chan->sent_size = MSG_GetNumBytesWritten( &send ) + UDP_HEADER_SIZE;
+	chan->cleartime += chan->sent_size * Netchan_ByteTime( chan );
+	chan->hold_files = false;
 
 	if( net_showpackets.value && net_showpackets.value != 2.0f )
 	{
@@ -1949,8 +2457,7 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 	{
 		for( i = 0; i < MAX_STREAMS; i++ )
 		{
-			int	j, inbufferid;
-			int	intotalbuffers;
+			int	j;
 			int	oldpos, curbit;
 			int	numbitstoremove;
 			fragbuf_t	*pbuf;
@@ -1958,16 +2465,12 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 			if( !frag_message[i] )
 				continue;
 
-			inbufferid = FRAG_GETID( fragid[i] );
-			intotalbuffers = FRAG_GETCOUNT( fragid[i] );
-
 			if( fragid[i] != 0 )
 			{
-				pbuf = Netchan_FindBufferById( &chan->incomingbufs[i], fragid[i], true );
+				pbuf = Netchan_AllocIncoming( chan, i, fragid[i], BitByte( frag_length[i] ));
 
 				if( pbuf )
 				{
-					byte	buffer[NET_MAX_FRAGMENT];
 					int	bits, size;
 					sizebuf_t	temp;
 
@@ -1975,15 +2478,13 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 					bits = frag_length[i];
 
 					// copy in data
-					MSG_Clear( &pbuf->frag_message );
-
 					MSG_StartReading( &temp, msg->pData, MSG_GetMaxBytes( msg ), size, -1 );
-					MSG_ReadBits( &temp, buffer, bits );
-					MSG_WriteBits( &pbuf->frag_message, buffer, bits );
+					MSG_ReadBits( &temp, pbuf->frag_message_buf, bits );
+					MSG_SeekToBit( &pbuf->frag_message, bits, SEEK_SET );
 				}
 
 				// count # of incoming bufs we've queued? are we done?
-				Netchan_CheckForCompletion( chan, i, intotalbuffers );
+				Netchan_CheckForCompletion( chan, i );
 			}
 
 			// rearrange incoming data to not have the frag stuff in the middle of it
@@ -2007,3 +2508,254 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 
 	return true;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_STREAM_FILE	"test_stream.tmp"
+#define TEST_STREAM_SIZE	0x20000
+#define TEST_STREAM_BUFFER	8192
+
+static int Test_StreamBlockSize( void *cl, fragsize_t mode )
+{
+	return FRAGMENT_DEFAULT_SIZE;
+}
+
+static void Test_StreamFile( void )
+{
+	netchan_t	*chan = Z_Calloc( sizeof( *chan ));
+	byte	*data = Z_Malloc( TEST_STREAM_SIZE );
+	byte	*received = Z_Calloc( TEST_STREAM_SIZE );
+	float	oldbuffer = net_filebuffer.value;
+	int	i, total, count = 0, pos = 0;
+	netadr_t	adr = { 0 };
+	fragbuf_t	*buf;
+
+	// random data isn't compressed, so file is streamed as is
+	for( i = 0; i < TEST_STREAM_SIZE; i++ )
+		data[i] = COM_RandomLong( 0, 255 );
+
+	TASSERT( FS_WriteFile( TEST_STREAM_FILE, data, TEST_STREAM_SIZE ));
+
+	net_filebuffer.value = TEST_STREAM_BUFFER;
+	Netchan_Setup( NS_SERVER, chan, adr, 0, NULL, Test_StreamBlockSize, 0 );
+
+	TASSERT( Netchan_CreateFileFragments( chan, TEST_STREAM_FILE ));
+	total = chan->waitlist[FRAG_FILE_STREAM]->fragbufcount;
+
+	while( 1 )
+	{
+		int	namelen = 0, size;
+
+		Netchan_FragSend( chan );
+
+		if( !( buf = chan->fragbufs[FRAG_FILE_STREAM] ))
+			break;
+
+		TASSERT( fragpool.filebuffered <= TEST_STREAM_BUFFER );
+		TASSERT_EQi( buf->bufferid, ++count );
+
+		if( count == 1 )
+		{
+			TASSERT_STR( buf->frag_message_buf, TEST_STREAM_FILE );
+			namelen = Q_strlen( TEST_STREAM_FILE ) + 1;
+		}
+
+		size = MSG_GetNumBytesWritten( &buf->frag_message ) - namelen;
+		TASSERT( pos + size <= TEST_STREAM_SIZE );
+
+		if( pos + size <= TEST_STREAM_SIZE )
+			memcpy( received + pos, buf->frag_message_buf + namelen, size );
+		pos += size;
+
+		// sent and acknowledged
+		Netchan_UnlinkFragment( buf, &chan->fragbufs[FRAG_FILE_STREAM] );
+	}
+
+	TASSERT_EQi( count, total );
+	TASSERT_EQi( pos, TEST_STREAM_SIZE );
+	TASSERT( !memcmp( data, received, TEST_STREAM_SIZE ));
+	TASSERT( chan->fragfile == NULL );
+	TASSERT_EQi( fragpool.filebuffered, 0 );
+	TASSERT_EQi( fragpool.numfiles, 0 );
+
+	// dropping connection in the middle of transfer releases everything
+	TASSERT( Netchan_CreateFileFragments( chan, TEST_STREAM_FILE ));
+	Netchan_FragSend( chan );
+	TASSERT( fragpool.filebuffered > 0 );
+	Netchan_Clear( chan );
+	TASSERT_EQi( fragpool.filebuffered, 0 );
+	TASSERT_EQi( fragpool.numfiles, 0 );
+
+	if( g_fsapi.Delete )
+		g_fsapi.Delete( TEST_STREAM_FILE );
+
+	net_filebuffer.value = oldbuffer;
+	Z_Free( received );
+	Z_Free( data );
+	Z_Free( chan );
+}
+
+#define TEST_MESSAGE_SIZE	0x8000
+#define TEST_MESSAGE_FRAGS	64
+
+static void Test_DeliverFragment( netchan_t *chan, fragbuf_t *frag, int total )
+{
+	int	bits = MSG_GetNumBitsWritten( &frag->frag_message );
+	fragbuf_t	*buf = Netchan_AllocIncoming( chan, FRAG_NORMAL_STREAM, MAKE_FRAGID( frag->bufferid, total ), BitByte( bits ));
+
+	memcpy( buf->frag_message_buf, frag->frag_message_buf, BitByte( bits ));
+	MSG_SeekToBit( &buf->frag_message, bits, SEEK_SET );
+
+	Netchan_CheckForCompletion( chan, FRAG_NORMAL_STREAM );
+}
+
+static void Test_Reassemble( void )
+{
+	netchan_t	*sender = Z_Calloc( sizeof( *sender ));
+	netchan_t	*receiver = Z_Calloc( sizeof( *receiver ));
+	byte	*data = Z_Malloc( TEST_MESSAGE_SIZE );
+	fragbuf_t	*frags[TEST_MESSAGE_FRAGS];
+	int	i, pass, numslabs = 0;
+	netadr_t	adr = { 0 };
+	sizebuf_t	msg;
+	qboolean	frag_message[MAX_STREAMS] = { false, false };
+	uint	fragid[MAX_STREAMS] = { 0, 0 };
+	int	frag_offset[MAX_STREAMS] = { 0, 0 };
+	int	frag_length[MAX_STREAMS] = { 0, 0 };
+
+	for( i = 0; i < TEST_MESSAGE_SIZE; i++ )
+		data[i] = COM_RandomLong( 0, 255 );
+
+	// server side never reconnects on stall, so it's safe to test here
+	Netchan_Setup( NS_SERVER, sender, adr, 0, NULL, Test_StreamBlockSize, 0 );
+	Netchan_Setup( NS_SERVER, receiver, adr, 0, NULL, Test_StreamBlockSize, 0 );
+
+	for( pass = 0; pass < 3; pass++ )
+	{
+		size_t	length = 0;
+		fragbuf_t	*buf;
+		int	total = 0;
+
+		MSG_Init( &msg, "TestMessage", data, TEST_MESSAGE_SIZE );
+		MSG_SeekToBit( &msg, TEST_MESSAGE_SIZE << 3, SEEK_SET );
+
+		Netchan_CreateFragments( sender, &msg );
+		Netchan_FragSend( sender );
+
+		for( buf = sender->fragbufs[FRAG_NORMAL_STREAM]; buf && total < TEST_MESSAGE_FRAGS; buf = buf->next )
+			frags[total++] = buf;
+
+		TASSERT_EQi( total, sender->fragbufcount[FRAG_NORMAL_STREAM] );
+		TASSERT( total > 1 );
+
+		// deliver backwards, first fragment is retransmitted at the end
+		Test_DeliverFragment( receiver, frags[0], total );
+
+		for( i = total - 1; i >= 0; i-- )
+		{
+			TASSERT( receiver->incomingready[FRAG_NORMAL_STREAM] == ( i == 0 ));
+			Test_DeliverFragment( receiver, frags[i], total );
+		}
+
+		TASSERT( receiver->incomingready[FRAG_NORMAL_STREAM] );
+		TASSERT( Netchan_CopyNormalFragments( receiver, &msg, &length ));
+		TASSERT_EQi( (int)length, TEST_MESSAGE_SIZE );
+		TASSERT( !memcmp( MSG_GetData( &msg ), data, TEST_MESSAGE_SIZE ));
+		TASSERT_EQi( receiver->incomingcount[FRAG_NORMAL_STREAM], 0 );
+
+		Netchan_ClearFragbufs( &sender->fragbufs[FRAG_NORMAL_STREAM] );
+
+		// buffers are recycled, nothing is allocated after the first message
+		if( pass == 0 )
+			numslabs = fragpool.numslabs;
+		else TASSERT_EQi( fragpool.numslabs, numslabs );
+	}
+
+	// fragment of another message drops incomplete one
+	Netchan_AllocIncoming( receiver, FRAG_NORMAL_STREAM, MAKE_FRAGID( 1, 5 ), 16 );
+	Netchan_AllocIncoming( receiver, FRAG_NORMAL_STREAM, MAKE_FRAGID( 2, 5 ), 16 );
+	Netchan_AllocIncoming( receiver, FRAG_NORMAL_STREAM, MAKE_FRAGID( 1, 3 ), 16 );
+	TASSERT_EQi( receiver->incomingcount[FRAG_NORMAL_STREAM], 1 );
+	TASSERT_EQi( receiver->incomingtotal[FRAG_NORMAL_STREAM], 3 );
+	TASSERT( Netchan_AllocIncoming( receiver, FRAG_NORMAL_STREAM, MAKE_FRAGID( 4, 3 ), 16 ) == NULL );
+
+	// oversized fragment is refused before anything is copied
+	TASSERT( Netchan_AllocFragbuf( FRAGBUF_MAX_SIZE + 1 ) == NULL );
+	TASSERT( Netchan_AllocIncoming( receiver, FRAG_NORMAL_STREAM, MAKE_FRAGID( 2, 3 ), FRAGMENT_MAX_SIZE << 3 ) == NULL );
+	TASSERT_EQi( receiver->incomingcount[FRAG_NORMAL_STREAM], 1 );
+
+	MSG_Init( &msg, "TestMessage", data, 1024 );
+	MSG_SeekToBit( &msg, 1024 << 3, SEEK_SET );
+	MSG_Clear( &msg );
+	frag_message[FRAG_NORMAL_STREAM] = true;
+	fragid[FRAG_NORMAL_STREAM] = MAKE_FRAGID( 1, 1 );
+	frag_offset[FRAG_NORMAL_STREAM] = 0;
+	frag_length[FRAG_NORMAL_STREAM] = 512 << 3;
+	TASSERT( Netchan_Validate( receiver, &msg, frag_message, fragid, frag_offset, frag_length ));
+	frag_length[FRAG_NORMAL_STREAM] = FRAGMENT_MAX_SIZE << 6;
+	TASSERT( !Netchan_Validate( receiver, &msg, frag_message, fragid, frag_offset, frag_length ));
+	frag_length[FRAG_NORMAL_STREAM] = ( 1024 << 3 ) + 1;
+	TASSERT( !Netchan_Validate( receiver, &msg, frag_message, fragid, frag_offset, frag_length ));
+
+	Netchan_Clear( receiver );
+	Netchan_Clear( sender );
+	TASSERT( receiver->incomingbufs[FRAG_NORMAL_STREAM] == NULL );
+
+	Z_Free( data );
+	Z_Free( receiver );
+	Z_Free( sender );
+}
+
+static void Test_AvailableBytes( void )
+{
+	netchan_t	*chan = Z_Calloc( sizeof( *chan ));
+	double	oldrealtime = host.realtime;
+
+	chan->remote_address.type = NA_IP;
+	chan->rate = 10000.0;
+	chan->rateburst = 0.1f;
+	host.realtime = 1000.0;
+
+	// idle channel gets no more than the burst
+	chan->cleartime = 0.0;
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime ), 1000 );
+
+	chan->cleartime = host.realtime - 0.0625;
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime ), 625 );
+
+	// choked
+	chan->cleartime = host.realtime + 0.0625;
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime ), -625 );
+
+	// debt that is paid off by nexttime, even without saved up burst
+	chan->rateburst = 0.0f;
+	chan->cleartime = host.realtime;
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime + 0.0625 ), 625 );
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime ), 0 );
+
+	// never more than a message, even at huge rate
+	chan->rateburst = 0.1f;
+	chan->rate = 1e12;
+	chan->cleartime = 0.0;
+	TASSERT_EQi( Netchan_AvailableBytes( chan, host.realtime ), NET_MAX_MESSAGE );
+
+	host.realtime = oldrealtime;
+	Z_Free( chan );
+}
+
+void Test_RunNetchan( void )
+{
+	qboolean	ownpool = !net_mempool;
+
+	if( ownpool )
+		net_mempool = Mem_AllocPool( "Network Pool" );
+
+	TRUN( Test_StreamFile( ));
+	TRUN( Test_Reassemble( ));
+	TRUN( Test_AvailableBytes( ));
+
+	if( ownpool )
+		Netchan_Shutdown();
+}
+#endif // XASH_ENGINE_TESTS
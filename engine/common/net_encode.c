@@ -49,6 +49,7 @@ GNU General Public License for more details.
 #define DESC_DEF( x )	#x, offsetof( goldsrc_delta_t, x ), sizeof( ((goldsrc_delta_t *)0)->x )
 
 static qboolean		delta_init = false;
+static qboolean		delta_quiet = false;	// console isn't thread safe, see Delta_SetQuiet
 
 // list of all the struct names
 static const delta_field_t cmd_fields[] =
@@ -309,6 +310,8 @@ static const delta_field_t ent_fields[] =
 { ENTS_DEF( vuser4[2] )	},
 };
 
+STATIC_ASSERT( ARRAYSIZE( ent_fields ) <= DELTA_MAX_ENTITY_FIELDS, "delta_entity_op_t field mask is too small" );
+
 static const delta_field_t meta_fields[] =
 {
 { DESC_DEF( fieldType ), },
@@ -433,6 +436,8 @@ static const delta_info_t dt_goldsrc_meta =
 	.bInitialized = true
 };
 
+static void Delta_FreeProgram( delta_info_t *dt );
+
 static delta_info_t *Delta_FindStruct( const char *name )
 {
 	int	i;
@@ -544,6 +549,8 @@ static qboolean Delta_AddField( delta_info_t *dt, const char *pName, int flags,
 	delta_t		*pField;
 	int		i;
 
+	Delta_FreeProgram( dt );
+
 	// check for coexisting field
 	for( i = 0, pField = dt->pFields; i < dt->numFields && pField; i++, pField++ )
 	{
@@ -862,6 +869,7 @@ static void Delta_ParseTable( char **delta_script, delta_info_t *dt, const char
 		dt->pFields = Z_Realloc( dt->pFields, dt->numFields * sizeof( delta_t ));
 	}
 
+	Delta_FreeProgram( dt );
 	dt->bInitialized = true; // table is ok
 }
 
@@ -990,6 +998,7 @@ void Delta_Shutdown( void )
 		dt_info[i].customEncode = CUSTOM_NONE;
 		dt_info[i].userCallback = NULL;
 		dt_info[i].funcName[0] = '\0';
+		Delta_FreeProgram( &dt_info[i] );
 
 		if( dt_info[i].pFields )
 		{
@@ -1003,6 +1012,19 @@ void Delta_Shutdown( void )
 	delta_init = false;
 }
 
+/*
+=====================
+Delta_SetQuiet
+
+overflow warnings are not printed while snapshot workers
+write entity deltas, set and cleared only from main thread
+=====================
+*/
+void Delta_SetQuiet( qboolean quiet )
+{
+	delta_quiet = quiet;
+}
+
 /*
 =====================
 Delta_ClampIntegerField
@@ -1013,7 +1035,7 @@ prevent data to out of range
 static int Delta_ClampIntegerField( delta_t *pField, int iValue, int signbit, int numbits )
 {
 #ifdef _DEBUG
-	if( numbits < 32 && abs( iValue ) >= (uint)BIT( numbits ))
+	if( !delta_quiet && numbits < 32 && abs( iValue ) >= (uint)BIT( numbits ))
 		Con_Reportf( S_WARN "Delta_ClampIntegerField: field %s = %d overflowed %d\n", pField->name, abs( iValue ), (uint)BIT( numbits ));
 #endif
 	if( numbits < 32 )
@@ -1032,13 +1054,13 @@ static int Delta_ClampIntegerField( delta_t *pField, int iValue, int signbit, in
 
 /*
 =====================
-Delta_CompareField
+Delta_CompareFieldValue
 
 compare fields by offsets
 assume from and to is valid
 =====================
 */
-static qboolean Delta_CompareField( delta_t *pField, const void *from, const void *to )
+static qboolean Delta_CompareFieldValue( delta_t *pField, const void *from, const void *to )
 {
 	int		signbit = ( pField->flags & DT_SIGNED ) ? 1 : 0;
 	float	val_a, val_b;
@@ -1048,9 +1070,6 @@ static qboolean Delta_CompareField( delta_t *pField, const void *from, const voi
 	Assert( from != NULL );
 	Assert( to != NULL );
 
-	if( pField->bInactive )
-		return true;
-
 	fromF = toF = 0;
 
 	if( pField->flags & DT_BYTE )
@@ -1152,6 +1171,441 @@ static qboolean Delta_CompareField( delta_t *pField, const void *from, const voi
 	return fromF == toF;
 }
 
+/*
+=====================
+Delta_CompareField
+
+inactive fields are never sent
+=====================
+*/
+static qboolean Delta_CompareField( delta_t *pField, const void *from, const void *to )
+{
+	if( pField->bInactive )
+		return true;
+
+	return Delta_CompareFieldValue( pField, from, to );
+}
+
+/*
+=============================================================================
+
+COMPILED ENCODERS
+
+Each table is flattened into a list of ops with flags already
+decoded, plus groups of fields that share contiguous bytes in the
+struct. Equal group bytes mean all fields in it are unchanged, so
+most of the work per entity is few memcmp calls. Output is bit
+exact with Delta_CompareFieldValue and Delta_WriteField_
+
+=============================================================================
+*/
+#define DELTA_MASK_WORDS	( DELTA_MAX_ENTITY_FIELDS / 32 )
+#define DELTA_GROUP_BYTES	16	// one changed field shouldn't dirty whole struct
+
+// in the same order Delta_WriteField_ checks flags
+enum
+{
+	DELTA_OP_NONE = 0,	// no known type, never sent
+	DELTA_OP_BYTE,
+	DELTA_OP_SHORT,
+	DELTA_OP_INTEGER,
+	DELTA_OP_FLOAT,
+	DELTA_OP_ANGLE,
+	DELTA_OP_TIMEWINDOW_8,
+	DELTA_OP_TIMEWINDOW_BIG,
+	DELTA_OP_STRING,
+};
+
+typedef struct delta_op_s
+{
+	byte		kind;
+	byte		signbit;
+	byte		bits;
+	byte		cmp_scaled;	// multiplier is applied when comparing
+	byte		write_scaled;	// multiplier is applied when writing
+	int		offset;
+	int		width;		// bytes read from struct, 0 for strings
+	float		multiplier;
+	int		minnum;		// Delta_ClampIntegerField range
+	int		maxnum;
+} delta_op_t;
+
+typedef struct delta_group_s
+{
+	int		offset;
+	int		size;		// 0 means fields must be compared one by one
+	int		first;		// in order[]
+	int		count;
+} delta_group_t;
+
+typedef struct delta_program_s
+{
+	int		numFields;
+	int		numGroups;
+	delta_op_t	ops[DELTA_MAX_ENTITY_FIELDS];	// in table order
+	delta_group_t	groups[DELTA_MAX_ENTITY_FIELDS];
+	byte		order[DELTA_MAX_ENTITY_FIELDS];	// fields sorted by offset
+} delta_program_t;
+
+static void Delta_FreeProgram( delta_info_t *dt )
+{
+	if( dt->program )
+	{
+		Z_Free( dt->program );
+		dt->program = NULL;
+	}
+}
+
+static void Delta_CompileOp( delta_op_t *op, const delta_t *pField )
+{
+	int	clampsign;
+
+	op->offset = pField->offset;
+	op->bits = pField->bits;
+	op->multiplier = pField->multiplier;
+	op->signbit = FBitSet( pField->flags, DT_SIGNED ) ? 1 : 0;
+	op->cmp_scaled = !Q_equal( pField->multiplier, 1.0f );
+	op->write_scaled = !Q_equal( pField->multiplier, 1.0 );
+
+	if( FBitSet( pField->flags, DT_BYTE ))
+		op->kind = DELTA_OP_BYTE, op->width = 1;
+	else if( FBitSet( pField->flags, DT_SHORT ))
+		op->kind = DELTA_OP_SHORT, op->width = 2;
+	else if( FBitSet( pField->flags, DT_INTEGER ))
+		op->kind = DELTA_OP_INTEGER, op->width = 4;
+	else if( FBitSet( pField->flags, DT_FLOAT ))
+		op->kind = DELTA_OP_FLOAT, op->width = 4;
+	else if( FBitSet( pField->flags, DT_ANGLE ))
+		op->kind = DELTA_OP_ANGLE, op->width = 4;
+	else if( FBitSet( pField->flags, DT_TIMEWINDOW_8 ))
+		op->kind = DELTA_OP_TIMEWINDOW_8, op->width = 4;
+	else if( FBitSet( pField->flags, DT_TIMEWINDOW_BIG ))
+		op->kind = DELTA_OP_TIMEWINDOW_BIG, op->width = 4;
+	else if( FBitSet( pField->flags, DT_STRING ))
+		op->kind = DELTA_OP_STRING, op->width = 0;
+	else op->kind = DELTA_OP_NONE, op->width = 0;
+
+	// time windows are always clamped as signed
+	clampsign = ( op->kind == DELTA_OP_TIMEWINDOW_8 || op->kind == DELTA_OP_TIMEWINDOW_BIG ) ? 1 : op->signbit;
+
+	if( op->bits < 32 )
+	{
+		op->maxnum = BIT( op->bits - clampsign ) - 1;
+		op->minnum = clampsign ? -op->maxnum - 1 : INT_MIN;
+	}
+	else
+	{
+		op->maxnum = INT_MAX;
+		op->minnum = INT_MIN;
+	}
+}
+
+/*
+=====================
+Delta_CompileTable
+
+=====================
+*/
+static void Delta_CompileTable( delta_info_t *dt )
+{
+	delta_program_t	*prog;
+	delta_group_t	*group = NULL;
+	int		i, j, numOrdered = 0;
+
+	Delta_FreeProgram( dt );
+
+	if( !dt->bInitialized || !dt->pFields || dt->numFields <= 0 || dt->numFields > DELTA_MAX_ENTITY_FIELDS )
+		return;
+
+	prog = Z_Calloc( sizeof( *prog ));
+	prog->numFields = dt->numFields;
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		Delta_CompileOp( &prog->ops[i], &dt->pFields[i] );
+
+		if( prog->ops[i].width == 0 )
+			continue;
+
+		// insertion sort by offset, tables are small
+		for( j = numOrdered; j > 0 && prog->ops[prog->order[j - 1]].offset > prog->ops[i].offset; j-- )
+			prog->order[j] = prog->order[j - 1];
+		prog->order[j] = i;
+		numOrdered++;
+	}
+
+	// merge fields touching same or adjacent bytes
+	for( i = 0; i < numOrdered; i++ )
+	{
+		const delta_op_t *op = &prog->ops[prog->order[i]];
+
+		if( group && op->offset <= group->offset + group->size && op->offset + op->width - group->offset <= DELTA_GROUP_BYTES )
+		{
+			group->size = Q_max( group->size, op->offset + op->width - group->offset );
+			group->count++;
+			continue;
+		}
+
+		group = &prog->groups[prog->numGroups++];
+		group->offset = op->offset;
+		group->size = op->width;
+		group->first = i;
+		group->count = 1;
+	}
+
+	// strings are compared by value
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( prog->ops[i].kind != DELTA_OP_STRING )
+			continue;
+
+		prog->order[numOrdered] = i;
+		group = &prog->groups[prog->numGroups++];
+		group->offset = prog->ops[i].offset;
+		group->size = 0;
+		group->first = numOrdered++;
+		group->count = 1;
+	}
+
+	dt->program = prog;
+}
+
+static inline int Delta_ClampOp( const delta_op_t *op, int iValue )
+{
+	if( iValue > op->maxnum )
+		return op->maxnum;
+	if( iValue < op->minnum )
+		return op->minnum;
+	return iValue;
+}
+
+/*
+=====================
+Delta_CompareOp
+
+same as Delta_CompareFieldValue
+=====================
+*/
+static qboolean Delta_CompareOp( const delta_op_t *op, const void *from, const void *to )
+{
+	const byte	*a = (const byte *)from + op->offset;
+	const byte	*b = (const byte *)to + op->offset;
+	int		fromF, toF;
+	float		val_a, val_b;
+
+	switch( op->kind )
+	{
+	case DELTA_OP_BYTE:
+		fromF = op->signbit ? *(const int8_t *)a : *(const uint8_t *)a;
+		toF = op->signbit ? *(const int8_t *)b : *(const uint8_t *)b;
+		break;
+	case DELTA_OP_SHORT:
+		fromF = op->signbit ? *(const int16_t *)a : *(const uint16_t *)a;
+		toF = op->signbit ? *(const int16_t *)b : *(const uint16_t *)b;
+		break;
+	case DELTA_OP_INTEGER:
+		fromF = *(const int32_t *)a;
+		toF = *(const int32_t *)b;
+		break;
+	case DELTA_OP_FLOAT:
+	case DELTA_OP_ANGLE:
+		// don't convert floats to integers
+		return *(const int *)a == *(const int *)b;
+	case DELTA_OP_TIMEWINDOW_8:
+		val_a = *(const float *)a;
+		val_b = *(const float *)b;
+		return Q_rint( val_a * 100.0 ) == Q_rint( val_b * 100.0 );
+	case DELTA_OP_TIMEWINDOW_BIG:
+		val_a = *(const float *)a;
+		val_b = *(const float *)b;
+		fromF = Q_rint( val_a * op->multiplier );
+		toF = Q_rint( val_b * op->multiplier );
+		return fromF == toF;
+	case DELTA_OP_STRING:
+		return !Q_strcmp( (const char *)a, (const char *)b );
+	default:
+		return true;
+	}
+
+	if( op->cmp_scaled )
+	{
+		fromF *= op->multiplier;
+		toF *= op->multiplier;
+	}
+
+	return Delta_ClampOp( op, fromF ) == Delta_ClampOp( op, toF );
+}
+
+/*
+=====================
+Delta_WriteOp
+
+same as Delta_WriteField_
+=====================
+*/
+static void Delta_WriteOp( bitwriter_t *bw, const delta_op_t *op, const void *to, double timebase )
+{
+	const byte	*p = (const byte *)to + op->offset;
+	float		flValue;
+	uint		iValue;
+	int		dt;
+
+	switch( op->kind )
+	{
+	case DELTA_OP_BYTE:
+		if( op->signbit ) iValue = *(const int8_t *)p;
+		else iValue = *(const uint8_t *)p;
+		break;
+	case DELTA_OP_SHORT:
+		if( op->signbit ) iValue = *(const int16_t *)p;
+		else iValue = *(const uint16_t *)p;
+		break;
+	case DELTA_OP_INTEGER:
+		iValue = *(const uint32_t *)p;
+		break;
+	case DELTA_OP_FLOAT:
+		flValue = *(const float *)p;
+		iValue = (int)((double)flValue * op->multiplier );
+		iValue = Delta_ClampOp( op, iValue );
+		MSG_PutBitLong( bw, iValue, op->bits, op->signbit );
+		return;
+	case DELTA_OP_ANGLE:
+		MSG_PutBitAngle( bw, *(const float *)p, op->bits );
+		return;
+	case DELTA_OP_TIMEWINDOW_8:
+		flValue = *(const float *)p;
+		dt = Q_rint(( timebase - flValue ) * 100.0 );
+		MSG_PutSBitLong( bw, Delta_ClampOp( op, dt ), op->bits );
+		return;
+	case DELTA_OP_TIMEWINDOW_BIG:
+		flValue = *(const float *)p;
+		dt = Q_rint(( timebase - flValue ) * op->multiplier );
+		MSG_PutSBitLong( bw, Delta_ClampOp( op, dt ), op->bits );
+		return;
+	case DELTA_OP_STRING:
+		MSG_FlushBitWriter( bw );
+		MSG_WriteString( bw->sb, (const char *)p );
+		return;
+	default:
+		return;
+	}
+
+	if( op->write_scaled )
+		iValue *= op->multiplier;
+
+	iValue = Delta_ClampOp( op, iValue );
+	MSG_PutBitLong( bw, iValue, op->bits, op->signbit );
+}
+
+/*
+=====================
+Delta_ChangedFields
+
+fills mask of active fields that differ, returns their count
+=====================
+*/
+static int Delta_ChangedFields( const delta_program_t *prog, const uint32_t *active, const void *from, const void *to, uint32_t *changed )
+{
+	const delta_group_t	*group = prog->groups;
+	int		i, j, numChanges = 0;
+
+	memset( changed, 0, sizeof( *changed ) * DELTA_MASK_WORDS );
+
+	for( i = 0; i < prog->numGroups; i++, group++ )
+	{
+		if( group->size && !memcmp((const byte *)from + group->offset, (const byte *)to + group->offset, group->size ))
+			continue;
+
+		for( j = group->first; j < group->first + group->count; j++ )
+		{
+			int	field = prog->order[j];
+
+			const delta_op_t	*op = &prog->ops[field];
+
+			if( !FBitSet( active[field >> 5], BIT( field & 31 )))
+				continue;
+
+			// same bytes always give same value
+			if( op->width && !memcmp((const byte *)from + op->offset, (const byte *)to + op->offset, op->width ))
+				continue;
+
+			if( Delta_CompareOp( op, from, to ))
+				continue;
+
+			SetBits( changed[field >> 5], BIT( field & 31 ));
+			numChanges++;
+		}
+	}
+
+	return numChanges;
+}
+
+/*
+=====================
+Delta_WriteProgram
+
+writes change flag for each field and values of changed ones,
+runs of unchanged flags are written at once
+=====================
+*/
+static void Delta_WriteProgram( sizebuf_t *msg, const delta_program_t *prog, const uint32_t *changed, const void *to, double timebase )
+{
+	int		i, unchanged = 0;
+	bitwriter_t	bw;
+
+	MSG_BeginBitWriter( &bw, msg );
+
+	for( i = 0; i < prog->numFields; i++ )
+	{
+		if( !FBitSet( changed[i >> 5], BIT( i & 31 )))
+		{
+			unchanged++;
+			continue;
+		}
+
+		while( unchanged > 0 )
+		{
+			int	n = Q_min( unchanged, 32 );
+
+			MSG_PutUBitLong( &bw, 0, n );
+			unchanged -= n;
+		}
+
+		MSG_PutOneBit( &bw, 1 );
+		Delta_WriteOp( &bw, &prog->ops[i], to, timebase );
+	}
+
+	while( unchanged > 0 )
+	{
+		int	n = Q_min( unchanged, 32 );
+
+		MSG_PutUBitLong( &bw, 0, n );
+		unchanged -= n;
+	}
+
+	MSG_FlushBitWriter( &bw );
+}
+
+/*
+=====================
+Delta_ActiveFields
+
+mask of fields left active by custom encoder
+=====================
+*/
+static void Delta_ActiveFields( const delta_info_t *dt, uint32_t *active )
+{
+	int	i;
+
+	memset( active, 0, sizeof( *active ) * DELTA_MASK_WORDS );
+
+	for( i = 0; i < dt->numFields && i < DELTA_MAX_ENTITY_FIELDS; i++ )
+	{
+		if( !dt->pFields[i].bInactive )
+			SetBits( active[i >> 5], BIT( i & 31 ));
+	}
+}
+
 /*
 =====================
 Delta_TestBaseline
@@ -1186,9 +1640,36 @@ int Delta_TestBaseline( const entity_state_t *from, const entity_state_t *to, qb
 	pField = dt->pFields;
 	Assert( pField != NULL );
 
+	if( !dt->program )
+		Delta_CompileTable( dt );
+
 	// activate fields and call custom encode func
 	Delta_CustomEncode( dt, from, to );
 
+	if( dt->program )
+	{
+		uint32_t	active[DELTA_MASK_WORDS], changed[DELTA_MASK_WORDS];
+
+		Delta_ActiveFields( dt, active );
+		Delta_ChangedFields( dt->program, active, from, to, changed );
+
+		// flag about field change (sets always)
+		countBits += dt->numFields;
+
+		for( i = 0; i < dt->numFields; i++, pField++ )
+		{
+			if( !FBitSet( changed[i >> 5], BIT( i & 31 )))
+				continue;
+
+			// strings are handled differently
+			if( FBitSet( pField->flags, DT_STRING ))
+				countBits += Q_strlen((char *)((byte *)to + pField->offset )) * 8;
+			else countBits += pField->bits;
+		}
+
+		return countBits;
+	}
+
 	// process fields
 	for( i = 0; i < dt->numFields; i++, pField++ )
 	{
@@ -1314,6 +1795,44 @@ static qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, const void *f
 	return true;
 }
 
+/*
+=====================
+Delta_WriteFields
+
+writes all fields of table marked in active mask,
+returns number of changed fields
+=====================
+*/
+static int Delta_WriteFields( sizebuf_t *msg, delta_info_t *dt, const uint32_t *active, const void *from, const void *to, double timebase )
+{
+	delta_t	*pField = dt->pFields;
+	int	i, numChanges = 0;
+
+	if( dt->program )
+	{
+		uint32_t	changed[DELTA_MASK_WORDS];
+
+		numChanges = Delta_ChangedFields( dt->program, active, from, to, changed );
+		Delta_WriteProgram( msg, dt->program, changed, to, timebase );
+		return numChanges;
+	}
+
+	for( i = 0; i < dt->numFields; i++, pField++ )
+	{
+		if( !FBitSet( active[i >> 5], BIT( i & 31 )) || Delta_CompareFieldValue( pField, from, to ))
+		{
+			MSG_WriteOneBit( msg, 0 );	// unchanged
+			continue;
+		}
+
+		MSG_WriteOneBit( msg, 1 );	// changed
+		Delta_WriteField_( msg, pField, from, to, timebase );
+		numChanges++;
+	}
+
+	return numChanges;
+}
+
 /*
 ====================
 Delta_CopyField
@@ -1888,20 +2407,85 @@ entity_state_t communication
 */
 /*
 ==================
-MSG_WriteDeltaEntity
+Delta_EntityStruct
 
-Writes part of a packetentities message, including the entity number.
-Can delta from either a baseline or a previous packet_entity
-If to is NULL, a remove entity update will be sent
-If force is not set, then nothing at all will be generated if the entity is
-identical, under the assumption that the in-order delta code will catch it.
 ==================
 */
-void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline )
+static delta_info_t *Delta_EntityStruct( const entity_state_t *to, int delta_type )
 {
-	delta_info_t	*dt = NULL;
-	delta_t		*pField;
-	int		i, startBit;
+	if( FBitSet( to->entityType, ENTITY_BEAM ))
+		return Delta_FindStructByIndex( DT_CUSTOM_ENTITY_STATE_T );
+	else if( delta_type == DELTA_PLAYER )
+		return Delta_FindStructByIndex( DT_ENTITY_STATE_PLAYER_T );
+	return Delta_FindStructByIndex( DT_ENTITY_STATE_T );
+}
+
+/*
+==================
+Delta_PrepareEntity
+
+Runs everything MSG_WriteDeltaEntity needs from the game dll
+and the shared delta tables and stores the result in op,
+so the delta itself can be written later from any thread
+==================
+*/
+void Delta_PrepareEntity( delta_entity_op_t *op, const entity_state_t *from, const entity_state_t *to, qboolean force, int delta_type, int baseline )
+{
+	delta_info_t	*dt;
+	int		i;
+
+	op->from = from;
+	op->to = to;
+	op->force = force;
+	op->delta_type = delta_type;
+	op->baseline = baseline;
+	memset( op->active, 0, sizeof( op->active ));
+
+	if( to == NULL )
+		return;
+
+	if( to->number < 0 || to->number >= GI->max_edicts )
+		Host_Error( "%s: Bad entity number: %i\n", __func__, to->number );
+
+	dt = Delta_EntityStruct( to, delta_type );
+
+	Assert( dt && dt->bInitialized );
+	Assert( dt->numFields <= DELTA_MAX_ENTITY_FIELDS );
+
+	if( !dt->program )
+		Delta_CompileTable( dt );
+
+	if( delta_type == DELTA_STATIC )
+	{
+		// static entities won't to be custom encoded
+		for( i = 0; i < dt->numFields; i++ )
+			dt->pFields[i].bInactive = false;
+	}
+	else
+	{
+		// activate fields and call custom encode func
+		Delta_CustomEncode( dt, from, to );
+	}
+
+	// remember which fields encoder left for us
+	Delta_ActiveFields( dt, op->active );
+}
+
+/*
+==================
+MSG_WriteDeltaEntityOp
+
+Writes entity delta prepared by Delta_PrepareEntity.
+Doesn't touch game dll or shared field state, so it's safe to call
+from worker threads as long as tables aren't modified meanwhile
+==================
+*/
+void MSG_WriteDeltaEntityOp( sizebuf_t *msg, const delta_entity_op_t *op, double timebase )
+{
+	const entity_state_t	*from = op->from;
+	const entity_state_t	*to = op->to;
+	delta_info_t	*dt;
+	int		startBit;
 	int		numChanges = 0;
 
 	if( to == NULL )
@@ -1917,7 +2501,7 @@ void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to,
 		// 0 - keep alive, has delta-update
 		// 1 - remove from delta message (but keep states)
 		// 2 - completely remove from server
-		if( force ) fRemoveType = 2;
+		if( op->force ) fRemoveType = 2;
 		else fRemoveType = 1;
 
 		MSG_WriteUBitLong( msg, fRemoveType, 2 );
@@ -1926,20 +2510,17 @@ void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to,
 
 	startBit = msg->iCurBit;
 
-	if( to->number < 0 || to->number >= GI->max_edicts )
-		Host_Error( "%s: Bad entity number: %i\n", __func__, to->number );
-
 	MSG_WriteUBitLong( msg, to->number, MAX_ENTITY_BITS );
 	MSG_WriteUBitLong( msg, 0, 2 ); // alive
 
-	if( baseline != 0 )
+	if( op->baseline != 0 )
 	{
 		MSG_WriteOneBit( msg, 1 );
-		MSG_WriteSBitLong( msg, baseline, 7 );
+		MSG_WriteSBitLong( msg, op->baseline, 7 );
 	}
 	else MSG_WriteOneBit( msg, 0 );
 
-	if( force || ( to->entityType != from->entityType ))
+	if( op->force || ( to->entityType != from->entityType ))
 	{
 		MSG_WriteOneBit( msg, 1 );
 		MSG_WriteUBitLong( msg, to->entityType, 2 );
@@ -1947,45 +2528,35 @@ void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to,
 	}
 	else MSG_WriteOneBit( msg, 0 );
 
-	if( FBitSet( to->entityType, ENTITY_BEAM ))
-	{
-		dt = Delta_FindStructByIndex( DT_CUSTOM_ENTITY_STATE_T );
-	}
-	else if( delta_type == DELTA_PLAYER )
-	{
-		dt = Delta_FindStructByIndex( DT_ENTITY_STATE_PLAYER_T );
-	}
-	else
-	{
-		dt = Delta_FindStructByIndex( DT_ENTITY_STATE_T );
-	}
+	dt = Delta_EntityStruct( to, op->delta_type );
 
 	Assert( dt && dt->bInitialized );
-
-	pField = dt->pFields;
-	Assert( pField != NULL );
-
-	if( delta_type == DELTA_STATIC )
-	{
-		// static entities won't to be custom encoded
-		for( i = 0; i < dt->numFields; i++ )
-			dt->pFields[i].bInactive = false;
-	}
-	else
-	{
-		// activate fields and call custom encode func
-		Delta_CustomEncode( dt, from, to );
-	}
+	Assert( dt->pFields != NULL );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges += Delta_WriteFields( msg, dt, op->active, from, to, timebase );
 
 	// if we have no changes - kill the message
-	if( !numChanges && !force ) MSG_SeekToBit( msg, startBit, SEEK_SET );
+	if( !numChanges && !op->force ) MSG_SeekToBit( msg, startBit, SEEK_SET );
+}
+
+/*
+==================
+MSG_WriteDeltaEntity
+
+Writes part of a packetentities message, including the entity number.
+Can delta from either a baseline or a previous packet_entity
+If to is NULL, a remove entity update will be sent
+If force is not set, then nothing at all will be generated if the entity is
+identical, under the assumption that the in-order delta code will catch it.
+==================
+*/
+void MSG_WriteDeltaEntity( const entity_state_t *from, const entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline )
+{
+	delta_entity_op_t	op;
+
+	Delta_PrepareEntity( &op, from, to, force, delta_type, baseline );
+	MSG_WriteDeltaEntityOp( msg, &op, timebase );
 }
 
 /*
@@ -2272,6 +2843,177 @@ void GAME_EXPORT Delta_UnsetFieldByIndex( delta_t *pFields, int fieldNumber )
 #if XASH_ENGINE_TESTS
 #include "tests.h"
 
+#define TEST_DELTA_STATES	512
+#define TEST_DELTA_PASSES	64
+
+static void Test_RandomEntityState( entity_state_t *state )
+{
+	byte	*p = (byte *)state;
+	int	i;
+
+	// garbage is fine, clamping must match too
+	for( i = 0; i < sizeof( *state ); i++ )
+		p[i] = COM_RandomLong( 0, 255 );
+
+	for( i = 0; i < 3; i++ )
+	{
+		state->origin[i] = COM_RandomFloat( -4096.0f, 4096.0f );
+		state->angles[i] = COM_RandomFloat( -360.0f, 360.0f );
+		state->mins[i] = COM_RandomFloat( -64.0f, 0.0f );
+		state->maxs[i] = COM_RandomFloat( 0.0f, 64.0f );
+		state->basevelocity[i] = COM_RandomFloat( -512.0f, 512.0f );
+	}
+
+	state->animtime = COM_RandomFloat( 0.0f, 200.0f );
+	state->impacttime = COM_RandomFloat( 0.0f, 200.0f );
+	state->frame = COM_RandomFloat( 0.0f, 255.0f );
+	state->framerate = COM_RandomFloat( -4.0f, 4.0f );
+	state->scale = COM_RandomFloat( 0.0f, 4.0f );
+}
+
+// typical frame, most of the fields are the same
+static void Test_MoveEntityState( entity_state_t *state )
+{
+	int	i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( COM_RandomLong( 0, 1 ))
+			state->origin[i] += COM_RandomFloat( -8.0f, 8.0f );
+	}
+
+	state->angles[YAW] += COM_RandomFloat( -10.0f, 10.0f );
+	state->animtime += 0.1f;
+	state->frame += 1.0f;
+
+	if( !COM_RandomLong( 0, 8 ))
+		state->sequence = COM_RandomLong( 0, 255 );
+}
+
+static double Test_EncodeEntities( sizebuf_t *msg, delta_info_t *dt, const entity_state_t *states, const uint32_t *active )
+{
+	double	start = Sys_DoubleTime();
+	int	pass, i;
+
+	for( pass = 0; pass < TEST_DELTA_PASSES; pass++ )
+	{
+		MSG_Clear( msg );
+
+		for( i = 0; i < TEST_DELTA_STATES; i++ )
+			Delta_WriteFields( msg, dt, &active[i * DELTA_MASK_WORDS], &states[i * 2], &states[i * 2 + 1], 100.0 );
+	}
+
+	return Sys_DoubleTime() - start;
+}
+
+static void Test_DeltaEncoders( void )
+{
+	delta_info_t *dt = &dt_info[DT_ENTITY_STATE_T];
+	static entity_state_t states[TEST_DELTA_STATES * 2];
+	static uint32_t active[TEST_DELTA_STATES * DELTA_MASK_WORDS];
+	static byte legacy[0x80000], compiled[0x80000];
+	delta_program_t *prog;
+	double legacy_time, compiled_time;
+	sizebuf_t msg1, msg2;
+	int i, j, bits;
+
+	// close to default delta.lst, plus few scaled and clamped fields
+	Delta_AddField( dt, "animtime", DT_TIMEWINDOW_8, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "frame", DT_FLOAT, 10, 4.0f, 1.0f );
+	Delta_AddField( dt, "origin[0]", DT_SIGNED|DT_FLOAT, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "angles[0]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "angles[1]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "origin[1]", DT_SIGNED|DT_FLOAT, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "origin[2]", DT_SIGNED|DT_FLOAT, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "sequence", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "modelindex", DT_INTEGER, 10, 1.0f, 1.0f );
+	Delta_AddField( dt, "movetype", DT_INTEGER, 4, 1.0f, 1.0f );
+	Delta_AddField( dt, "solid", DT_SHORT, 3, 1.0f, 1.0f );
+	Delta_AddField( dt, "mins[0]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "mins[1]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "mins[2]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "maxs[0]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "maxs[1]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "maxs[2]", DT_SIGNED|DT_FLOAT, 12, 1.0f, 1.0f );
+	Delta_AddField( dt, "impacttime", DT_TIMEWINDOW_BIG, 8, 100.0f, 1.0f );
+	Delta_AddField( dt, "weaponmodel", DT_INTEGER, 10, 1.0f, 1.0f );
+	Delta_AddField( dt, "owner", DT_INTEGER, 5, 1.0f, 1.0f );
+	Delta_AddField( dt, "effects", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "eflags", DT_INTEGER, 1, 1.0f, 1.0f );
+	Delta_AddField( dt, "angles[2]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "colormap", DT_INTEGER, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "framerate", DT_SIGNED|DT_FLOAT, 8, 16.0f, 1.0f );
+	Delta_AddField( dt, "skin", DT_SHORT|DT_SIGNED, 9, 1.0f, 1.0f );
+	Delta_AddField( dt, "controller[0]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "controller[1]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "controller[2]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "controller[3]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "blending[0]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "blending[1]", DT_BYTE|DT_SIGNED, 6, 1.0f, 1.0f );
+	Delta_AddField( dt, "body", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "rendermode", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "renderamt", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "renderfx", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "scale", DT_FLOAT, 16, 256.0f, 1.0f );
+	Delta_AddField( dt, "rendercolor.r", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "rendercolor.g", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "rendercolor.b", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "aiment", DT_INTEGER, 11, 1.0f, 1.0f );
+	Delta_AddField( dt, "basevelocity[0]", DT_SIGNED|DT_FLOAT, 16, 8.0f, 1.0f );
+	Delta_AddField( dt, "basevelocity[1]", DT_SIGNED|DT_FLOAT, 16, 8.0f, 1.0f );
+	Delta_AddField( dt, "basevelocity[2]", DT_SIGNED|DT_FLOAT, 16, 8.0f, 1.0f );
+	Delta_AddField( dt, "team", DT_INTEGER|DT_SIGNED, 6, 2.0f, 1.0f );
+	Delta_AddField( dt, "iuser1", DT_INTEGER, 12, 0.5f, 1.0f );
+	Delta_AddField( dt, "gravity", DT_SHORT|DT_SIGNED, 10, 3.0f, 1.0f );
+	dt->bInitialized = true;
+
+	for( i = 0; i < TEST_DELTA_STATES; i++ )
+	{
+		Test_RandomEntityState( &states[i * 2] );
+
+		// mix of idle, moving and completely different entities
+		if(( i & 3 ) == 3 )
+		{
+			Test_RandomEntityState( &states[i * 2 + 1] );
+		}
+		else
+		{
+			states[i * 2 + 1] = states[i * 2];
+			if( i & 1 ) Test_MoveEntityState( &states[i * 2 + 1] );
+		}
+
+		for( j = 0; j < DELTA_MASK_WORDS; j++ )
+			active[i * DELTA_MASK_WORDS + j] = ( i % 3 ) ? 0xffffffff : COM_RandomLong( 0, 0x7fffffff );
+	}
+
+	MSG_Init( &msg1, "legacy", legacy, sizeof( legacy ));
+	MSG_Init( &msg2, "compiled", compiled, sizeof( compiled ));
+
+	Delta_CompileTable( dt );
+	prog = dt->program;
+	TASSERT( prog != NULL );
+
+	dt->program = NULL;
+	legacy_time = Test_EncodeEntities( &msg1, dt, states, active );
+	dt->program = prog;
+	compiled_time = Test_EncodeEntities( &msg2, dt, states, active );
+
+	bits = MSG_GetNumBitsWritten( &msg1 );
+	TASSERT( !MSG_CheckOverflow( &msg1 ));
+	TASSERT_EQi( bits, MSG_GetNumBitsWritten( &msg2 ));
+	TASSERT( !memcmp( legacy, compiled, BitByte( bits )));
+
+	Con_Printf( "%s: %d fields, %d groups, %.1f ns per entity_state_t (%.1f ns before)\n", __func__, dt->numFields,
+		prog->numGroups, compiled_time * 1e9 / ( TEST_DELTA_STATES * TEST_DELTA_PASSES ),
+		legacy_time * 1e9 / ( TEST_DELTA_STATES * TEST_DELTA_PASSES ));
+
+	Delta_FreeProgram( dt );
+	Z_Free( dt->pFields );
+	dt->pFields = NULL;
+	dt->numFields = 0;
+	dt->bInitialized = false;
+}
+
 void Test_RunDelta( void )
 {
 	delta_info_t *dt = &dt_info[DT_DELTA_TEST_STRUCT_T];
@@ -2362,5 +3104,12 @@ void Test_RunDelta( void )
 	Con_Printf( "to.dt_byte_signed   = %i\n", to.dt_byte_signed );
 	Con_Printf( "from.dt_byte_unsigned = %i\n", from.dt_byte_unsigned );
 	Con_Printf( "to.dt_byte_unsigned   = %i\n", to.dt_byte_unsigned );
+
+	Delta_FreeProgram( dt );
+	Z_Free( dt->pFields );
+	dt->pFields = NULL;
+	dt->numFields = 0;
+
+	TRUN( Test_DeltaEncoders( ));
 }
 #endif // XASH_ENGINE_TESTS
@@ -95,8 +95,23 @@ typedef struct
 	char		funcName[32];
 	pfnDeltaEncode	userCallback;
 	qboolean		bInitialized;
+
+	struct delta_program_s	*program;	// compiled encoder, rebuilt when fields change
 } delta_info_t;
 
+#define DELTA_MAX_ENTITY_FIELDS	128
+
+// entity delta with custom encoder already applied
+typedef struct delta_entity_op_s
+{
+	const struct entity_state_s	*from;
+	const struct entity_state_s	*to;
+	int		baseline;
+	qboolean		force;
+	int		delta_type;
+	uint32_t		active[DELTA_MAX_ENTITY_FIELDS / 32]; // fields left active by encoder
+} delta_entity_op_t;
+
 //
 // net_encode.c
 //
@@ -134,6 +149,9 @@ void MSG_ReadClientData( sizebuf_t *msg, const struct clientdata_s *from, struct
 void MSG_WriteWeaponData( sizebuf_t *msg, const struct weapon_data_s *from, const struct weapon_data_s *to, double timebase, int index );
 void MSG_ReadWeaponData( sizebuf_t *msg, const struct weapon_data_s *from, struct weapon_data_s *to, double timebase );
 void MSG_WriteDeltaEntity( const struct entity_state_s *from, const struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs );
+void Delta_PrepareEntity( delta_entity_op_t *op, const struct entity_state_s *from, const struct entity_state_s *to, qboolean force, int delta_type, int baseline );
+void MSG_WriteDeltaEntityOp( sizebuf_t *msg, const delta_entity_op_t *op, double timebase );
+void Delta_SetQuiet( qboolean quiet );
 qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, const struct entity_state_s *from, struct entity_state_s *to, int num, int type, double timebase );
 int Delta_TestBaseline( const struct entity_state_s *from, const struct entity_state_s *to, qboolean player, double timebase );
 void Delta_ReadGSFields( sizebuf_t *msg, int index, const void *from, void *to, double timebase );
@@ -35,6 +35,14 @@ GNU General Public License for more details.
 #define NET_MAX_FRAGMENTS         ( NET_MAX_FRAGMENT / (SPLITPACKET_MIN_SIZE - sizeof( SPLITPACKET )))
 #define NET_MAX_GOLDSRC_FRAGMENTS 5 // magic number
 
+#if XASH_LINUX && !XASH_ANDROID
+#define XASH_NET_MMSG 1 // recvmmsg and sendmmsg are available
+#define NET_MMSG_BATCH 16      // datagrams per syscall
+#define NET_MMSG_ARENA 0x20000 // storage for queued outgoing datagrams
+#else
+#define XASH_NET_MMSG 0
+#endif
+
 // ff02:1
 static const uint8_t k_ipv6Bytes_LinkLocalAllNodes[16] =
 { 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
@@ -87,6 +95,33 @@ typedef struct
 } SPLITPACKETGS;
 #pragma pack(pop)
 
+#if XASH_NET_MMSG
+// datagrams received by single recvmmsg call, handed out one by one
+typedef struct
+{
+	byte		*data;	// NET_MMSG_BATCH slots of NET_MAX_FRAGMENT bytes
+	struct mmsghdr	hdrs[NET_MMSG_BATCH];
+	struct iovec	iovs[NET_MMSG_BATCH];
+	struct sockaddr_storage	addrs[NET_MMSG_BATCH];
+	int		head;	// next slot to hand out
+	int		count;	// slots filled by last call
+} net_recvring_t;
+
+// datagrams waiting for single sendmmsg call
+typedef struct
+{
+	byte		*data;	// NET_MMSG_ARENA bytes
+	size_t		used;
+	struct mmsghdr	hdrs[NET_MMSG_BATCH];
+	struct iovec	iovs[NET_MMSG_BATCH];
+	struct sockaddr_storage	addrs[NET_MMSG_BATCH];
+	netadr_t		to[NET_MMSG_BATCH];	// for error messages
+	int		sockets[NET_MMSG_BATCH];
+	int		count;
+	qboolean		active;	// between NET_BeginSendBatch and NET_FlushSendBatch
+} net_sendqueue_t;
+#endif
+
 typedef struct
 {
 	net_loopback_t	loopbacks[NS_COUNT];
@@ -103,6 +138,12 @@ typedef struct
 	qboolean		configured;
 	qboolean		allow_ip;
 	qboolean		allow_ip6;
+	uint		recvcalls;		// socket syscalls, for benchmarking
+	uint		sendcalls;
+#if XASH_NET_MMSG
+	net_recvring_t	recvrings[2];		// server socket, IPv4 and IPv6
+	net_sendqueue_t	sendqueue;		// server socket
+#endif
 #if XASH_WIN32
 	WSADATA		winsockdata;
 #endif
@@ -118,6 +159,9 @@ static CVAR_DEFINE( net_clientport, "clientport", "0", FCVAR_READ_ONLY, "network
 static CVAR_DEFINE( net_fakelag, "fakelag", "0", FCVAR_PRIVILEGED, "lag all incoming network data (including loopback) by xxx ms." );
 static CVAR_DEFINE( net_fakeloss, "fakeloss", "0", FCVAR_PRIVILEGED, "act like we dropped the packet this % of the time." );
 static CVAR_DEFINE_AUTO( net_resolve_debug, "0", FCVAR_PRIVILEGED, "print resolve thread debug messages" );
+#if XASH_NET_MMSG
+static CVAR_DEFINE_AUTO( net_mmsg, "1", FCVAR_PRIVILEGED, "receive and send server packets in batches with recvmmsg/sendmmsg" );
+#endif
 CVAR_DEFINE( net_clockwindow, "clockwindow", "0.5", FCVAR_PRIVILEGED, "timewindow to execute client moves" );
 
 netadr_t			net_local;
@@ -140,6 +184,21 @@ static inline qboolean NET_IsSocketError( int retval )
 #endif
 }
 
+static inline qboolean NET_IsQuietRecvError( int err )
+{
+	switch( err )
+	{
+	case WSAEWOULDBLOCK:
+	case WSAECONNRESET:
+	case WSAECONNREFUSED:
+	case WSAEMSGSIZE:
+	case WSAETIMEDOUT:
+		return true;
+	}
+
+	return false;
+}
+
 static inline qboolean NET_IsSocketValid( int socket )
 {
 #if XASH_WIN32 || XASH_DOS4GW
@@ -1382,6 +1441,7 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 
 		addr_len = sizeof( addr );
 		ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+		net.recvcalls++;
 
 		NET_SockadrToNetadr( &addr, from );
 
@@ -1412,27 +1472,114 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 				Con_Reportf( "%s: oversize packet from %s\n", __func__, NET_AdrToString( *from ));
 			}
 		}
-		else
+		else if( !NET_IsQuietRecvError( WSAGetLastError( )))
+		{
+			// let's continue even after errors
+			Con_DPrintf( S_ERROR "%s: %s from %s\n", __func__, NET_ErrorString(), NET_AdrToString( *from ));
+		}
+	}
+
+	return NET_LagPacket( false, sock, from, length, data );
+}
+
+#if XASH_NET_MMSG
+/*
+==================
+NET_FillRecvRing
+
+reads all pending datagrams, up to NET_MMSG_BATCH, with one syscall
+==================
+*/
+static int NET_FillRecvRing( net_recvring_t *ring, int net_socket )
+{
+	int	i, ret;
+
+	if( !ring->data )
+		ring->data = Z_Malloc( NET_MMSG_BATCH * NET_MAX_FRAGMENT );
+
+	for( i = 0; i < NET_MMSG_BATCH; i++ )
+	{
+		struct msghdr *hdr = &ring->hdrs[i].msg_hdr;
+
+		ring->iovs[i].iov_base = ring->data + i * NET_MAX_FRAGMENT;
+		ring->iovs[i].iov_len = NET_MAX_FRAGMENT;
+
+		memset( hdr, 0, sizeof( *hdr ));
+		hdr->msg_name = &ring->addrs[i];
+		hdr->msg_namelen = sizeof( ring->addrs[i] );
+		hdr->msg_iov = &ring->iovs[i];
+		hdr->msg_iovlen = 1;
+	}
+
+	ret = recvmmsg( net_socket, ring->hdrs, NET_MMSG_BATCH, MSG_DONTWAIT, NULL );
+	net.recvcalls++;
+
+	ring->head = 0;
+	ring->count = Q_max( ret, 0 );
+
+	return ret;
+}
+
+/*
+==================
+NET_GetRingPacket
+
+returns next datagram from the server receive rings,
+data points into the ring and is valid until the next call.
+Rings are refilled only when batching is enabled
+==================
+*/
+static qboolean NET_GetRingPacket( netadr_t *from, byte **data, size_t *length )
+{
+	int	protocol;
+
+	for( protocol = 0; protocol < 2; protocol++ )
+	{
+		net_recvring_t	*ring = &net.recvrings[protocol];
+		int		net_socket = protocol ? net.ip6_sockets[NS_SERVER] : net.ip_sockets[NS_SERVER];
+
+		if( !NET_IsSocketValid( net_socket ))
+			continue;
+
+		while( true )
 		{
-			int	err = WSAGetLastError();
+			const struct mmsghdr *hdr;
+			int	slot;
 
-			switch( err )
+			if( ring->head >= ring->count )
 			{
-			case WSAEWOULDBLOCK:
-			case WSAECONNRESET:
-			case WSAECONNREFUSED:
-			case WSAEMSGSIZE:
-			case WSAETIMEDOUT:
-				break;
-			default:	// let's continue even after errors
-				Con_DPrintf( S_ERROR "%s: %s from %s\n", __func__, NET_ErrorString(), NET_AdrToString( *from ));
-				break;
+				if( !net_mmsg.value )
+					break;
+
+				if( NET_IsSocketError( NET_FillRecvRing( ring, net_socket )))
+				{
+					if( !NET_IsQuietRecvError( WSAGetLastError( )))
+						Con_DPrintf( S_ERROR "%s: %s\n", __func__, NET_ErrorString( ));
+					break;
+				}
+			}
+
+			slot = ring->head++;
+			hdr = &ring->hdrs[slot];
+
+			NET_SockadrToNetadr( &ring->addrs[slot], from );
+
+			if( hdr->msg_len >= NET_MAX_FRAGMENT || FBitSet( hdr->msg_hdr.msg_flags, MSG_TRUNC ))
+			{
+				Con_Reportf( "%s: oversize packet from %s\n", __func__, NET_AdrToString( *from ));
+				continue;
 			}
+
+			*data = ring->iovs[slot].iov_base;
+			*length = hdr->msg_len;
+
+			return true;
 		}
 	}
 
-	return NET_LagPacket( false, sock, from, length, data );
+	return false;
 }
+#endif // XASH_NET_MMSG
 
 /*
 ==================
@@ -1458,6 +1605,56 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 	}
 }
 
+/*
+==================
+NET_GetPacketNoCopy
+
+same as NET_GetPacket, but server packets may be returned
+in place from the receive ring. buffer is used when packet
+has to be copied anyway, *data is valid until the next call
+==================
+*/
+qboolean NET_GetPacketNoCopy( netsrc_t sock, netadr_t *from, byte *buffer, byte **data, size_t *length )
+{
+	if( !buffer || !data || !length )
+		return false;
+
+	*data = buffer;
+
+#if XASH_NET_MMSG
+	if( sock == NS_SERVER )
+	{
+		NET_AdjustLag();
+
+		if( NET_GetLoopPacket( sock, from, buffer, length ))
+			return NET_LagPacket( true, sock, from, length, buffer );
+
+		if( NET_GetRingPacket( from, data, length ))
+		{
+			if( net.fakelag <= 0.0f )
+				return NET_LagPacket( true, sock, from, length, *data );
+
+			// lagged packet that is returned instead of this one
+			// can be bigger than ring slot
+			memcpy( buffer, *data, *length );
+			*data = buffer;
+
+			return NET_LagPacket( true, sock, from, length, buffer );
+		}
+
+		*data = buffer;
+
+		// rings were polled already
+		if( net_mmsg.value )
+			return NET_LagPacket( false, sock, from, length, buffer );
+
+		return NET_QueuePacket( sock, from, buffer, length );
+	}
+#endif
+
+	return NET_GetPacket( sock, from, buffer, length );
+}
+
 /*
 ==================
 NET_SendLong
@@ -1506,6 +1703,7 @@ static int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t
 			}
 
 			ret = sendto( net_socket, packet, size + sizeof( SPLITPACKET ), flags, (const struct sockaddr *)to, tolen );
+			net.sendcalls++;
 			if( ret < 0 ) return ret; // error
 
 			if( ret >= size )
@@ -1521,10 +1719,153 @@ static int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t
 #endif
 	{
 		// no fragmenantion for client connection
+		net.sendcalls++;
 		return sendto( net_socket, buf, len, flags, (const struct sockaddr *)to, tolen );
 	}
 }
 
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( const char *caller, netadr_t to )
+{
+	netadrtype_t type = NET_NetadrType( &to );
+	int err = WSAGetLastError();
+
+	// WSAEWOULDBLOCK is silent
+	if( err == WSAEWOULDBLOCK )
+		return;
+
+	// some PPP links don't allow broadcasts
+	if( err == WSAEADDRNOTAVAIL && ( type == NA_BROADCAST || type == NA_MULTICAST_IP6 ))
+		return;
+
+	if( Host_IsDedicated( ))
+	{
+		Con_DPrintf( S_ERROR "%s: %s to %s\n", caller, NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
+	{
+		Con_DPrintf( S_ERROR "%s: %s to %s\n", caller, NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else
+	{
+		Con_Printf( S_ERROR "%s: %s to %s\n", caller, NET_ErrorString(), NET_AdrToString( to ));
+	}
+}
+
+#if XASH_NET_MMSG
+/*
+==================
+NET_FlushSendQueue
+
+sends queued datagrams, one syscall per run of same socket
+==================
+*/
+static void NET_FlushSendQueue( net_sendqueue_t *q )
+{
+	int	start = 0;
+
+	while( start < q->count )
+	{
+		int	end = start + 1;
+		int	ret;
+
+		while( end < q->count && q->sockets[end] == q->sockets[start] )
+			end++;
+
+		ret = sendmmsg( q->sockets[start], &q->hdrs[start], end - start, 0 );
+		net.sendcalls++;
+
+		// first datagram failed, report and skip it
+		if( ret <= 0 )
+		{
+			NET_SendError( __func__, q->to[start] );
+			ret = 1;
+		}
+
+		start += ret;
+	}
+
+	q->count = 0;
+	q->used = 0;
+}
+
+/*
+==================
+NET_QueueSendPacket
+
+returns false if datagram must be sent right away
+==================
+*/
+static qboolean NET_QueueSendPacket( net_sendqueue_t *q, int net_socket, const void *data, size_t length, const struct sockaddr_storage *addr, netadr_t to )
+{
+	struct msghdr	*hdr;
+	int		i;
+
+	if( length > NET_MMSG_ARENA )
+		return false;
+
+	if( q->count == NET_MMSG_BATCH || q->used + length > NET_MMSG_ARENA )
+		NET_FlushSendQueue( q );
+
+	if( !q->data )
+		q->data = Z_Malloc( NET_MMSG_ARENA );
+
+	i = q->count++;
+	memcpy( q->data + q->used, data, length );
+	q->iovs[i].iov_base = q->data + q->used;
+	q->iovs[i].iov_len = length;
+	q->used += length;
+
+	q->addrs[i] = *addr;
+	q->to[i] = to;
+	q->sockets[i] = net_socket;
+
+	hdr = &q->hdrs[i].msg_hdr;
+	memset( hdr, 0, sizeof( *hdr ));
+	hdr->msg_name = &q->addrs[i];
+	hdr->msg_namelen = NET_SockAddrLen( addr );
+	hdr->msg_iov = &q->iovs[i];
+	hdr->msg_iovlen = 1;
+
+	return true;
+}
+#endif // XASH_NET_MMSG
+
+/*
+==================
+NET_BeginSendBatch
+
+packets sent from server socket are queued until NET_FlushSendBatch
+==================
+*/
+void NET_BeginSendBatch( netsrc_t sock )
+{
+#if XASH_NET_MMSG
+	if( sock == NS_SERVER && net_mmsg.value )
+		net.sendqueue.active = true;
+#endif
+}
+
+/*
+==================
+NET_FlushSendBatch
+==================
+*/
+void NET_FlushSendBatch( netsrc_t sock )
+{
+#if XASH_NET_MMSG
+	if( sock != NS_SERVER )
+		return;
+
+	NET_FlushSendQueue( &net.sendqueue );
+	net.sendqueue.active = false;
+#endif
+}
+
 /*
 ==================
 NET_SendPacketEx
@@ -1561,34 +1902,25 @@ void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t
 
 	NET_NetadrToSockadr( &to, &addr );
 
-	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
-
-	if( NET_IsSocketError( ret ))
+#if XASH_NET_MMSG
+	if( sock == NS_SERVER && net.sendqueue.active )
 	{
-		int err = WSAGetLastError();
-
-		// WSAEWOULDBLOCK is silent
-		if( err == WSAEWOULDBLOCK )
-			return;
-
-		// some PPP links don't allow broadcasts
-		if( err == WSAEADDRNOTAVAIL && ( type == NA_BROADCAST || type == NA_MULTICAST_IP6 ))
-			return;
-
-		if( Host_IsDedicated( ))
+		// split packets are paced, so they go out directly
+		// but must not overtake queued ones
+		if(!( splitsize > sizeof( SPLITPACKET ) && length > splitsize ))
 		{
-			Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
-		{
-			Con_DPrintf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else
-		{
-			Con_Printf( S_ERROR "%s: %s to %s\n", __func__, NET_ErrorString(), NET_AdrToString( to ));
+			if( NET_QueueSendPacket( &net.sendqueue, net_socket, data, length, &addr, to ))
+				return;
 		}
+
+		NET_FlushSendQueue( &net.sendqueue );
 	}
+#endif
 
+	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
+
+	if( NET_IsSocketError( ret ))
+		NET_SendError( __func__, to );
 }
 
 /*
@@ -1918,6 +2250,13 @@ void NET_Config( qboolean multiplayer, qboolean changeport )
 	{
 		int	i;
 
+#if XASH_NET_MMSG
+		// drop everything that belongs to closed sockets
+		net.sendqueue.count = net.sendqueue.used = 0;
+		net.recvrings[0].head = net.recvrings[0].count = 0;
+		net.recvrings[1].head = net.recvrings[1].count = 0;
+#endif
+
 		// shut down any existing sockets
 		for( i = 0; i < NS_COUNT; i++ )
 		{
@@ -2028,6 +2367,9 @@ void NET_Init( void )
 	Cvar_RegisterVariable( &net_fakeloss );
 	Cvar_RegisterVariable( &net_resolve_debug );
 	Cvar_RegisterVariable( &net_clockwindow );
+#if XASH_NET_MMSG
+	Cvar_RegisterVariable( &net_mmsg );
+#endif
 
 	Q_snprintf( cmd, sizeof( cmd ), "%i", PORT_SERVER );
 	Cvar_FullSet( "hostport", cmd, FCVAR_READ_ONLY );
@@ -2110,6 +2452,14 @@ void NET_Shutdown( void )
 
 	NET_Config( false, false );
 
+#if XASH_NET_MMSG
+	if( net.recvrings[0].data ) Z_Free( net.recvrings[0].data );
+	if( net.recvrings[1].data ) Z_Free( net.recvrings[1].data );
+	if( net.sendqueue.data ) Z_Free( net.sendqueue.data );
+	memset( net.recvrings, 0, sizeof( net.recvrings ));
+	memset( &net.sendqueue, 0, sizeof( net.sendqueue ));
+#endif
+
 #ifdef CAN_ASYNC_NS_RESOLVE
 	NET_DeleteCriticalSections();
 #endif
@@ -2121,3 +2471,150 @@ void NET_Shutdown( void )
 }
 
 
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_NET_CLIENTS	16	// datagrams per simulated server frame
+#define TEST_NET_FRAMES	64
+
+#if XASH_NET_MMSG
+static int Test_NetSocket( struct sockaddr_storage *addr )
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+	WSAsize_t len = sizeof( *sin );
+	int s = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	uint nonblocking = 1;
+
+	if( !NET_IsSocketValid( s ))
+		return INVALID_SOCKET;
+
+	memset( addr, 0, sizeof( *addr ));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	if( NET_IsSocketError( bind( s, (struct sockaddr *)sin, len )) || NET_IsSocketError( getsockname( s, (struct sockaddr *)sin, &len ))
+		|| NET_IsSocketError( ioctlsocket( s, FIONBIO, (void *)&nonblocking )))
+	{
+		closesocket( s );
+		return INVALID_SOCKET;
+	}
+
+	return s;
+}
+
+static void Test_NetPayload( byte *buf, int frame, int client, size_t *len )
+{
+	size_t i;
+
+	*len = 64 + (( frame * 7 + client * 13 ) % 1200 );
+
+	for( i = 0; i < *len; i++ )
+		buf[i] = (byte)( frame + client * 3 + i );
+}
+
+static void Test_NetBatch( void )
+{
+	static net_recvring_t ring;
+	static net_sendqueue_t queue;
+	struct sockaddr_storage to, from;
+	byte buf[NET_MAX_FRAGMENT], expected[NET_MAX_FRAGMENT];
+	uint plain_calls = 0, batch_calls = 0, start;
+	int recvsock, sendsock;
+	int frame, i, received, errors = 0;
+	netadr_t adr;
+	size_t len;
+
+	recvsock = Test_NetSocket( &to );
+	sendsock = Test_NetSocket( &from );
+
+	if( !NET_IsSocketValid( recvsock ) || !NET_IsSocketValid( sendsock ))
+	{
+		Con_Printf( S_WARN "%s: can't open loopback sockets, skipping\n", __func__ );
+		if( NET_IsSocketValid( recvsock )) closesocket( recvsock );
+		if( NET_IsSocketValid( sendsock )) closesocket( sendsock );
+		return;
+	}
+
+	NET_SockadrToNetadr( &to, &adr );
+
+	// one syscall per datagram
+	start = net.recvcalls + net.sendcalls;
+	for( frame = 0, received = 0; frame < TEST_NET_FRAMES; frame++ )
+	{
+		for( i = 0; i < TEST_NET_CLIENTS; i++ )
+		{
+			Test_NetPayload( buf, frame, i, &len );
+			sendto( sendsock, buf, len, 0, (struct sockaddr *)&to, sizeof( struct sockaddr_in ));
+			net.sendcalls++;
+		}
+
+		while( true )
+		{
+			int ret = recvfrom( recvsock, buf, sizeof( buf ), 0, NULL, NULL );
+			net.recvcalls++;
+
+			if( ret < 0 )
+				break;
+
+			Test_NetPayload( expected, frame, received % TEST_NET_CLIENTS, &len );
+			if( ret != len || memcmp( buf, expected, len ))
+				errors++;
+			received++;
+		}
+	}
+	plain_calls = net.recvcalls + net.sendcalls - start;
+
+	TASSERT_EQi( received, TEST_NET_FRAMES * TEST_NET_CLIENTS );
+	TASSERT_EQi( errors, 0 );
+
+	// same traffic through the send queue and receive ring
+	start = net.recvcalls + net.sendcalls;
+	for( frame = 0, received = 0; frame < TEST_NET_FRAMES; frame++ )
+	{
+		for( i = 0; i < TEST_NET_CLIENTS; i++ )
+		{
+			Test_NetPayload( buf, frame, i, &len );
+			NET_QueueSendPacket( &queue, sendsock, buf, len, &to, adr );
+		}
+		NET_FlushSendQueue( &queue );
+
+		while( !NET_IsSocketError( NET_FillRecvRing( &ring, recvsock )))
+		{
+			for( ; ring.head < ring.count; ring.head++ )
+			{
+				const struct mmsghdr *hdr = &ring.hdrs[ring.head];
+
+				Test_NetPayload( expected, frame, received % TEST_NET_CLIENTS, &len );
+				if( hdr->msg_len != len || memcmp( ring.iovs[ring.head].iov_base, expected, len ))
+					errors++;
+				received++;
+			}
+		}
+	}
+	batch_calls = net.recvcalls + net.sendcalls - start;
+
+	TASSERT_EQi( received, TEST_NET_FRAMES * TEST_NET_CLIENTS );
+	TASSERT_EQi( errors, 0 );
+	TASSERT( batch_calls < plain_calls );
+
+	Con_Printf( "%s: %d datagrams per frame, %.1f syscalls per frame with sendto/recvfrom, %.1f with sendmmsg/recvmmsg\n",
+		__func__, TEST_NET_CLIENTS, plain_calls / (float)TEST_NET_FRAMES, batch_calls / (float)TEST_NET_FRAMES );
+
+	Z_Free( ring.data );
+	Z_Free( queue.data );
+	memset( &ring, 0, sizeof( ring ));
+	memset( &queue, 0, sizeof( queue ));
+
+	closesocket( recvsock );
+	closesocket( sendsock );
+}
+#endif // XASH_NET_MMSG
+
+void Test_RunNetBatch( void )
+{
+#if XASH_NET_MMSG
+	TRUN( Test_NetBatch( ));
+#endif
+}
+#endif // XASH_ENGINE_TESTS
@@ -72,8 +72,11 @@ qboolean NET_CompareAdr( const netadr_t a, const netadr_t b );
 qboolean NET_CompareBaseAdr( const netadr_t a, const netadr_t b );
 qboolean NET_CompareAdrByMask( const netadr_t a, const netadr_t b, uint prefixlen );
 qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length );
+qboolean NET_GetPacketNoCopy( netsrc_t sock, netadr_t *from, byte *buffer, byte **data, size_t *length );
 void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to );
 void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t to, size_t splitsize );
+void NET_BeginSendBatch( netsrc_t sock );
+void NET_FlushSendBatch( netsrc_t sock );
 void NET_IP6BytesToNetadr( netadr_t *adr, const uint8_t *ip6 );
 void NET_NetadrToIP6Bytes( uint8_t *ip6, const netadr_t *adr );
 
@@ -185,19 +185,29 @@ typedef struct fragbuf_s
 	sizebuf_t		frag_message;			// message buffer where raw data is stored
 	qboolean		isfile;				// is this a file buffer?
 	qboolean		isbuffer;				// is this file buffer from memory ( custom decal, etc. ).
-	qboolean		iscompressed;			// is compressed file, we should using filename.ztmp
-	char		filename[MAX_OSPATH];		// name of the file to save out on remote host
-	int		foffset;				// offset in file from which to read data
-	int		size;				// size of data to read at that offset
+	struct fragslab_s	*slab;				// pool block this buffer was carved from
 	byte frag_message_buf[]; // the actual data sits here (flexible)
 } fragbuf_t;
 
+// file that is read from disk a window of fragments at a time while it's sent
+typedef struct fragfile_s
+{
+	file_t		*file;				// opened when transfer starts
+	char		filename[MAX_OSPATH];		// name of the file to save out on remote host
+	char		diskname[MAX_OSPATH + 8];		// name of the file to read, may be filename.ztmp
+	int		remaining;			// bytes not read yet
+	int		chunksize;
+	int		bufferid;				// id of next fragment
+} fragfile_t;
+
 // Waiting list of fragbuf chains
 typedef struct fbufqueue_s
 {
 	struct fbufqueue_s	*next;		// next chain in waiting list
 	int		fragbufcount;	// number of buffers in this chain
 	fragbuf_t		*fragbufs;	// the actual buffers
+	fragbuf_t		*lastbuf;		// end of the chain, new buffers are linked here
+	fragfile_t	*file;		// if set, buffers are read from this file on demand
 } fragbufwaiting_t;
 
 typedef enum fragsize_e
@@ -214,6 +224,7 @@ typedef enum netchan_flags_e
 	NETCHAN_USE_BZIP2 = BIT( 2 ),
 	NETCHAN_GOLDSRC = BIT( 3 ),
 	NETCHAN_USE_LZSS = BIT( 4 ), // mutually exclusive with bzip2
+	NETCHAN_USE_LZ4 = BIT( 5 ), // preferred over lzss for outgoing data
 } netchan_flags_t;
 
 // Network Connection Channel
@@ -227,6 +238,14 @@ typedef struct netchan_s
 	double		connect_time;	// Usage: host.realtime - netchan.connect_time
 	double		rate;		// bandwidth choke. bytes per second
 	double		cleartime;	// if realtime > cleartime, free to send next packet
+	float		rateburst;	// seconds of rate that can be saved up while idle
+	qboolean		hold_files;	// don't start file fragment in next packet
+
+	// contents of the last transmitted packet, in bytes
+	int		sent_message;	// reliable message
+	int		sent_frag[MAX_STREAMS];	// reliable fragments
+	int		sent_unreliable;
+	int		sent_size;	// whole datagram with udp header
 
 	// Sequencing variables
 	unsigned int		incoming_sequence;			// increasing count of sequence numbers
@@ -259,11 +278,15 @@ typedef struct netchan_s
 
 	fragbuf_t		*fragbufs[MAX_STREAMS];	// the current fragment being set
 	int		fragbufcount[MAX_STREAMS];	// the total number of fragments in this stream
+	fragfile_t	*fragfile;		// file being streamed on FRAG_FILE_STREAM
 
 	int		frag_startpos[MAX_STREAMS];	// position in outgoing buffer where frag data starts
 	int		frag_length[MAX_STREAMS];	// length of frag data in the buffer
 
-	fragbuf_t		*incomingbufs[MAX_STREAMS];	// incoming fragments are stored here
+	fragbuf_t		**incomingbufs[MAX_STREAMS];	// incoming fragments indexed by buffer id
+	int		incomingsize[MAX_STREAMS];	// allocated entries in incomingbufs
+	int		incomingtotal[MAX_STREAMS];	// number of fragments in message being received
+	int		incomingcount[MAX_STREAMS];	// number of fragments received so far
 	qboolean		incomingready[MAX_STREAMS];	// set to true when incoming data is ready
 
 	// Only referenced by the FRAG_FILE_STREAM component
@@ -286,6 +309,7 @@ typedef struct netchan_s
 	qboolean	use_munge;
 	qboolean	use_bz2;
 	qboolean	use_lzss;
+	qboolean	use_lz4;
 	qboolean	gs_netchan;
 } netchan_t;
 
@@ -313,6 +337,8 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg );
 void Netchan_UpdateProgress( netchan_t *chan );
 qboolean Netchan_IncomingReady( netchan_t *chan );
 qboolean Netchan_CanPacket( netchan_t *chan, qboolean choke );
+int Netchan_AvailableBytes( netchan_t *chan, double nexttime );
+int Netchan_NextFragmentSize( netchan_t *chan, int stream );
 qboolean Netchan_IsLocal( netchan_t *chan );
 void Netchan_ReportFlow( netchan_t *chan );
 void Netchan_FragSend( netchan_t *chan );
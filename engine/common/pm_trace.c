@@ -195,10 +195,12 @@ static hull_t *PM_HullForStudio( physent_t *pe, playermove_t *pmove, int *numhit
 
 /*
 ==================
-PM_RecursiveHullCheck
+PM_RecursiveHullCheck_r
+
+reference traversal, used for hulls without compact nodes
 ==================
 */
-qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+static qboolean PM_RecursiveHullCheck_r( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
 {
 	int children[2];
 	mplane_t		*plane;
@@ -274,14 +276,14 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	VectorLerp( p1, frac, p2, mid );
 
 	// move up to the node
-	if( !PM_RecursiveHullCheck( hull, children[side], p1f, midf, p1, mid, trace ))
+	if( !PM_RecursiveHullCheck_r( hull, children[side], p1f, midf, p1, mid, trace ))
 		return false;
 
 	// this recursion can not be optimized because mid would need to be duplicated on a stack
 	if( PM_HullPointContents( hull, children[side^1], mid ) != CONTENTS_SOLID )
 	{
 		// go past the node
-		return PM_RecursiveHullCheck( hull, children[side^1], midf, p2f, mid, p2, trace );
+		return PM_RecursiveHullCheck_r( hull, children[side^1], midf, p2f, mid, p2, trace );
 	}
 
 	// never got out of the solid area
@@ -323,6 +325,334 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	return false;
 }
 
+#define PM_HULL_STACK	64
+
+// pending "go past the node" step of PM_RecursiveHullCheck_r
+typedef struct pm_hullframe_s
+{
+	const mhullnode_t	*node;
+	int		side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} pm_hullframe_t;
+
+static int PM_CompactPointContents( const mhullnode_t *nodes, int num, const vec3_t p )
+{
+	while( num >= 0 )
+		num = nodes[num].children[PlaneDiff( p, &nodes[num] ) < 0];
+
+	return num;
+}
+
+/*
+==================
+PM_CompactHullCheck
+
+same as PM_RecursiveHullCheck_r but iterates over compact
+nodes with an explicit stack, results are bit-identical
+==================
+*/
+static qboolean PM_CompactHullCheck( hull_t *hull, const mhullnode_t *nodes, int num, float p1f, float p2f, const vec3_t start, const vec3_t end, pmtrace_t *trace )
+{
+	pm_hullframe_t	stack[PM_HULL_STACK];
+	pm_hullframe_t	overflow;
+	pm_hullframe_t	*f;
+	int		depth = 0;
+	vec3_t		p1, p2;
+
+	VectorCopy( start, p1 );
+	VectorCopy( end, p2 );
+
+	while( 1 )
+	{
+		const mhullnode_t	*node;
+		float		t1, t2, frac, midf;
+		int		side;
+		vec3_t		mid;
+
+		if( num < 0 )
+		{
+			// check for empty
+			if( num != CONTENTS_SOLID )
+			{
+				trace->allsolid = false;
+				if( num == CONTENTS_EMPTY )
+					trace->inopen = true;
+				else trace->inwater = true;
+			}
+			else trace->startsolid = true;
+		}
+		else if( hull->firstclipnode >= hull->lastclipnode )
+		{
+			// empty hull?
+			trace->allsolid = false;
+			trace->inopen = true;
+		}
+		else
+		{
+			if( num < hull->firstclipnode || num > hull->lastclipnode )
+				Host_Error( "%s: bad node number %i\n", __func__, num );
+
+			// find the point distances
+			node = &nodes[num];
+			t1 = PlaneDiff( p1, node );
+			t2 = PlaneDiff( p2, node );
+
+			if( t1 >= 0.0f && t2 >= 0.0f )
+			{
+				num = node->children[0];
+				continue;
+			}
+
+			if( t1 < 0.0f && t2 < 0.0f )
+			{
+				num = node->children[1];
+				continue;
+			}
+
+			// put the crosspoint DIST_EPSILON pixels on the near side
+			side = (t1 < 0.0f);
+
+			if( side ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
+			else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+
+			if( frac < 0.0f ) frac = 0.0f;
+			if( frac > 1.0f ) frac = 1.0f;
+
+			midf = p1f + ( p2f - p1f ) * frac;
+			VectorLerp( p1, frac, p2, mid );
+
+			f = ( depth < PM_HULL_STACK ) ? &stack[depth++] : &overflow;
+			f->node = node;
+			f->side = side;
+			f->frac = frac;
+			f->p1f = p1f;
+			f->p2f = p2f;
+			f->midf = midf;
+			VectorCopy( p1, f->p1 );
+			VectorCopy( p2, f->p2 );
+			VectorCopy( mid, f->mid );
+
+			if( f == &overflow )
+			{
+				// too deep, let recursion handle this side
+				if( !PM_RecursiveHullCheck_r( hull, node->children[side], p1f, midf, p1, mid, trace ))
+					return false;
+				goto go_past;
+			}
+
+			// move up to the node
+			num = node->children[side];
+			p2f = midf;
+			VectorCopy( mid, p2 );
+			continue;
+		}
+
+		// near side is done without impact
+		if( !depth )
+			return true;
+
+		f = &stack[--depth];
+go_past:
+		if( PM_CompactPointContents( nodes, f->node->children[f->side^1], f->mid ) != CONTENTS_SOLID )
+		{
+			// go past the node
+			num = f->node->children[f->side^1];
+			p1f = f->midf;
+			p2f = f->p2f;
+			VectorCopy( f->mid, p1 );
+			VectorCopy( f->p2, p2 );
+			continue;
+		}
+
+		// never got out of the solid area
+		if( trace->allsolid )
+			return false;
+
+		// the other side of the node is solid, this is the impact point
+		if( !f->side )
+		{
+			VectorCopy( f->node->normal, trace->plane.normal );
+			trace->plane.dist = f->node->dist;
+		}
+		else
+		{
+			VectorNegate( f->node->normal, trace->plane.normal );
+			trace->plane.dist = -f->node->dist;
+		}
+
+		frac = f->frac;
+		midf = f->midf;
+		VectorCopy( f->mid, mid );
+
+		while( PM_CompactPointContents( nodes, hull->firstclipnode, mid ) == CONTENTS_SOLID )
+		{
+			// shouldn't really happen, but does occasionally
+			frac -= 0.1f;
+
+			if( frac < 0.0f )
+			{
+				trace->fraction = midf;
+				VectorCopy( mid, trace->endpos );
+				Con_Reportf( S_WARN "trace backed up past 0.0\n" );
+				return false;
+			}
+
+			midf = f->p1f + ( f->p2f - f->p1f ) * frac;
+			VectorLerp( f->p1, frac, f->p2, mid );
+		}
+
+		trace->fraction = midf;
+		VectorCopy( mid, trace->endpos );
+
+		return false;
+	}
+}
+
+// traces captured by "hullbench record"
+typedef struct pm_hulltrace_s
+{
+	hull_t		hull;
+	int		num;
+	float		p1f, p2f;
+	vec3_t		p1, p2;
+} pm_hulltrace_t;
+
+static struct
+{
+	pm_hulltrace_t	*traces;
+	int		count;
+	int		max;	// recording while count < max
+} pm_hullrecord;
+
+/*
+==================
+PM_RecursiveHullCheck
+==================
+*/
+qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	const mhullnode_t	*nodes = Mod_HullNodes( hull );
+
+	if( !nodes )
+		return PM_RecursiveHullCheck_r( hull, num, p1f, p2f, p1, p2, trace );
+
+	if( pm_hullrecord.count < pm_hullrecord.max )
+	{
+		pm_hulltrace_t	*rec = &pm_hullrecord.traces[pm_hullrecord.count++];
+
+		rec->hull = *hull;
+		rec->num = num;
+		rec->p1f = p1f;
+		rec->p2f = p2f;
+		VectorCopy( p1, rec->p1 );
+		VectorCopy( p2, rec->p2 );
+
+		if( pm_hullrecord.count == pm_hullrecord.max )
+			Con_Printf( "hullbench: recorded %i traces\n", pm_hullrecord.count );
+	}
+
+	return PM_CompactHullCheck( hull, nodes, num, p1f, p2f, p1, p2, trace );
+}
+
+/*
+==================
+PM_ClearHullTraces
+
+==================
+*/
+void PM_ClearHullTraces( void )
+{
+	if( pm_hullrecord.traces )
+		Z_Free( pm_hullrecord.traces );
+
+	memset( &pm_hullrecord, 0, sizeof( pm_hullrecord ));
+}
+
+static void PM_InitHullTrace( pmtrace_t *trace, const vec3_t end )
+{
+	memset( trace, 0, sizeof( *trace ));
+	VectorCopy( end, trace->endpos );
+	trace->allsolid = true;
+	trace->fraction = 1.0f;
+}
+
+/*
+==================
+PM_HullBench_f
+
+hullbench record <count> - capture next hull traces from the game
+hullbench [passes] - replay them with both traversals
+==================
+*/
+void PM_HullBench_f( void )
+{
+	pmtrace_t		*results;
+	double		start, time[2];
+	int		i, pass, passes, mismatches = 0;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		int	count = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 100000;
+
+		PM_ClearHullTraces();
+		pm_hullrecord.max = bound( 1, count, 4000000 );
+		pm_hullrecord.traces = Z_Malloc( sizeof( *pm_hullrecord.traces ) * pm_hullrecord.max );
+		Con_Printf( "hullbench: recording %i traces\n", pm_hullrecord.max );
+		return;
+	}
+
+	if( !pm_hullrecord.count )
+	{
+		Con_Printf( "Usage: hullbench record <count>, then hullbench [passes]\n" );
+		return;
+	}
+
+	// stop recording, replay must not feed itself
+	pm_hullrecord.max = pm_hullrecord.count;
+	passes = Cmd_Argc() > 1 ? bound( 1, Q_atoi( Cmd_Argv( 1 )), 1000 ) : 10;
+	results = Z_Malloc( sizeof( *results ) * pm_hullrecord.count );
+
+	start = Sys_DoubleTime();
+
+	for( pass = 0; pass < passes; pass++ )
+	{
+		for( i = 0; i < pm_hullrecord.count; i++ )
+		{
+			pm_hulltrace_t	*rec = &pm_hullrecord.traces[i];
+
+			PM_InitHullTrace( &results[i], rec->p2 );
+			PM_RecursiveHullCheck_r( &rec->hull, rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &results[i] );
+		}
+	}
+
+	time[0] = Sys_DoubleTime() - start;
+	start = Sys_DoubleTime();
+
+	for( pass = 0; pass < passes; pass++ )
+	{
+		for( i = 0; i < pm_hullrecord.count; i++ )
+		{
+			pm_hulltrace_t	*rec = &pm_hullrecord.traces[i];
+			pmtrace_t		trace;
+
+			PM_InitHullTrace( &trace, rec->p2 );
+			PM_CompactHullCheck( &rec->hull, Mod_HullNodes( &rec->hull ), rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &trace );
+
+			if( pass == 0 && memcmp( &trace, &results[i], sizeof( trace )))
+				mismatches++;
+		}
+	}
+
+	time[1] = Sys_DoubleTime() - start;
+
+	Con_Printf( "%i traces x %i passes: recursive %.2f ms, compact %.2f ms, %i mismatches\n",
+		pm_hullrecord.count, passes, time[0] * 1000.0, time[1] * 1000.0, mismatches );
+
+	Z_Free( results );
+}
+
 pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
 {
 	physent_t	*pe;
@@ -888,3 +1218,118 @@ void PM_StuckTouch( playermove_t *pmove, int hitent, pmtrace_t *tr )
 
 	pmove->touchindex[pmove->numtouch++] = *tr;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_HULL_NODES 2048
+
+static int Test_BuildHullNode( mclipnode16_t *clipnodes, mplane_t *planes, int *count, int depth )
+{
+	static const int contents[] = { CONTENTS_EMPTY, CONTENTS_EMPTY, CONTENTS_SOLID, CONTENTS_WATER };
+	mplane_t	*plane;
+	int	num;
+
+	if( *count == TEST_HULL_NODES || ( depth > 2 && COM_RandomLong( 0, 15 ) < depth ))
+		return contents[COM_RandomLong( 0, 3 )];
+
+	num = (*count)++;
+	plane = &planes[num];
+	clipnodes[num].planenum = num;
+
+	if( COM_RandomLong( 0, 1 ))
+	{
+		plane->type = COM_RandomLong( 0, 2 );
+		VectorClear( plane->normal );
+		plane->normal[plane->type] = 1.0f;
+	}
+	else
+	{
+		plane->type = 3;
+		VectorSet( plane->normal, COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( -1.0f, 1.0f ));
+		VectorNormalize( plane->normal );
+	}
+
+	plane->dist = COM_RandomFloat( -256.0f, 256.0f );
+	clipnodes[num].children[0] = Test_BuildHullNode( clipnodes, planes, count, depth + 1 );
+	clipnodes[num].children[1] = Test_BuildHullNode( clipnodes, planes, count, depth + 1 );
+
+	return num;
+}
+
+static int Test_CompareHullTraces( hull_t *hull, int count, float range )
+{
+	int	i, errors = 0;
+
+	for( i = 0; i < count; i++ )
+	{
+		pmtrace_t	ref, trace;
+		vec3_t	start, end;
+
+		VectorSet( start, COM_RandomFloat( -range, range ), COM_RandomFloat( -range, range ), COM_RandomFloat( -range, range ));
+		VectorSet( end, COM_RandomFloat( -range, range ), COM_RandomFloat( -range, range ), COM_RandomFloat( -range, range ));
+
+		PM_InitHullTrace( &ref, end );
+		PM_InitHullTrace( &trace, end );
+
+		PM_RecursiveHullCheck_r( hull, hull->firstclipnode, 0.0f, 1.0f, start, end, &ref );
+		PM_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start, end, &trace );
+
+		if( memcmp( &ref, &trace, sizeof( ref )))
+			errors++;
+	}
+
+	return errors;
+}
+
+static void Test_HullTrace( void )
+{
+	static mclipnode16_t	clipnodes[TEST_HULL_NODES];
+	static mplane_t	planes[TEST_HULL_NODES];
+	poolhandle_t	pool = Mem_AllocPool( "hull test" );
+	hull_t		hull;
+	int		i, count = 0;
+
+	// random tree
+	memset( &hull, 0, sizeof( hull ));
+	while( count < 2 )
+	{
+		count = 0;
+		Test_BuildHullNode( clipnodes, planes, &count, 0 );
+	}
+
+	hull.clipnodes16 = clipnodes;
+	hull.planes = planes;
+	hull.lastclipnode = count - 1;
+	Mod_MakeHullNodes( &hull, count, false, pool );
+
+	TASSERT( Mod_HullNodes( &hull ) != NULL );
+	TASSERT_EQi( Test_CompareHullTraces( &hull, 4096, 320.0f ), 0 );
+
+	Mod_FreeHullNodes( pool );
+	TASSERT( Mod_HullNodes( &hull ) == NULL );
+
+	// chain that is deeper than traversal stack
+	for( i = 0; i < 200; i++ )
+	{
+		clipnodes[i].planenum = i;
+		clipnodes[i].children[0] = ( i == 199 ) ? CONTENTS_EMPTY : i + 1;
+		clipnodes[i].children[1] = ( i & 1 ) ? CONTENTS_SOLID : CONTENTS_EMPTY;
+		planes[i].type = 0;
+		VectorSet( planes[i].normal, 1.0f, 0.0f, 0.0f );
+		planes[i].dist = i * 2.0f - 200.0f;
+	}
+
+	hull.lastclipnode = 199;
+	Mod_MakeHullNodes( &hull, 200, false, pool );
+	TASSERT_EQi( Test_CompareHullTraces( &hull, 1024, 400.0f ), 0 );
+
+	Mod_FreeHullNodes( pool );
+	Mem_FreePool( &pool );
+}
+
+void Test_RunHullTrace( void )
+{
+	TRUN( Test_HullTrace( ));
+}
+#endif // XASH_ENGINE_TESTS
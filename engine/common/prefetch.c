@@ -0,0 +1,377 @@
+/*
+prefetch.c - parallel read of map resources
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+
+// filesystem reads different files from different threads safely only
+// where it has positioned reads, otherwise entries of the same archive
+// share descriptor offset, see FS_ReadAt in filesystem
+#if XASH_POSIX && defined( HAVE_DUP ) && !defined( XASH_REDUCE_FD )
+#define XASH_PREFETCH_THREADS 1
+#else
+#define XASH_PREFETCH_THREADS 0
+#endif
+
+/*
+========================================================================
+PREFETCH
+
+Map loaders ask for models, sounds and WAD textures one by one, so on
+cold disk cache most of the load time is spent waiting for each read
+in turn. Before the loaders run, whole resource list is read by a small
+pool of threads into staging buffers, then FS_LoadFile, sound and WAD
+texture loaders take data from there. Files are opened and buffers are
+allocated on main thread, workers only call FS_Read, each on its own file.
+Each file keeps a descriptor until it's read, so queue is flushed every
+PREFETCH_MAX_OPEN files instead of keeping whole list open. Files are
+opened with 'p' mode, so deflated ZIP entries skip decompressed cache:
+they are inflated by workers and aren't held in memory twice
+========================================================================
+*/
+#define PREFETCH_HASH_SIZE	256
+#define PREFETCH_GROW	64
+#define PREFETCH_MAX_OPEN	64	// files waiting for FS_PrefetchRun
+
+typedef struct prefetch_s
+{
+	string		name;
+	file_t		*file;	// open until batch is read
+	byte		*data;	// NULL when taken or failed
+	fs_offset_t	size;
+	qboolean		failed;	// set by worker, reported by FS_PrefetchRun
+	int		next;	// hash chain, -1 terminates
+} prefetch_t;
+
+static CVAR_DEFINE_AUTO( fs_prefetch_threads, "3", FCVAR_ARCHIVE, "number of threads reading map resources ahead of loaders, 0 disables prefetch" );
+static CVAR_DEFINE_AUTO( fs_prefetch_size, "64", FCVAR_ARCHIVE, "limit of data read ahead during map load in megabytes" );
+
+static struct
+{
+	workers_t		*workers;
+	poolhandle_t	mempool;
+	prefetch_t	*files;
+	int		maxfiles;
+	int		numfiles;
+	int		numread;	// files before that are already read
+	int		hash[PREFETCH_HASH_SIZE];
+	size_t		staged;	// bytes held by files that weren't taken
+
+	// statistics since last report
+	int		numfetched;
+	size_t		fetchedbytes;
+	double		fetchtime;
+	int		numtaken;
+	int		numunused;
+	int		numskipped;	// didn't fit into fs_prefetch_size
+} fs_prefetch;
+
+/*
+================
+FS_FindPrefetched
+
+================
+*/
+static prefetch_t *FS_FindPrefetched( const char *name )
+{
+	int	i;
+
+	for( i = fs_prefetch.hash[COM_HashKey( name, PREFETCH_HASH_SIZE )]; i >= 0; i = fs_prefetch.files[i].next )
+	{
+		if( !Q_stricmp( fs_prefetch.files[i].name, name ))
+			return &fs_prefetch.files[i];
+	}
+
+	return NULL;
+}
+
+/*
+================
+FS_ClearPrefetch
+
+frees everything loaders didn't take
+================
+*/
+void FS_ClearPrefetch( void )
+{
+	int	i;
+
+	for( i = 0; i < fs_prefetch.numfiles; i++ )
+	{
+		prefetch_t *p = &fs_prefetch.files[i];
+
+		if( p->file )
+			FS_Close( p->file );
+
+		if( p->data )
+		{
+			Mem_Free( p->data );
+			fs_prefetch.numunused++;
+		}
+	}
+
+	fs_prefetch.numfiles = fs_prefetch.numread = 0;
+	fs_prefetch.staged = 0;
+	memset( fs_prefetch.hash, 0xff, sizeof( fs_prefetch.hash ));
+}
+
+/*
+================
+FS_PrefetchBegin
+
+starts new batch, returns false if prefetch is disabled
+and callers shouldn't bother with building the list
+================
+*/
+qboolean FS_PrefetchBegin( void )
+{
+	FS_ClearPrefetch();
+
+#if XASH_PREFETCH_THREADS
+	if( FBitSet( fs_prefetch_threads.flags, FCVAR_CHANGED ))
+	{
+		ClearBits( fs_prefetch_threads.flags, FCVAR_CHANGED );
+
+		Sys_DestroyWorkers( fs_prefetch.workers );
+		fs_prefetch.workers = Sys_CreateWorkers( "prefetch", fs_prefetch_threads.value );
+	}
+#endif
+
+	return fs_prefetch.workers != NULL;
+}
+
+/*
+================
+FS_PrefetchAdd
+
+================
+*/
+static void FS_PrefetchAdd( const char *name, file_t *file )
+{
+	size_t		budget = fs_prefetch_size.value > 0.0f ? (size_t)( fs_prefetch_size.value * 1024.0f * 1024.0f ) : 0;
+	fs_offset_t	size = FS_FileLength( file );
+	prefetch_t	*p;
+	uint		hash;
+
+	if( size <= 0 || fs_prefetch.staged + (size_t)size > budget )
+	{
+		if( size > 0 )
+			fs_prefetch.numskipped++;
+
+		FS_Close( file );
+		return;
+	}
+
+	if( fs_prefetch.numfiles == fs_prefetch.maxfiles )
+	{
+		fs_prefetch.maxfiles += PREFETCH_GROW;
+		fs_prefetch.files = Mem_Realloc( fs_prefetch.mempool, fs_prefetch.files, sizeof( *fs_prefetch.files ) * fs_prefetch.maxfiles );
+	}
+
+	p = &fs_prefetch.files[fs_prefetch.numfiles];
+	Q_strncpy( p->name, name, sizeof( p->name ));
+	p->file = file;
+	p->size = size;
+	p->failed = false;
+
+	// loaders expect zero terminated data, like FS_LoadFile gives
+	p->data = Mem_Malloc( fs_prefetch.mempool, size + 1 );
+	p->data[size] = 0;
+
+	hash = COM_HashKey( p->name, PREFETCH_HASH_SIZE );
+	p->next = fs_prefetch.hash[hash];
+	fs_prefetch.hash[hash] = fs_prefetch.numfiles++;
+
+	fs_prefetch.staged += size;
+
+	if( fs_prefetch.numfiles - fs_prefetch.numread >= PREFETCH_MAX_OPEN )
+		FS_PrefetchRun();
+}
+
+/*
+================
+FS_PrefetchFile
+
+queues file to be read by FS_PrefetchRun, missing files are ignored
+================
+*/
+void FS_PrefetchFile( const char *path )
+{
+	file_t	*f;
+
+	if( !fs_prefetch.workers || !COM_CheckString( path ) || FS_FindPrefetched( path ))
+		return;
+
+	if(( f = FS_Open( path, "rbp", false )) != NULL )
+		FS_PrefetchAdd( path, f );
+}
+
+/*
+================
+FS_PrefetchFromArchive
+
+same, but for entries that are looked up in specific archive,
+name is the key for FS_TakePrefetched
+================
+*/
+void FS_PrefetchFromArchive( const char *name, searchpath_t *sp, const char *path, int pack_ind )
+{
+	file_t	*f;
+
+	if( !fs_prefetch.workers || FS_FindPrefetched( name ))
+		return;
+
+	if(( f = g_fsapi.OpenFileFromArchive( sp, path, "rbp", pack_ind )) != NULL )
+		FS_PrefetchAdd( name, f );
+}
+
+static void FS_PrefetchJob( void *data, int index )
+{
+	prefetch_t	*p = (prefetch_t *)data + index;
+
+	if( FS_Read( p->file, p->data, p->size ) != p->size )
+		p->failed = true;
+}
+
+/*
+================
+FS_PrefetchRun
+
+reads queued files on worker threads and returns when all
+of them are in memory. Filesystem must not be used meanwhile,
+so this blocks instead of running in background
+================
+*/
+void FS_PrefetchRun( void )
+{
+	double	start = Sys_DoubleTime();
+	int	i, count = fs_prefetch.numfiles - fs_prefetch.numread;
+
+	if( count <= 0 )
+		return;
+
+	Sys_RunJobs( fs_prefetch.workers, FS_PrefetchJob, &fs_prefetch.files[fs_prefetch.numread], count );
+
+	for( i = fs_prefetch.numread; i < fs_prefetch.numfiles; i++ )
+	{
+		prefetch_t *p = &fs_prefetch.files[i];
+
+		FS_Close( p->file );
+		p->file = NULL;
+
+		if( p->failed )
+		{
+			// FS_Read doesn't print on workers, loader will try again
+			Con_Printf( S_WARN "%s: can't read %s\n", __func__, p->name );
+			Mem_Free( p->data );
+			p->data = NULL;
+			fs_prefetch.staged -= p->size;
+			continue;
+		}
+
+		fs_prefetch.numfetched++;
+		fs_prefetch.fetchedbytes += p->size;
+	}
+
+	fs_prefetch.numread = fs_prefetch.numfiles;
+	fs_prefetch.fetchtime += Sys_DoubleTime() - start;
+}
+
+/*
+================
+FS_TakePrefetched
+
+returns staged data and passes its ownership to caller,
+to be released with Mem_Free. NULL if file wasn't prefetched
+================
+*/
+byte *FS_TakePrefetched( const char *name, fs_offset_t *filesizeptr )
+{
+	prefetch_t	*p;
+	byte		*data;
+
+	if( !fs_prefetch.numread )
+		return NULL;
+
+	p = FS_FindPrefetched( name );
+
+	if( !p || !p->data || p->file )
+		return NULL;
+
+	data = p->data;
+	p->data = NULL;
+	fs_prefetch.staged -= p->size;
+	fs_prefetch.numtaken++;
+
+	if( filesizeptr ) *filesizeptr = p->size;
+
+	return data;
+}
+
+/*
+================
+FS_PrintPrefetchInfo
+
+statistics are reset after printing,
+so each map load reports only its own
+================
+*/
+void FS_PrintPrefetchInfo( void )
+{
+	if( !fs_prefetch.workers )
+		Con_Printf( "prefetch: disabled\n" );
+	else
+	{
+		Con_Printf( "prefetch: %i files, %s in %.1f ms on %i threads, %i used, %i unused, %i over limit\n",
+			fs_prefetch.numfetched, Q_memprint( fs_prefetch.fetchedbytes ), fs_prefetch.fetchtime * 1000.0,
+			Sys_WorkersCount( fs_prefetch.workers ) + 1, fs_prefetch.numtaken, fs_prefetch.numunused, fs_prefetch.numskipped );
+	}
+
+	fs_prefetch.numfetched = fs_prefetch.numtaken = fs_prefetch.numunused = fs_prefetch.numskipped = 0;
+	fs_prefetch.fetchedbytes = 0;
+	fs_prefetch.fetchtime = 0.0;
+}
+
+/*
+================
+FS_InitPrefetch
+
+================
+*/
+void FS_InitPrefetch( void )
+{
+	Cvar_RegisterVariable( &fs_prefetch_threads );
+	Cvar_RegisterVariable( &fs_prefetch_size );
+
+	fs_prefetch.mempool = Mem_AllocPool( "Prefetch Staging" );
+	memset( fs_prefetch.hash, 0xff, sizeof( fs_prefetch.hash ));
+	SetBits( fs_prefetch_threads.flags, FCVAR_CHANGED );
+}
+
+/*
+================
+FS_ShutdownPrefetch
+
+================
+*/
+void FS_ShutdownPrefetch( void )
+{
+	if( !fs_prefetch.mempool )
+		return;
+
+	FS_ClearPrefetch();
+	Sys_DestroyWorkers( fs_prefetch.workers );
+	Mem_FreePool( &fs_prefetch.mempool );
+	memset( &fs_prefetch, 0, sizeof( fs_prefetch ));
+}
@@ -286,6 +286,7 @@ extern const char *const clc_strings[clc_lastmsg+1];
 
 // FWGS extensions
 #define NET_EXT_SPLITSIZE (1U<<0) // set splitsize by cl_dlmax
+#define NET_EXT_LZ4       (1U<<1) // compress fragments and file transfers with LZ4 instead of LZSS
 
 // legacy protocol definitons
 #define PROTOCOL_LEGACY_VERSION		48
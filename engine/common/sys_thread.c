@@ -0,0 +1,309 @@
+/*
+sys_thread.c - simple worker thread pool
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "xash3d_mathlib.h"
+
+#if !XASH_EMSCRIPTEN && !XASH_DOS4GW && !defined XASH_NO_ASYNC_NS_RESOLVE
+#define XASH_WORKER_THREADS 1
+#else
+#define XASH_WORKER_THREADS 0
+#endif
+
+#if XASH_WORKER_THREADS
+#if !XASH_WIN32
+#include <pthread.h>
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t  signal_t;
+typedef pthread_t       thread_t;
+#define mutex_create( x )       pthread_mutex_init( &( x ), NULL )
+#define mutex_destroy( x )      pthread_mutex_destroy( &( x ))
+#define mutex_lock( x )         pthread_mutex_lock( &( x ))
+#define mutex_unlock( x )       pthread_mutex_unlock( &( x ))
+#define signal_create( x, n )   pthread_cond_init( &( x ), NULL )
+#define signal_destroy( x )     pthread_cond_destroy( &( x ))
+#define signal_wait( x, m )     pthread_cond_wait( &( x ), &( m ))
+#define signal_raise( x, n )    pthread_cond_broadcast( &( x ))
+#define create_thread( thread, pfn, arg ) !pthread_create( &( thread ), NULL, ( pfn ), ( arg ))
+#define join_thread( x )        pthread_join(( x ), NULL )
+#define THREAD_RETURN           void *
+#define THREAD_EXIT             return NULL
+#else // WIN32
+// semaphores instead of condition variables to keep pre-Vista targets working,
+// spurious wakeups are harmless because workers always recheck the job counter
+typedef CRITICAL_SECTION mutex_t;
+typedef HANDLE           signal_t;
+typedef HANDLE           thread_t;
+#define mutex_create( x )       InitializeCriticalSection( &( x ))
+#define mutex_destroy( x )      DeleteCriticalSection( &( x ))
+#define mutex_lock( x )         EnterCriticalSection( &( x ))
+#define mutex_unlock( x )       LeaveCriticalSection( &( x ))
+#define signal_create( x, n )   (( x ) = CreateSemaphore( NULL, 0, ( n ), NULL ))
+#define signal_destroy( x )     CloseHandle(( x ))
+#define signal_wait( x, m )     ( LeaveCriticalSection( &( m )), WaitForSingleObject(( x ), INFINITE ), EnterCriticalSection( &( m )))
+#define signal_raise( x, n )    ReleaseSemaphore(( x ), ( n ), NULL )
+#define create_thread( thread, pfn, arg ) (( thread ) = CreateThread( NULL, 0, ( pfn ), ( arg ), 0, NULL ))
+#define join_thread( x )        ( WaitForSingleObject(( x ), INFINITE ), CloseHandle(( x )))
+#define THREAD_RETURN           DWORD WINAPI
+#define THREAD_EXIT             return 0
+#endif // !XASH_WIN32
+#endif // XASH_WORKER_THREADS
+
+struct workers_s
+{
+	char         name[32];
+	int          numthreads;
+
+#if XASH_WORKER_THREADS
+	mutex_t      lock;
+	signal_t     wake;       // raised when new batch is posted
+	signal_t     done;       // raised when last job of batch is finished
+	thread_t     threads[MAX_WORKER_THREADS];
+	qboolean     shutdown;
+
+	// current batch, protected by lock
+	pfnWorkerJob pfnJob;
+	void         *data;
+	int          next;       // next unclaimed job index
+	int          count;      // number of jobs in batch
+	int          finished;   // number of completed jobs
+#endif
+};
+
+#if XASH_WORKER_THREADS
+/*
+================
+Sys_WorkOnBatch
+
+claims jobs until batch is exhausted, lock must be held
+================
+*/
+static void Sys_WorkOnBatch( workers_t *w )
+{
+	while( w->next < w->count )
+	{
+		pfnWorkerJob pfnJob = w->pfnJob;
+		void *data = w->data;
+		int index = w->next++;
+
+		mutex_unlock( w->lock );
+		pfnJob( data, index );
+		mutex_lock( w->lock );
+
+		if( ++w->finished == w->count )
+			signal_raise( w->done, 1 );
+	}
+}
+
+static THREAD_RETURN Sys_WorkerThread( void *arg )
+{
+	workers_t *w = arg;
+
+	mutex_lock( w->lock );
+
+	while( !w->shutdown )
+	{
+		Sys_WorkOnBatch( w );
+
+		if( !w->shutdown )
+			signal_wait( w->wake, w->lock );
+	}
+
+	mutex_unlock( w->lock );
+
+	THREAD_EXIT;
+}
+#endif // XASH_WORKER_THREADS
+
+/*
+================
+Sys_CreateWorkers
+
+creates pool of worker threads, returns NULL if threads
+can't be used on this platform or numthreads is zero
+================
+*/
+workers_t *Sys_CreateWorkers( const char *name, int numthreads )
+{
+#if XASH_WORKER_THREADS
+	workers_t *w;
+	int i;
+
+	numthreads = bound( 0, numthreads, MAX_WORKER_THREADS );
+
+	if( !numthreads )
+		return NULL;
+
+	w = Z_Calloc( sizeof( *w ));
+	Q_strncpy( w->name, name, sizeof( w->name ));
+
+	mutex_create( w->lock );
+	signal_create( w->wake, MAX_WORKER_THREADS );
+	signal_create( w->done, 1 );
+
+	for( i = 0; i < numthreads; i++ )
+	{
+		if( !create_thread( w->threads[i], Sys_WorkerThread, w ))
+		{
+			Con_Printf( S_ERROR "%s: failed to start thread %d for %s\n", __func__, i, w->name );
+			break;
+		}
+		w->numthreads++;
+	}
+
+	if( !w->numthreads )
+	{
+		Sys_DestroyWorkers( w );
+		return NULL;
+	}
+
+	Con_Reportf( "%s: started %d threads for %s\n", __func__, w->numthreads, w->name );
+
+	return w;
+#else
+	return NULL;
+#endif
+}
+
+/*
+================
+Sys_DestroyWorkers
+
+waits for all threads to exit and frees the pool
+================
+*/
+void Sys_DestroyWorkers( workers_t *w )
+{
+#if XASH_WORKER_THREADS
+	int i;
+
+	if( !w )
+		return;
+
+	mutex_lock( w->lock );
+	w->shutdown = true;
+	signal_raise( w->wake, w->numthreads );
+	mutex_unlock( w->lock );
+
+	for( i = 0; i < w->numthreads; i++ )
+		join_thread( w->threads[i] );
+
+	signal_destroy( w->done );
+	signal_destroy( w->wake );
+	mutex_destroy( w->lock );
+
+	Z_Free( w );
+#endif
+}
+
+/*
+================
+Sys_WorkersCount
+
+number of threads in pool, not counting the caller
+================
+*/
+int Sys_WorkersCount( const workers_t *w )
+{
+	return w ? w->numthreads : 0;
+}
+
+/*
+================
+Sys_RunJobs
+
+calls pfnJob( data, i ) for i in [0, count) and
+returns when all of them are finished. Calling thread
+takes jobs as well, so it never sleeps while there is work.
+Without a pool jobs are executed in order on calling thread
+================
+*/
+void Sys_RunJobs( workers_t *w, pfnWorkerJob pfnJob, void *data, int count )
+{
+	int i;
+
+#if XASH_WORKER_THREADS
+	if( w && count > 1 )
+	{
+		mutex_lock( w->lock );
+
+		w->pfnJob = pfnJob;
+		w->data = data;
+		w->next = 0;
+		w->finished = 0;
+		w->count = count;
+
+		signal_raise( w->wake, Q_min( w->numthreads, count - 1 ));
+
+		Sys_WorkOnBatch( w );
+
+		while( w->finished < w->count )
+			signal_wait( w->done, w->lock );
+
+		// don't let late wakeups pick jobs from stale batch
+		w->count = w->next = w->finished = 0;
+
+		mutex_unlock( w->lock );
+		return;
+	}
+#endif
+
+	for( i = 0; i < count; i++ )
+		pfnJob( data, i );
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define RESULTS_COUNT 1024
+
+static void Test_WorkersJob( void *data, int index )
+{
+	int *results = data;
+
+	results[index] += index + 1;
+}
+
+static void Test_Workers( int numthreads )
+{
+	workers_t *w = Sys_CreateWorkers( "tests", numthreads );
+	int results[RESULTS_COUNT];
+	int i, pass, errors = 0;
+
+	memset( results, 0, sizeof( results ));
+
+	// few batches in a row to catch lost wakeups
+	for( pass = 0; pass < 16; pass++ )
+		Sys_RunJobs( w, Test_WorkersJob, results, RESULTS_COUNT - pass );
+
+	for( i = 0; i < RESULTS_COUNT; i++ )
+	{
+		int expected = Q_min( 16, RESULTS_COUNT - i ) * ( i + 1 );
+
+		if( results[i] != expected )
+			errors++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+
+	Sys_DestroyWorkers( w );
+}
+
+void Test_RunWorkers( void )
+{
+	TRUN( Test_Workers( 0 ));
+	TRUN( Test_Workers( 4 ));
+}
+#endif // XASH_ENGINE_TESTS
@@ -79,6 +79,19 @@ void Sys_InitLog( void );
 void Sys_PrintLog( const char *pMsg );
 int Sys_LogFileNo( void );
 
+//
+// sys_thread.c
+//
+#define MAX_WORKER_THREADS	16
+
+typedef struct workers_s workers_t;
+typedef void (*pfnWorkerJob)( void *data, int index );
+
+workers_t *Sys_CreateWorkers( const char *name, int numthreads );
+void Sys_DestroyWorkers( workers_t *w );
+int Sys_WorkersCount( const workers_t *w );
+void Sys_RunJobs( workers_t *w, pfnWorkerJob pfnJob, void *data, int count );
+
 // text messages
 #define Msg	Con_Printf
 
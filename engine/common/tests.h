@@ -42,6 +42,13 @@ void Test_RunGamma( void );
 void Test_RunDelta( void );
 void Test_RunBuffer( void );
 void Test_RunMunge( void );
+void Test_RunWorkers( void );
+void Test_RunWorldTree( void );
+void Test_RunHullTrace( void );
+void Test_RunNetBatch( void );
+void Test_RunNetchan( void );
+void Test_RunMoveMany( void );
+void Test_RunTransmit( void );
 
 #define TEST_LIST_0 \
 	Test_RunLibCommon(); \
@@ -51,14 +58,21 @@ void Test_RunMunge( void );
 	Test_RunIPFilter(); \
 	Test_RunBuffer(); \
 	Test_RunDelta(); \
-	Test_RunMunge();
+	Test_RunMunge(); \
+	Test_RunWorkers(); \
+	Test_RunWorldTree(); \
+	Test_RunHullTrace(); \
+	Test_RunNetBatch();
 
 #define TEST_LIST_0_CLIENT \
 	Test_RunCon(); \
 	Test_RunGamma();
 
 #define TEST_LIST_1 \
-	Test_RunImagelib();
+	Test_RunImagelib(); \
+	Test_RunNetchan(); \
+	Test_RunMoveMany(); \
+	Test_RunTransmit();
 
 #define TEST_LIST_1_CLIENT \
 	Test_RunVOX();
@@ -66,3 +66,549 @@ void World_TransformAABB( matrix4x4 transform, const vec3_t mins, const vec3_t m
 		}
 	}
 }
+
+/*
+===============================================================================
+
+	DYNAMIC AABB TREE
+
+bounding volume hierarchy with fattened leafs, kept balanced
+with AVL rotations. Insertion picks the sibling with smallest
+surface area growth, so queries cost O(log n + k)
+===============================================================================
+*/
+#define WORLDTREE_MAX_DEPTH	256
+
+static float World_TreeArea( const vec3_t mins, const vec3_t maxs )
+{
+	float	dx = maxs[0] - mins[0];
+	float	dy = maxs[1] - mins[1];
+	float	dz = maxs[2] - mins[2];
+
+	return 2.0f * ( dx * dy + dy * dz + dz * dx );
+}
+
+static void World_TreeUnion( const worldtreenode_t *a, const worldtreenode_t *b, vec3_t mins, vec3_t maxs )
+{
+	int	i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		mins[i] = Q_min( a->mins[i], b->mins[i] );
+		maxs[i] = Q_max( a->maxs[i], b->maxs[i] );
+	}
+}
+
+static int World_TreeAllocNode( worldtree_t *tree )
+{
+	worldtreenode_t	*node;
+	int		i, id;
+
+	if( tree->freelist == WORLDTREE_NULL )
+	{
+		int	newmax = tree->maxnodes ? tree->maxnodes * 2 : 64;
+
+		tree->nodes = Mem_Realloc( tree->mempool, tree->nodes, newmax * sizeof( *tree->nodes ));
+
+		for( i = tree->maxnodes; i < newmax; i++ )
+		{
+			tree->nodes[i].parent = ( i == newmax - 1 ) ? WORLDTREE_NULL : i + 1;
+			tree->nodes[i].height = -1;
+		}
+
+		tree->freelist = tree->maxnodes;
+		tree->maxnodes = newmax;
+	}
+
+	id = tree->freelist;
+	node = &tree->nodes[id];
+	tree->freelist = node->parent;
+
+	node->parent = WORLDTREE_NULL;
+	node->children[0] = node->children[1] = WORLDTREE_NULL;
+	node->height = 0;
+	node->data = NULL;
+
+	return id;
+}
+
+static void World_TreeFreeNode( worldtree_t *tree, int id )
+{
+	tree->nodes[id].parent = tree->freelist;
+	tree->nodes[id].height = -1;
+	tree->freelist = id;
+}
+
+/*
+==================
+World_TreeBalance
+
+performs a left or right rotation if node is imbalanced,
+returns the new root of the subtree
+==================
+*/
+static int World_TreeBalance( worldtree_t *tree, int ia )
+{
+	worldtreenode_t	*a = &tree->nodes[ia];
+	worldtreenode_t	*b, *c;
+	int		ib, ic, balance;
+
+	if( a->height < 2 )
+		return ia;
+
+	ib = a->children[0];
+	ic = a->children[1];
+	b = &tree->nodes[ib];
+	c = &tree->nodes[ic];
+
+	balance = c->height - b->height;
+
+	if( balance > 1 || balance < -1 )
+	{
+		// rotate the higher child up
+		qboolean		right = balance > 1;
+		int		iup = right ? ic : ib;
+		int		ilow = right ? ib : ic;
+		worldtreenode_t	*up = &tree->nodes[iup];
+		worldtreenode_t	*low = &tree->nodes[ilow];
+		int		if_ = up->children[0];
+		int		ig = up->children[1];
+		worldtreenode_t	*f = &tree->nodes[if_];
+		worldtreenode_t	*g = &tree->nodes[ig];
+		int		ikeep, imove;
+
+		// swap a and up
+		up->children[0] = ia;
+		up->parent = a->parent;
+		a->parent = iup;
+
+		if( up->parent != WORLDTREE_NULL )
+		{
+			worldtreenode_t *p = &tree->nodes[up->parent];
+
+			if( p->children[0] == ia )
+				p->children[0] = iup;
+			else p->children[1] = iup;
+		}
+		else tree->root = iup;
+
+		// higher grandchild stays with up, lower one goes to a
+		if( f->height > g->height )
+		{
+			ikeep = if_;
+			imove = ig;
+		}
+		else
+		{
+			ikeep = ig;
+			imove = if_;
+		}
+
+		up->children[1] = ikeep;
+		a->children[right ? 1 : 0] = imove;
+		tree->nodes[imove].parent = ia;
+
+		World_TreeUnion( low, &tree->nodes[imove], a->mins, a->maxs );
+		World_TreeUnion( a, &tree->nodes[ikeep], up->mins, up->maxs );
+
+		a->height = 1 + Q_max( low->height, tree->nodes[imove].height );
+		up->height = 1 + Q_max( a->height, tree->nodes[ikeep].height );
+
+		return iup;
+	}
+
+	return ia;
+}
+
+/*
+==================
+World_TreeRefit
+
+walk back up the tree fixing heights and boxes
+==================
+*/
+static void World_TreeRefit( worldtree_t *tree, int index )
+{
+	while( index != WORLDTREE_NULL )
+	{
+		worldtreenode_t	*node, *c0, *c1;
+
+		index = World_TreeBalance( tree, index );
+
+		node = &tree->nodes[index];
+		c0 = &tree->nodes[node->children[0]];
+		c1 = &tree->nodes[node->children[1]];
+
+		node->height = 1 + Q_max( c0->height, c1->height );
+		World_TreeUnion( c0, c1, node->mins, node->maxs );
+
+		index = node->parent;
+	}
+}
+
+static void World_TreeInsertLeaf( worldtree_t *tree, int leaf )
+{
+	vec3_t	mins, maxs;
+	int	index, sibling, oldparent, newparent;
+
+	if( tree->root == WORLDTREE_NULL )
+	{
+		tree->root = leaf;
+		tree->nodes[leaf].parent = WORLDTREE_NULL;
+		return;
+	}
+
+	// find the best sibling
+	index = tree->root;
+
+	while( tree->nodes[index].height > 0 )
+	{
+		const worldtreenode_t	*node = &tree->nodes[index];
+		const worldtreenode_t	*l = &tree->nodes[leaf];
+		float		area, combined, cost, inheritance;
+		float		childcost[2];
+		int		i;
+
+		area = World_TreeArea( node->mins, node->maxs );
+		World_TreeUnion( node, l, mins, maxs );
+		combined = World_TreeArea( mins, maxs );
+
+		// cost of creating a new parent for this node and the new leaf
+		cost = 2.0f * combined;
+
+		// minimum cost of pushing the leaf further down the tree
+		inheritance = 2.0f * ( combined - area );
+
+		for( i = 0; i < 2; i++ )
+		{
+			const worldtreenode_t *child = &tree->nodes[node->children[i]];
+
+			World_TreeUnion( child, l, mins, maxs );
+			childcost[i] = World_TreeArea( mins, maxs ) + inheritance;
+
+			if( child->height > 0 )
+				childcost[i] -= World_TreeArea( child->mins, child->maxs );
+		}
+
+		if( cost < childcost[0] && cost < childcost[1] )
+			break;
+
+		index = ( childcost[0] < childcost[1] ) ? node->children[0] : node->children[1];
+	}
+
+	sibling = index;
+
+	// create a new parent, may reallocate nodes
+	newparent = World_TreeAllocNode( tree );
+	oldparent = tree->nodes[sibling].parent;
+
+	tree->nodes[newparent].parent = oldparent;
+	tree->nodes[newparent].height = tree->nodes[sibling].height + 1;
+	World_TreeUnion( &tree->nodes[leaf], &tree->nodes[sibling], tree->nodes[newparent].mins, tree->nodes[newparent].maxs );
+
+	if( oldparent != WORLDTREE_NULL )
+	{
+		if( tree->nodes[oldparent].children[0] == sibling )
+			tree->nodes[oldparent].children[0] = newparent;
+		else tree->nodes[oldparent].children[1] = newparent;
+	}
+	else tree->root = newparent;
+
+	tree->nodes[newparent].children[0] = sibling;
+	tree->nodes[newparent].children[1] = leaf;
+	tree->nodes[sibling].parent = newparent;
+	tree->nodes[leaf].parent = newparent;
+
+	World_TreeRefit( tree, tree->nodes[leaf].parent );
+}
+
+static void World_TreeRemoveLeaf( worldtree_t *tree, int leaf )
+{
+	int	parent, grandparent, sibling;
+
+	if( leaf == tree->root )
+	{
+		tree->root = WORLDTREE_NULL;
+		return;
+	}
+
+	parent = tree->nodes[leaf].parent;
+	grandparent = tree->nodes[parent].parent;
+
+	if( tree->nodes[parent].children[0] == leaf )
+		sibling = tree->nodes[parent].children[1];
+	else sibling = tree->nodes[parent].children[0];
+
+	if( grandparent != WORLDTREE_NULL )
+	{
+		// destroy parent and connect sibling to grandparent
+		if( tree->nodes[grandparent].children[0] == parent )
+			tree->nodes[grandparent].children[0] = sibling;
+		else tree->nodes[grandparent].children[1] = sibling;
+
+		tree->nodes[sibling].parent = grandparent;
+		World_TreeFreeNode( tree, parent );
+
+		World_TreeRefit( tree, grandparent );
+	}
+	else
+	{
+		tree->root = sibling;
+		tree->nodes[sibling].parent = WORLDTREE_NULL;
+		World_TreeFreeNode( tree, parent );
+	}
+}
+
+/*
+==================
+World_TreeInit
+
+==================
+*/
+void World_TreeInit( worldtree_t *tree, poolhandle_t mempool )
+{
+	memset( tree, 0, sizeof( *tree ));
+	tree->root = WORLDTREE_NULL;
+	tree->freelist = WORLDTREE_NULL;
+	tree->mempool = mempool;
+}
+
+/*
+==================
+World_TreeFree
+
+==================
+*/
+void World_TreeFree( worldtree_t *tree )
+{
+	if( tree->nodes )
+		Mem_Free( tree->nodes );
+
+	World_TreeInit( tree, tree->mempool );
+}
+
+/*
+==================
+World_TreeInsert
+
+returns leaf index that used as proxy for data
+==================
+*/
+int World_TreeInsert( worldtree_t *tree, const vec3_t mins, const vec3_t maxs, void *data )
+{
+	int	leaf = World_TreeAllocNode( tree );
+	worldtreenode_t	*node = &tree->nodes[leaf];
+
+	VectorCopy( mins, node->mins );
+	VectorCopy( maxs, node->maxs );
+	ExpandBounds( node->mins, node->maxs, WORLDTREE_MARGIN );
+	node->data = data;
+
+	World_TreeInsertLeaf( tree, leaf );
+	tree->numleafs++;
+
+	return leaf;
+}
+
+/*
+==================
+World_TreeRemove
+
+==================
+*/
+void World_TreeRemove( worldtree_t *tree, int leaf )
+{
+	Assert( leaf >= 0 && leaf < tree->maxnodes && tree->nodes[leaf].height == 0 );
+
+	World_TreeRemoveLeaf( tree, leaf );
+	World_TreeFreeNode( tree, leaf );
+	tree->numleafs--;
+}
+
+/*
+==================
+World_TreeMove
+
+leaf keeps its index, returns true if tree was changed
+==================
+*/
+qboolean World_TreeMove( worldtree_t *tree, int leaf, const vec3_t mins, const vec3_t maxs )
+{
+	worldtreenode_t	*node = &tree->nodes[leaf];
+
+	Assert( leaf >= 0 && leaf < tree->maxnodes && node->height == 0 );
+
+	// still inside of fattened box
+	if( node->mins[0] <= mins[0] && node->mins[1] <= mins[1] && node->mins[2] <= mins[2]
+		&& node->maxs[0] >= maxs[0] && node->maxs[1] >= maxs[1] && node->maxs[2] >= maxs[2] )
+		return false;
+
+	World_TreeRemoveLeaf( tree, leaf );
+
+	node = &tree->nodes[leaf];
+	VectorCopy( mins, node->mins );
+	VectorCopy( maxs, node->maxs );
+	ExpandBounds( node->mins, node->maxs, WORLDTREE_MARGIN );
+
+	World_TreeInsertLeaf( tree, leaf );
+
+	return true;
+}
+
+/*
+==================
+World_TreeQuery
+
+collects data of all leafs intersecting the box,
+returns -1 if list is too small
+==================
+*/
+int World_TreeQuery( const worldtree_t *tree, const vec3_t mins, const vec3_t maxs, void **list, int maxlist )
+{
+	int	stack[WORLDTREE_MAX_DEPTH];
+	int	depth = 0, count = 0;
+
+	if( tree->root == WORLDTREE_NULL )
+		return 0;
+
+	stack[depth++] = tree->root;
+
+	while( depth > 0 )
+	{
+		const worldtreenode_t *node = &tree->nodes[stack[--depth]];
+
+		if( !BoundsIntersect( mins, maxs, node->mins, node->maxs ))
+			continue;
+
+		if( node->height == 0 )
+		{
+			if( count == maxlist )
+				return -1;
+
+			list[count++] = node->data;
+			continue;
+		}
+
+		// can't happen with balanced tree
+		if( depth + 2 > WORLDTREE_MAX_DEPTH )
+			return -1;
+
+		stack[depth++] = node->children[1];
+		stack[depth++] = node->children[0];
+	}
+
+	return count;
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_BOXES 512
+
+static void Test_WorldTreeRandomBox( vec3_t mins, vec3_t maxs )
+{
+	int	i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		mins[i] = COM_RandomFloat( -4096.0f, 4096.0f );
+		maxs[i] = mins[i] + COM_RandomFloat( 0.0f, 256.0f );
+	}
+}
+
+static void Test_WorldTreeQuery( const worldtree_t *tree, vec3_t boxes[][2], const int *leafs, int *errors )
+{
+	void	*list[TEST_BOXES];
+	vec3_t	mins, maxs;
+	int	i, j, count;
+
+	Test_WorldTreeRandomBox( mins, maxs );
+	ExpandBounds( mins, maxs, 512.0f );
+
+	count = World_TreeQuery( tree, mins, maxs, list, TEST_BOXES );
+
+	// every box that really intersects must be reported
+	for( i = 0; i < TEST_BOXES; i++ )
+	{
+		if( leafs[i] == WORLDTREE_NULL || !BoundsIntersect( mins, maxs, boxes[i][0], boxes[i][1] ))
+			continue;
+
+		for( j = 0; j < count; j++ )
+		{
+			if( list[j] == boxes[i] )
+				break;
+		}
+
+		if( j == count )
+			(*errors)++;
+	}
+}
+
+static void Test_WorldTree( void )
+{
+	static vec3_t	boxes[TEST_BOXES][2];
+	int		leafs[TEST_BOXES];
+	worldtree_t	tree;
+	int		i, pass, errors = 0, numleafs = 0;
+
+	World_TreeInit( &tree, host.mempool );
+
+	for( i = 0; i < TEST_BOXES; i++ )
+	{
+		Test_WorldTreeRandomBox( boxes[i][0], boxes[i][1] );
+		leafs[i] = World_TreeInsert( &tree, boxes[i][0], boxes[i][1], boxes[i] );
+	}
+
+	for( pass = 0; pass < 64; pass++ )
+	{
+		// move some, remove some, put them back later
+		for( i = 0; i < TEST_BOXES; i++ )
+		{
+			int	op = COM_RandomLong( 0, 7 );
+
+			if( leafs[i] == WORLDTREE_NULL )
+			{
+				if( op == 0 )
+				{
+					Test_WorldTreeRandomBox( boxes[i][0], boxes[i][1] );
+					leafs[i] = World_TreeInsert( &tree, boxes[i][0], boxes[i][1], boxes[i] );
+				}
+			}
+			else if( op == 0 )
+			{
+				World_TreeRemove( &tree, leafs[i] );
+				leafs[i] = WORLDTREE_NULL;
+			}
+			else if( op < 4 )
+			{
+				vec3_t	delta;
+
+				VectorSet( delta, COM_RandomFloat( -32.0f, 32.0f ), COM_RandomFloat( -32.0f, 32.0f ), COM_RandomFloat( -32.0f, 32.0f ));
+				VectorAdd( boxes[i][0], delta, boxes[i][0] );
+				VectorAdd( boxes[i][1], delta, boxes[i][1] );
+				World_TreeMove( &tree, leafs[i], boxes[i][0], boxes[i][1] );
+			}
+		}
+
+		Test_WorldTreeQuery( &tree, boxes, leafs, &errors );
+	}
+
+	for( i = 0; i < TEST_BOXES; i++ )
+	{
+		if( leafs[i] != WORLDTREE_NULL )
+			numleafs++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+	TASSERT_EQi( tree.numleafs, numleafs );
+	// balanced tree of 512 leafs is far below the query stack limit
+	TASSERT( tree.root == WORLDTREE_NULL || tree.nodes[tree.root].height < 32 );
+
+	World_TreeFree( &tree );
+}
+
+void Test_RunWorldTree( void )
+{
+	TRUN( Test_WorldTree( ));
+}
+#endif // XASH_ENGINE_TESTS
@@ -102,6 +102,43 @@ static inline int RankForContents( int contents )
 
 void World_TransformAABB( matrix4x4 transform, const vec3_t mins, const vec3_t maxs, vec3_t outmins, vec3_t outmaxs );
 
+/*
+===============================================================================
+
+	DYNAMIC AABB TREE
+
+===============================================================================
+*/
+#define WORLDTREE_NULL	-1
+#define WORLDTREE_MARGIN	8.0f	// leaf boxes are fattened so small moves don't touch the tree
+
+typedef struct worldtreenode_s
+{
+	vec3_t		mins;
+	vec3_t		maxs;
+	int		parent;		// next free node when unused
+	int		children[2];	// WORLDTREE_NULL for leafs
+	int		height;		// 0 for leafs, -1 for free nodes
+	void		*data;
+} worldtreenode_t;
+
+typedef struct worldtree_s
+{
+	worldtreenode_t	*nodes;
+	int		maxnodes;
+	int		numleafs;
+	int		root;
+	int		freelist;
+	poolhandle_t	mempool;
+} worldtree_t;
+
+void World_TreeInit( worldtree_t *tree, poolhandle_t mempool );
+void World_TreeFree( worldtree_t *tree );
+int World_TreeInsert( worldtree_t *tree, const vec3_t mins, const vec3_t maxs, void *data );
+void World_TreeRemove( worldtree_t *tree, int leaf );
+qboolean World_TreeMove( worldtree_t *tree, int leaf, const vec3_t mins, const vec3_t maxs );
+int World_TreeQuery( const worldtree_t *tree, const vec3_t mins, const vec3_t maxs, void **list, int maxlist );
+
 #define check_angles( x )	( (int)x == 90 || (int)x == 180 || (int)x == 270 || (int)x == -90 || (int)x == -180 || (int)x == -270 )
 
 /*
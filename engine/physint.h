@@ -18,7 +18,8 @@ GNU General Public License for more details.
 
 #include "eiface.h" // offsetof
 
-#define SV_PHYSICS_INTERFACE_VERSION	6
+#define SV_PHYSICS_INTERFACE_VERSION	7	// 7: pfnTraceMany and lag compensation calls
+#define SV_PHYSICS_INTERFACE_VERSION_OLD	6	// still accepted, game won't use new calls
 
 #define STRUCT_FROM_LINK( l, t, m )	((t *)((byte *)l - offsetof(t, m)))
 #define EDICT_FROM_AREA( l )		STRUCT_FROM_LINK( l, edict_t, area )
@@ -115,6 +116,17 @@ typedef struct server_physics_api_s
 
 	// FWGS extension
 	void       *(*pfnGetNativeObject)( const char *object );
+
+	// batched pfnTrace: count moves sharing hull, type and ignored edict,
+	// starts and ends are arrays of count * 3 floats
+	void       (*pfnTraceMany)( const float *starts, const float *ends, int count, float *mins, float *maxs, int type, edict_t *e, trace_t *traces );
+
+	// lag compensation: server time seen by client when current command was issued
+	double     (*pfnGetUnlagTime)( const edict_t *client );
+	// moves players and monsters back to their recorded state at given time, NULL list means all.
+	// Returns number of moved edicts, pfnRestoreEdicts must be called before frame ends
+	int        (*pfnRewindEdicts)( edict_t **edicts, int count, double time );
+	void       (*pfnRestoreEdicts)( void );
 } server_physics_api_t;
 
 // physic callbacks
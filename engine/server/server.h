@@ -70,6 +70,10 @@ extern int SV_UPDATE_BACKUP;
 
 #define MAX_ENT_LEAFS( ext ) (( ext ) ? MAX_ENT_LEAFS_32 : MAX_ENT_LEAFS_16 )
 
+#define SV_VISCACHE_ENTRIES	32	// distinct client viewpoints shared per frame
+#define SV_CLIENT_HASH_SIZE	( MAX_CLIENTS * 2 )	// must be power of two
+#define SV_VOICEDATA_SIZE	8192	// voice relayed to one client per packet
+
 #define FCL_RESEND_USERINFO	BIT( 0 )
 #define FCL_RESEND_MOVEVARS	BIT( 1 )
 #define FCL_SKIP_NET_MESSAGE	BIT( 2 )
@@ -97,6 +101,16 @@ typedef enum
 	cs_spawned	// client is fully in game
 } cl_state_t;
 
+// what client bandwidth is spent on, in order of priority
+typedef enum
+{
+	bw_snapshot = 0,	// entities, events and other unreliable data
+	bw_reliable,	// game messages and their fragments
+	bw_voice,
+	bw_download,	// file fragments
+	BW_CLASSES
+} sv_bwclass_t;
+
 typedef enum
 {
 	us_inactive = 0,
@@ -146,6 +160,22 @@ typedef struct server_s
 	char		files_precache[MAX_CUSTOM][MAX_QPATH];
 	char		event_precache[MAX_EVENTS][MAX_QPATH];
 	byte		model_precache_flags[MAX_MODELS];
+
+	// case insensitive name hashes for the precache tables above, chained
+	// by precache index, zero terminates the chain as slot zero is never used
+	word		model_hash[MAX_MODELS];
+	word		model_hashnext[MAX_MODELS];
+	word		sound_hash[MAX_SOUNDS];
+	word		sound_hashnext[MAX_SOUNDS];
+	word		files_hash[MAX_CUSTOM];
+	word		files_hashnext[MAX_CUSTOM];
+	word		event_hash[MAX_EVENTS];
+	word		event_hashnext[MAX_EVENTS];
+	int		model_precache_count;	// last used slot in each table
+	int		sound_precache_count;
+	int		files_precache_count;
+	int		event_precache_count;
+
 	model_t		*models[MAX_MODELS];
 	int		num_static_entities;
 
@@ -224,9 +254,20 @@ typedef struct sv_client_s
 	int userid;              // identifying number on server
 
 	netchan_t netchan;
+	uint      hashValue;          // base address and qport hash, see SV_LinkClientAddress
+	struct sv_client_s *hashNext; // next client in svs.client_hash chain
+
 	sizebuf_t datagram; // the datagram is written to by sound calls, prints, temp ents, etc.
 	byte      datagram_buf[MAX_DATAGRAM]; // it can be harmlessly overflowed.
 
+	sizebuf_t voicedata; // voice from other players, dropped when there is no bandwidth left
+	byte      voicedata_buf[SV_VOICEDATA_SIZE];
+
+	int    bw_bytes[BW_CLASSES]; // sent during current sv_showbandwidth period
+	int    bw_voicedrops;        // voice messages dropped in this period
+	double bw_filehold;          // file fragments are held since then, 0 if not
+	double bw_readouttime;       // start of sv_showbandwidth period
+
 	int chokecount;     // number of messages rate supressed
 	int delta_sequence; // -1 = no compression.
 
@@ -359,6 +400,11 @@ typedef struct
 	int		spawncount;		// incremented each server start
 						// used to check late spawns
 	sv_client_t	*clients;			// [svs.maxclients]
+	sv_client_t	*client_hash[SV_CLIENT_HASH_SIZE];	// clients by base address and qport
+	uint		client_hash_hits;		// incoming packets matched to a client
+	uint		client_hash_misses;		// incoming packets without a client
+	uint		viscache_hits;		// clients that reused visibility of another client
+	uint		viscache_misses;		// clients with a new viewpoint
 	int		num_client_entities;	// svs.maxclients*UPDATE_BACKUP*MAX_PACKET_ENTITIES
 	int		next_client_entities;	// next client_entity to use
 	entity_state_t	*packet_entities;		// [num_client_entities]
@@ -390,6 +436,7 @@ extern convar_t		sv_unlag;
 extern convar_t		sv_maxunlag;
 extern convar_t		sv_unlagpush;
 extern convar_t		sv_unlagsamples;
+extern convar_t		sv_unlaghistory;
 extern convar_t		rcon_enable;
 extern convar_t		sv_instancedbaseline;
 extern convar_t		sv_background_freeze;
@@ -401,6 +448,10 @@ extern convar_t		sv_downloadurl;
 extern convar_t		sv_newunit;
 extern convar_t		sv_clienttrace;
 extern convar_t		sv_failuretime;
+extern convar_t		sv_snapshot_threads;
+extern convar_t		sv_deltamemo;
+extern convar_t		sv_viscache;
+extern convar_t		sv_areaindex;
 extern convar_t		sv_send_resources;
 extern convar_t		sv_send_logos;
 extern convar_t		sv_allow_upload;
@@ -412,6 +463,8 @@ extern convar_t		sv_wateralpha;
 extern convar_t		sv_wateramp;
 extern convar_t		sv_voiceenable;
 extern convar_t		sv_voicequality;
+extern convar_t		sv_rateburst;
+extern convar_t		sv_showbandwidth;
 extern convar_t		sv_maxvelocity;
 extern convar_t		sv_stepsize;
 extern convar_t		sv_skyname;
@@ -463,6 +516,8 @@ void SV_KickPlayer( sv_client_t *cl, const char *fmt, ... ) FORMAT_CHECK( 2 );
 void SV_DropClient( sv_client_t *cl, qboolean crash ) RENAME_SYMBOL( "SV_DropClient_" );
 void SV_UpdateMovevars( qboolean initialize );
 int SV_ModelIndex( const char *name );
+int SV_FindModelIndex( const char *name );
+int SV_CheckVisibility( const edict_t *ent, byte *pset );
 int SV_SoundIndex( const char *name );
 int SV_EventIndex( const char *name );
 int SV_GenericIndex( const char *name );
@@ -472,6 +527,10 @@ void SV_RemoteCommand( netadr_t from, sizebuf_t *msg );
 void SV_SendResource( resource_t *pResource, sizebuf_t *msg );
 void SV_AddToMaster( netadr_t from, sizebuf_t *msg );
 qboolean SV_ProcessUserAgent( netadr_t from, const char *useragent );
+void SV_LinkClientAddress( sv_client_t *cl );
+void SV_UnlinkClientAddress( sv_client_t *cl );
+void SV_ClearClientAddresses( void );
+void SV_ClientAddressStats_f( void );
 
 //
 // sv_init.c
@@ -592,6 +651,10 @@ qboolean SV_CheckID( const char *id );
 void SV_InactivateClients( void );
 int SV_FindBestBaseline( int index, entity_state_t **baseline, entity_state_t *to, client_frame_t *frame, qboolean player );
 void SV_SkipUpdates( void );
+void SV_FreeSnapshots( void );
+int SV_VisCacheCheck( const edict_t *ent, byte *pset );
+void SV_FreeVisCache( void );
+void SV_VisCacheStats_f( void );
 
 //
 // sv_game.c
@@ -674,20 +737,45 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed );
 // sv_world.c
 //
 void SV_ClearWorld( void );
+void SV_UpdateAreaIndex( void );
+void SV_FreeAreaIndex( void );
+void SV_AreaBench_f( void );
 void SV_UnlinkEdict( edict_t *ent );
 void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip );
 trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e );
+void SV_MoveMany( const float *starts, const float *ends, int count, vec3_t mins, vec3_t maxs, int type, edict_t *e, qboolean monsterclip, trace_t *traces );
 const char *SV_TraceTexture( edict_t *ent, const vec3_t start, const vec3_t end );
 msurface_t *SV_TraceSurface( edict_t *ent, const vec3_t start, const vec3_t end );
 trace_t SV_MoveToss( edict_t *tossent, edict_t *ignore );
 void SV_LinkEdict( edict_t *ent, qboolean touch_triggers );
+void SV_RelinkEdictArea( edict_t *ent );
 int SV_TruePointContents( const vec3_t p );
 int SV_PointContents( const vec3_t p );
 void SV_SetLightStyle( int style, const char* s, float f );
 int SV_LightForEntity( edict_t *pEdict );
 
+//
+// sv_unlag.c
+//
+void SV_RecordUnlagHistory( void );
+double SV_GetUnlagTime( const edict_t *client );
+int SV_RewindEdicts( edict_t **edicts, int count, double time );
+void SV_RestoreEdicts( void );
+void SV_ClearUnlagHistory( void );
+
+//
+// sv_replay.c
+//
+void SV_CaptureFrame( void );
+void SV_CaptureSpawnServer( void );
+void SV_StopCapture( void );
+void SV_Capture_f( void );
+void SV_StopCapture_f( void );
+qboolean SV_GetPacket( netadr_t *from, byte *buffer, byte **data, size_t *length );
+qboolean SV_Replaying( void );
+
 //
 // sv_query.c
 //
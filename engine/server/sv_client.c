@@ -415,6 +415,7 @@ static void SV_ConnectClient( netadr_t from )
 	frames = Mem_Realloc( host.mempool, newcl->frames, sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
 	memset( frames, 0, sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
 	SV_ClearResourceLists( newcl );
+	SV_UnlinkClientAddress( newcl );
 
 	memset( newcl, 0, sizeof( *newcl ));
 
@@ -422,7 +423,7 @@ static void SV_ConnectClient( netadr_t from )
 	newcl->frames = frames;
 	newcl->userid = g_userid++;	// create unique userid
 	newcl->state = cs_connected;
-	newcl->extensions = FBitSet( extensions, NET_EXT_SPLITSIZE );
+	newcl->extensions = FBitSet( extensions, NET_EXT_SPLITSIZE|NET_EXT_LZ4 );
 	Q_strncpy( newcl->useragent, protinfo, sizeof( newcl->useragent ));
 
 	// HACKHACK: can hear all players by default to avoid issues
@@ -431,9 +432,16 @@ static void SV_ConnectClient( netadr_t from )
 
 	// initailize netchan
 	if( !Host_IsLocalClient( ))
+	{
 		SetBits( netchan_flags, NETCHAN_USE_LZSS );
+
+		if( FBitSet( newcl->extensions, NET_EXT_LZ4 ))
+			SetBits( netchan_flags, NETCHAN_USE_LZ4 );
+	}
 	Netchan_Setup( NS_SERVER, &newcl->netchan, from, qport, newcl, SV_GetFragmentSize, netchan_flags );
+	SV_LinkClientAddress( newcl );
 	MSG_Init( &newcl->datagram, "Datagram", newcl->datagram_buf, sizeof( newcl->datagram_buf )); // datagram buf
+	MSG_Init( &newcl->voicedata, "VoiceData", newcl->voicedata_buf, sizeof( newcl->voicedata_buf ));
 
 	Q_strncpy( newcl->hashedcdkey, Info_ValueForKey( protinfo, "uuid" ), 32 );
 	newcl->hashedcdkey[32] = '\0';
@@ -499,6 +507,7 @@ edict_t *GAME_EXPORT SV_FakeConnect( const char *netname )
 	if( cl->frames )
 		Mem_Free( cl->frames );	// fakeclients doesn't have frames
 	SV_ClearResourceLists( cl );
+	SV_UnlinkClientAddress( cl );
 
 	memset( cl, 0, sizeof( *cl ));
 
@@ -3491,17 +3500,17 @@ static void SV_ParseVoiceData( sv_client_t *cl, sizebuf_t *msg )
 		length = size;
 
 		// 6 is a number of bytes for other parts of message
-		if( MSG_GetNumBytesLeft( &cur->datagram ) < length + 6 )
+		if( MSG_GetNumBytesLeft( &cur->voicedata ) < length + 6 )
 			continue;
 
 		if( cl == cur && !cur->m_bLoopback )
 			length = 0;
 
-		MSG_BeginServerCmd( &cur->datagram, svc_voicedata );
-		MSG_WriteByte( &cur->datagram, client );
-		MSG_WriteByte( &cur->datagram, frames );
-		MSG_WriteShort( &cur->datagram, length );
-		MSG_WriteBytes( &cur->datagram, received, length );
+		MSG_BeginServerCmd( &cur->voicedata, svc_voicedata );
+		MSG_WriteByte( &cur->voicedata, client );
+		MSG_WriteByte( &cur->voicedata, frames );
+		MSG_WriteShort( &cur->voicedata, length );
+		MSG_WriteBytes( &cur->voicedata, received, length );
 	}
 }
 
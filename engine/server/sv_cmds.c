@@ -1022,6 +1022,11 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "logaddress", SV_SetLogAddress_f, "sets address and port for remote logging host" );
 	Cmd_AddCommand( "log", SV_ServerLog_f, "enables logging to file" );
 	Cmd_AddCommand( "str64stats", SV_PrintStr64Stats_f, "print engine pool string statistics" );
+	Cmd_AddCommand( "sv_clientaddrstats", SV_ClientAddressStats_f, "print client address lookup statistics" );
+	Cmd_AddCommand( "sv_viscachestats", SV_VisCacheStats_f, "print shared client visibility statistics" );
+	Cmd_AddCommand( "sv_areabench", SV_AreaBench_f, "compare trace and link costs of areanodes and area index on current map" );
+	Cmd_AddCommand( "sv_capture", SV_Capture_f, "record incoming client packets to file for -replay" );
+	Cmd_AddCommand( "sv_stopcapture", SV_StopCapture_f, "stop recording incoming client packets" );
 	Cmd_AddCommand( "sv_list_messages", SV_ListMessages_f, "list registered user messages" );
 
 	if( host.type == HOST_NORMAL )
@@ -1062,6 +1067,11 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "logaddress" );
 	Cmd_RemoveCommand( "log" );
 	Cmd_RemoveCommand( "str64stats" );
+	Cmd_RemoveCommand( "sv_clientaddrstats" );
+	Cmd_RemoveCommand( "sv_viscachestats" );
+	Cmd_RemoveCommand( "sv_areabench" );
+	Cmd_RemoveCommand( "sv_capture" );
+	Cmd_RemoveCommand( "sv_stopcapture" );
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -25,6 +25,95 @@ typedef struct
 	byte		sended[MAX_EDICTS_BYTES];
 } sv_ents_t;
 
+// client datagram split into the part that needs game dll and shared
+// server state (built on main thread) and packet entities deltas, that
+// can be written by worker threads when sv_snapshot_threads is set
+typedef struct
+{
+	sv_client_t	*cl;
+	client_frame_t	*frame;
+	client_frame_t	*from;		// delta frame, NULL for full update
+	int		header_bit;	// packetentities header position in msg
+
+	delta_entity_op_t	*ops;
+	int		*memo;		// delta memo entry per op, -1 is written directly
+	int		numops;
+	int		maxops;
+
+	sizebuf_t		arena;		// deltas encoded by this snapshot for delta memo
+	byte		*arena_buf;
+
+	sizebuf_t		msg;
+	sizebuf_t		trailer;		// events and pings, goes after packet entities
+	byte		msg_buf[MAX_DATAGRAM];
+	byte		trailer_buf[MAX_DATAGRAM];
+} sv_snapshot_t;
+
+static struct
+{
+	sv_snapshot_t	*snapshots;
+	int		maxsnapshots;
+	int		numsnapshots;	// queued in this frame
+	workers_t		*workers;
+} sv_snap;
+
+#define SV_DELTAMEMO_HASH	1024	// must be power of two
+#define SV_DELTAMEMO_ARENA	0x8000	// bytes per snapshot
+
+// entity delta encoded in this frame, clients that acknowledged
+// the same frame get these bits instead of encoding it again
+typedef struct
+{
+	uint		hash;
+	int		next;		// hash chain, -1 is end
+	delta_entity_op_t	op;
+	int		expiry;		// states in packet_entities are overwritten after that
+
+	int		owner;		// snapshot that encodes it
+	int		ownerop;
+	qboolean		pending;
+	int		bitpos;		// in owner arena, -1 if it didn't fit
+	int		numbits;
+} sv_deltamemo_t;
+
+static struct
+{
+	int		hashtable[SV_DELTAMEMO_HASH];
+	sv_deltamemo_t	*entries;
+	int		numentries;
+	int		maxentries;
+
+	// counters for last frame
+	int		lookups;
+	int		hits;
+} deltamemo;
+
+// clients with identical fat PVS/PHS share visibility checks within a frame
+typedef struct
+{
+	uint		hash;
+	byte		*pvs;
+	byte		*phs;
+	qboolean		has_phs;
+	signed char	*pvsvis;		// pfnCheckVisibility results, -1 if not checked yet
+	signed char	*phsvis;
+	int		*candidates;	// entities that may pass AddToFullPack
+	int		numcandidates;	// -1 if not built yet
+} sv_viscache_t;
+
+static struct
+{
+	sv_viscache_t	entries[SV_VISCACHE_ENTRIES];
+	int		numentries;	// used in this frame
+	size_t		fatbytes;		// allocation sizes of entries
+	int		maxedicts;
+
+	// sets returned by pfnSetupVisibility for the client being processed
+	sv_viscache_t	*current;
+	const byte	*curpvs;
+	const byte	*curphs;
+} viscache;
+
 static int	c_fullsend;	// just a debug counter
 static int	c_notsend;
 
@@ -49,6 +138,233 @@ static int SV_EntityNumbers( const void *a, const void *b )
 	return 1;
 }
 
+/*
+=============
+SV_VisCacheHash
+
+=============
+*/
+static uint SV_VisCacheHash( const byte *pvs, const byte *phs, size_t size )
+{
+	uint	hash = 2166136261u; // FNV-1a
+	size_t	i;
+
+	for( i = 0; i < size; i++ )
+		hash = ( hash ^ pvs[i] ) * 16777619u;
+
+	if( phs )
+	{
+		for( i = 0; i < size; i++ )
+			hash = ( hash ^ phs[i] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+=============
+SV_VisCacheBegin
+
+find or create cache entry for sets returned by pfnSetupVisibility
+=============
+*/
+static sv_viscache_t *SV_VisCacheBegin( const byte *pvs, const byte *phs )
+{
+	size_t		size = world.fatbytes;
+	sv_viscache_t	*entry;
+	uint		hash;
+	int		i;
+
+	viscache.current = NULL;
+	viscache.curpvs = viscache.curphs = NULL;
+
+	if( !sv_viscache.value || !pvs || !size )
+		return NULL;
+
+	// sizes depend on map and game, so reallocate when they change
+	if( viscache.fatbytes != size || viscache.maxedicts != GI->max_edicts )
+	{
+		SV_FreeVisCache();
+		viscache.fatbytes = size;
+		viscache.maxedicts = GI->max_edicts;
+	}
+
+	hash = SV_VisCacheHash( pvs, phs, size );
+
+	for( i = 0; i < viscache.numentries; i++ )
+	{
+		entry = &viscache.entries[i];
+
+		if( entry->hash != hash || entry->has_phs != ( phs != NULL ))
+			continue;
+
+		if( memcmp( entry->pvs, pvs, size ))
+			continue;
+
+		if( phs && memcmp( entry->phs, phs, size ))
+			continue;
+
+		svs.viscache_hits++;
+		break;
+	}
+
+	if( i == viscache.numentries )
+	{
+		// too many different viewpoints, check everything directly
+		if( viscache.numentries == SV_VISCACHE_ENTRIES )
+			return NULL;
+
+		entry = &viscache.entries[viscache.numentries++];
+
+		if( !entry->pvs )
+		{
+			entry->pvs = Z_Malloc( size * 2 );
+			entry->phs = entry->pvs + size;
+			entry->pvsvis = Z_Malloc( viscache.maxedicts * 2 );
+			entry->phsvis = entry->pvsvis + viscache.maxedicts;
+			entry->candidates = Z_Malloc( viscache.maxedicts * sizeof( int ));
+		}
+
+		entry->hash = hash;
+		entry->has_phs = ( phs != NULL );
+		memcpy( entry->pvs, pvs, size );
+		if( phs ) memcpy( entry->phs, phs, size );
+		memset( entry->pvsvis, -1, viscache.maxedicts * 2 );
+		entry->numcandidates = -1;
+
+		svs.viscache_misses++;
+	}
+
+	viscache.current = entry;
+	viscache.curpvs = pvs;
+	viscache.curphs = phs;
+
+	return entry;
+}
+
+/*
+=============
+SV_VisCacheEnd
+
+sets may be changed by game dll after this point
+=============
+*/
+static void SV_VisCacheEnd( void )
+{
+	viscache.current = NULL;
+	viscache.curpvs = viscache.curphs = NULL;
+}
+
+/*
+=============
+SV_VisCacheCheck
+
+pfnCheckVisibility with results shared between clients
+=============
+*/
+int SV_VisCacheCheck( const edict_t *ent, byte *pset )
+{
+	sv_viscache_t	*entry = viscache.current;
+	signed char	*vis = NULL;
+	int		e;
+
+	if( entry && pset )
+	{
+		if( pset == viscache.curpvs )
+			vis = entry->pvsvis;
+		else if( pset == viscache.curphs )
+			vis = entry->phsvis;
+	}
+
+	if( !vis || !SV_IsValidEdict( ent ))
+		return SV_CheckVisibility( ent, pset );
+
+	e = NUM_FOR_EDICT( ent );
+
+	if( vis[e] < 0 )
+		vis[e] = SV_CheckVisibility( ent, pset );
+
+	return vis[e];
+}
+
+/*
+=============
+SV_VisCacheCandidates
+
+entities that can pass visibility test in AddToFullPack,
+players and portals are always included
+=============
+*/
+static int SV_VisCacheCandidates( sv_viscache_t *entry, const int **candidates )
+{
+	int	e;
+
+	if( entry->numcandidates < 0 )
+	{
+		entry->numcandidates = 0;
+
+		for( e = 1; e < svgame.numEntities; e++ )
+		{
+			edict_t	*ent = EDICT_NUM( e );
+			byte	*pset;
+
+			if( e > svs.maxclients && !FBitSet( ent->v.effects, EF_MERGE_VISIBILITY ))
+			{
+				if( FBitSet( ent->v.effects, EF_REQUEST_PHS ))
+					pset = (byte *)viscache.curphs;
+				else pset = (byte *)viscache.curpvs;
+
+				// NULL set means everything is visible
+				if( pset && !SV_VisCacheCheck( ent, pset ))
+					continue;
+			}
+
+			entry->candidates[entry->numcandidates++] = e;
+		}
+	}
+
+	*candidates = entry->candidates;
+
+	return entry->numcandidates;
+}
+
+/*
+=============
+SV_VisCacheStats_f
+
+=============
+*/
+void SV_VisCacheStats_f( void )
+{
+	Con_Printf( "%i viewpoints in last frame\n", viscache.numentries );
+	Con_Printf( "%u clients reused visibility, %u computed it\n", svs.viscache_hits, svs.viscache_misses );
+}
+
+/*
+=============
+SV_FreeVisCache
+
+=============
+*/
+void SV_FreeVisCache( void )
+{
+	int	i;
+
+	for( i = 0; i < SV_VISCACHE_ENTRIES; i++ )
+	{
+		sv_viscache_t *entry = &viscache.entries[i];
+
+		if( !entry->pvs )
+			continue;
+
+		Z_Free( entry->pvs );
+		Z_Free( entry->pvsvis );
+		Z_Free( entry->candidates );
+	}
+
+	memset( &viscache, 0, sizeof( viscache ));
+}
+
 /*
 =============
 SV_AddEntitiesToPacket
@@ -64,7 +380,10 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	sv_client_t	*cl = NULL;
 	qboolean		player;
 	entity_state_t	*state;
-	int		e;
+	sv_viscache_t	*cache;
+	const int		*candidates = NULL;
+	int		numcandidates;
+	int		i, e;
 
 	// during an error shutdown message we may need to transmit
 	// the shutdown message after the server has shutdown, so
@@ -91,11 +410,20 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	svgame.dllFuncs.pfnSetupVisibility( pViewEnt, pClient, &clientpvs, &clientphs );
 	if( !clientpvs ) fullvis = true;
 
+	cache = SV_VisCacheBegin( clientpvs, clientphs );
+
+	// skip entities that are not in PVS at all, expects AddToFullPack
+	// to reject them anyway, as stock game dlls do
+	if( cache && sv_viscache.value >= 2.0f )
+		numcandidates = SV_VisCacheCandidates( cache, &candidates );
+	else numcandidates = svgame.numEntities - 1;
+
 	// g-cont: of course we can send world but not want to do it :-)
-	for( e = 1; e < svgame.numEntities; e++ )
+	for( i = 0; i < numcandidates; i++ )
 	{
 		byte	*pset;
 
+		e = candidates ? candidates[i] : i + 1;
 		ent = EDICT_NUM( e );
 
 		// don't double add an entity through portals (in case this already added)
@@ -162,8 +490,13 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 			SetBits( sv.hostflags, SVF_MERGE_VISIBILITY );
 			SV_AddEntitiesToPacket( ent, pClient, frame, ents, false );
 			ClearBits( sv.hostflags, SVF_MERGE_VISIBILITY );
+
+			// portal merged its visibility into our sets
+			SV_VisCacheEnd();
 		}
 	}
+
+	SV_VisCacheEnd();
 }
 
 /*
@@ -225,14 +558,30 @@ int SV_FindBestBaseline( int index, entity_state_t **baseline, entity_state_t *t
 	return index - bestfound;
 }
 
+/*
+=============
+SV_AddEntityOp
+
+=============
+*/
+static delta_entity_op_t *SV_AddEntityOp( sv_snapshot_t *snap )
+{
+	// SV_EmitPacketEntities reserves enough ops for whole frame
+	Assert( snap->numops < snap->maxops );
+
+	snap->memo[snap->numops] = -1;
+	return &snap->ops[snap->numops++];
+}
+
 /*
 =============
 SV_EmitPacketEntities
 
-Writes a delta update of an entity_state_t list to the message->
+Writes packetentities header and prepares delta update of
+an entity_state_t list, that will be written by SV_WriteSnapshot
 =============
 */
-static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg )
+static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sv_snapshot_t *snap )
 {
 	entity_state_t	*oldent, *newent;
 	int		oldindex, newindex;
@@ -240,6 +589,10 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 	qboolean		player;
 	int		oldmax;
 	client_frame_t	*from;
+	sizebuf_t		*msg = &snap->msg;
+
+	snap->header_bit = MSG_GetNumBitsWritten( msg );
+	snap->numops = 0;
 
 	// this is the frame that we are going to delta update from
 	if( cl->delta_sequence != -1 )
@@ -273,6 +626,16 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 		MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
 	}
 
+	snap->from = from;
+
+	// every entity produces at most one op
+	if( snap->maxops < to->num_entities + oldmax )
+	{
+		snap->maxops = to->num_entities + oldmax;
+		snap->ops = Z_Realloc( snap->ops, snap->maxops * sizeof( *snap->ops ));
+		snap->memo = Z_Realloc( snap->memo, snap->maxops * sizeof( *snap->memo ));
+	}
+
 	newent = NULL;
 	oldent = NULL;
 	newindex = 0;
@@ -307,7 +670,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time, 0 );
+			Delta_PrepareEntity( SV_AddEntityOp( snap ), oldent, newent, false, player, 0 );
 			oldindex++;
 			newindex++;
 			continue;
@@ -338,7 +701,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			}
 
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( baseline, newent, msg, true, player, sv.time, offset );
+			Delta_PrepareEntity( SV_AddEntityOp( snap ), baseline, newent, true, player, offset );
 			newindex++;
 			continue;
 		}
@@ -353,13 +716,11 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 				force = true;
 
 			// remove from message
-			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0 );
+			Delta_PrepareEntity( SV_AddEntityOp( snap ), oldent, NULL, force, false, 0 );
 			oldindex++;
 			continue;
 		}
 	}
-
-	MSG_WriteUBitLong( msg, LAST_EDICT, MAX_ENTITY_BITS ); // end of packetentities
 }
 
 /*
@@ -610,7 +971,7 @@ SV_WriteEntitiesToClient
 
 ==================
 */
-static void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+static void SV_WriteEntitiesToClient( sv_client_t *cl, sv_snapshot_t *snap )
 {
 	client_frame_t	*frame;
 	entity_state_t	*state;
@@ -665,9 +1026,11 @@ static void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		frame->num_entities++;
 	}
 
-	SV_EmitPacketEntities( cl, frame, msg );
-	SV_EmitEvents( cl, frame, msg );
-	if( send_pings ) SV_EmitPings( msg );
+	snap->frame = frame;
+
+	SV_EmitPacketEntities( cl, frame, snap );
+	SV_EmitEvents( cl, frame, &snap->trailer );
+	if( send_pings ) SV_EmitPings( &snap->trailer );
 }
 
 /*
@@ -679,23 +1042,429 @@ FRAME UPDATES
 */
 /*
 =======================
-SV_SendClientDatagram
+SV_BuildClientDatagram
+
+everything that touches game dll or shared server state,
+always runs on main thread
 =======================
 */
-static void SV_SendClientDatagram( sv_client_t *cl )
+static void SV_BuildClientDatagram( sv_client_t *cl, sv_snapshot_t *snap )
 {
-	byte	msg_buf[MAX_DATAGRAM];
-	sizebuf_t	msg;
-
-	memset( msg_buf, 0, sizeof( msg_buf ));
-	MSG_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
+	memset( snap->msg_buf, 0, sizeof( snap->msg_buf ));
+	MSG_Init( &snap->msg, "Datagram", snap->msg_buf, sizeof( snap->msg_buf ));
+	MSG_Init( &snap->trailer, "Datagram", snap->trailer_buf, sizeof( snap->trailer_buf ));
+	snap->cl = cl;
 
 	// always send servertime at new frame
-	MSG_BeginServerCmd( &msg, svc_time );
-	MSG_WriteFloat( &msg, sv.time );
+	MSG_BeginServerCmd( &snap->msg, svc_time );
+	MSG_WriteFloat( &snap->msg, sv.time );
+
+	SV_WriteClientdataToMessage( cl, &snap->msg );
+	SV_WriteEntitiesToClient( cl, snap );
+}
+
+/*
+=======================
+SV_DeltaMemoHash
+
+=======================
+*/
+static uint SV_DeltaMemoHash( const delta_entity_op_t *op )
+{
+	const byte	*from = (const byte *)op->from;
+	const byte	*to = (const byte *)op->to;
+	uint		hash = 2166136261u; // FNV-1a
+	uint32_t		word;
+	size_t		i;
+
+	// word at a time, tail bytes are still checked by SV_DeltaMemoEqual
+	for( i = 0; i + sizeof( word ) <= sizeof( entity_state_t ); i += sizeof( word ))
+	{
+		memcpy( &word, from + i, sizeof( word ));
+		hash = ( hash ^ word ) * 16777619u;
+		memcpy( &word, to + i, sizeof( word ));
+		hash = ( hash ^ word ) * 16777619u;
+	}
+
+	for( i = 0; i < ARRAYSIZE( op->active ); i++ )
+		hash = ( hash ^ op->active[i] ) * 16777619u;
+
+	hash = ( hash ^ op->baseline ) * 16777619u;
+	hash = ( hash ^ op->delta_type ) * 16777619u;
+	hash = ( hash ^ op->force ) * 16777619u;
+
+	return hash;
+}
+
+/*
+=======================
+SV_DeltaMemoEqual
+
+ops produce the same bits
+=======================
+*/
+static qboolean SV_DeltaMemoEqual( const delta_entity_op_t *a, const delta_entity_op_t *b )
+{
+	if( a->baseline != b->baseline || a->delta_type != b->delta_type || a->force != b->force )
+		return false;
+
+	if( memcmp( a->active, b->active, sizeof( a->active )))
+		return false;
+
+	if( a->from != b->from && memcmp( a->from, b->from, sizeof( entity_state_t )))
+		return false;
 
-	SV_WriteClientdataToMessage( cl, &msg );
-	SV_WriteEntitiesToClient( cl, &msg );
+	return a->to == b->to || !memcmp( a->to, b->to, sizeof( entity_state_t ));
+}
+
+/*
+=======================
+SV_DeltaMemoExpiry
+
+value of svs.next_client_entities when state
+is overwritten, baselines never expire
+=======================
+*/
+static int SV_DeltaMemoExpiry( const entity_state_t *state, int expiry )
+{
+	ptrdiff_t	slot = state - svs.packet_entities;
+	int	age;
+
+	if( slot < 0 || slot >= svs.num_client_entities )
+		return expiry;
+
+	age = svs.next_client_entities - 1 - (int)slot;
+
+	// written before packet_entities counter wrapped
+	if( age < 0 )
+		return 0;
+
+	return Q_min( expiry, svs.next_client_entities + svs.num_client_entities - 1 - age % svs.num_client_entities );
+}
+
+/*
+=======================
+SV_MemoizeSnapshot
+
+finds entity deltas already queued by other clients in this
+frame, new ones are encoded by SV_EncodeDeltaMemo of this snapshot.
+Runs on main thread
+=======================
+*/
+static void SV_MemoizeSnapshot( int index )
+{
+	sv_snapshot_t	*snap = &sv_snap.snapshots[index];
+	sv_deltamemo_t	*entry;
+	int		i, e;
+
+	// nobody to share with
+	if( !sv_deltamemo.value || svs.maxclients <= 1 )
+		return;
+
+	if( !snap->arena_buf )
+	{
+		snap->arena_buf = Z_Malloc( SV_DELTAMEMO_ARENA );
+		MSG_Init( &snap->arena, "DeltaMemo", snap->arena_buf, SV_DELTAMEMO_ARENA );
+	}
+
+	for( i = 0; i < snap->numops; i++ )
+	{
+		const delta_entity_op_t	*op = &snap->ops[i];
+		uint			hash;
+
+		// removes are just few bits
+		if( !op->from || !op->to )
+			continue;
+
+		hash = SV_DeltaMemoHash( op );
+		deltamemo.lookups++;
+
+		for( e = deltamemo.hashtable[hash & ( SV_DELTAMEMO_HASH - 1 )]; e >= 0; e = entry->next )
+		{
+			entry = &deltamemo.entries[e];
+
+			if( entry->hash != hash || svs.next_client_entities > entry->expiry )
+				continue;
+
+			if( SV_DeltaMemoEqual( &entry->op, op ))
+				break;
+		}
+
+		if( e >= 0 )
+		{
+			deltamemo.hits++;
+			snap->memo[i] = e;
+			continue;
+		}
+
+		if( deltamemo.numentries == deltamemo.maxentries )
+		{
+			deltamemo.maxentries = Q_max( deltamemo.maxentries * 2, MAX_VISIBLE_PACKET );
+			deltamemo.entries = Z_Realloc( deltamemo.entries, deltamemo.maxentries * sizeof( *deltamemo.entries ));
+		}
+
+		e = deltamemo.numentries++;
+		entry = &deltamemo.entries[e];
+		entry->hash = hash;
+		entry->next = deltamemo.hashtable[hash & ( SV_DELTAMEMO_HASH - 1 )];
+		entry->op = *op;
+		entry->expiry = SV_DeltaMemoExpiry( op->from, SV_DeltaMemoExpiry( op->to, INT_MAX ));
+		entry->owner = index;
+		entry->ownerop = i;
+		entry->pending = true;
+		entry->bitpos = -1;
+		entry->numbits = 0;
+
+		deltamemo.hashtable[hash & ( SV_DELTAMEMO_HASH - 1 )] = e;
+		snap->memo[i] = e;
+	}
+}
+
+/*
+=======================
+SV_EncodeDeltaMemo
+
+encodes memo entries owned by snapshot into its arena,
+safe to run on worker threads
+=======================
+*/
+static void SV_EncodeDeltaMemo( void *data, int index )
+{
+	sv_snapshot_t	*snap = (sv_snapshot_t *)data + index;
+	sizebuf_t		*arena = &snap->arena;
+	int		i, start;
+
+	for( i = 0; i < snap->numops; i++ )
+	{
+		sv_deltamemo_t	*entry;
+
+		if( snap->memo[i] < 0 )
+			continue;
+
+		entry = &deltamemo.entries[snap->memo[i]];
+
+		// pending is only touched by the owner
+		if( entry->owner != index || entry->ownerop != i || !entry->pending )
+			continue;
+
+		entry->pending = false;
+
+		// starts at byte boundary to be copied with MSG_WriteBits
+		start = ( MSG_GetNumBitsWritten( arena ) + 7 ) & ~7;
+
+		if( MSG_SeekToBit( arena, start, SEEK_SET ) < 0 )
+			continue;
+
+		MSG_WriteDeltaEntityOp( arena, &snap->ops[i], sv.time );
+
+		// arena is full, clients will encode it themselves
+		if( MSG_CheckOverflow( arena ))
+			continue;
+
+		entry->bitpos = start;
+		entry->numbits = MSG_GetNumBitsWritten( arena ) - start;
+	}
+}
+
+/*
+=======================
+SV_WriteSnapshot
+
+writes prepared entity deltas, safe to run on worker threads
+=======================
+*/
+static void SV_WriteSnapshot( void *data, int index )
+{
+	sv_snapshot_t	*snap = (sv_snapshot_t *)data + index;
+	int		i;
+
+	for( i = 0; i < snap->numops; i++ )
+	{
+		const sv_deltamemo_t *entry = NULL;
+
+		if( snap->memo[i] >= 0 )
+			entry = &deltamemo.entries[snap->memo[i]];
+
+		if( entry && entry->bitpos >= 0 )
+		{
+			const sv_snapshot_t *owner = &sv_snap.snapshots[entry->owner];
+
+			if( entry->numbits > 0 )
+				MSG_WriteBits( &snap->msg, owner->arena_buf + ( entry->bitpos >> 3 ), entry->numbits );
+			continue;
+		}
+
+		MSG_WriteDeltaEntityOp( &snap->msg, &snap->ops[i], sv.time );
+	}
+
+	MSG_WriteUBitLong( &snap->msg, LAST_EDICT, MAX_ENTITY_BITS ); // end of packetentities
+
+	if( MSG_CheckOverflow( &snap->trailer ))
+		snap->msg.bOverflow = true;
+	else MSG_WriteBits( &snap->msg, MSG_GetData( &snap->trailer ), MSG_GetNumBitsWritten( &snap->trailer ));
+}
+
+#define SV_MAX_FILEHOLD	1.0	// seconds, downloads never stall longer on saturated link
+
+/*
+=======================
+SV_PriorityBytes
+
+estimated size of packet without voice and file fragments
+=======================
+*/
+static int SV_PriorityBytes( sv_client_t *cl, int unreliable )
+{
+	netchan_t	*chan = &cl->netchan;
+	int	size = HEADER_BYTES + unreliable;
+
+	if( chan->reliable_length )
+		return size + BitByte( chan->reliable_length );
+
+	return size + MSG_GetNumBytesWritten( &chan->message ) + Netchan_NextFragmentSize( chan, FRAG_NORMAL_STREAM );
+}
+
+/*
+=======================
+SV_AppendVoiceData
+
+voice takes bandwidth that's left after snapshot
+and reliable data, otherwise it's dropped
+=======================
+*/
+static int SV_AppendVoiceData( sv_client_t *cl, sizebuf_t *msg, int budget )
+{
+	int	size = MSG_GetNumBytesWritten( &cl->voicedata );
+
+	if( !size )
+		return 0;
+
+	if( size <= budget && size < MSG_GetNumBytesLeft( msg ))
+		MSG_WriteBits( msg, MSG_GetData( &cl->voicedata ), MSG_GetNumBitsWritten( &cl->voicedata ));
+	else size = 0;
+
+	if( !size )
+		cl->bw_voicedrops++;
+
+	MSG_Clear( &cl->voicedata );
+
+	return size;
+}
+
+/*
+=======================
+SV_ScheduleDownloads
+
+holds next file fragment if it doesn't fit
+into bandwidth that's left in this packet
+=======================
+*/
+static void SV_ScheduleDownloads( sv_client_t *cl, int budget )
+{
+	int	size = Netchan_NextFragmentSize( &cl->netchan, FRAG_FILE_STREAM );
+
+	// new fragment can't go out until reliable buffer is acknowledged
+	if( !size || cl->netchan.reliable_length )
+		return;
+
+	if( size <= budget )
+	{
+		cl->bw_filehold = 0.0;
+		return;
+	}
+
+	if( !cl->bw_filehold )
+	{
+		cl->bw_filehold = host.realtime;
+	}
+	else if( host.realtime - cl->bw_filehold > SV_MAX_FILEHOLD )
+	{
+		cl->bw_filehold = 0.0;
+		return;
+	}
+
+	cl->netchan.hold_files = true;
+}
+
+/*
+=======================
+SV_ScheduleExtraData
+
+voice and downloads get what's left after snapshot and reliable data.
+Channel can go into debt as long as it's paid off by the next update,
+so they don't delay it. Returns bytes of voice added to msg
+=======================
+*/
+static int SV_ScheduleExtraData( sv_client_t *cl, sizebuf_t *msg )
+{
+	// next update goes out once realtime + frametime reaches next_messagetime
+	double	nexttime = cl->next_messagetime - sv.frametime;
+	int	budget, voice;
+
+	budget = Netchan_AvailableBytes( &cl->netchan, nexttime ) - SV_PriorityBytes( cl, MSG_GetNumBytesWritten( msg ));
+	voice = SV_AppendVoiceData( cl, msg, budget );
+	SV_ScheduleDownloads( cl, budget - voice );
+
+	return voice;
+}
+
+/*
+=======================
+SV_AccountPacket
+
+splits last sent packet by bandwidth classes
+=======================
+*/
+static void SV_AccountPacket( sv_client_t *cl, int voice )
+{
+	netchan_t	*chan = &cl->netchan;
+	int	bytes[BW_CLASSES];
+	int	i;
+
+	voice = Q_min( voice, chan->sent_unreliable );
+
+	bytes[bw_snapshot] = chan->sent_unreliable - voice;
+	bytes[bw_reliable] = chan->sent_message + chan->sent_frag[FRAG_NORMAL_STREAM];
+	bytes[bw_voice] = voice;
+	bytes[bw_download] = chan->sent_frag[FRAG_FILE_STREAM];
+
+	for( i = 0; i < BW_CLASSES; i++ )
+		cl->bw_bytes[i] += bytes[i];
+
+	if( sv_showbandwidth.value == 1.0f )
+	{
+		Con_Printf( " %s --> snap=%i rel=%i voice=%i dl=%i sz=%i avail=%i\n", cl->name,
+			bytes[bw_snapshot], bytes[bw_reliable], bytes[bw_voice], bytes[bw_download],
+			chan->sent_size, Netchan_AvailableBytes( chan, host.realtime ));
+	}
+
+	if( host.realtime - cl->bw_readouttime < 1.0 )
+		return;
+
+	if( sv_showbandwidth.value == 2.0f )
+	{
+		float	scale = 1.0f / ( host.realtime - cl->bw_readouttime );
+
+		Con_Printf( " %s --> snap=%i rel=%i voice=%i dl=%i bytes/s, %i voice drops\n", cl->name,
+			(int)( cl->bw_bytes[bw_snapshot] * scale ), (int)( cl->bw_bytes[bw_reliable] * scale ),
+			(int)( cl->bw_bytes[bw_voice] * scale ), (int)( cl->bw_bytes[bw_download] * scale ), cl->bw_voicedrops );
+	}
+
+	memset( cl->bw_bytes, 0, sizeof( cl->bw_bytes ));
+	cl->bw_voicedrops = 0;
+	cl->bw_readouttime = host.realtime;
+}
+
+/*
+=======================
+SV_TransmitSnapshot
+=======================
+*/
+static void SV_TransmitSnapshot( sv_snapshot_t *snap )
+{
+	sv_client_t	*cl = snap->cl;
+	sizebuf_t		*msg = &snap->msg;
+	int		voice;
 
 	// copy the accumulated multicast datagram
 	// for this client out to the message
@@ -705,22 +1474,185 @@ static void SV_SendClientDatagram( sv_client_t *cl )
 	}
 	else
 	{
-		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( &msg ))
-			MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
+		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( msg ))
+			MSG_WriteBits( msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
 		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
 	}
 
 	MSG_Clear( &cl->datagram );
 
-	if( MSG_CheckOverflow( &msg ))
+	if( MSG_CheckOverflow( msg ))
 	{
 		// must have room left for the packet header
-		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( &msg ), cl->name );
-		MSG_Clear( &msg );
+		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( msg ), cl->name );
+		MSG_Clear( msg );
 	}
 
+	voice = SV_ScheduleExtraData( cl, msg );
+
 	// send the datagram
-	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( &msg ), MSG_GetData( &msg ));
+	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( msg ), MSG_GetData( msg ));
+	SV_AccountPacket( cl, voice );
+}
+
+/*
+=======================
+SV_SendClientDatagram
+
+with worker threads only queues the snapshot,
+it's sent later by SV_FlushClientDatagrams
+=======================
+*/
+static void SV_SendClientDatagram( sv_client_t *cl )
+{
+	sv_snapshot_t	*snap;
+
+	if( sv_snap.maxsnapshots < svs.maxclients )
+	{
+		sv_snap.snapshots = Z_Realloc( sv_snap.snapshots, svs.maxclients * sizeof( *sv_snap.snapshots ));
+		sv_snap.maxsnapshots = svs.maxclients;
+	}
+
+	if( !sv_snap.workers )
+	{
+		snap = &sv_snap.snapshots[0];
+		SV_BuildClientDatagram( cl, snap );
+		SV_MemoizeSnapshot( 0 );
+		SV_EncodeDeltaMemo( snap, 0 );
+		SV_WriteSnapshot( snap, 0 );
+		SV_TransmitSnapshot( snap );
+		return;
+	}
+
+	snap = &sv_snap.snapshots[sv_snap.numsnapshots++];
+	SV_BuildClientDatagram( cl, snap );
+}
+
+/*
+=======================
+SV_FlushClientDatagrams
+
+write queued snapshots in parallel and send them
+=======================
+*/
+static void SV_FlushClientDatagrams( void )
+{
+	sv_snapshot_t	*snap;
+	int		i;
+
+	if( !sv_snap.numsnapshots )
+		return;
+
+	// clients built after this one could push its delta frame
+	// out of packet_entities, fall back to full update then
+	for( i = 0, snap = sv_snap.snapshots; i < sv_snap.numsnapshots; i++, snap++ )
+	{
+		if( !snap->from || snap->from->first_entity > ( svs.next_client_entities - svs.num_client_entities ))
+			continue;
+
+		MSG_SeekToBit( &snap->msg, snap->header_bit, SEEK_SET );
+		SV_EmitPacketEntities( snap->cl, snap->frame, snap );
+	}
+
+	for( i = 0; i < sv_snap.numsnapshots; i++ )
+		SV_MemoizeSnapshot( i );
+
+	Delta_SetQuiet( sv_snap.workers != NULL );
+	Sys_RunJobs( sv_snap.workers, SV_EncodeDeltaMemo, sv_snap.snapshots, sv_snap.numsnapshots );
+	Sys_RunJobs( sv_snap.workers, SV_WriteSnapshot, sv_snap.snapshots, sv_snap.numsnapshots );
+	Delta_SetQuiet( false );
+
+	for( i = 0, snap = sv_snap.snapshots; i < sv_snap.numsnapshots; i++, snap++ )
+		SV_TransmitSnapshot( snap );
+
+	sv_snap.numsnapshots = 0;
+}
+
+/*
+=======================
+SV_UpdateSnapshotWorkers
+=======================
+*/
+static void SV_UpdateSnapshotWorkers( void )
+{
+	if( !FBitSet( sv_snapshot_threads.flags, FCVAR_CHANGED ))
+		return;
+
+	ClearBits( sv_snapshot_threads.flags, FCVAR_CHANGED );
+
+	Sys_DestroyWorkers( sv_snap.workers );
+	sv_snap.workers = Sys_CreateWorkers( "client snapshots", sv_snapshot_threads.value );
+}
+
+/*
+=======================
+SV_BeginDeltaMemo
+
+forget deltas of previous frame
+=======================
+*/
+static void SV_BeginDeltaMemo( void )
+{
+	int	i;
+
+	memset( deltamemo.hashtable, 0xff, sizeof( deltamemo.hashtable ));
+	deltamemo.numentries = 0;
+	deltamemo.lookups = deltamemo.hits = 0;
+
+	for( i = 0; i < sv_snap.maxsnapshots; i++ )
+	{
+		if( sv_snap.snapshots[i].arena_buf )
+			MSG_Clear( &sv_snap.snapshots[i].arena );
+	}
+}
+
+/*
+=======================
+SV_EndDeltaMemo
+
+=======================
+*/
+static void SV_EndDeltaMemo( void )
+{
+	if( !deltamemo.lookups || !net_showpackets.value || net_showpackets.value == 2.0f )
+		return;
+
+	Con_Printf( " memo --> deltas=%i hits=%i (%i%%) encoded=%i\n", deltamemo.lookups, deltamemo.hits,
+		deltamemo.hits * 100 / deltamemo.lookups, deltamemo.numentries );
+}
+
+/*
+=======================
+SV_FreeSnapshots
+=======================
+*/
+void SV_FreeSnapshots( void )
+{
+	int	i;
+
+	Sys_DestroyWorkers( sv_snap.workers );
+
+	for( i = 0; i < sv_snap.maxsnapshots; i++ )
+	{
+		if( sv_snap.snapshots[i].ops )
+			Z_Free( sv_snap.snapshots[i].ops );
+		if( sv_snap.snapshots[i].memo )
+			Z_Free( sv_snap.snapshots[i].memo );
+		if( sv_snap.snapshots[i].arena_buf )
+			Z_Free( sv_snap.snapshots[i].arena_buf );
+	}
+
+	if( sv_snap.snapshots )
+		Z_Free( sv_snap.snapshots );
+
+	if( deltamemo.entries )
+		Z_Free( deltamemo.entries );
+
+	memset( &sv_snap, 0, sizeof( sv_snap ));
+	memset( &deltamemo, 0, sizeof( deltamemo ));
+
+	// recreate workers on next frame
+	SetBits( sv_snapshot_threads.flags, FCVAR_CHANGED );
 }
 
 /*
@@ -824,6 +1756,14 @@ void SV_SendClientMessages( void )
 		return;
 
 	SV_UpdateToReliableMessages ();
+	SV_UpdateSnapshotWorkers ();
+
+	// all datagrams of this pass go out together
+	NET_BeginSendBatch( NS_SERVER );
+
+	// entities may have moved since last frame
+	viscache.numentries = 0;
+	SV_BeginDeltaMemo();
 
 	// send a message to each connected client
 	for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
@@ -860,6 +1800,7 @@ void SV_SendClientMessages( void )
 		{
 			MSG_Clear( &cl->netchan.message );
 			MSG_Clear( &cl->datagram );
+			MSG_Clear( &cl->voicedata );
 			SV_BroadcastPrintf( NULL, "%s overflowed\n", cl->name );
 			Con_DPrintf( S_ERROR "reliable overflow for %s\n", cl->name );
 			SV_DropClient( cl, false );
@@ -875,6 +1816,9 @@ void SV_SendClientMessages( void )
 				ClearBits( cl->flags, FCL_SEND_NET_MESSAGE );
 		}
 
+		// idle bandwidth can be spent at once on bigger updates
+		cl->netchan.rateburst = Q_max( sv_rateburst.value, 0.0f );
+
 		// only send messages if the client has sent one
 		// and the bandwidth is not choked
 		if( FBitSet( cl->flags, FCL_SEND_NET_MESSAGE ))
@@ -894,13 +1838,23 @@ void SV_SendClientMessages( void )
 
 			// NOTE: we should send frame even if server is not simulated to prevent overflow
 			if( cl->state == cs_spawned )
+			{
 				SV_SendClientDatagram( cl );
-			else Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
+			}
+			else
+			{
+				Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
+				SV_AccountPacket( cl, 0 );
+			}
 		}
 	}
 
 	// reset current client
 	sv.current_client = NULL;
+
+	SV_FlushClientDatagrams();
+	SV_EndDeltaMemo();
+	NET_FlushSendBatch( NS_SERVER );
 }
 
 /*
@@ -970,5 +1924,162 @@ void SV_InactivateClients( void )
 
 		MSG_Clear( &cl->netchan.message );
 		MSG_Clear( &cl->datagram );
+		MSG_Clear( &cl->voicedata );
+	}
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_UPDATE_INTERVAL	0.05
+#define TEST_FRAGMENT_SIZE	592
+
+typedef struct
+{
+	sv_client_t	*cl;
+	sizebuf_t		msg;
+	byte		msg_buf[NET_MAX_MESSAGE];
+	int		voicedrops;
+	int		held;
+	int		choked;
+} test_link_t;
+
+static void Test_InitLink( test_link_t *link, float rate, float rateburst, qboolean download )
+{
+	sv_client_t	*cl = link->cl;
+
+	memset( &cl->netchan, 0, sizeof( cl->netchan ));
+	cl->netchan.remote_address.type = NA_IP;
+	cl->netchan.rate = rate;
+	cl->netchan.rateburst = rateburst;
+	cl->netchan.cleartime = 0.0;
+	MSG_Init( &cl->netchan.message, "NetMessage", cl->netchan.message_buf, sizeof( cl->netchan.message_buf ));
+	MSG_Init( &cl->voicedata, "VoiceData", cl->voicedata_buf, sizeof( cl->voicedata_buf ));
+	cl->bw_filehold = 0.0;
+	cl->bw_voicedrops = 0;
+
+	if( download )
+	{
+		fragbuf_t *buf = Z_Calloc( sizeof( *buf ) + TEST_FRAGMENT_SIZE );
+
+		MSG_Init( &buf->frag_message, "Frag", buf->frag_message_buf, TEST_FRAGMENT_SIZE );
+		MSG_SeekToBit( &buf->frag_message, TEST_FRAGMENT_SIZE << 3, SEEK_SET );
+		cl->netchan.fragbufs[FRAG_FILE_STREAM] = buf;
+	}
+
+	link->voicedrops = link->held = link->choked = 0;
+}
+
+static void Test_FreeLink( test_link_t *link )
+{
+	if( link->cl->netchan.fragbufs[FRAG_FILE_STREAM] )
+		Z_Free( link->cl->netchan.fragbufs[FRAG_FILE_STREAM] );
+	link->cl->netchan.fragbufs[FRAG_FILE_STREAM] = NULL;
+}
+
+// one update: snapshot, voice and whatever file fragment scheduler lets through,
+// channel is charged the same way Netchan_TransmitBits does it
+static void Test_SendUpdate( test_link_t *link, int snapshot, int voice )
+{
+	sv_client_t	*cl = link->cl;
+	netchan_t		*chan = &cl->netchan;
+	byte		zeroes[256] = { 0 };
+	int		sent;
+
+	if( !Netchan_CanPacket( chan, true ))
+	{
+		link->choked++;
+		return;
 	}
+
+	MSG_Init( &link->msg, "Test", link->msg_buf, sizeof( link->msg_buf ));
+	MSG_WriteBytes( &link->msg, zeroes, snapshot );
+	MSG_WriteBytes( &cl->voicedata, zeroes, voice );
+
+	cl->next_messagetime = host.realtime + sv.frametime + TEST_UPDATE_INTERVAL;
+	chan->hold_files = false;
+
+	SV_ScheduleExtraData( cl, &link->msg );
+
+	sent = HEADER_BYTES + MSG_GetNumBytesWritten( &link->msg );
+	if( chan->hold_files )
+		link->held++;
+	else sent += Netchan_NextFragmentSize( chan, FRAG_FILE_STREAM );
+
+	link->voicedrops += cl->bw_voicedrops;
+	cl->bw_voicedrops = 0;
+
+	if( chan->cleartime < host.realtime - chan->rateburst )
+		chan->cleartime = host.realtime - chan->rateburst;
+	chan->cleartime += sent / (double)chan->rate;
+}
+
+static void Test_RunUpdates( test_link_t *link, int count, int snapshot, int voice )
+{
+	int	i;
+
+	for( i = 0; i < count; i++ )
+	{
+		Test_SendUpdate( link, snapshot, voice );
+		host.realtime += TEST_UPDATE_INTERVAL;
+	}
+}
+
+static void Test_ExtraData( void )
+{
+	test_link_t	*link = Z_Calloc( sizeof( *link ));
+	double		oldrealtime = host.realtime;
+
+	link->cl = Z_Calloc( sizeof( *link->cl ));
+	host.realtime = 1000.0;
+
+	// no saved up burst: idle link still has room for voice
+	Test_InitLink( link, 9999.0f, 0.0f, false );
+	Test_RunUpdates( link, 20, 200, 200 );
+	TASSERT_EQi( link->voicedrops, 0 );
+	TASSERT_EQi( link->choked, 0 );
+
+	// fragment fits into each update at higher rate, with and without burst
+	Test_InitLink( link, 25000.0f, 0.0f, true );
+	Test_RunUpdates( link, 20, 300, 0 );
+	TASSERT_EQi( link->held, 0 );
+	TASSERT_EQi( link->choked, 0 );
+	Test_FreeLink( link );
+
+	Test_InitLink( link, 25000.0f, 0.1f, true );
+	Test_RunUpdates( link, 20, 300, 200 );
+	TASSERT_EQi( link->held, 0 );
+	TASSERT_EQi( link->voicedrops, 0 );
+	TASSERT_EQi( link->choked, 0 );
+	Test_FreeLink( link );
+
+	// fragment doesn't fit at low rate, it's held but snapshots keep going
+	Test_InitLink( link, 9999.0f, 0.1f, true );
+	Test_RunUpdates( link, 20, 300, 0 );
+	TASSERT( link->held > 0 );
+	TASSERT_EQi( link->choked, 0 );
+	Test_FreeLink( link );
+
+	// snapshot takes whole allowance, voice is dropped and file is held
+	Test_InitLink( link, 9999.0f, 0.0f, true );
+	link->cl->netchan.cleartime = host.realtime - 0.001;
+	link->cl->next_messagetime = host.realtime + sv.frametime + TEST_UPDATE_INTERVAL;
+	MSG_Init( &link->msg, "Test", link->msg_buf, sizeof( link->msg_buf ));
+	MSG_SeekToBit( &link->msg, 450 << 3, SEEK_SET );
+	MSG_WriteBytes( &link->cl->voicedata, link->msg_buf, 100 );
+	SV_ScheduleExtraData( link->cl, &link->msg );
+	TASSERT_EQi( link->cl->bw_voicedrops, 1 );
+	TASSERT( link->cl->netchan.hold_files );
+	TASSERT( link->cl->bw_filehold == host.realtime );
+	Test_FreeLink( link );
+
+	host.realtime = oldrealtime;
+	Z_Free( link->cl );
+	Z_Free( link );
+}
+
+void Test_RunTransmit( void )
+{
+	TRUN( Test_ExtraData( ));
 }
+#endif // XASH_ENGINE_TESTS
@@ -1330,11 +1330,8 @@ static int GAME_EXPORT pfnModelIndex( const char *m )
 	Q_strncpy( name, m, sizeof( name ));
 	COM_FixSlashes( name );
 
-	for( i = 1; i < MAX_MODELS && sv.model_precache[i][0]; i++ )
-	{
-		if( !Q_stricmp( sv.model_precache[i], name ))
-			return i;
-	}
+	if(( i = SV_FindModelIndex( name )) != 0 )
+		return i;
 
 	Con_Printf( S_ERROR "Cannot get index for model %s: not precached\n", name );
 	return 0;
@@ -2977,6 +2974,12 @@ static void *GAME_EXPORT pfnPvEntPrivateData( edict_t *pEdict )
 }
 
 
+typedef struct str64_hash_s
+{
+	uint hash;
+	uint offset; // from pstringarray, zero is empty slot
+} str64_hash_t;
+
 static struct str64_s
 {
 	size_t maxstringarray;
@@ -2992,8 +2995,126 @@ static struct str64_s
 	size_t numdups;
 	size_t numoverflows;
 	size_t totalalloc;
+
+	// open addressing index of strings between poldstringbase and plast
+	str64_hash_t *hashtable;
+	uint hashsize; // always power of two
+	uint hashcount;
+	size_t numlookups;
+	size_t numprobes;
+	size_t maxprobes;
 } str64;
 
+#if XASH_64BIT
+#define STR64_HASH_MIN_SIZE 4096
+
+/*
+==================
+SV_Str64Hash
+
+case sensitive, as deduplication uses Q_strcmp
+==================
+*/
+static uint SV_Str64Hash( const char *s )
+{
+	uint hash = 2166136261U;
+
+	while( *s )
+	{
+		hash ^= (byte)*s++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+==================
+SV_Str64ClearHash
+
+must be called each time poldstringbase moves
+==================
+*/
+static void SV_Str64ClearHash( void )
+{
+	if( str64.hashtable )
+		memset( str64.hashtable, 0, sizeof( *str64.hashtable ) * str64.hashsize );
+	str64.hashcount = 0;
+}
+
+static void SV_Str64InsertHash( uint hash, uint offset )
+{
+	uint mask = str64.hashsize - 1;
+	uint i;
+
+	for( i = hash & mask; str64.hashtable[i].offset; i = ( i + 1 ) & mask );
+
+	str64.hashtable[i].hash = hash;
+	str64.hashtable[i].offset = offset;
+	str64.hashcount++;
+}
+
+static void SV_Str64GrowHash( void )
+{
+	str64_hash_t *oldtable = str64.hashtable;
+	uint oldsize = str64.hashsize;
+	uint i;
+
+	str64.hashsize = oldsize ? oldsize * 2 : STR64_HASH_MIN_SIZE;
+	str64.hashtable = Mem_Calloc( host.mempool, sizeof( *str64.hashtable ) * str64.hashsize );
+	str64.hashcount = 0;
+
+	if( !oldtable )
+		return;
+
+	for( i = 0; i < oldsize; i++ )
+	{
+		if( oldtable[i].offset )
+			SV_Str64InsertHash( oldtable[i].hash, oldtable[i].offset );
+	}
+
+	Mem_Free( oldtable );
+}
+
+static void SV_Str64AddHash( uint hash, const char *string )
+{
+	// keep load factor under 0.5 so probe sequences stay short
+	if(( str64.hashcount + 1 ) * 2 > str64.hashsize )
+		SV_Str64GrowHash();
+
+	SV_Str64InsertHash( hash, string - str64.pstringarray );
+}
+
+static char *SV_Str64FindHash( uint hash, const char *string )
+{
+	uint mask = str64.hashsize - 1;
+	char *found = NULL;
+	size_t probes = 1;
+	uint i;
+
+	if( !str64.hashsize )
+		return NULL;
+
+	for( i = hash & mask; str64.hashtable[i].offset; i = ( i + 1 ) & mask, probes++ )
+	{
+		char *s = str64.pstringarray + str64.hashtable[i].offset;
+
+		if( str64.hashtable[i].hash == hash && !Q_strcmp( s, string ))
+		{
+			found = s;
+			break;
+		}
+	}
+
+	str64.numlookups++;
+	str64.numprobes += probes;
+	if( str64.maxprobes < probes )
+		str64.maxprobes = probes;
+
+	return found;
+}
+#endif // XASH_64BIT
+
 /*
 ==================
 SV_EmptyStringPool
@@ -3012,6 +3133,7 @@ void SV_EmptyStringPool( qboolean clear_stats )
 	{
 		str64.pstringbase = str64.poldstringbase = str64.pstringarraystatic;
 		str64.plast = str64.pstringbase + 1;
+		SV_Str64ClearHash();
 	}
 
 	if( clear_stats )
@@ -3020,6 +3142,9 @@ void SV_EmptyStringPool( qboolean clear_stats )
 		str64.totalalloc = 0;
 		str64.numdups = 0;
 		str64.numoverflows = 0;
+		str64.numlookups = 0;
+		str64.numprobes = 0;
+		str64.maxprobes = 0;
 	}
 #endif // !XASH_64BIT
 }
@@ -3141,6 +3266,7 @@ static void SV_AllocStringPool( void )
 	str64.pstringarraystatic = (byte*)ptr + str64.maxstringarray;
 	str64.pstringbase = str64.poldstringbase = ptr;
 	str64.plast = (byte*)ptr + 1;
+	SV_Str64ClearHash();
 	svgame.globals->pStringBase = ptr;
 #else // !XASH_64BIT
 	svgame.globals->pStringBase = "";
@@ -3162,6 +3288,11 @@ static void SV_FreeStringPool( void )
 	{
 		Mem_Free( str64.staticstringarray );
 	}
+
+	if( str64.hashtable )
+		Mem_Free( str64.hashtable );
+	str64.hashtable = NULL;
+	str64.hashsize = str64.hashcount = 0;
 #else // !XASH_64BIT
 	Mem_FreePool( &svgame.stringspool );
 #endif // !XASH_64BIT
@@ -3237,6 +3368,9 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 	char *processed_string = Mem_Calloc( svgame.stringspool, len );
 	char *dupe_string = NULL;
 	qboolean found_dupe = false;
+#if XASH_64BIT
+	uint hash = 0;
+#endif // XASH_64BIT
 
 	(void)dupe_string;
 	(void)found_dupe;
@@ -3253,9 +3387,9 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 #if XASH_64BIT
 	if( !str64.allowdup )
 	{
-		for( dupe_string = str64.poldstringbase + 1;
-			dupe_string < str64.plast && ( found_dupe = !Q_strcmp( dupe_string, processed_string ));
-			dupe_string += Q_strlen( dupe_string ) + 1 );
+		hash = SV_Str64Hash( processed_string );
+		dupe_string = SV_Str64FindHash( hash, processed_string );
+		found_dupe = dupe_string != NULL;
 	}
 
 	if( !found_dupe )
@@ -3265,6 +3399,7 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 			str64.plast = str64.pstringbase + 1;
 			str64.poldstringbase = str64.pstringbase;
 			str64.numoverflows++;
+			SV_Str64ClearHash();
 		}
 
 		//MsgDev( D_NOTE, "SV_AllocString: %ld %s\n", str64.plast - svgame.globals->pStringBase, processed_string );
@@ -3273,6 +3408,9 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 
 		dupe_string = str64.plast;
 		str64.plast += len;
+
+		if( !str64.allowdup )
+			SV_Str64AddHash( hash, dupe_string );
 	}
 	else
 	{
@@ -3302,6 +3440,9 @@ void SV_PrintStr64Stats_f( void )
 	Con_Printf( "maximum array usage: %lu\n", str64.maxalloc );
 	Con_Printf( "overflow counter: %lu\n", str64.numoverflows );
 	Con_Printf( "dup string counter: %lu\n", str64.numdups );
+	Con_Printf( "hashed strings: %u (table size %u)\n", str64.hashcount, str64.hashsize );
+	Con_Printf( "hash lookups: %lu, probes: %lu (%.2f average, %lu max)\n", str64.numlookups, str64.numprobes,
+		str64.numlookups ? (double)str64.numprobes / str64.numlookups : 0.0, str64.maxprobes );
 #else // !XASH_64BIT
 	Con_Printf( "Not implemented\n" );
 #endif // !XASH_64BIT
@@ -4322,11 +4463,11 @@ static qboolean Mod_HeadnodeVisible( model_t *mod, mnode_t *node, const byte *vi
 
 /*
 =============
-pfnCheckVisibility
+SV_CheckVisibility
 
 =============
 */
-static int GAME_EXPORT pfnCheckVisibility( const edict_t *ent, byte *pset )
+int SV_CheckVisibility( const edict_t *ent, byte *pset )
 {
 	int	i, leafnum;
 	qboolean large_leafs = FBitSet( sv.worldmodel->flags, MODEL_QBSP2 );
@@ -4388,6 +4529,17 @@ static int GAME_EXPORT pfnCheckVisibility( const edict_t *ent, byte *pset )
 	}
 }
 
+/*
+=============
+pfnCheckVisibility
+
+=============
+*/
+static int GAME_EXPORT pfnCheckVisibility( const edict_t *ent, byte *pset )
+{
+	return SV_VisCacheCheck( ent, pset );
+}
+
 /*
 =============
 pfnCanSkipPlayer
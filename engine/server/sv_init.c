@@ -93,6 +93,62 @@ static void SV_SendSingleResource( const char *name, resourcetype_t type, int in
 	SV_SendResource( pResource, &sv.reliable_datagram );
 }
 
+/*
+================
+SV_FindPrecache
+
+hashed lookup into one of precache tables, returns 0 if name wasn't precached
+================
+*/
+static int SV_FindPrecache( char names[][MAX_QPATH], const word *hash, const word *next, uint size, const char *name )
+{
+	int i;
+
+	for( i = hash[COM_HashKey( name, size )]; i != 0; i = next[i] )
+	{
+		if( !Q_stricmp( names[i], name ))
+			return i;
+	}
+
+	return 0;
+}
+
+/*
+================
+SV_LinkPrecache
+
+link precache slot that was just filled into the hash
+================
+*/
+static void SV_LinkPrecache( char names[][MAX_QPATH], word *hash, word *next, uint size, int index )
+{
+	uint key = COM_HashKey( names[index], size );
+
+	next[index] = hash[key];
+	hash[key] = index;
+}
+
+#define SV_FIND_PRECACHE( type, name ) \
+	SV_FindPrecache( sv.type##_precache, sv.type##_hash, sv.type##_hashnext, ARRAYSIZE( sv.type##_precache ), name )
+
+#define SV_ADD_PRECACHE( type, index, name ) do { \
+	Q_strncpy( sv.type##_precache[index], name, sizeof( sv.type##_precache[index] )); \
+	SV_LinkPrecache( sv.type##_precache, sv.type##_hash, sv.type##_hashnext, ARRAYSIZE( sv.type##_precache ), index ); \
+	sv.type##_precache_count = Q_max( sv.type##_precache_count, index ); \
+} while( 0 )
+
+/*
+================
+SV_FindModelIndex
+
+get index of already precached model
+================
+*/
+int SV_FindModelIndex( const char *name )
+{
+	return SV_FIND_PRECACHE( model, name );
+}
+
 /*
 ================
 SV_ModelIndex
@@ -113,20 +169,19 @@ int SV_ModelIndex( const char *filename )
 	Q_strncpy( name, filename, sizeof( name ));
 	COM_FixSlashes( name );
 
-	for( i = 1; i < MAX_MODELS && sv.model_precache[i][0]; i++ )
-	{
-		if( !Q_stricmp( sv.model_precache[i], name ))
-			return i;
-	}
+	if(( i = SV_FIND_PRECACHE( model, name )) != 0 )
+		return i;
+
+	i = sv.model_precache_count + 1;
 
-	if( i == MAX_MODELS )
+	if( i >= MAX_MODELS )
 	{
 		Host_Error( "MAX_MODELS limit exceeded (%d)\n", MAX_MODELS );
 		return 0;
 	}
 
 	// register new model
-	Q_strncpy( sv.model_precache[i], name, sizeof( sv.model_precache[i] ));
+	SV_ADD_PRECACHE( model, i, name );
 
 	if( sv.state != ss_loading )
 	{
@@ -164,20 +219,19 @@ int GAME_EXPORT SV_SoundIndex( const char *filename )
 	Q_strncpy( name, filename, sizeof( name ));
 	COM_FixSlashes( name );
 
-	for( i = 1; i < MAX_SOUNDS && sv.sound_precache[i][0]; i++ )
-	{
-		if( !Q_stricmp( sv.sound_precache[i], name ))
-			return i;
-	}
+	if(( i = SV_FIND_PRECACHE( sound, name )) != 0 )
+		return i;
 
-	if( i == MAX_SOUNDS )
+	i = sv.sound_precache_count + 1;
+
+	if( i >= MAX_SOUNDS )
 	{
 		Host_Error( "MAX_SOUNDS limit exceeded (%d)\n", MAX_SOUNDS );
 		return 0;
 	}
 
 	// register new sound
-	Q_strncpy( sv.sound_precache[i], name, sizeof( sv.sound_precache[i] ));
+	SV_ADD_PRECACHE( sound, i, name );
 
 	if( sv.state != ss_loading )
 	{
@@ -207,20 +261,19 @@ int SV_EventIndex( const char *filename )
 	Q_strncpy( name, filename, sizeof( name ));
 	COM_FixSlashes( name );
 
-	for( i = 1; i < MAX_EVENTS && sv.event_precache[i][0]; i++ )
-	{
-		if( !Q_stricmp( sv.event_precache[i], name ))
-			return i;
-	}
+	if(( i = SV_FIND_PRECACHE( event, name )) != 0 )
+		return i;
 
-	if( i == MAX_EVENTS )
+	i = sv.event_precache_count + 1;
+
+	if( i >= MAX_EVENTS )
 	{
 		Host_Error( "MAX_EVENTS limit exceeded (%d)\n", MAX_EVENTS );
 		return 0;
 	}
 
 	// register new event
-	Q_strncpy( sv.event_precache[i], name, sizeof( sv.event_precache[i] ));
+	SV_ADD_PRECACHE( event, i, name );
 
 	if( sv.state != ss_loading )
 	{
@@ -249,20 +302,19 @@ int GAME_EXPORT SV_GenericIndex( const char *filename )
 	Q_strncpy( name, filename, sizeof( name ));
 	COM_FixSlashes( name );
 
-	for( i = 1; i < MAX_CUSTOM && sv.files_precache[i][0]; i++ )
-	{
-		if( !Q_stricmp( sv.files_precache[i], name ))
-			return i;
-	}
+	if(( i = SV_FIND_PRECACHE( files, name )) != 0 )
+		return i;
+
+	i = sv.files_precache_count + 1;
 
-	if( i == MAX_CUSTOM )
+	if( i >= MAX_CUSTOM )
 	{
 		Host_Error( "MAX_CUSTOM limit exceeded (%d)\n", MAX_CUSTOM );
 		return 0;
 	}
 
 	// register new generic resource
-	Q_strncpy( sv.files_precache[i], name, sizeof( sv.files_precache[i] ));
+	SV_ADD_PRECACHE( files, i, name );
 
 	if( sv.state != ss_loading )
 	{
@@ -816,12 +868,13 @@ static void SV_SetupClients( void )
 #endif
 
 	svs.clients = Z_Realloc( svs.clients, sizeof( sv_client_t ) * svs.maxclients );
+	SV_ClearClientAddresses();
 	svs.num_client_entities = svs.maxclients * SV_UPDATE_BACKUP * NUM_PACKET_ENTITIES;
 	svs.packet_entities = Z_Realloc( svs.packet_entities, sizeof( entity_state_t ) * svs.num_client_entities );
 	Con_Reportf( "%s alloced by server packet entities\n", Q_memprint( sizeof( entity_state_t ) * svs.num_client_entities ));
 
-	// init network stuff
-	NET_Config(( svs.maxclients > 1 ), true );
+	// init network stuff, replay runs without sockets
+	NET_Config(( svs.maxclients > 1 ) && !SV_Replaying( ), true );
 	svgame.numEntities = svs.maxclients + 1; // clients + world
 	ClearBits( sv_maxclients.flags, FCVAR_CHANGED );
 }
@@ -1008,6 +1061,7 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 	int		i, current_skill;
 	edict_t		*ent;
 	const char	*cycle;
+	double		start;
 
 	SV_SetupClients();
 
@@ -1030,6 +1084,8 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 	for( i = 0; i < ARRAYSIZE( svs.challenge_salt ); i++ )
 		svs.challenge_salt[i] = COM_RandomLong( 0, 0x7FFFFFFE );
 
+	SV_CaptureSpawnServer();
+
 	cycle = Cvar_VariableString( "mapchangecfgfile" );
 
 	if( COM_CheckString( cycle ))
@@ -1109,9 +1165,16 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 		Q_strncpy( sv.startspot, startspot, sizeof( sv.startspot ));
 	else sv.startspot[0] = '\0';
 
-	Q_snprintf( sv.model_precache[WORLD_INDEX], sizeof( sv.model_precache[0] ), "maps/%s.bsp", sv.name );
+	SV_ADD_PRECACHE( model, WORLD_INDEX, va( "maps/%s.bsp", sv.name ));
 	SetBits( sv.model_precache_flags[WORLD_INDEX], RES_FATALIFMISSING );
+	start = Sys_DoubleTime();
 	sv.worldmodel = sv.models[WORLD_INDEX] = Mod_LoadWorld( sv.model_precache[WORLD_INDEX], true );
+
+	if( Sys_CheckParm( "-benchload" ))
+	{
+		Con_Printf( "benchload: server world %.1f ms\n", ( Sys_DoubleTime() - start ) * 1000.0 );
+		FS_PrintPrefetchInfo();
+	}
 	CRC32_MapFile( &sv.worldmapCRC, sv.model_precache[WORLD_INDEX], svs.maxclients > 1 );
 
 	if( FBitSet( host.features, ENGINE_QUAKE_COMPATIBLE ) && FS_FileExists( "progs.dat", false ))
@@ -1124,7 +1187,7 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 
 	for( i = WORLD_INDEX; i < sv.worldmodel->numsubmodels; i++ )
 	{
-		Q_snprintf( sv.model_precache[i+1], sizeof( sv.model_precache[i+1] ), "*%i", i );
+		SV_ADD_PRECACHE( model, i + 1, va( "*%i", i ));
 		sv.models[i+1] = Mod_ForName( sv.model_precache[i+1], false, false );
 		SetBits( sv.model_precache_flags[i+1], RES_FATALIFMISSING );
 	}
@@ -1150,6 +1213,7 @@ qboolean SV_SpawnServer( const char *mapname, const char *startspot, qboolean ba
 
 	// clear physics interaction links
 	SV_ClearWorld();
+	SV_ClearUnlagHistory();
 
 	// pregenerate test packet
 	SV_GenerateTestPacket();
@@ -28,6 +28,7 @@ CVAR_DEFINE_AUTO( sv_unlag, "1", 0, "allow lag compensation on server-side" );
 CVAR_DEFINE_AUTO( sv_maxunlag, "0.5", 0, "max latency value which can be interpolated (by default ping should not exceed 500 units)" );
 CVAR_DEFINE_AUTO( sv_unlagpush, "0.0", 0, "interpolation bias for unlag time" );
 CVAR_DEFINE_AUTO( sv_unlagsamples, "1", 0, "max samples to interpolate" );
+CVAR_DEFINE_AUTO( sv_unlaghistory, "1", 0, "record positions of players and monsters for game-side lag compensation" );
 CVAR_DEFINE_AUTO( rcon_password, "", FCVAR_PROTECTED | FCVAR_PRIVILEGED, "remote connect password" );
 CVAR_DEFINE_AUTO( rcon_enable, "1", FCVAR_PROTECTED, "enable accepting remote commands on server" );
 // TODO: CVAR_DEFINE_AUTO( sv_filterban, "1", 0, "filter banned users" );
@@ -37,12 +38,18 @@ static CVAR_DEFINE_AUTO( sv_contact, "", FCVAR_ARCHIVE|FCVAR_SERVER, "server tec
 CVAR_DEFINE_AUTO( sv_minupdaterate, "25.0", FCVAR_ARCHIVE, "minimal value for 'cl_updaterate' window" );
 CVAR_DEFINE_AUTO( sv_maxupdaterate, "60.0", FCVAR_ARCHIVE, "maximal value for 'cl_updaterate' window" );
 CVAR_DEFINE_AUTO( sv_minrate, "5000", FCVAR_SERVER, "min bandwidth rate allowed on server, 0 == unlimited" );
+CVAR_DEFINE_AUTO( sv_rateburst, "0.1", 0, "seconds of unused client rate that can be sent at once" );
+CVAR_DEFINE_AUTO( sv_showbandwidth, "0", 0, "show client bandwidth by class, 1 - every packet, 2 - every second" );
 CVAR_DEFINE_AUTO( sv_maxrate, "50000", FCVAR_SERVER, "max bandwidth rate allowed on server, 0 == unlimited" );
 // TODO: CVAR_DEFINE_AUTO( sv_logrelay, "0", FCVAR_ARCHIVE, "allow log messages from remote machines to be logged on this server" );
 CVAR_DEFINE_AUTO( sv_newunit, "0", 0, "clear level-saves from previous SP game chapter to help keep .sav file size as minimum" );
 CVAR_DEFINE_AUTO( sv_clienttrace, "1", FCVAR_SERVER, "0 = big box(Quake), 0.5 = halfsize, 1 = normal (100%), otherwise it's a scaling factor" );
 static CVAR_DEFINE_AUTO( sv_timeout, "65", 0, "after this many seconds without a message from a client, the client is dropped" );
 CVAR_DEFINE_AUTO( sv_failuretime, "0.5", 0, "after this long without a packet from client, don't send any more until client starts sending again" );
+CVAR_DEFINE_AUTO( sv_viscache, "1", 0, "share visibility checks between clients with identical PVS, 2 also skips AddToFullPack for entities outside of it" );
+CVAR_DEFINE_AUTO( sv_areaindex, "0", 0, "use dynamic AABB tree for entity traces and trigger touches instead of areanodes" );
+CVAR_DEFINE_AUTO( sv_snapshot_threads, "0", 0, "number of worker threads writing client snapshots, 0 writes them on main thread" );
+CVAR_DEFINE_AUTO( sv_deltamemo, "1", 0, "encode identical entity deltas once per frame and share them between clients" );
 CVAR_DEFINE_AUTO( sv_password, "", FCVAR_SERVER|FCVAR_PROTECTED, "server password for entry into multiplayer games" );
 // TODO: CVAR_DEFINE_AUTO( sv_proxies, "1", FCVAR_SERVER, "maximum count of allowed proxies for HLTV spectating" );
 CVAR_DEFINE_AUTO( sv_send_logos, "1", 0, "send custom decal logo to other players so they can view his too" );
@@ -362,6 +369,152 @@ static void SV_ProcessFile( sv_client_t *cl, const char *filename )
 	if( bError ) Con_Printf( S_ERROR "parsing custom decal from %s\n", cl->name );
 }
 
+/*
+=================
+SV_ClientHashKey
+
+hash only what NET_CompareBaseAdr compares, so
+port changes doesn't require relinking the client
+=================
+*/
+static uint SV_ClientHashKey( const netadr_t *adr, int qport )
+{
+	netadrtype_t type = NET_NetadrType( adr );
+	const byte *data = NULL;
+	uint hash = 5381 + type;
+	size_t i, len = 0;
+
+	if( type == NA_IP )
+	{
+		data = adr->ip;
+		len = sizeof( adr->ip );
+	}
+	else if( type == NA_IP6 )
+	{
+		data = adr->ip6_1;
+		len = sizeof( adr->ip6_1 );
+		hash = ( hash << 5 ) + hash + adr->ip6_0[0];
+		hash = ( hash << 5 ) + hash + adr->ip6_0[1];
+	}
+
+	for( i = 0; i < len; i++ )
+		hash = ( hash << 5 ) + hash + data[i];
+
+	hash = ( hash << 5 ) + hash + ( qport & 0xffff );
+
+	return ( hash ^ ( hash >> 16 )) & ( SV_CLIENT_HASH_SIZE - 1 );
+}
+
+/*
+=================
+SV_UnlinkClientAddress
+
+remove client from address hash, safe to call on unlinked clients
+=================
+*/
+void SV_UnlinkClientAddress( sv_client_t *cl )
+{
+	sv_client_t **prev = &svs.client_hash[cl->hashValue & ( SV_CLIENT_HASH_SIZE - 1 )];
+
+	while( *prev )
+	{
+		if( *prev == cl )
+		{
+			*prev = cl->hashNext;
+			break;
+		}
+
+		prev = &(*prev)->hashNext;
+	}
+
+	cl->hashNext = NULL;
+}
+
+/*
+=================
+SV_LinkClientAddress
+
+must be called every time netchan address or qport is changed
+=================
+*/
+void SV_LinkClientAddress( sv_client_t *cl )
+{
+	SV_UnlinkClientAddress( cl );
+
+	cl->hashValue = SV_ClientHashKey( &cl->netchan.remote_address, cl->netchan.qport );
+	cl->hashNext = svs.client_hash[cl->hashValue];
+	svs.client_hash[cl->hashValue] = cl;
+}
+
+/*
+=================
+SV_ClearClientAddresses
+
+called when clients array is reallocated or freed
+=================
+*/
+void SV_ClearClientAddresses( void )
+{
+	memset( svs.client_hash, 0, sizeof( svs.client_hash ));
+	svs.client_hash_hits = svs.client_hash_misses = 0;
+}
+
+/*
+=================
+SV_FindClientByAddress
+
+find connected client that owns this sequenced packet
+=================
+*/
+static sv_client_t *SV_FindClientByAddress( netadr_t from, int qport )
+{
+	sv_client_t *cl;
+
+	for( cl = svs.client_hash[SV_ClientHashKey( &from, qport )]; cl; cl = cl->hashNext )
+	{
+		if( cl->state == cs_free || FBitSet( cl->flags, FCL_FAKECLIENT ))
+			continue;
+
+		if( cl->netchan.qport != qport )
+			continue;
+
+		if( !NET_CompareBaseAdr( from, cl->netchan.remote_address ))
+			continue;
+
+		svs.client_hash_hits++;
+		return cl;
+	}
+
+	svs.client_hash_misses++;
+	return NULL;
+}
+
+/*
+=================
+SV_ClientAddressStats_f
+=================
+*/
+void SV_ClientAddressStats_f( void )
+{
+	int i, linked = 0, buckets = 0, longest = 0;
+
+	for( i = 0; i < SV_CLIENT_HASH_SIZE; i++ )
+	{
+		sv_client_t *cl;
+		int len = 0;
+
+		for( cl = svs.client_hash[i]; cl; cl = cl->hashNext )
+			len++;
+
+		if( len ) buckets++;
+		linked += len;
+		longest = Q_max( longest, len );
+	}
+
+	Con_Printf( "%i clients linked into %i of %i buckets, longest chain %i\n", linked, buckets, SV_CLIENT_HASH_SIZE, longest );
+	Con_Printf( "%u packet lookups hit, %u missed\n", svs.client_hash_hits, svs.client_hash_misses );
+}
+
 /*
 =================
 SV_ReadPackets
@@ -370,12 +523,13 @@ SV_ReadPackets
 static void SV_ReadPackets( void )
 {
 	sv_client_t	*cl;
-	int		i, qport;
+	int		qport;
 	size_t		curSize;
+	byte		*data;
 
-	while( NET_GetPacket( NS_SERVER, &net_from, net_message_buffer, &curSize ))
+	while( SV_GetPacket( &net_from, net_message_buffer, &data, &curSize ))
 	{
-		MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
+		MSG_Init( &net_message, "ClientPacket", data, curSize );
 
 		// check for connectionless packet (0xffffffff) first
 		if( MSG_GetMaxBytes( &net_message ) >= 4 && *(int *)net_message.pData == -1 )
@@ -392,24 +546,35 @@ static void SV_ReadPackets( void )
 		qport = (int)MSG_ReadShort( &net_message ) & 0xffff;
 
 		// check for packets from connected clients
-		for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
-		{
-			cl = sv.current_client;
+		cl = sv.current_client = SV_FindClientByAddress( net_from, qport );
 
-			if( cl->state == cs_free || FBitSet( cl->flags, FCL_FAKECLIENT ))
-				continue;
+		if( !cl )
+			continue;
 
-			if( !NET_CompareBaseAdr( net_from, cl->netchan.remote_address ))
-				continue;
+		if( cl->netchan.remote_address.port != net_from.port )
+			cl->netchan.remote_address.port = net_from.port;
 
-			if( cl->netchan.qport != qport )
-				continue;
+		if( Netchan_Process( &cl->netchan, &net_message ))
+		{
+			if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
+				SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
 
-			if( cl->netchan.remote_address.port != net_from.port )
-				cl->netchan.remote_address.port = net_from.port;
+			// this is a valid, sequenced packet, so process it
+			if( cl->frames != NULL && cl->state != cs_zombie )
+			{
+				SV_ExecuteClientMessage( cl, &net_message );
+				svgame.globals->frametime = sv.frametime;
+				svgame.globals->time = sv.time;
+			}
+		}
 
-			if( Netchan_Process( &cl->netchan, &net_message ))
+		// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
+		if( Netchan_IncomingReady( &cl->netchan ))
+		{
+			if( Netchan_CopyNormalFragments( &cl->netchan, &net_message, &curSize ))
 			{
+				MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
+
 				if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
 					SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
 
@@ -422,35 +587,11 @@ static void SV_ReadPackets( void )
 				}
 			}
 
-			// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
-			if( Netchan_IncomingReady( &cl->netchan ))
+			if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
 			{
-				if( Netchan_CopyNormalFragments( &cl->netchan, &net_message, &curSize ))
-				{
-					MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
-
-					if(( svs.maxclients == 1 && !host_limitlocal.value ) || ( cl->state != cs_spawned ))
-						SetBits( cl->flags, FCL_SEND_NET_MESSAGE ); // reply at end of frame
-
-					// this is a valid, sequenced packet, so process it
-					if( cl->frames != NULL && cl->state != cs_zombie )
-					{
-						SV_ExecuteClientMessage( cl, &net_message );
-						svgame.globals->frametime = sv.frametime;
-						svgame.globals->time = sv.time;
-					}
-				}
-
-				if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
-				{
-					SV_ProcessFile( cl, cl->netchan.incomingfilename );
-				}
+				SV_ProcessFile( cl, cl->netchan.incomingfilename );
 			}
-			break;
 		}
-
-		if( i != svs.maxclients )
-			continue;
 	}
 
 	sv.current_client = NULL;
@@ -492,6 +633,7 @@ static void SV_CheckTimeouts( void )
 		// FIXME: get rid of the zombie state
 		if( cl->state == cs_zombie )
 		{
+			SV_UnlinkClientAddress( cl );
 			cl->state = cs_free; // can now be reused
 			continue;
 		}
@@ -502,6 +644,7 @@ static void SV_CheckTimeouts( void )
 			{
 				SV_BroadcastPrintf( NULL, "%s timed out\n", cl->name );
 				SV_DropClient( cl, false );
+				SV_UnlinkClientAddress( cl );
 				cl->state = cs_free; // don't bother with zombie state
 			}
 		}
@@ -594,6 +737,7 @@ static qboolean SV_RunGameFrame( void )
 
 			sv.time_residual -= fps;
 			sv.time += fps;
+			SV_RecordUnlagHistory();
 			numFrames++;
 		}
 
@@ -603,6 +747,7 @@ static qboolean SV_RunGameFrame( void )
 	{
 		SV_Physics();
 		sv.time += sv.frametime;
+		SV_RecordUnlagHistory();
 		return true;
 	}
 }
@@ -665,6 +810,9 @@ void Host_ServerFrame( void )
 		sv.frametime = host.frametime;
 	svgame.globals->frametime = sv.frametime;
 
+	// record frame times before packets for replay
+	SV_CaptureFrame ();
+
 	// check clients timewindow
 	SV_CheckCmdTimes ();
 
@@ -864,6 +1012,8 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_maxupdaterate );
 	Cvar_RegisterVariable( &sv_minrate );
 	Cvar_RegisterVariable( &sv_maxrate );
+	Cvar_RegisterVariable( &sv_rateburst );
+	Cvar_RegisterVariable( &sv_showbandwidth );
 	Cvar_RegisterVariable( &sv_cheats );
 	Cvar_RegisterVariable( &sv_airmove );
 	Cvar_RegisterVariable( &sv_fps );
@@ -903,10 +1053,15 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_check_errors );
 	Cvar_RegisterVariable( &public_server );
 	Cvar_RegisterVariable( &sv_failuretime );
+	Cvar_RegisterVariable( &sv_snapshot_threads );
+	Cvar_RegisterVariable( &sv_deltamemo );
+	Cvar_RegisterVariable( &sv_viscache );
+	Cvar_RegisterVariable( &sv_areaindex );
 	Cvar_RegisterVariable( &sv_unlag );
 	Cvar_RegisterVariable( &sv_maxunlag );
 	Cvar_RegisterVariable( &sv_unlagpush );
 	Cvar_RegisterVariable( &sv_unlagsamples );
+	Cvar_RegisterVariable( &sv_unlaghistory );
 	Cvar_RegisterVariable( &sv_allow_upload );
 	Cvar_RegisterVariable( &sv_allow_download );
 	Cvar_RegisterVariable( &sv_allow_dlfile );
@@ -1052,6 +1207,10 @@ static void SV_FreeClients( void )
 			svs.clients = NULL;
 		}
 
+		SV_ClearClientAddresses();
+		SV_FreeSnapshots();
+		SV_FreeVisCache();
+
 		if( svs.packet_entities )
 		{
 			Z_Free( svs.packet_entities );
@@ -1072,6 +1231,9 @@ before Sys_Quit or Sys_Error
 */
 void SV_Shutdown( const char *finalmsg )
 {
+	// capture may be started before the map
+	SV_StopCapture();
+
 	// already freed
 	if( !SV_Initialized( ))
 	{
@@ -1110,6 +1272,12 @@ void SV_Shutdown( const char *finalmsg )
 	// release test packet blob
 	SV_FreeTestPacket();
 
+	// release entity spatial index
+	SV_FreeAreaIndex();
+
+	// release lag compensation history
+	SV_ClearUnlagHistory();
+
 	// release all models
 	Mod_FreeAll();
 
@@ -1817,6 +1817,9 @@ void SV_Physics( void )
 
 	SV_CheckAllEnts ();
 
+	// build or drop spatial index if sv_areaindex was changed
+	SV_UpdateAreaIndex();
+
 	svgame.globals->time = sv.time;
 
 	// let the progs know that a new frame has started
@@ -2039,6 +2042,14 @@ static trace_t GAME_EXPORT SV_MoveNormal( const vec3_t start, vec3_t mins, vec3_
 	return SV_Move( start, mins, maxs, end, type, e, false );
 }
 
+static void GAME_EXPORT SV_MoveManyNormal( const float *starts, const float *ends, int count, float *mins, float *maxs, int type, edict_t *e, trace_t *traces )
+{
+	if( count <= 0 || !starts || !ends || !traces )
+		return;
+
+	SV_MoveMany( starts, ends, count, mins ? mins : vec3_origin, maxs ? maxs : vec3_origin, type, e, false, traces );
+}
+
 /*
 =============
 pfnWriteBytes
@@ -2124,7 +2135,11 @@ static server_physics_api_t gPhysicsAPI =
 	COM_SaveFile,
 	pfnLoadImagePixels,
 	pfnGetModelName,
-	Sys_GetNativeObject
+	Sys_GetNativeObject,
+	SV_MoveManyNormal,
+	SV_GetUnlagTime,
+	SV_RewindEdicts,
+	SV_RestoreEdicts,
 };
 
 /*
@@ -2137,13 +2152,22 @@ Initialize server external physics
 qboolean SV_InitPhysicsAPI( void )
 {
 	static PHYSICAPI	pPhysIface;
+	int		version = SV_PHYSICS_INTERFACE_VERSION;
 
 	pPhysIface = (PHYSICAPI)COM_GetProcAddress( svgame.hInstance, "Server_GetPhysicsInterface" );
 	if( pPhysIface )
 	{
-		if( pPhysIface( SV_PHYSICS_INTERFACE_VERSION, &gPhysicsAPI, &svgame.physFuncs ))
+		// game dlls usually accept only the version they were built with,
+		// older ones don't know about slots appended after it
+		if( !pPhysIface( version, &gPhysicsAPI, &svgame.physFuncs ))
+		{
+			memset( &svgame.physFuncs, 0, sizeof( svgame.physFuncs ));
+			version = SV_PHYSICS_INTERFACE_VERSION_OLD;
+		}
+
+		if( version == SV_PHYSICS_INTERFACE_VERSION || pPhysIface( version, &gPhysicsAPI, &svgame.physFuncs ))
 		{
-			Con_Reportf( "%s: ^2initailized extended PhysicAPI ^7ver. %i\n", __func__, SV_PHYSICS_INTERFACE_VERSION );
+			Con_Reportf( "%s: ^2initailized extended PhysicAPI ^7ver. %i\n", __func__, version );
 
 			if( svgame.physFuncs.SV_CheckFeatures != NULL )
 			{
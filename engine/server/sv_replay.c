@@ -0,0 +1,518 @@
+/*
+sv_replay.c - incoming packet capture and offline replay
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+
+#define CAPTURE_IDENT	(('C'<<24)+('V'<<16)+('S'<<8)+'X') // little-endian "XSVC"
+#define CAPTURE_VERSION	1
+#define CAPTURE_BUFSIZE	0x10000	// flushed to disk when full
+#define CAPTURE_MAPNAME	64	// MAX_QPATH depends on build, keep file format fixed
+
+// record types
+#define CAPREC_SPAWN	1	// capspawn_t, server spawned a map
+#define CAPREC_FRAME	2	// capframe_t, start of server frame
+#define CAPREC_PACKET	3	// netadr_t, word length, packet data
+
+typedef struct capheader_s
+{
+	int		ident;
+	int		version;
+	int		adrsize;		// sizeof( netadr_t ) of the build that wrote it
+} capheader_t;
+
+// everything replay has to restore so recorded
+// challenges and spawn commands stay valid
+typedef struct capspawn_s
+{
+	char		mapname[CAPTURE_MAPNAME];
+	int		maxclients;
+	int		spawncount;
+	uint32_t		salt[16];
+} capspawn_t;
+
+typedef struct capframe_s
+{
+	double		realtime;
+	double		frametime;
+} capframe_t;
+
+STATIC_ASSERT( sizeof( ((capspawn_t *)0)->salt ) == sizeof( svs.challenge_salt ), "capture salt size mismatch" );
+
+static struct
+{
+	file_t		*file;
+	char		filename[MAX_OSPATH];
+	byte		buffer[CAPTURE_BUFSIZE];
+	int		cursize;
+	int		numframes;
+	int		numpackets;
+	fs_offset_t	written;
+} capture;
+
+static struct
+{
+	byte		*data;
+	fs_offset_t	size;
+	fs_offset_t	cursor;		// next record
+	fs_offset_t	spawnofs;		// next record to search for spawn info
+	int		numpackets;
+} replay;
+
+/*
+=============
+SV_CaptureFlush
+
+=============
+*/
+static void SV_CaptureFlush( void )
+{
+	if( !capture.file || !capture.cursize )
+		return;
+
+	if( FS_Write( capture.file, capture.buffer, capture.cursize ) != capture.cursize )
+		Con_Printf( S_ERROR "%s: write to %s failed\n", __func__, capture.filename );
+
+	capture.written += capture.cursize;
+	capture.cursize = 0;
+}
+
+static void SV_CaptureWrite( const void *data, int size )
+{
+	if( capture.cursize + size > sizeof( capture.buffer ))
+		SV_CaptureFlush();
+
+	memcpy( capture.buffer + capture.cursize, data, size );
+	capture.cursize += size;
+}
+
+static void SV_CaptureRecord( int type, const void *data, int size )
+{
+	byte	b = type;
+
+	SV_CaptureWrite( &b, sizeof( b ));
+	SV_CaptureWrite( data, size );
+}
+
+/*
+=============
+SV_CaptureSpawn
+
+=============
+*/
+static void SV_CaptureSpawn( void )
+{
+	capspawn_t	spawn;
+
+	memset( &spawn, 0, sizeof( spawn ));
+	Q_strncpy( spawn.mapname, sv.name, sizeof( spawn.mapname ));
+	spawn.maxclients = svs.maxclients;
+	spawn.spawncount = svs.spawncount;
+	memcpy( spawn.salt, svs.challenge_salt, sizeof( spawn.salt ));
+
+	SV_CaptureRecord( CAPREC_SPAWN, &spawn, sizeof( spawn ));
+}
+
+/*
+=============
+SV_CaptureFrame
+
+called at the start of every server frame,
+replay will use exactly the same times
+=============
+*/
+void SV_CaptureFrame( void )
+{
+	capframe_t	frame;
+
+	if( !capture.file )
+		return;
+
+	frame.realtime = host.realtime;
+	frame.frametime = host.frametime;
+
+	SV_CaptureRecord( CAPREC_FRAME, &frame, sizeof( frame ));
+	capture.numframes++;
+}
+
+static void SV_CapturePacket( const netadr_t *from, const byte *data, size_t length )
+{
+	word	len;
+
+	// can't arrive through UDP anyway
+	if( length > 0xffff )
+		return;
+
+	len = length;
+	SV_CaptureRecord( CAPREC_PACKET, from, sizeof( *from ));
+	SV_CaptureWrite( &len, sizeof( len ));
+	SV_CaptureWrite( data, len );
+	capture.numpackets++;
+}
+
+/*
+=============
+SV_StopCapture
+
+=============
+*/
+void SV_StopCapture( void )
+{
+	if( !capture.file )
+		return;
+
+	SV_CaptureFlush();
+	FS_Close( capture.file );
+
+	Con_Printf( "capture %s stopped: %i frames, %i packets, %s\n", capture.filename,
+		capture.numframes, capture.numpackets, Q_memprint( capture.written ));
+
+	capture.file = NULL;
+}
+
+/*
+=============
+SV_Capture_f
+
+sv_capture <filename>
+=============
+*/
+void SV_Capture_f( void )
+{
+	capheader_t	header;
+	int		i;
+
+	if( Cmd_Argc() != 2 )
+	{
+		Con_Printf( S_USAGE "sv_capture <filename>\n" );
+		return;
+	}
+
+	if( replay.data )
+	{
+		Con_Printf( "sv_capture: can't capture while replaying\n" );
+		return;
+	}
+
+	SV_StopCapture();
+
+	Q_strncpy( capture.filename, Cmd_Argv( 1 ), sizeof( capture.filename ));
+	COM_DefaultExtension( capture.filename, ".svc", sizeof( capture.filename ));
+
+	capture.file = FS_Open( capture.filename, "wb", true );
+
+	if( !capture.file )
+	{
+		Con_Printf( S_ERROR "sv_capture: couldn't open %s\n", capture.filename );
+		return;
+	}
+
+	capture.cursize = 0;
+	capture.numframes = capture.numpackets = 0;
+	capture.written = 0;
+
+	header.ident = CAPTURE_IDENT;
+	header.version = CAPTURE_VERSION;
+	header.adrsize = sizeof( netadr_t );
+	SV_CaptureWrite( &header, sizeof( header ));
+
+	if( SV_Active( ))
+	{
+		SV_CaptureSpawn();
+
+		for( i = 0; i < svs.maxclients; i++ )
+		{
+			if( svs.clients[i].state >= cs_connected && !FBitSet( svs.clients[i].flags, FCL_FAKECLIENT ))
+			{
+				Con_Printf( S_WARN "sv_capture: clients already connected won't be replayed, start capture before map\n" );
+				break;
+			}
+		}
+	}
+
+	Con_Printf( "capturing incoming packets to %s\n", capture.filename );
+}
+
+/*
+=============
+SV_StopCapture_f
+
+=============
+*/
+void SV_StopCapture_f( void )
+{
+	if( !capture.file )
+	{
+		Con_Printf( "sv_stopcapture: not capturing\n" );
+		return;
+	}
+
+	SV_StopCapture();
+}
+
+/*
+=============
+SV_ReplayRecordSize
+
+size of record at given offset including type byte,
+zero if it's truncated or unknown
+=============
+*/
+static int SV_ReplayRecordSize( fs_offset_t ofs )
+{
+	fs_offset_t	left = replay.size - ofs;
+	word		len;
+
+	if( left < 1 )
+		return 0;
+
+	switch( replay.data[ofs] )
+	{
+	case CAPREC_SPAWN:
+		return left >= 1 + sizeof( capspawn_t ) ? 1 + sizeof( capspawn_t ) : 0;
+	case CAPREC_FRAME:
+		return left >= 1 + sizeof( capframe_t ) ? 1 + sizeof( capframe_t ) : 0;
+	case CAPREC_PACKET:
+		if( left < 1 + sizeof( netadr_t ) + sizeof( len ))
+			return 0;
+		memcpy( &len, replay.data + ofs + 1 + sizeof( netadr_t ), sizeof( len ));
+		if( len > NET_MAX_MESSAGE || left < 1 + sizeof( netadr_t ) + sizeof( len ) + len )
+			return 0;
+		return 1 + sizeof( netadr_t ) + sizeof( len ) + len;
+	}
+
+	return 0;
+}
+
+/*
+=============
+SV_CaptureSpawnServer
+
+called from SV_SpawnServer, records salt and spawncount
+or restores them on replay so captured challenges and
+spawn commands still match
+=============
+*/
+void SV_CaptureSpawnServer( void )
+{
+	capspawn_t	spawn;
+	int		size;
+
+	if( capture.file )
+	{
+		SV_CaptureSpawn();
+		return;
+	}
+
+	if( !replay.data )
+		return;
+
+	for( ; ( size = SV_ReplayRecordSize( replay.spawnofs )) != 0; replay.spawnofs += size )
+	{
+		if( replay.data[replay.spawnofs] != CAPREC_SPAWN )
+			continue;
+
+		memcpy( &spawn, replay.data + replay.spawnofs + 1, sizeof( spawn ));
+		replay.spawnofs += size;
+
+		if( Q_stricmp( spawn.mapname, sv.name ))
+			Con_Printf( S_WARN "replay: spawned %s, but %s was recorded\n", sv.name, spawn.mapname );
+
+		svs.spawncount = spawn.spawncount;
+		memcpy( svs.challenge_salt, spawn.salt, sizeof( svs.challenge_salt ));
+		return;
+	}
+
+	Con_Printf( S_WARN "replay: no recorded spawn for %s\n", sv.name );
+}
+
+/*
+=============
+SV_GetPacket
+
+reads next client packet either from network or
+from replay, *data is valid until the next call
+=============
+*/
+qboolean SV_GetPacket( netadr_t *from, byte *buffer, byte **data, size_t *length )
+{
+	if( replay.data )
+	{
+		int	size;
+		word	len;
+
+		while(( size = SV_ReplayRecordSize( replay.cursor )) != 0 )
+		{
+			const byte	*rec = replay.data + replay.cursor;
+
+			// packets of the next frame
+			if( rec[0] == CAPREC_FRAME )
+				return false;
+
+			replay.cursor += size;
+
+			if( rec[0] != CAPREC_PACKET )
+				continue;
+
+			memcpy( from, rec + 1, sizeof( *from ));
+			memcpy( &len, rec + 1 + sizeof( *from ), sizeof( len ));
+
+			// netchan decodes packets in place, don't let it touch replay data
+			memcpy( buffer, rec + 1 + sizeof( *from ) + sizeof( len ), len );
+			*data = buffer;
+			*length = len;
+			replay.numpackets++;
+			return true;
+		}
+
+		return false;
+	}
+
+	if( !NET_GetPacketNoCopy( NS_SERVER, from, buffer, data, length ))
+		return false;
+
+	if( capture.file )
+		SV_CapturePacket( from, *data, *length );
+
+	return true;
+}
+
+/*
+=============
+SV_Replaying
+
+=============
+*/
+qboolean SV_Replaying( void )
+{
+	return replay.data != NULL;
+}
+
+static int SV_CompareFrameTimes( const void *a, const void *b )
+{
+	double	t1 = *(const double *)a;
+	double	t2 = *(const double *)b;
+
+	return ( t1 > t2 ) - ( t1 < t2 );
+}
+
+static double SV_Percentile( const double *times, int count, int percent )
+{
+	return times[( count - 1 ) * percent / 100] * 1000.0;
+}
+
+/*
+=============
+SV_RunReplay
+
+runs captured traffic through the server at full speed
+without sockets and prints frame time statistics.
+Never returns
+=============
+*/
+void SV_RunReplay( const char *filename )
+{
+	capheader_t	header;
+	capspawn_t	spawn;
+	capframe_t	frame;
+	double		*times, start, total = 0.0;
+	int		size, numframes = 0, count = 0;
+	fs_offset_t	ofs;
+
+	replay.data = FS_LoadFile( filename, &replay.size, false );
+
+	if( !replay.data || replay.size < sizeof( header ))
+		Sys_Error( "replay: couldn't load %s\n", filename );
+
+	memcpy( &header, replay.data, sizeof( header ));
+
+	if( header.ident != CAPTURE_IDENT || header.version != CAPTURE_VERSION || header.adrsize != sizeof( netadr_t ))
+		Sys_Error( "replay: %s is not a capture or has wrong version\n", filename );
+
+	// validate everything and count frames before starting
+	for( ofs = sizeof( header ); ( size = SV_ReplayRecordSize( ofs )) != 0; ofs += size )
+	{
+		if( replay.data[ofs] == CAPREC_FRAME )
+			numframes++;
+	}
+
+	if( ofs != replay.size )
+		Con_Printf( S_WARN "replay: %s is truncated at %s\n", filename, Q_memprint( ofs ));
+
+	replay.size = ofs;
+	replay.cursor = replay.spawnofs = sizeof( header );
+
+	if( SV_ReplayRecordSize( replay.cursor ) == 0 || replay.data[replay.cursor] != CAPREC_SPAWN || !numframes )
+		Sys_Error( "replay: %s has no recorded map\n", filename );
+
+	memcpy( &spawn, replay.data + replay.cursor + 1, sizeof( spawn ));
+	spawn.mapname[sizeof( spawn.mapname ) - 1] = 0;
+
+	Con_Printf( "replaying %s: map %s, %i players, %i frames\n", filename, spawn.mapname, spawn.maxclients, numframes );
+
+	// replies go nowhere, see SV_InitGame
+	Cvar_FullSet( "maxplayers", va( "%d", spawn.maxclients ), FCVAR_LATCH );
+	Cvar_DirectSet( &public_server, "0" );
+	Cbuf_AddTextf( "map %s\n", spawn.mapname );
+	Cbuf_Execute();
+
+	if( !SV_Active( ))
+		Sys_Error( "replay: couldn't start map %s\n", spawn.mapname );
+
+	times = Mem_Malloc( host.mempool, sizeof( *times ) * numframes );
+	start = Sys_DoubleTime();
+
+	while(( size = SV_ReplayRecordSize( replay.cursor )) != 0 )
+	{
+		const byte	*rec = replay.data + replay.cursor;
+		double		t1;
+
+		replay.cursor += size;
+
+		// spawns are picked up by SV_CaptureSpawnServer
+		if( rec[0] != CAPREC_FRAME )
+			continue;
+
+		memcpy( &frame, rec + 1, sizeof( frame ));
+		host.realtime = frame.realtime;
+		host.frametime = frame.frametime;
+
+		// map changes and commands from game, same as Host_Frame
+		Cbuf_Execute();
+
+		t1 = Sys_DoubleTime();
+		Host_ServerFrame();
+		times[count] = Sys_DoubleTime() - t1;
+		total += times[count];
+		count++;
+	}
+
+	if( count )
+	{
+		qsort( times, count, sizeof( *times ), SV_CompareFrameTimes );
+
+		Con_Printf( "replay result: %i frames, %i packets in %.3f seconds, %.3f seconds in server frames\n",
+			count, replay.numpackets, Sys_DoubleTime() - start, total );
+		Con_Printf( "frame time ms: min %.3f, mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+			times[0] * 1000.0, total * 1000.0 / count, SV_Percentile( times, count, 50 ),
+			SV_Percentile( times, count, 90 ), SV_Percentile( times, count, 99 ), times[count - 1] * 1000.0 );
+	}
+
+	Mem_Free( times );
+	Mem_Free( replay.data );
+	memset( &replay, 0, sizeof( replay ));
+
+	Sys_Quit( "replay finished" );
+}
@@ -0,0 +1,389 @@
+/*
+sv_unlag.c - edict history for server-side lag compensation
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+
+#define SV_HISTORY_SAMPLES	64	// must be power of two, one sample per server frame
+#define SV_HISTORY_MASK	( SV_HISTORY_SAMPLES - 1 )
+#define SV_HISTORY_TELEPORT	64.0f	// never interpolate across bigger jumps
+
+// everything that affects hitboxes
+typedef struct sv_hitstate_s
+{
+	vec3_t		origin;
+	vec3_t		angles;
+	vec3_t		mins;
+	vec3_t		maxs;
+	int		sequence;
+	int		gaitsequence;
+	float		frame;
+	float		animtime;
+	byte		controller[4];
+	byte		blending[2];
+	qboolean		nointerp;		// don't interpolate from previous sample
+} sv_hitstate_t;
+
+typedef struct sv_history_s
+{
+	int		serialnumber;	// history is dropped when edict is reused
+	int		head;		// next sample to write
+	int		count;
+	double		times[SV_HISTORY_SAMPLES];
+	sv_hitstate_t	samples[SV_HISTORY_SAMPLES];
+
+	qboolean		rewound;
+	sv_hitstate_t	saved;		// current state while rewound
+} sv_history_t;
+
+static struct
+{
+	poolhandle_t	mempool;
+	sv_history_t	**histories;	// per edict, allocated on first sample
+	int		maxedicts;
+	edict_t		**rewound;
+	int		numrewound;
+} unlag;
+
+static void SV_SaveHitState( const edict_t *ent, sv_hitstate_t *st )
+{
+	VectorCopy( ent->v.origin, st->origin );
+	VectorCopy( ent->v.angles, st->angles );
+	VectorCopy( ent->v.mins, st->mins );
+	VectorCopy( ent->v.maxs, st->maxs );
+	st->sequence = ent->v.sequence;
+	st->gaitsequence = ent->v.gaitsequence;
+	st->frame = ent->v.frame;
+	st->animtime = ent->v.animtime;
+	memcpy( st->controller, ent->v.controller, sizeof( st->controller ));
+	memcpy( st->blending, ent->v.blending, sizeof( st->blending ));
+	st->nointerp = FBitSet( ent->v.effects, EF_NOINTERP ) ? true : false;
+}
+
+static void SV_LoadHitState( edict_t *ent, const sv_hitstate_t *st )
+{
+	VectorCopy( st->origin, ent->v.origin );
+	VectorCopy( st->angles, ent->v.angles );
+	VectorCopy( st->mins, ent->v.mins );
+	VectorCopy( st->maxs, ent->v.maxs );
+	VectorSubtract( st->maxs, st->mins, ent->v.size );
+	ent->v.sequence = st->sequence;
+	ent->v.gaitsequence = st->gaitsequence;
+	ent->v.frame = st->frame;
+	ent->v.animtime = st->animtime;
+	memcpy( ent->v.controller, st->controller, sizeof( st->controller ));
+	memcpy( ent->v.blending, st->blending, sizeof( st->blending ));
+}
+
+static float SV_LerpAngle( float from, float to, float frac )
+{
+	float	delta = to - from;
+
+	if( delta > 180.0f )
+		delta -= 360.0f;
+	else if( delta < -180.0f )
+		delta += 360.0f;
+
+	return from + delta * frac;
+}
+
+/*
+=============
+SV_LerpHitState
+
+frac 0 gives older sample, animation keys are
+taken from the nearest one
+=============
+*/
+static void SV_LerpHitState( const sv_hitstate_t *from, const sv_hitstate_t *to, float frac, sv_hitstate_t *out )
+{
+	const sv_hitstate_t	*nearest = ( frac < 0.5f ) ? from : to;
+	int		i;
+
+	*out = *nearest;
+
+	for( i = 0; i < 3; i++ )
+	{
+		out->origin[i] = from->origin[i] + ( to->origin[i] - from->origin[i] ) * frac;
+		out->angles[i] = SV_LerpAngle( from->angles[i], to->angles[i], frac );
+	}
+
+	// frames wrap around on looped sequences
+	if( from->sequence == to->sequence && to->frame >= from->frame )
+		out->frame = from->frame + ( to->frame - from->frame ) * frac;
+
+	out->animtime = from->animtime + ( to->animtime - from->animtime ) * frac;
+}
+
+static qboolean SV_UnlagTeleported( const sv_hitstate_t *from, const sv_hitstate_t *to )
+{
+	int	i;
+
+	if( to->nointerp )
+		return true;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( fabs( to->origin[i] - from->origin[i] ) > SV_HISTORY_TELEPORT )
+			return true;
+	}
+
+	return false;
+}
+
+static qboolean SV_ShouldRecordHistory( const edict_t *ent )
+{
+	if( !SV_IsValidEdict( ent ) || !ent->v.modelindex )
+		return false;
+
+	if( ent->v.solid == SOLID_NOT || ent->v.solid == SOLID_TRIGGER )
+		return false;
+
+	// only things that can be shot
+	return FBitSet( ent->v.flags, FL_CLIENT|FL_FAKECLIENT|FL_MONSTER ) ? true : false;
+}
+
+/*
+=============
+SV_RecordUnlagHistory
+
+called once per server frame after physics
+=============
+*/
+void SV_RecordUnlagHistory( void )
+{
+	int	i;
+
+	// game forgot to restore, don't record rewound positions
+	if( unlag.numrewound )
+		SV_RestoreEdicts();
+
+	if( !sv_unlaghistory.value || svs.maxclients <= 1 )
+		return;
+
+	if( !unlag.mempool )
+	{
+		unlag.mempool = Mem_AllocPool( "Unlag History" );
+		unlag.maxedicts = GI->max_edicts;
+		unlag.histories = Mem_Calloc( unlag.mempool, sizeof( *unlag.histories ) * unlag.maxedicts );
+		unlag.rewound = Mem_Calloc( unlag.mempool, sizeof( *unlag.rewound ) * unlag.maxedicts );
+	}
+
+	for( i = 1; i < svgame.numEntities && i < unlag.maxedicts; i++ )
+	{
+		edict_t		*ent = EDICT_NUM( i );
+		sv_history_t	*hist = unlag.histories[i];
+
+		if( !SV_ShouldRecordHistory( ent ))
+		{
+			if( hist ) hist->count = 0;
+			continue;
+		}
+
+		if( !hist )
+			hist = unlag.histories[i] = Mem_Calloc( unlag.mempool, sizeof( *hist ));
+
+		if( hist->serialnumber != ent->serialnumber )
+		{
+			hist->serialnumber = ent->serialnumber;
+			hist->count = 0;
+		}
+
+		hist->times[hist->head] = sv.time;
+		SV_SaveHitState( ent, &hist->samples[hist->head] );
+		hist->head = ( hist->head + 1 ) & SV_HISTORY_MASK;
+		hist->count = Q_min( hist->count + 1, SV_HISTORY_SAMPLES );
+	}
+}
+
+/*
+=============
+SV_GetUnlagTime
+
+server time that client saw when it issued current command,
+same math as player move interpolation
+=============
+*/
+double SV_GetUnlagTime( const edict_t *client )
+{
+	sv_client_t	*cl = SV_ClientFromEdict( client, true );
+	float		latency, lerp_msec;
+	double		time;
+
+	if( !cl || svs.maxclients <= 1 || !sv_unlag.value )
+		return sv.time;
+
+	if( !FBitSet( cl->flags, FCL_LAG_COMPENSATION ) || !svgame.dllFuncs.pfnAllowLagCompensation( ))
+		return sv.time;
+
+	latency = Q_min( cl->latency, 1.5f );
+
+	if( sv_maxunlag.value > 0.0f )
+		latency = Q_min( latency, sv_maxunlag.value );
+
+	lerp_msec = cl->lastcmd.lerp_msec * 0.001f;
+	if( lerp_msec > 0.1f ) lerp_msec = 0.1f;
+
+	if( lerp_msec < cl->cl_updaterate )
+		lerp_msec = cl->cl_updaterate;
+
+	time = sv.time - latency - lerp_msec + sv_unlagpush.value;
+
+	return Q_min( time, sv.time );
+}
+
+/*
+=============
+SV_RewindEdict
+
+=============
+*/
+static qboolean SV_RewindEdict( edict_t *ent, double time )
+{
+	const sv_hitstate_t	*from, *to;
+	sv_hitstate_t	state;
+	sv_history_t	*hist;
+	int		i, newest, slot;
+	float		frac = 0.0f;
+
+	if( !SV_IsValidEdict( ent ))
+		return false;
+
+	i = NUM_FOR_EDICT( ent );
+
+	if( i >= unlag.maxedicts || !( hist = unlag.histories[i] ) || !hist->count )
+		return false;
+
+	if( hist->rewound || hist->serialnumber != ent->serialnumber )
+		return false;
+
+	newest = ( hist->head - 1 ) & SV_HISTORY_MASK;
+
+	// edict is already there
+	if( time >= hist->times[newest] )
+		return false;
+
+	// walk back to the first sample that isn't newer than requested time
+	for( i = 0; i < hist->count; i++ )
+	{
+		slot = ( newest - i ) & SV_HISTORY_MASK;
+
+		if( hist->times[slot] <= time )
+			break;
+	}
+
+	if( i == hist->count )
+	{
+		// older than whole history, use the oldest sample
+		slot = ( newest - hist->count + 1 ) & SV_HISTORY_MASK;
+		from = to = &hist->samples[slot];
+	}
+	else
+	{
+		int	next = ( slot + 1 ) & SV_HISTORY_MASK;
+		double	span = hist->times[next] - hist->times[slot];
+
+		from = &hist->samples[slot];
+		to = &hist->samples[next];
+
+		if( span > 0.0 && !SV_UnlagTeleported( from, to ))
+			frac = bound( 0.0f, ( time - hist->times[slot] ) / span, 1.0f );
+	}
+
+	SV_LerpHitState( from, to, frac, &state );
+
+	SV_SaveHitState( ent, &hist->saved );
+	SV_LoadHitState( ent, &state );
+	SV_RelinkEdictArea( ent );
+
+	hist->rewound = true;
+	unlag.rewound[unlag.numrewound++] = ent;
+
+	return true;
+}
+
+/*
+=============
+SV_RewindEdicts
+
+moves edicts to where they were at given server time,
+NULL list rewinds every edict with history.
+Returns number of moved edicts
+=============
+*/
+int SV_RewindEdicts( edict_t **edicts, int count, double time )
+{
+	int	i, moved = 0;
+
+	if( !unlag.mempool )
+		return 0;
+
+	if( !edicts )
+	{
+		for( i = 1; i < svgame.numEntities && i < unlag.maxedicts; i++ )
+		{
+			if( unlag.histories[i] && SV_RewindEdict( EDICT_NUM( i ), time ))
+				moved++;
+		}
+		return moved;
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		if( SV_RewindEdict( edicts[i], time ))
+			moved++;
+	}
+
+	return moved;
+}
+
+/*
+=============
+SV_RestoreEdicts
+
+puts all rewound edicts back
+=============
+*/
+void SV_RestoreEdicts( void )
+{
+	while( unlag.numrewound > 0 )
+	{
+		edict_t		*ent = unlag.rewound[--unlag.numrewound];
+		sv_history_t	*hist = unlag.histories[NUM_FOR_EDICT( ent )];
+
+		hist->rewound = false;
+
+		// removed while rewound
+		if( !SV_IsValidEdict( ent ) || hist->serialnumber != ent->serialnumber )
+			continue;
+
+		SV_LoadHitState( ent, &hist->saved );
+		SV_RelinkEdictArea( ent );
+	}
+}
+
+/*
+=============
+SV_ClearUnlagHistory
+
+=============
+*/
+void SV_ClearUnlagHistory( void )
+{
+	if( unlag.mempool )
+		Mem_FreePool( &unlag.mempool );
+
+	memset( &unlag, 0, sizeof( unlag ));
+}
@@ -32,6 +32,8 @@ typedef struct moveclip_s
 	qboolean		monsterclip;
 } moveclip_t;
 
+#define SV_MOVE_BATCH	32	// moves clipped together by SV_MoveMany
+
 /*
 ===============================================================================
 
@@ -412,6 +414,286 @@ static int	iTouchLinkSemaphore = 0;	// prevent recursion when SV_TouchLinks is a
 areanode_t	sv_areanodes[AREA_NODES];
 static int	sv_numareanodes;
 
+/*
+===============================================================================
+
+DYNAMIC AREA INDEX
+
+optional AABB trees that mirror areanode lists. Areanodes are
+still maintained because game dlls can walk them via pfnGetHeadnode
+and pmove collects visents from them
+===============================================================================
+*/
+#define AREA_SOLID		0
+#define AREA_TRIGGERS	1
+#define AREA_PORTALS	2
+#define AREA_TREES		3
+
+typedef struct sv_areaproxy_s
+{
+	int		leaf;	// WORLDTREE_NULL if edict isn't in index
+	int		tree;
+} sv_areaproxy_t;
+
+static struct
+{
+	qboolean		active;
+	worldtree_t	trees[AREA_TREES];
+	sv_areaproxy_t	*proxies;
+	int		maxproxies;
+
+	// query results shared by index and SV_AreaGather
+	void		**scratch;
+	int		maxscratch;
+	int		numscratch;
+} areaindex;
+
+static int SV_AreaTreeForEdict( const edict_t *ent )
+{
+	if( ent->v.solid == SOLID_TRIGGER )
+		return AREA_TRIGGERS;
+	if( ent->v.solid == SOLID_PORTAL )
+		return AREA_PORTALS;
+	return AREA_SOLID;
+}
+
+/*
+===============
+SV_AreaIndexRemove
+
+===============
+*/
+static void SV_AreaIndexRemove( edict_t *ent )
+{
+	sv_areaproxy_t	*proxy;
+
+	if( !areaindex.active )
+		return;
+
+	proxy = &areaindex.proxies[NUM_FOR_EDICT( ent )];
+
+	if( proxy->leaf == WORLDTREE_NULL )
+		return;
+
+	World_TreeRemove( &areaindex.trees[proxy->tree], proxy->leaf );
+	proxy->leaf = WORLDTREE_NULL;
+}
+
+/*
+===============
+SV_AreaIndexLink
+
+updates proxy after edict was linked into areanodes
+===============
+*/
+static void SV_AreaIndexLink( edict_t *ent )
+{
+	sv_areaproxy_t	*proxy;
+	int		tree;
+
+	if( !areaindex.active )
+		return;
+
+	proxy = &areaindex.proxies[NUM_FOR_EDICT( ent )];
+	tree = SV_AreaTreeForEdict( ent );
+
+	if( proxy->leaf != WORLDTREE_NULL )
+	{
+		if( proxy->tree == tree )
+		{
+			World_TreeMove( &areaindex.trees[tree], proxy->leaf, ent->v.absmin, ent->v.absmax );
+			return;
+		}
+
+		World_TreeRemove( &areaindex.trees[proxy->tree], proxy->leaf );
+	}
+
+	proxy->leaf = World_TreeInsert( &areaindex.trees[tree], ent->v.absmin, ent->v.absmax, ent );
+	proxy->tree = tree;
+}
+
+/*
+===============
+SV_AreaIndexQuery
+
+collects edicts touching the box, returns NULL if index
+can't be used and caller have to walk the areanodes instead
+===============
+*/
+static void **SV_AreaIndexQuery( int tree, const vec3_t mins, const vec3_t maxs, int *count )
+{
+	void	**list;
+	int	num;
+
+	if( !areaindex.active )
+		return NULL;
+
+	list = areaindex.scratch + areaindex.numscratch;
+	num = World_TreeQuery( &areaindex.trees[tree], mins, maxs, list, areaindex.maxscratch - areaindex.numscratch );
+
+	if( num < 0 )
+		return NULL;
+
+	areaindex.numscratch += num;
+	*count = num;
+
+	return list;
+}
+
+static void SV_AreaIndexRelease( int count )
+{
+	areaindex.numscratch -= count;
+}
+
+static qboolean SV_AreaNodeGather( areanode_t *node, int tree, const vec3_t mins, const vec3_t maxs, void **list, int maxlist, int *count )
+{
+	link_t	*head, *l;
+
+	if( tree == AREA_TRIGGERS )
+		head = &node->trigger_edicts;
+	else if( tree == AREA_PORTALS )
+		head = &node->portal_edicts;
+	else head = &node->solid_edicts;
+
+	for( l = head->next; l != head; l = l->next )
+	{
+		if( *count == maxlist )
+			return false;
+
+		list[(*count)++] = EDICT_FROM_AREA( l );
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return true;
+
+	if( maxs[node->axis] > node->dist && !SV_AreaNodeGather( node->children[0], tree, mins, maxs, list, maxlist, count ))
+		return false;
+	if( mins[node->axis] < node->dist && !SV_AreaNodeGather( node->children[1], tree, mins, maxs, list, maxlist, count ))
+		return false;
+
+	return true;
+}
+
+/*
+===============
+SV_AreaGather
+
+same as SV_AreaIndexQuery but walks the areanodes
+when index is disabled, result is a superset
+of edicts touching the box
+===============
+*/
+static void **SV_AreaGather( int tree, const vec3_t mins, const vec3_t maxs, int *count )
+{
+	void	**list;
+	int	num = 0;
+
+	if( areaindex.active )
+		return SV_AreaIndexQuery( tree, mins, maxs, count );
+
+	if( !areaindex.scratch )
+		return NULL;
+
+	list = areaindex.scratch + areaindex.numscratch;
+
+	if( !SV_AreaNodeGather( sv_areanodes, tree, mins, maxs, list, areaindex.maxscratch - areaindex.numscratch, &num ))
+		return NULL;
+
+	areaindex.numscratch += num;
+	*count = num;
+
+	return list;
+}
+
+/*
+===============
+SV_DropAreaIndex
+
+===============
+*/
+static void SV_DropAreaIndex( void )
+{
+	int	i;
+
+	for( i = 0; i < AREA_TREES; i++ )
+		World_TreeFree( &areaindex.trees[i] );
+
+	if( areaindex.proxies )
+		Z_Free( areaindex.proxies );
+
+	areaindex.proxies = NULL;
+	areaindex.maxproxies = 0;
+	areaindex.active = false;
+}
+
+/*
+===============
+SV_FreeAreaIndex
+
+===============
+*/
+void SV_FreeAreaIndex( void )
+{
+	SV_DropAreaIndex();
+
+	if( areaindex.scratch )
+		Z_Free( areaindex.scratch );
+
+	memset( &areaindex, 0, sizeof( areaindex ));
+}
+
+/*
+===============
+SV_BuildAreaIndex
+
+inserts all edicts that already linked into areanodes
+===============
+*/
+static void SV_BuildAreaIndex( void )
+{
+	int	i;
+
+	SV_DropAreaIndex();
+
+	areaindex.maxproxies = GI->max_edicts;
+	areaindex.proxies = Z_Malloc( sizeof( *areaindex.proxies ) * areaindex.maxproxies );
+
+	for( i = 0; i < areaindex.maxproxies; i++ )
+		areaindex.proxies[i].leaf = WORLDTREE_NULL;
+
+	for( i = 0; i < AREA_TREES; i++ )
+		World_TreeInit( &areaindex.trees[i], host.mempool );
+
+	areaindex.active = true;
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		edict_t	*ent = EDICT_NUM( i );
+
+		if( ent->area.prev && SV_IsValidEdict( ent ))
+			SV_AreaIndexLink( ent );
+	}
+}
+
+/*
+===============
+SV_UpdateAreaIndex
+
+called between frames when no queries are running
+===============
+*/
+void SV_UpdateAreaIndex( void )
+{
+	qboolean	wanted = sv_areaindex.value != 0.0f && sv.worldmodel != NULL;
+
+	if( wanted == areaindex.active )
+		return;
+
+	if( wanted )
+		SV_BuildAreaIndex();
+	else SV_DropAreaIndex();
+}
+
 /*
 ===============
 SV_CreateAreaNode
@@ -480,6 +762,17 @@ void SV_ClearWorld( void )
 	iTouchLinkSemaphore = 0;
 	sv_numareanodes = 0;
 
+	// rebuilt by SV_UpdateAreaIndex on next frame
+	SV_DropAreaIndex();
+
+	// query results, nested queries (touch functions doing traces) are stacked on top
+	if( !areaindex.scratch )
+	{
+		areaindex.maxscratch = GI->max_edicts * 2;
+		areaindex.scratch = Z_Malloc( sizeof( *areaindex.scratch ) * areaindex.maxscratch );
+	}
+	areaindex.numscratch = 0;
+
 	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
 }
 
@@ -496,6 +789,8 @@ void SV_UnlinkEdict( edict_t *ent )
 	RemoveLink( &ent->area );
 	ent->area.prev = NULL;
 	ent->area.next = NULL;
+
+	SV_AreaIndexRemove( ent );
 }
 
 /*
@@ -503,78 +798,81 @@ void SV_UnlinkEdict( edict_t *ent )
 SV_TouchLinks
 ====================
 */
-static void SV_TouchLinks( edict_t *ent, areanode_t *node )
+static void SV_TouchEdict( edict_t *ent, edict_t *touch )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
 	hull_t	*hull;
 	vec3_t	test, offset;
 	model_t	*mod;
 
-	// touch linked edicts
-	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
+	if( svgame.physFuncs.SV_TriggerTouch != NULL )
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA( l );
+		// user dll can override trigger checking (Xash3D extension)
+		if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
+			return;
+	}
+	else
+	{
+		if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
+			return;
 
-		if( svgame.physFuncs.SV_TriggerTouch != NULL )
-		{
-			// user dll can override trigger checking (Xash3D extension)
-			if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
-				continue;
-		}
-		else
+		if( touch->v.groupinfo && ent->v.groupinfo )
 		{
-			if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
-				continue;
+			if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+				return;
 
-			if( touch->v.groupinfo && ent->v.groupinfo )
-			{
-				if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
+			if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+				return;
+		}
 
-				if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
-			}
+		if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
+			return;
 
-			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
-				continue;
+		mod = SV_ModelHandle( touch->v.modelindex );
 
-			mod = SV_ModelHandle( touch->v.modelindex );
+		// check brush triggers accuracy
+		if( mod && mod->type == mod_brush )
+		{
+			// force to select bsp-hull
+			hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
 
-			// check brush triggers accuracy
-			if( mod && mod->type == mod_brush )
+			// support for rotational triggers
+			if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
 			{
-				// force to select bsp-hull
-				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
-
-				// support for rotational triggers
-				if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-				{
-					matrix4x4	matrix;
-					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
-				}
-				else
-				{
-					// offset the test point appropriately for this hull.
-					VectorSubtract( ent->v.origin, offset, test );
-				}
-
-				// test hull for intersection with this model
-				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
-					continue;
+				matrix4x4	matrix;
+				Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+				Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
+			}
+			else
+			{
+				// offset the test point appropriately for this hull.
+				VectorSubtract( ent->v.origin, offset, test );
 			}
-		}
 
-		// never touch the triggers when "playersonly" is active
-		if( !sv.playersonly )
-		{
-			svgame.globals->time = sv.time;
-			svgame.dllFuncs.pfnTouch( touch, ent );
+			// test hull for intersection with this model
+			if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
+				return;
 		}
 	}
 
+	// never touch the triggers when "playersonly" is active
+	if( !sv.playersonly )
+	{
+		svgame.globals->time = sv.time;
+		svgame.dllFuncs.pfnTouch( touch, ent );
+	}
+}
+
+static void SV_TouchLinks( edict_t *ent, areanode_t *node )
+{
+	link_t	*l, *next;
+
+	// touch linked edicts
+	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
+	{
+		next = l->next;
+		SV_TouchEdict( ent, EDICT_FROM_AREA( l ));
+	}
+
 	// recurse down both sides
 	if( node->axis == -1 ) return;
 
@@ -584,6 +882,38 @@ static void SV_TouchLinks( edict_t *ent, areanode_t *node )
 		SV_TouchLinks( ent, node->children[1] );
 }
 
+/*
+====================
+SV_TouchTriggers
+====================
+*/
+static void SV_TouchTriggers( edict_t *ent )
+{
+	void	**list;
+	int	i, count;
+
+	list = SV_AreaIndexQuery( AREA_TRIGGERS, ent->v.absmin, ent->v.absmax, &count );
+
+	if( !list )
+	{
+		SV_TouchLinks( ent, sv_areanodes );
+		return;
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		edict_t	*touch = list[i];
+
+		// touch functions may remove or unlink the rest of triggers
+		if( touch->free || !touch->area.prev )
+			continue;
+
+		SV_TouchEdict( ent, touch );
+	}
+
+	SV_AreaIndexRelease( count );
+}
+
 /*
 ===============
 SV_FindTouchedLeafs
@@ -632,6 +962,73 @@ static void SV_FindTouchedLeafs( edict_t *ent, model_t *mod, mnode_t *node, int
 		SV_FindTouchedLeafs( ent, mod, node_child( node, 1, mod ), headnode );
 }
 
+/*
+===============
+SV_LinkArea
+
+returns false for bodies that are not linked at all
+===============
+*/
+static qboolean SV_LinkArea( edict_t *ent )
+{
+	areanode_t	*node;
+
+	// ignore non-solid bodies
+	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+	{
+		SV_AreaIndexRemove( ent );
+		return false;
+	}
+
+	// find the first node that the ent's box crosses
+	node = sv_areanodes;
+
+	while( 1 )
+	{
+		if( node->axis == -1 ) break;
+		if( ent->v.absmin[node->axis] > node->dist )
+			node = node->children[0];
+		else if( ent->v.absmax[node->axis] < node->dist )
+			node = node->children[1];
+		else break; // crosses the node
+	}
+
+	// link it in
+	if( ent->v.solid == SOLID_TRIGGER )
+		InsertLinkBefore( &ent->area, &node->trigger_edicts );
+	else if( ent->v.solid == SOLID_PORTAL )
+		InsertLinkBefore( &ent->area, &node->portal_edicts );
+	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+
+	SV_AreaIndexLink( ent );
+
+	return true;
+}
+
+/*
+===============
+SV_RelinkEdictArea
+
+moves edict in areanodes and area index only, PVS leafs
+and triggers are left alone. Used to move edicts back
+and forth in time for lag compensation
+===============
+*/
+void SV_RelinkEdictArea( edict_t *ent )
+{
+	if( ent->area.prev )
+	{
+		RemoveLink( &ent->area );
+		ent->area.prev = ent->area.next = NULL;
+	}
+
+	if( ent == svgame.edicts || !SV_IsValidEdict( ent ))
+		return;
+
+	svgame.dllFuncs.pfnSetAbsBox( ent );
+	SV_LinkArea( ent );
+}
+
 /*
 ===============
 SV_LinkEdict
@@ -639,12 +1036,23 @@ SV_LinkEdict
 */
 void GAME_EXPORT SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
 {
-	areanode_t	*node;
 	int		headnode;
 
-	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
+	// unlink from old position, index proxy is moved after linking
+	if( ent->area.prev )
+	{
+		RemoveLink( &ent->area );
+		ent->area.prev = ent->area.next = NULL;
+	}
+
 	if( ent == svgame.edicts ) return;		// don't add the world
-	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+
+	if( !SV_IsValidEdict( ent ))
+	{
+		// never add freed ents
+		SV_AreaIndexRemove( ent );
+		return;
+	}
 
 	// set the abs box
 	svgame.dllFuncs.pfnSetAbsBox( ent );
@@ -673,34 +1081,13 @@ void GAME_EXPORT SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
 		}
 	}
 
-	// ignore non-solid bodies
-	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+	if( !SV_LinkArea( ent ))
 		return;
 
-	// find the first node that the ent's box crosses
-	node = sv_areanodes;
-
-	while( 1 )
-	{
-		if( node->axis == -1 ) break;
-		if( ent->v.absmin[node->axis] > node->dist )
-			node = node->children[0];
-		else if( ent->v.absmax[node->axis] < node->dist )
-			node = node->children[1];
-		else break; // crosses the node
-	}
-
-	// link it in
-	if( ent->v.solid == SOLID_TRIGGER )
-		InsertLinkBefore( &ent->area, &node->trigger_edicts );
-	else if( ent->v.solid == SOLID_PORTAL )
-		InsertLinkBefore( &ent->area, &node->portal_edicts );
-	else InsertLinkBefore( &ent->area, &node->solid_edicts );
-
 	if( touch_triggers && !iTouchLinkSemaphore )
 	{
 		iTouchLinkSemaphore = true;
-		SV_TouchLinks( ent, sv_areanodes );
+		SV_TouchTriggers( ent );
 		iTouchLinkSemaphore = false;
 	}
 }
@@ -712,64 +1099,67 @@ POINT TESTING IN HULLS
 
 ===============================================================================
 */
-static void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+static void SV_WaterEdict( const vec3_t origin, int *pCont, edict_t *touch )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
 	hull_t	*hull;
 	vec3_t	test, offset;
 	model_t	*mod;
 
-	// get water edicts
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	if( touch->v.solid != SOLID_NOT ) // disabled ?
+		return;
+
+	if( touch->v.groupinfo )
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA( l );
+		if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, svs.groupmask ))
+			return;
 
-		if( touch->v.solid != SOLID_NOT ) // disabled ?
-			continue;
+		if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, svs.groupmask ))
+			return;
+	}
 
-		if( touch->v.groupinfo )
-		{
-			if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, svs.groupmask ))
-				continue;
+	mod = SV_ModelHandle( touch->v.modelindex );
 
-			if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, svs.groupmask ))
-				continue;
-		}
+	// only brushes can have special contents
+	if( !mod || mod->type != mod_brush )
+		return;
 
-		mod = SV_ModelHandle( touch->v.modelindex );
+	if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
+		return;
 
-		// only brushes can have special contents
-		if( !mod || mod->type != mod_brush )
-			continue;
+	// check water brushes accuracy
+	hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
 
-		if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
-			continue;
+	// support for rotational water
+	if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+	{
+		matrix4x4	matrix;
+		Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+		Matrix4x4_VectorITransform( matrix, origin, test );
+	}
+	else
+	{
+		// offset the test point appropriately for this hull.
+		VectorSubtract( origin, offset, test );
+	}
 
-		// check water brushes accuracy
-		hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
+	// test hull for intersection with this model
+	if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
+		return;
 
-		// support for rotational water
-		if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-		{
-			matrix4x4	matrix;
-			Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-			Matrix4x4_VectorITransform( matrix, origin, test );
-		}
-		else
-		{
-			// offset the test point appropriately for this hull.
-			VectorSubtract( origin, offset, test );
-		}
+	// compare contents ranking
+	if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
+		*pCont = touch->v.skin; // new content has more priority
+}
 
-		// test hull for intersection with this model
-		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
-			continue;
+static void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+{
+	link_t	*l, *next;
 
-		// compare contents ranking
-		if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
-			*pCont = touch->v.skin; // new content has more priority
+	// get water edicts
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+		SV_WaterEdict( origin, pCont, EDICT_FROM_AREA( l ));
 	}
 
 	// recurse down both sides
@@ -789,7 +1179,8 @@ SV_TruePointContents
 */
 int SV_TruePointContents( const vec3_t p )
 {
-	int	cont;
+	void	**list;
+	int	cont, i, count;
 
 	// sanity check
 	if( !p ) return CONTENTS_NONE;
@@ -798,7 +1189,13 @@ int SV_TruePointContents( const vec3_t p )
 	cont = PM_HullPointContents( &sv.worldmodel->hulls[0], 0, p );
 
 	// check all water entities
-	SV_WaterLinks( p, &cont, sv_areanodes );
+	if(( list = SV_AreaIndexQuery( AREA_SOLID, p, p, &count )) != NULL )
+	{
+		for( i = 0; i < count; i++ )
+			SV_WaterEdict( p, &cont, list[i] );
+		SV_AreaIndexRelease( count );
+	}
+	else SV_WaterLinks( p, &cont, sv_areanodes );
 
 	return cont;
 }
@@ -1098,27 +1495,27 @@ void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, v
 
 /*
 ====================
-SV_ClipToEntity
+SV_ClipFilterEntity
 
-generic clip function
+checks that doesn't depend on move start and end,
+returns false if entity is never clipped by this move
 ====================
 */
-static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
+static qboolean SV_ClipFilterEntity( edict_t *touch, moveclip_t *clip )
 {
-	trace_t	trace;
 	model_t	*mod;
 
 	if( touch->v.groupinfo && SV_IsValidEdict( clip->passedict ) && clip->passedict->v.groupinfo != 0 )
 	{
 		if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, clip->passedict->v.groupinfo ))
-			return true;
+			return false;
 
 		if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, clip->passedict->v.groupinfo ))
-			return true;
+			return false;
 	}
 
 	if( touch == clip->passedict || touch->v.solid == SOLID_NOT )
-		return true;
+		return false;
 
 	if( touch->v.solid == SOLID_TRIGGER )
 		Host_Error( "trigger in clipping list\n" );
@@ -1127,7 +1524,7 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 	if( svgame.dllFuncs2.pfnShouldCollide )
 	{
 		if( !svgame.dllFuncs2.pfnShouldCollide( touch, clip->passedict ))
-			return true;
+			return false;
 	}
 
 	// monsterclip filter (solid custom is a static or dynamic bodies)
@@ -1135,13 +1532,13 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 	{
 		// func_monsterclip works only with monsters that have same flag!
 		if( FBitSet( touch->v.flags, FL_MONSTERCLIP ) && !clip->monsterclip )
-			return true;
+			return false;
 	}
 	else
 	{
 		// ignore all monsters but pushables
 		if( clip->type == MOVE_NOMONSTERS && touch->v.movetype != MOVETYPE_PUSHSTEP )
-			return true;
+			return false;
 	}
 
 	mod = SV_ModelHandle( touch->v.modelindex );
@@ -1150,16 +1547,9 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 	{
 		// we ignore brushes with rendermode != kRenderNormal and without FL_WORLDBRUSH set
 		if( touch->v.rendermode != kRenderNormal && !FBitSet( touch->v.flags, FL_WORLDBRUSH ))
-			return true;
+			return false;
 	}
 
-	if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
-		return true;
-
-	// aditional check to intersects clients with sphere
-	if( touch->v.solid != SOLID_SLIDEBOX && !SV_CheckSphereIntersection( touch, clip->start, clip->end ))
-		return true;
-
 	// Xash3D extension
 	if( SV_IsValidEdict( clip->passedict ) && clip->passedict->v.solid == SOLID_TRIGGER )
 	{
@@ -1167,24 +1557,46 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 		// and total trace returns fail (old half-life bug)
 		// items touch should be done in SV_TouchLinks not here
 		if( FBitSet( touch->v.flags, FL_CLIENT|FL_FAKECLIENT ))
-			return true;
+			return false;
 	}
 
 	// g-cont. make sure what size is really zero - check all the components
 	if( SV_IsValidEdict( clip->passedict ) && !VectorIsNull( clip->passedict->v.size ) && VectorIsNull( touch->v.size ))
-		return true; // points never interact
-
-	// might intersect, so do an exact clip
-	if( clip->trace.allsolid ) return false;
+		return false; // points never interact
 
 	if( SV_IsValidEdict( clip->passedict ))
 	{
 	 	if( touch->v.owner == clip->passedict )
-			return true; // don't clip against own missiles
+			return false; // don't clip against own missiles
 		if( clip->passedict->v.owner == touch )
-			return true; // don't clip against owner
+			return false; // don't clip against owner
 	}
 
+	return true;
+}
+
+/*
+====================
+SV_ClipToFilteredEntity
+
+clip entity that passed SV_ClipFilterEntity,
+returns false if trace is allsolid
+====================
+*/
+static qboolean SV_ClipToFilteredEntity( edict_t *touch, moveclip_t *clip )
+{
+	trace_t	trace;
+
+	if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+		return true;
+
+	// aditional check to intersects clients with sphere
+	if( touch->v.solid != SOLID_SLIDEBOX && !SV_CheckSphereIntersection( touch, clip->start, clip->end ))
+		return true;
+
+	// might intersect, so do an exact clip
+	if( clip->trace.allsolid ) return false;
+
 	// make sure we don't hit the world if we're inside the portal
 	if( touch->v.solid == SOLID_PORTAL )
 		SV_PortalCSG( touch, clip->mins, clip->maxs, clip->start, clip->end, &clip->trace );
@@ -1200,6 +1612,21 @@ static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
 	return true;
 }
 
+/*
+====================
+SV_ClipToEntity
+
+generic clip function
+====================
+*/
+static qboolean SV_ClipToEntity( edict_t *touch, moveclip_t *clip )
+{
+	if( !SV_ClipFilterEntity( touch, clip ))
+		return true;
+
+	return SV_ClipToFilteredEntity( touch, clip );
+}
+
 /*
 ====================
 SV_ClipToLinks
@@ -1271,29 +1698,35 @@ SV_ClipToWorldBrush
 Mins and maxs enclose the entire area swept by the move
 ====================
 */
-static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+static qboolean SV_ClipToWorldBrushEdict( edict_t *touch, moveclip_t *clip )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
 	trace_t	trace;
 
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
-	{
-		next = l->next;
+	if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
+		return true;
 
-		touch = EDICT_FROM_AREA( l );
+	if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+		return true;
 
-		if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
-			continue;
+	if( clip->trace.allsolid ) return false;
 
-		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
-			continue;
+	SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+
+	clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
 
-		if( clip->trace.allsolid ) return;
+	return true;
+}
+
+static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
 
-		SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
 
-		clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+		if( !SV_ClipToWorldBrushEdict( EDICT_FROM_AREA( l ), clip ))
+			return; // trace.allsoild
 	}
 
 	// recurse down both sides
@@ -1306,6 +1739,40 @@ static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
 		SV_ClipToWorldBrush( node->children[1], clip );
 }
 
+/*
+====================
+SV_ClipToIndex
+
+same as areanode walkers above but uses area index,
+returns false if index isn't available
+====================
+*/
+static qboolean SV_ClipToIndex( int tree, moveclip_t *clip, qboolean worldbrush )
+{
+	void	**list;
+	int	i, count;
+
+	list = SV_AreaIndexQuery( tree, clip->boxmins, clip->boxmaxs, &count );
+
+	if( !list )
+		return false;
+
+	for( i = 0; i < count; i++ )
+	{
+		if( worldbrush )
+		{
+			if( !SV_ClipToWorldBrushEdict( list[i], clip ))
+				break;
+		}
+		else if( !SV_ClipToEntity( list[i], clip ))
+			break; // trace.allsoild
+	}
+
+	SV_AreaIndexRelease( count );
+
+	return true;
+}
+
 /*
 ==================
 SV_Move
@@ -1349,8 +1816,10 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 		}
 
 		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
-		SV_ClipToLinks( sv_areanodes, &clip );
-		SV_ClipToPortals( sv_areanodes, &clip );
+		if( !SV_ClipToIndex( AREA_SOLID, &clip, false ))
+			SV_ClipToLinks( sv_areanodes, &clip );
+		if( !SV_ClipToIndex( AREA_PORTALS, &clip, false ))
+			SV_ClipToPortals( sv_areanodes, &clip );
 
 		clip.trace.fraction *= trace_fraction;
 		svgame.globals->trace_ent = clip.trace.ent;
@@ -1393,8 +1862,10 @@ trace_t GAME_EXPORT SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs,
 		VectorCopy( maxs, clip.maxs2 );
 
 		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
-		SV_ClipToWorldBrush( sv_areanodes, &clip );
-		SV_ClipToPortals( sv_areanodes, &clip );
+		if( !SV_ClipToIndex( AREA_SOLID, &clip, true ))
+			SV_ClipToWorldBrush( sv_areanodes, &clip );
+		if( !SV_ClipToIndex( AREA_PORTALS, &clip, false ))
+			SV_ClipToPortals( sv_areanodes, &clip );
 
 		clip.trace.fraction *= trace_fraction;
 		svgame.globals->trace_ent = clip.trace.ent;
@@ -1405,6 +1876,134 @@ trace_t GAME_EXPORT SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs,
 	return clip.trace;
 }
 
+/*
+==================
+SV_MoveMany
+
+traces count moves sharing hull, type and pass edict.
+Entities near all moves are gathered once, filtered once
+and then clipped against every move of the batch in turn,
+so hull of each entity stays hot in cache
+==================
+*/
+void SV_MoveMany( const float *starts, const float *ends, int count, vec3_t mins, vec3_t maxs, int type, edict_t *e, qboolean monsterclip, trace_t *traces )
+{
+	moveclip_t	clips[SV_MOVE_BATCH];
+	float		fractions[SV_MOVE_BATCH];
+	vec3_t		trace_endpos[SV_MOVE_BATCH];
+	vec3_t		boxmins, boxmaxs;
+	int		first, num, active, i, j;
+
+	for( first = 0; first < count; first += SV_MOVE_BATCH )
+	{
+		void	**list[2];
+		int	numlist[2] = { 0, 0 };
+
+		num = Q_min( count - first, SV_MOVE_BATCH );
+		ClearBounds( boxmins, boxmaxs );
+		active = 0;
+
+		for( i = 0; i < num; i++ )
+		{
+			const float	*start = starts + ( first + i ) * 3;
+			moveclip_t	*clip = &clips[i];
+
+			// filter fields are set even for moves stuck in world,
+			// first clip is used to filter entities for whole batch
+			memset( clip, 0, sizeof( *clip ));
+			clip->type = (type & 0xFF);
+			clip->ignoretrans = type >> 8;
+			clip->monsterclip = monsterclip && !FBitSet( host.features, ENGINE_QUAKE_COMPATIBLE );
+			clip->passedict = (e) ? e : EDICT_NUM( 0 );
+
+			SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, ends + ( first + i ) * 3, &clip->trace );
+
+			if( clip->trace.fraction == 0.0f )
+				continue;
+
+			VectorCopy( clip->trace.endpos, trace_endpos[i] );
+			fractions[i] = clip->trace.fraction;
+			clip->trace.fraction = 1.0f;
+			clip->start = start;
+			clip->end = trace_endpos[i];
+			clip->mins = mins;
+			clip->maxs = maxs;
+
+			if( clip->type == MOVE_MISSILE )
+			{
+				VectorSet( clip->mins2, -15.0f, -15.0f, -15.0f );
+				VectorSet( clip->maxs2,  15.0f,  15.0f,  15.0f );
+			}
+			else
+			{
+				VectorCopy( mins, clip->mins2 );
+				VectorCopy( maxs, clip->maxs2 );
+			}
+
+			World_MoveBounds( start, clip->mins2, clip->maxs2, trace_endpos[i], clip->boxmins, clip->boxmaxs );
+			AddPointToBounds( clip->boxmins, boxmins, boxmaxs );
+			AddPointToBounds( clip->boxmaxs, boxmins, boxmaxs );
+			active++;
+		}
+
+		if( active )
+		{
+			list[0] = SV_AreaGather( AREA_SOLID, boxmins, boxmaxs, &numlist[0] );
+			list[1] = list[0] ? SV_AreaGather( AREA_PORTALS, boxmins, boxmaxs, &numlist[1] ) : NULL;
+
+			if( list[0] && list[1] )
+			{
+				int	k;
+
+				// same order as SV_ClipToLinks and SV_ClipToPortals would visit them
+				for( k = 0; k < 2; k++ )
+				{
+					for( j = 0; j < numlist[k]; j++ )
+					{
+						edict_t	*touch = list[k][j];
+
+						if( !SV_ClipFilterEntity( touch, &clips[0] ))
+							continue;
+
+						for( i = 0; i < num; i++ )
+						{
+							if( clips[i].start && !clips[i].trace.allsolid )
+								SV_ClipToFilteredEntity( touch, &clips[i] );
+						}
+					}
+				}
+			}
+			else
+			{
+				// scratch is exhausted, clip moves one by one
+				for( i = 0; i < num; i++ )
+				{
+					if( !clips[i].start )
+						continue;
+
+					SV_ClipToLinks( sv_areanodes, &clips[i] );
+					SV_ClipToPortals( sv_areanodes, &clips[i] );
+				}
+			}
+
+			SV_AreaIndexRelease( numlist[0] + numlist[1] );
+		}
+
+		for( i = 0; i < num; i++ )
+		{
+			if( clips[i].start )
+				clips[i].trace.fraction *= fractions[i];
+			traces[first + i] = clips[i].trace;
+		}
+	}
+
+	if( count > 0 )
+	{
+		svgame.globals->trace_ent = traces[count - 1].ent;
+		SV_CopyTraceToGlobal( &traces[count - 1] );
+	}
+}
+
 /*
 ==================
 SV_TraceSurface
@@ -1666,3 +2265,261 @@ int SV_LightForEntity( edict_t *pEdict )
 
 	return VectorAvg( point_color );
 }
+
+/*
+===============================================================================
+
+AREA INDEX BENCHMARK
+
+===============================================================================
+*/
+/*
+==================
+SV_AreaBench_f
+
+compares areanodes and area index on current map,
+traces start from linked edicts to stay out of solid
+==================
+*/
+void SV_AreaBench_f( void )
+{
+	static vec3_t	hullmins[2] = {{ 0.0f, 0.0f, 0.0f }, { -16.0f, -16.0f, -36.0f }};
+	static vec3_t	hullmaxs[2] = {{ 0.0f, 0.0f, 0.0f }, { 16.0f, 16.0f, 36.0f }};
+	qboolean		wasactive = areaindex.active;
+	double		tracetime[2], linktime[2], buildtime = 0.0, start;
+	int		i, j, mode, count, numlinked = 0, nodes = 0, mismatches = 0;
+	edict_t		**linked;
+	vec3_t		*points;
+	trace_t		*results;
+
+	if( sv.state != ss_active || !sv.worldmodel )
+	{
+		Con_Printf( "sv_areabench: no map running\n" );
+		return;
+	}
+
+	count = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 10000;
+	count = bound( 1, count, 1000000 );
+
+	linked = Z_Malloc( sizeof( *linked ) * svgame.numEntities );
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		edict_t	*ent = EDICT_NUM( i );
+
+		if( ent->area.prev && SV_IsValidEdict( ent ))
+			linked[numlinked++] = ent;
+	}
+
+	if( !numlinked )
+	{
+		Con_Printf( "sv_areabench: no linked edicts\n" );
+		Z_Free( linked );
+		return;
+	}
+
+	points = Z_Malloc( sizeof( *points ) * count * 2 );
+	results = Z_Malloc( sizeof( *results ) * count );
+
+	for( i = 0; i < count; i++ )
+	{
+		edict_t	*ent = linked[COM_RandomLong( 0, numlinked - 1 )];
+		vec3_t	dir;
+
+		VectorAverage( ent->v.absmin, ent->v.absmax, points[i*2+0] );
+		VectorSet( dir, COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( -1.0f, 1.0f ), COM_RandomFloat( -0.5f, 0.5f ));
+		VectorNormalize( dir );
+		VectorMA( points[i*2+0], COM_RandomFloat( 64.0f, 2048.0f ), dir, points[i*2+1] );
+	}
+
+	SV_DropAreaIndex();
+
+	for( mode = 0; mode < 2; mode++ )
+	{
+		if( mode == 1 )
+		{
+			start = Sys_DoubleTime();
+			SV_BuildAreaIndex();
+			buildtime = Sys_DoubleTime() - start;
+		}
+
+		start = Sys_DoubleTime();
+
+		for( i = 0; i < count; i++ )
+		{
+			trace_t	tr = SV_Move( points[i*2+0], hullmins[i&1], hullmaxs[i&1], points[i*2+1], MOVE_NORMAL, NULL, false );
+
+			if( mode == 0 )
+				results[i] = tr;
+			else if( tr.fraction != results[i].fraction || tr.ent != results[i].ent )
+				mismatches++;
+		}
+
+		tracetime[mode] = Sys_DoubleTime() - start;
+		start = Sys_DoubleTime();
+
+		for( j = 0; j < 16; j++ )
+		{
+			for( i = 0; i < numlinked; i++ )
+				SV_LinkEdict( linked[i], false );
+		}
+
+		linktime[mode] = Sys_DoubleTime() - start;
+	}
+
+	for( i = 0; i < AREA_TREES; i++ )
+		nodes += areaindex.trees[i].maxnodes;
+
+	if( !wasactive )
+		SV_DropAreaIndex();
+
+	Con_Printf( "%i traces: areanodes %.2f ms, area index %.2f ms, %i mismatches\n",
+		count, tracetime[0] * 1000.0, tracetime[1] * 1000.0, mismatches );
+	Con_Printf( "%i relinks: areanodes %.2f ms, areanodes + index %.2f ms\n",
+		numlinked * 16, linktime[0] * 1000.0, linktime[1] * 1000.0 );
+	Con_Printf( "area index: %i edicts, %i nodes allocated, built in %.2f ms\n",
+		numlinked, nodes, buildtime * 1000.0 );
+
+	Z_Free( results );
+	Z_Free( points );
+	Z_Free( linked );
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_EDICTS	64
+#define TEST_MOVES	( SV_MOVE_BATCH * 2 + 7 )
+
+static qboolean Test_SameTrace( const trace_t *a, const trace_t *b )
+{
+	return a->allsolid == b->allsolid && a->startsolid == b->startsolid
+		&& a->fraction == b->fraction && VectorCompare( a->endpos, b->endpos )
+		&& VectorCompare( a->plane.normal, b->plane.normal ) && a->ent == b->ent
+		&& a->hitgroup == b->hitgroup;
+}
+
+static int Test_CompareMoves( vec3_t mins, vec3_t maxs, int type, edict_t *e, qboolean monsterclip )
+{
+	static float	starts[TEST_MOVES * 3], ends[TEST_MOVES * 3];
+	static trace_t	traces[TEST_MOVES];
+	int		i, errors = 0;
+
+	for( i = 0; i < TEST_MOVES * 3; i++ )
+	{
+		starts[i] = COM_RandomFloat( -512.0f, 512.0f );
+		ends[i] = COM_RandomFloat( -512.0f, 512.0f );
+	}
+
+	// some moves start inside of the floor
+	starts[2] = ends[2] = -32.0f;
+
+	SV_MoveMany( starts, ends, TEST_MOVES, mins, maxs, type, e, monsterclip, traces );
+
+	for( i = 0; i < TEST_MOVES; i++ )
+	{
+		trace_t	ref = SV_Move( starts + i * 3, mins, maxs, ends + i * 3, type, e, monsterclip );
+
+		if( !Test_SameTrace( &ref, &traces[i] ))
+			errors++;
+	}
+
+	return errors;
+}
+
+static void Test_MoveMany( void )
+{
+	static vec3_t	hullmins = { -16.0f, -16.0f, -36.0f }, hullmaxs = { 16.0f, 16.0f, 36.0f };
+	static const int	types[] = { MOVE_NORMAL, MOVE_NOMONSTERS, MOVE_MISSILE };
+	globalvars_t	globals, *oldglobals = svgame.globals;
+	gameinfo_t	gameinfo, *oldgameinfo = FI->GameInfo;
+	edict_t		*oldedicts = svgame.edicts;
+	int		oldnumentities = svgame.numEntities;
+	vec3_t		worldmins = { -1024.0f, -1024.0f, -1024.0f }, worldmaxs = { 1024.0f, 1024.0f, 1024.0f };
+	int		i, j, mode, errors = 0;
+
+	// game isn't loaded yet
+	memset( &gameinfo, 0, sizeof( gameinfo ));
+	gameinfo.max_edicts = TEST_EDICTS;
+	FI->GameInfo = &gameinfo;
+
+	memset( &globals, 0, sizeof( globals ));
+	svgame.globals = &globals;
+	svgame.edicts = Z_Calloc( sizeof( edict_t ) * TEST_EDICTS );
+	svgame.numEntities = TEST_EDICTS;
+
+	SV_InitBoxHull();
+	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	sv_numareanodes = 0;
+	SV_CreateAreaNode( 0, worldmins, worldmaxs );
+
+	if( !areaindex.scratch )
+	{
+		areaindex.maxscratch = GI->max_edicts * 2;
+		areaindex.scratch = Z_Malloc( sizeof( *areaindex.scratch ) * areaindex.maxscratch );
+	}
+
+	// world is a floor slab, brush models need a map
+	svgame.edicts[0].v.solid = SOLID_BBOX;
+	VectorSet( svgame.edicts[0].v.mins, -1024.0f, -1024.0f, -64.0f );
+	VectorSet( svgame.edicts[0].v.maxs, 1024.0f, 1024.0f, 0.0f );
+
+	for( i = 1; i < TEST_EDICTS; i++ )
+	{
+		edict_t	*ent = &svgame.edicts[i];
+
+		ent->v.solid = COM_RandomLong( 0, 3 ) ? SOLID_BBOX : SOLID_SLIDEBOX;
+		ent->v.movetype = COM_RandomLong( 0, 3 ) ? MOVETYPE_STEP : MOVETYPE_PUSHSTEP;
+		ent->v.flags = COM_RandomLong( 0, 1 ) ? FL_MONSTER : 0;
+
+		// missiles of the first edict shouldn't be clipped
+		if( i % 7 == 0 )
+			ent->v.owner = &svgame.edicts[1];
+
+		for( j = 0; j < 3; j++ )
+		{
+			ent->v.origin[j] = COM_RandomFloat( -480.0f, 480.0f );
+			ent->v.mins[j] = -COM_RandomFloat( 0.0f, 48.0f );
+			ent->v.maxs[j] = COM_RandomFloat( 0.0f, 48.0f );
+		}
+
+		VectorSubtract( ent->v.maxs, ent->v.mins, ent->v.size );
+		VectorAdd( ent->v.origin, ent->v.mins, ent->v.absmin );
+		VectorAdd( ent->v.origin, ent->v.maxs, ent->v.absmax );
+		ExpandBounds( ent->v.absmin, ent->v.absmax, 1.0f );
+		SV_LinkArea( ent );
+	}
+
+	// areanodes first, then area index
+	for( mode = 0; mode < 2; mode++ )
+	{
+		if( mode )
+			SV_BuildAreaIndex();
+
+		for( i = 0; i < ARRAYSIZE( types ); i++ )
+		{
+			errors += Test_CompareMoves( hullmins, hullmaxs, types[i], NULL, false );
+			errors += Test_CompareMoves( vec3_origin, vec3_origin, types[i], &svgame.edicts[1], false );
+			errors += Test_CompareMoves( hullmins, hullmaxs, types[i], &svgame.edicts[2], true );
+		}
+	}
+
+	TASSERT_EQi( errors, 0 );
+	TASSERT_EQi( areaindex.numscratch, 0 );
+
+	SV_FreeAreaIndex();
+	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	sv_numareanodes = 0;
+
+	Z_Free( svgame.edicts );
+	svgame.edicts = oldedicts;
+	svgame.numEntities = oldnumentities;
+	svgame.globals = oldglobals;
+	FI->GameInfo = oldgameinfo;
+}
+
+void Test_RunMoveMany( void )
+{
+	TRUN( Test_MoveMany( ));
+}
+#endif // XASH_ENGINE_TESTS
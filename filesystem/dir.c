@@ -20,6 +20,7 @@ GNU General Public License for more details.
 #include <fcntl.h>
 #include <errno.h>
 #include <stddef.h>
+#include <time.h>
 #if XASH_POSIX
 #include <unistd.h>
 #if !XASH_PSVITA
@@ -51,6 +52,8 @@ typedef struct dir_s
 	string name;
 	int numentries;
 	struct dir_s *entries; // sorted
+	int mtime;       // directory mtime when entries were listed, -1 if unknown
+	time_t scantime; // when entries were listed
 } dir_t;
 
 static qboolean Platform_GetDirectoryCaseSensitivity( const char *dir )
@@ -119,15 +122,43 @@ static void FS_InitDirEntries( dir_t *dir, const stringlist_t *list )
 		Q_strncpy( entry->name, list->strings[i], sizeof( entry->name ));
 		entry->numentries = DIRENTRY_NOT_SCANNED;
 		entry->entries = NULL;
+		entry->mtime = -1;
 	}
 
 	qsort( dir->entries, dir->numentries, sizeof( dir->entries[0] ), FS_SortDirEntries );
 }
 
+static void FS_MarkDirScanned( dir_t *dir, const char *path )
+{
+	// take time before listing, so changes made while listing aren't lost
+	dir->mtime = FS_SysFileTime( path );
+	dir->scantime = time( NULL );
+}
+
+/*
+==================
+FS_DirEntriesUnchanged
+
+true if directory wasn't modified since it was listed,
+so missing entry can't appear there without rescan
+==================
+*/
+static qboolean FS_DirEntriesUnchanged( const dir_t *dir, const char *path )
+{
+	// mtime has one second resolution on some filesystems,
+	// listing made in the same second as the change may miss it
+	if( dir->mtime < 0 || dir->mtime >= dir->scantime )
+		return false;
+
+	return FS_SysFileTime( path ) == dir->mtime;
+}
+
 static void FS_PopulateDirEntries( dir_t *dir, const char *path )
 {
 	stringlist_t list;
 
+	FS_MarkDirScanned( dir, path );
+
 	if( !FS_SysFolderExists( path ))
 	{
 		dir->numentries = DIRENTRY_EMPTY_DIRECTORY;
@@ -219,6 +250,8 @@ static void FS_MergeDirEntries( dir_t *dir, const stringlist_t *list )
 
 		newentry->numentries = oldentry->numentries;
 		newentry->entries = oldentry->entries;
+		newentry->mtime = oldentry->mtime;
+		newentry->scantime = oldentry->scantime;
 	}
 
 	// now we can free old tree and replace it with temporary
@@ -233,6 +266,8 @@ static int FS_MaybeUpdateDirEntries( dir_t *dir, const char *path, const char *e
 	stringlist_t list;
 	int ret;
 
+	FS_MarkDirScanned( dir, path );
+
 	stringlistinit( &list );
 	listdirectory( &list, path, false );
 
@@ -337,7 +372,7 @@ qboolean FS_FixFileCase( dir_t *dir, const char *path, char *dst, const size_t l
 		{
 			// if we're creating files or folders, we don't care if path doesn't exist
 			// so copy everything that's left and exit without an error
-			if( uptodate || ( ret = FS_MaybeUpdateDirEntries( dir, dst, entryname )) < 0 )
+			if( uptodate || FS_DirEntriesUnchanged( dir, dst ) || ( ret = FS_MaybeUpdateDirEntries( dir, dst, entryname )) < 0 )
 				return createpath ? FS_AppendToPath( dst, &i, len, prev, path, "create path" ) : false;
 
 			uptodate = true;
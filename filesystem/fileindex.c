@@ -0,0 +1,264 @@
+/*
+fileindex.c - merged hash index of archive contents
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <time.h>
+#if XASH_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+
+/*
+========================================================================
+FILE INDEX
+
+Every searchpath that provides pfnFileName (PAK and ZIP, their
+contents never change while mounted) is put into one case-insensitive
+hash table, so FS_FindFile doesn't have to probe each archive.
+Plain directories, WADs and other searchpaths are still probed in order.
+Index is rebuilt on first lookup after searchpath list was changed
+========================================================================
+*/
+#define FS_INDEX_MIN_BUCKETS	256
+
+typedef struct fs_indexentry_s
+{
+	searchpath_t	*search;
+	int		pack_ind;
+	int		order;	// position of searchpath in the chain, lower wins
+	int		next;	// next entry in bucket, -1 terminates
+} fs_indexentry_t;
+
+static struct
+{
+	qboolean		valid;
+	fs_indexentry_t	*entries;
+	int		numentries;
+	int		*buckets;
+	uint		numbuckets;	// power of two
+	int		numarchives;
+
+	// statistics
+	double		buildtime;
+	int		numbuilds;
+	double		mounttime;
+	int		nummounts;
+	double		lookuptime;
+	uint		numlookups;
+	uint		numfound;
+} fs_index;
+
+/*
+================
+FS_DoubleTime
+
+filesystem doesn't have access to engine timer
+================
+*/
+double FS_DoubleTime( void )
+{
+#if XASH_WIN32
+	static LARGE_INTEGER	freq;
+	LARGE_INTEGER		counter;
+
+	if( !freq.QuadPart )
+		QueryPerformanceFrequency( &freq );
+
+	QueryPerformanceCounter( &counter );
+	return (double)counter.QuadPart / (double)freq.QuadPart;
+#elif XASH_POSIX && defined( CLOCK_MONOTONIC )
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+================
+FS_InvalidateIndex
+
+must be called whenever searchpaths are added or removed
+================
+*/
+void FS_InvalidateIndex( void )
+{
+	fs_index.valid = false;
+}
+
+/*
+================
+FS_FreeIndex
+
+================
+*/
+void FS_FreeIndex( void )
+{
+	if( fs_index.entries )
+		Mem_Free( fs_index.entries );
+
+	if( fs_index.buckets )
+		Mem_Free( fs_index.buckets );
+
+	fs_index.entries = NULL;
+	fs_index.buckets = NULL;
+	fs_index.numentries = 0;
+	fs_index.numbuckets = 0;
+	fs_index.numarchives = 0;
+	fs_index.valid = false;
+}
+
+/*
+================
+FS_BuildIndex
+
+================
+*/
+static void FS_BuildIndex( searchpath_t *searchpaths )
+{
+	double		start = FS_DoubleTime();
+	searchpath_t	*search;
+	int		count = 0, order;
+	int		i;
+
+	FS_FreeIndex();
+
+	for( search = searchpaths; search; search = search->next )
+	{
+		if( !search->pfnFileName )
+			continue;
+
+		i = 0;
+		while( search->pfnFileName( search, i ))
+			i++;
+
+		count += i;
+		fs_index.numarchives++;
+	}
+
+	fs_index.numbuckets = FS_INDEX_MIN_BUCKETS;
+	while( fs_index.numbuckets < (uint)count )
+		fs_index.numbuckets <<= 1;
+
+	fs_index.buckets = Mem_Malloc( fs_mempool, sizeof( *fs_index.buckets ) * fs_index.numbuckets );
+	memset( fs_index.buckets, 0xff, sizeof( *fs_index.buckets ) * fs_index.numbuckets );
+
+	if( count )
+		fs_index.entries = Mem_Malloc( fs_mempool, sizeof( *fs_index.entries ) * count );
+
+	for( search = searchpaths, order = 0; search; search = search->next, order++ )
+	{
+		const char *name;
+
+		if( !search->pfnFileName )
+			continue;
+
+		for( i = 0; ( name = search->pfnFileName( search, i )) != NULL; i++ )
+		{
+			fs_indexentry_t	*entry = &fs_index.entries[fs_index.numentries];
+			uint		hash = COM_HashKey( name, fs_index.numbuckets );
+
+			entry->search = search;
+			entry->pack_ind = i;
+			entry->order = order;
+			entry->next = fs_index.buckets[hash];
+			fs_index.buckets[hash] = fs_index.numentries++;
+		}
+	}
+
+	fs_index.valid = true;
+	fs_index.numbuilds++;
+	fs_index.buildtime += FS_DoubleTime() - start;
+}
+
+/*
+================
+FS_LookupIndex
+
+returns first indexed searchpath in chain order that
+contains the file, NULL if no archive has it
+================
+*/
+searchpath_t *FS_LookupIndex( searchpath_t *searchpaths, const char *name, qboolean gamedironly )
+{
+	const fs_indexentry_t	*best = NULL;
+	int			i;
+
+	if( !fs_index.valid )
+		FS_BuildIndex( searchpaths );
+
+	for( i = fs_index.buckets[COM_HashKey( name, fs_index.numbuckets )]; i >= 0; i = fs_index.entries[i].next )
+	{
+		const fs_indexentry_t *entry = &fs_index.entries[i];
+
+		if( best && best->order <= entry->order )
+			continue;
+
+		if( gamedironly && !FBitSet( entry->search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+			continue;
+
+		if( Q_stricmp( entry->search->pfnFileName( entry->search, entry->pack_ind ), name ))
+			continue;
+
+		best = entry;
+	}
+
+	return best ? best->search : NULL;
+}
+
+void FS_CountMount( double time )
+{
+	fs_index.mounttime += time;
+	fs_index.nummounts++;
+}
+
+void FS_CountLookup( double time, qboolean found )
+{
+	fs_index.lookuptime += time;
+	fs_index.numlookups++;
+
+	if( found )
+		fs_index.numfound++;
+}
+
+/*
+================
+FS_PrintIndexInfo
+
+================
+*/
+void FS_PrintIndexInfo( void )
+{
+	Con_Printf( "%i searchpaths mounted in %.2f ms\n", fs_index.nummounts, fs_index.mounttime * 1000.0 );
+
+	if( fs_index.valid )
+	{
+		Con_Printf( "index: %i files from %i archives in %u buckets, built %i times in %.2f ms\n",
+			fs_index.numentries, fs_index.numarchives, fs_index.numbuckets, fs_index.numbuilds, fs_index.buildtime * 1000.0 );
+	}
+	else Con_Printf( "index: not built, %i builds in %.2f ms\n", fs_index.numbuilds, fs_index.buildtime * 1000.0 );
+
+	if( fs_index.numlookups )
+	{
+		Con_Printf( "%u lookups, %u found, %u missed, %.2f us average\n", fs_index.numlookups, fs_index.numfound,
+			fs_index.numlookups - fs_index.numfound, fs_index.lookuptime * 1e6 / fs_index.numlookups );
+	}
+}
@@ -0,0 +1,326 @@
+/*
+filemap.c - read-only views of archive entries
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <errno.h>
+#if XASH_POSIX && !XASH_NSWITCH && !XASH_PSVITA && !XASH_WASI && !defined XASH_REDUCE_FD
+#define XASH_FS_MMAP 1
+#include <unistd.h>
+#include <sys/mman.h>
+#else
+#define XASH_FS_MMAP 0
+#endif
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "common/com_strings.h"
+
+/*
+========================================================================
+FILE VIEWS
+
+Uncompressed entries of PAK, WAD and ZIP archives are mapped straight
+from the archive file, so loaders parse page cache instead of a heap
+copy. Everything else (loose files, deflated entries, platforms without
+mmap) is loaded into memory as usual. Archive entries are shared: same
+entry mapped twice gives same pointer and bumps the reference count.
+Mappings outlive the archive, searchpath is only used to share views
+========================================================================
+*/
+#define FS_VIEWS_GROW	32
+
+typedef struct fs_view_s
+{
+	const byte	*data;
+	fs_offset_t	size;
+	void		*base;		// mmap base, NULL for heap copy
+	size_t		maplen;
+	searchpath_t	*search;		// NULL if view can't be shared
+	int		pack_ind;
+	int		refcount;		// 0 means free slot
+} fs_view_t;
+
+static struct
+{
+	fs_view_t		*views;
+	int		maxviews;
+	int		numviews;		// live views
+
+	// statistics
+	uint		nummapped;
+	uint		numcopied;
+	uint		numshared;
+	size_t		mappedbytes;	// currently mapped
+} fs_views;
+
+#if XASH_FS_MMAP
+/*
+================
+FS_MapRange
+
+maps [offset, offset + size) of the archive handle,
+returns NULL if mmap can't be used for that entry
+================
+*/
+static const byte *FS_MapRange( file_t *handle, fs_offset_t offset, fs_offset_t size, void **base, size_t *maplen )
+{
+	static long	pagesize;
+	fs_offset_t	start, delta;
+	void		*p;
+
+	if( !pagesize )
+	{
+		pagesize = sysconf( _SC_PAGESIZE );
+		if( pagesize <= 0 ) pagesize = 4096;
+	}
+
+	// small files are cheaper to read than to map, compressed handles can't be mapped at all
+	if( size < pagesize || handle->ztk || handle->handle < 0 )
+		return NULL;
+
+	// don't let truncated archive raise SIGBUS later
+	if( offset < 0 || offset + size > handle->real_length )
+		return NULL;
+
+	offset += handle->offset;
+	start = offset & ~((fs_offset_t)pagesize - 1 );
+	delta = offset - start;
+
+	p = mmap( NULL, delta + size, PROT_READ, MAP_PRIVATE, handle->handle, start );
+
+	if( p == MAP_FAILED )
+	{
+		Con_Reportf( S_WARN "%s: mmap failed: %s\n", __func__, strerror( errno ));
+		return NULL;
+	}
+
+	*base = p;
+	*maplen = delta + size;
+
+	return (const byte *)p + delta;
+}
+#endif // XASH_FS_MMAP
+
+static fs_view_t *FS_AllocView( void )
+{
+	int	i;
+
+	for( i = 0; i < fs_views.maxviews; i++ )
+	{
+		if( !fs_views.views[i].refcount )
+			return &fs_views.views[i];
+	}
+
+	fs_views.maxviews += FS_VIEWS_GROW;
+	fs_views.views = Mem_Realloc( fs_mempool, fs_views.views, sizeof( *fs_views.views ) * fs_views.maxviews );
+	memset( &fs_views.views[i], 0, sizeof( *fs_views.views ) * FS_VIEWS_GROW );
+
+	return &fs_views.views[i];
+}
+
+/*
+================
+FS_MapFile
+
+returns read-only contents of the file, must be released with
+FS_UnmapFile. Unlike FS_LoadFile, data is not zero terminated
+================
+*/
+const byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+	searchpath_t	*search;
+	char		netpath[MAX_SYSPATH];
+	fs_view_t		*view;
+	const byte	*data = NULL;
+	void		*base = NULL;
+	size_t		maplen = 0;
+	fs_offset_t	size = 0;
+	int		i, pack_ind;
+
+	if( filesizeptr ) *filesizeptr = 0;
+
+	// some mappers used leading '/' or '\' in path to models or sounds
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	if( FS_CheckNastyPath( path ))
+		return NULL;
+
+	search = FS_FindFile( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
+
+	if( !search )
+		return NULL;
+
+	// archive contents never change while mounted
+	if( search->pfnFileRange )
+	{
+		for( i = 0; i < fs_views.maxviews; i++ )
+		{
+			view = &fs_views.views[i];
+
+			if( view->refcount && view->search == search && view->pack_ind == pack_ind )
+			{
+				view->refcount++;
+				fs_views.numshared++;
+
+				if( filesizeptr ) *filesizeptr = view->size;
+				return view->data;
+			}
+		}
+	}
+
+#if XASH_FS_MMAP
+	if( search->pfnFileRange )
+	{
+		fs_offset_t	offset;
+		file_t		*handle = search->pfnFileRange( search, pack_ind, &offset, &size );
+
+		if( handle )
+			data = FS_MapRange( handle, offset, size, &base, &maplen );
+	}
+#endif
+
+	if( data )
+	{
+		fs_views.nummapped++;
+		fs_views.mappedbytes += maplen;
+	}
+	else
+	{
+		data = FS_LoadFileFromArchive( search, netpath, pack_ind, &size, false );
+
+		if( !data )
+			return NULL;
+
+		fs_views.numcopied++;
+	}
+
+	view = FS_AllocView();
+	view->data = data;
+	view->size = size;
+	view->base = base;
+	view->maplen = maplen;
+	view->search = search->pfnFileRange ? search : NULL;
+	view->pack_ind = pack_ind;
+	view->refcount = 1;
+	fs_views.numviews++;
+
+	if( filesizeptr ) *filesizeptr = size;
+
+	return data;
+}
+
+static void FS_FreeView( fs_view_t *view )
+{
+#if XASH_FS_MMAP
+	if( view->base )
+	{
+		munmap( view->base, view->maplen );
+		fs_views.mappedbytes -= view->maplen;
+	}
+	else
+#endif
+	Mem_Free( (void *)view->data );
+
+	memset( view, 0, sizeof( *view ));
+	fs_views.numviews--;
+}
+
+/*
+================
+FS_UnmapFile
+
+================
+*/
+void FS_UnmapFile( const byte *data )
+{
+	int	i;
+
+	if( !data )
+		return;
+
+	for( i = 0; i < fs_views.maxviews; i++ )
+	{
+		fs_view_t *view = &fs_views.views[i];
+
+		if( !view->refcount || view->data != data )
+			continue;
+
+		if( --view->refcount == 0 )
+			FS_FreeView( view );
+		return;
+	}
+
+	Con_Reportf( S_ERROR "%s: %p wasn't mapped\n", __func__, data );
+}
+
+/*
+================
+FS_DetachViews
+
+searchpath is about to be closed, its views stay valid
+but mustn't be matched against a new searchpath at same address
+================
+*/
+void FS_DetachViews( searchpath_t *search )
+{
+	int	i;
+
+	for( i = 0; i < fs_views.maxviews; i++ )
+	{
+		if( fs_views.views[i].search == search )
+			fs_views.views[i].search = NULL;
+	}
+}
+
+/*
+================
+FS_FreeViews
+
+================
+*/
+void FS_FreeViews( void )
+{
+	int	i;
+
+	if( fs_views.numviews )
+		Con_Reportf( S_WARN "%s: %i views weren't unmapped\n", __func__, fs_views.numviews );
+
+	for( i = 0; i < fs_views.maxviews; i++ )
+	{
+		if( fs_views.views[i].refcount )
+			FS_FreeView( &fs_views.views[i] );
+	}
+
+	if( fs_views.views )
+		Mem_Free( fs_views.views );
+
+	memset( &fs_views, 0, sizeof( fs_views ));
+}
+
+/*
+================
+FS_PrintViewsInfo
+
+================
+*/
+void FS_PrintViewsInfo( void )
+{
+	Con_Printf( "views: %i live, %s mapped, %u maps, %u copies, %u shared\n", fs_views.numviews,
+		Q_memprint( fs_views.mappedbytes ), fs_views.nummapped, fs_views.numcopied, fs_views.numshared );
+}
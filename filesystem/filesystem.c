@@ -331,6 +331,7 @@ void FS_CreatePath( char *path )
 searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *file, int flags )
 {
 	searchpath_t *search;
+	double start;
 
 	for( search = fs_searchpaths; search; search = search->next )
 	{
@@ -338,13 +339,16 @@ searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *f
 			return search; // already loaded
 	}
 
+	start = FS_DoubleTime();
 	search = archive->pfnAddArchive_Fullpath( file, flags );
+	FS_CountMount( FS_DoubleTime() - start );
 
 	if( !search )
 		return NULL;
 
 	search->next = fs_searchpaths;
 	fs_searchpaths = search;
+	FS_InvalidateIndex();
 
 	// time to add in search list all the wads from this archive
 	if( archive->load_wads && !FBitSet( flags, FS_SKIP_ARCHIVED_WADS ))
@@ -468,10 +472,13 @@ void FS_ClearSearchPath( void )
 		}
 
 		*prev = cur->next;
+		FS_DetachViews( cur );
 		cur->pfnClose( cur );
 		Mem_Free( cur );
 	}
 
+	FS_InvalidateIndex();
+
 	for( i = 0; i < FI.numgames; i++ )
 	{
 		if( FI.games[i] )
@@ -488,7 +495,7 @@ Return true if the path should be rejected due to one of the following:
 	or are just not a good idea for a mod to be using.
 ====================
 */
-static int FS_CheckNastyPath( const char *path )
+int FS_CheckNastyPath( const char *path )
 {
 	// all: never allow an empty path, as for gamedir it would access the parent directory and a non-gamedir path it is just useless
 	if( !COM_CheckString( path )) return 2;
@@ -1742,6 +1749,9 @@ void FS_ShutdownStdio( void )
 	FI.numgames = 0;
 
 	FS_ClearSearchPath(); // release all wad files too
+	FS_FreeIndex();
+	FS_FreeViews();
+	FS_FreeZipCache();
 	Mem_FreePool( &fs_mempool );
 }
 
@@ -1774,6 +1784,11 @@ void FS_Path_f( void )
 
 		Con_Printf( "\n" );
 	}
+
+	FS_PrintIndexInfo();
+	FS_PrintViewsInfo();
+	FS_PrintZipCacheInfo();
+	FS_PrintZipCheckpointsInfo();
 }
 
 /*
@@ -2088,17 +2103,17 @@ qboolean FS_GetRootDirectory( char *path, size_t size )
 
 /*
 ====================
-FS_FindFile
-
-Look for a file in the packages and in the filesystem
+FS_FindFileInSearchPaths
 
-Return the searchpath where the file was found (or NULL)
-and the file index in the package if relevant
+archives are looked up in the index once,
+everything else is probed in chain order
 ====================
 */
-searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly )
+static searchpath_t *FS_FindFileInSearchPaths( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly )
 {
-	searchpath_t	*search;
+	searchpath_t	*search, *indexed;
+
+	indexed = FS_LookupIndex( fs_searchpaths, name, gamedironly );
 
 	// search through the path, one element at a time
 	for( search = fs_searchpaths; search; search = search->next )
@@ -2108,6 +2123,10 @@ searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t
 		if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
 			continue;
 
+		// index knows it's not there
+		if( search->pfnFileName && search != indexed )
+			continue;
+
 		pack_ind = search->pfnFindFile( search, name, fixedname, len );
 		if( pack_ind >= 0 )
 		{
@@ -2117,6 +2136,30 @@ searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t
 		}
 	}
 
+	return NULL;
+}
+
+/*
+====================
+FS_FindFile
+
+Look for a file in the packages and in the filesystem
+
+Return the searchpath where the file was found (or NULL)
+and the file index in the package if relevant
+====================
+*/
+searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly )
+{
+	searchpath_t	*search;
+	double		start = FS_DoubleTime();
+
+	search = FS_FindFileInSearchPaths( name, index, fixedname, len, gamedironly );
+	FS_CountLookup( FS_DoubleTime() - start, search != NULL );
+
+	if( search )
+		return search;
+
 	if( fs_ext_path )
 	{
 		char netpath[MAX_SYSPATH], dirpath[MAX_SYSPATH];
@@ -2204,6 +2247,7 @@ file_t *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamedi
 	searchpath_t *search;
 	char netpath[MAX_SYSPATH];
 	int pack_ind;
+	file_t *f;
 
 	search = FS_FindFile( filename, &pack_ind, netpath, sizeof( netpath ), gamedironly );
 
@@ -2211,7 +2255,12 @@ file_t *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamedi
 	if( search == NULL )
 		return NULL;
 
-	return search->pfnOpenFile( search, netpath, mode, pack_ind );
+	f = search->pfnOpenFile( search, netpath, mode, pack_ind );
+
+	if( f && Q_strchr( mode, 'p' ))
+		SetBits( f->flags, FILE_PREFETCH );
+
+	return f;
 }
 
 /*
@@ -2282,10 +2331,14 @@ int FS_Close( file_t *file )
 
 	if( file->ztk )
 	{
+		FS_FreeZipCheckpoints( file->ztk );
 		inflateEnd( &file->ztk->zstream );
 		Mem_Free( file->ztk );
 	}
 
+	if( file->cached )
+		FS_UnlockZipCache( file->cached );
+
 	Mem_Free( file );
 	return 0;
 }
@@ -2329,9 +2382,9 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 
 	if( !file ) return 0;
 
-	// if necessary, seek to the exact file position we're supposed to be
-	if( file->buff_ind != file->buff_len )
-		lseek( file->handle, file->buff_ind - file->buff_len, SEEK_CUR );
+	// seek to the exact file position we're supposed to be,
+	// reads don't move descriptor offset
+	lseek( file->handle, file->offset + file->position - file->buff_len + file->buff_ind, SEEK_SET );
 
 	// purge cached data
 	FS_Purge( file );
@@ -2348,6 +2401,26 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 	return result;
 }
 
+/*
+====================
+FS_ReadAt
+
+positioned read that leaves descriptor offset alone. Archive entries
+share offset through dup'ed descriptor, so with pread different files
+can be read from different threads, as long as nothing else touches
+filesystem at the same time. FS_Write seeks before writing because of that
+====================
+*/
+static fs_offset_t FS_ReadAt( file_t *file, void *buffer, size_t size, fs_offset_t offset )
+{
+#if XASH_POSIX && defined( HAVE_DUP ) && !defined( XASH_REDUCE_FD )
+	return pread( file->handle, buffer, size, file->offset + offset );
+#else
+	lseek( file->handle, file->offset + offset, SEEK_SET );
+	return read( file->handle, buffer, size );
+#endif
+}
+
 /*
 ====================
 FS_Read
@@ -2391,6 +2464,17 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 
 	// NOTE: at this point, the read buffer is always empty
 
+	if( file->cached )
+	{
+		count = file->real_length - file->position;
+		count = ( buffersize > count ) ? count : (fs_offset_t)buffersize;
+
+		memcpy( &((byte *)buffer)[done], file->cached + file->position, count );
+		file->position += count;
+
+		return done + count;
+	}
+
 	FS_EnsureOpenFile( file ); // FIXME: broken XASH_REDUCE_FD in case of compressed files!
 
 	if( FBitSet( file->flags, FILE_DEFLATED ))
@@ -2414,10 +2498,10 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 				count = (fs_offset_t)( ztk->comp_length - ztk->in_position );
 				if( count > (fs_offset_t)sizeof( ztk->input ))
 					count = (fs_offset_t)sizeof( ztk->input );
-				lseek( file->handle, file->offset + (fs_offset_t)ztk->in_position, SEEK_SET );
-				if( read( file->handle, ztk->input, count ) != count )
+				if( FS_ReadAt( file, ztk->input, count, (fs_offset_t)ztk->in_position ) != count )
 				{
-					Con_Printf( "%s: unexpected end of file\n", __func__ );
+					if( !FBitSet( file->flags, FILE_PREFETCH ))
+						Con_Printf( "%s: unexpected end of file\n", __func__ );
 					break;
 				}
 
@@ -2447,7 +2531,8 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 			error = inflate( &ztk->zstream, Z_SYNC_FLUSH );
 			if( error != Z_OK && error != Z_STREAM_END )
 			{
-				Con_Printf( "%s: Can't inflate file (%d)\n", __func__, error );
+				if( !FBitSet( file->flags, FILE_PREFETCH ))
+					Con_Printf( "%s: Can't inflate file (%d)\n", __func__, error );
 				break;
 			}
 			ztk->in_ind = ztk->in_len - ztk->zstream.avail_in;
@@ -2471,6 +2556,8 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 				FS_Purge( file );
 			}
 
+			FS_SaveZipCheckpoint( file );
+
 			done += count;
 			buffersize -= count;
 		}
@@ -2486,8 +2573,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > (fs_offset_t)buffersize )
 			count = (fs_offset_t)buffersize;
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, &((byte *)buffer)[done], count );
+		nb = FS_ReadAt( file, &((byte *)buffer)[done], count, file->position );
 
 		if( nb > 0 )
 		{
@@ -2501,8 +2587,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > (fs_offset_t)sizeof( file->buff ))
 			count = (fs_offset_t)sizeof( file->buff );
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, file->buff, count );
+		nb = FS_ReadAt( file, file->buff, count, file->position );
 
 		if( nb > 0 )
 		{
@@ -2693,6 +2778,12 @@ int FS_Seek( file_t *file, fs_offset_t offset, int whence )
 	// Purge cached data
 	FS_Purge( file );
 
+	if( file->cached )
+	{
+		file->position = offset;
+		return 0;
+	}
+
 	if( FBitSet( file->flags, FILE_DEFLATED ))
 	{
 		// Seeking in compressed files is more a hack than anything else,
@@ -2702,7 +2793,8 @@ int FS_Seek( file_t *file, fs_offset_t offset, int whence )
 		fs_offset_t buffersize;
 
 		// If we have to go back in the file, we need to restart from the beginning
-		if( offset <= file->position )
+		// unless inflate state was saved somewhere before the offset
+		if( !FS_RestoreZipCheckpoint( file, offset ) && offset <= file->position )
 		{
 			ztk->in_ind = 0;
 			ztk->in_len = 0;
@@ -2798,7 +2890,7 @@ static void FS_CustomFree( void *data )
 	Mem_Free( data );
 }
 
-static byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc )
+byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc )
 {
 	fs_offset_t	filesize;
 	file_t *file;
@@ -3326,7 +3418,12 @@ static int FS_FindFileInArchive( searchpath_t *sp, const char *path, char *truep
 
 static file_t *FS_OpenFileFromArchive( searchpath_t *sp, const char *path, const char *mode, int pack_ind )
 {
-	return sp->pfnOpenFile( sp, path, mode, pack_ind );
+	file_t *f = sp->pfnOpenFile( sp, path, mode, pack_ind );
+
+	if( f && Q_strchr( mode, 'p' ))
+		SetBits( f->flags, FILE_PREFETCH );
+
+	return f;
 }
 
 void FS_InitMemory( void )
@@ -3467,6 +3564,11 @@ const fs_api_t g_api =
 	FS_GetRootDirectory,
 
 	FS_MakeGameInfo,
+
+	FS_MapFile,
+	FS_UnmapFile,
+
+	FS_SetZipCacheSize,
 };
 
 int EXPORT GetFSAPI( int version, fs_api_t *api, fs_globals_t **globals, fs_interface_t *engfuncs );
@@ -32,8 +32,8 @@ extern "C"
 {
 #endif // __cplusplus
 
-#define FS_API_VERSION 3 // not stable yet!
-#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem002" // follow FS_API_VERSION!!!
+#define FS_API_VERSION 4 // not stable yet!
+#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem003" // follow FS_API_VERSION!!!
 #define FILESYSTEM_INTERFACE_VERSION "VFileSystem009" // never change this!
 
 // search path flags
@@ -238,6 +238,16 @@ typedef struct fs_api_t
 	qboolean (*GetRootDirectory)( char *path, size_t size );
 
 	void (*MakeGameInfo)( void );
+
+	// read-only view of the file, uncompressed archive entries are mapped
+	// without copying where platform allows. Views of the same archive entry
+	// are shared and refcounted, every MapFile must be paired with UnmapFile
+	// NOTE: unlike LoadFile, data is not zero terminated!
+	const byte *(*MapFile)( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+	void (*UnmapFile)( const byte *data );
+
+	// sets memory budget in bytes for decompressed zip entries, 0 disables cache
+	void (*SetZipCacheSize)( size_t size );
 } fs_api_t;
 
 typedef struct fs_interface_t
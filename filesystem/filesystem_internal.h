@@ -42,6 +42,14 @@ typedef struct android_assets_s android_assets_t;
 
 #define FILE_BUFF_SIZE (2048)
 #define FILE_DEFLATED BIT( 0 )
+#define FILE_PREFETCH BIT( 1 ) // read by prefetch threads, errors are left to the reader
+
+typedef struct zcheckpoint_s
+{
+	fs_offset_t position;    // uncompressed offset the snapshot resumes from
+	size_t      in_position; // compressed offset of the next input byte
+	z_stream    zstream;     // inflate state, including the window
+} zcheckpoint_t;
 
 typedef struct ztoolkit_s
 {
@@ -50,6 +58,17 @@ typedef struct ztoolkit_s
 	size_t   in_ind, in_len;
 	size_t   in_position;
 	byte     input[FILE_BUFF_SIZE];
+
+	// inflate snapshots for backward seeks, see zip.c
+	zcheckpoint_t *checkpoints;
+	int            numcheckpoints;
+	fs_offset_t    checkpoint_spacing;
+	fs_offset_t    next_checkpoint;
+
+	// seek statistics, added to totals on close
+	uint           saved;
+	uint           restored;
+	size_t         skipped;
 } ztoolkit_t;
 
 struct file_s
@@ -63,6 +82,7 @@ struct file_s
 	fs_offset_t  offset;      // offset into the package (0 if external file)
 	uint32_t     flags;
 	ztoolkit_t   *ztk; // if not NULL, all read functions must go through decompression
+	const byte   *cached; // if not NULL, file is read from decompressed zip entry, see zip.c
 
 	// contents buffer
 	fs_offset_t buff_ind; // buffer current index
@@ -116,6 +136,8 @@ typedef struct searchpath_s
 	file_t *(*pfnOpenFile)( struct searchpath_s *search, const char *filename, const char *mode, int pack_ind );
 	int     (*pfnFileTime)( struct searchpath_s *search, const char *filename );
 	int     (*pfnFindFile)( struct searchpath_s *search, const char *path, char *fixedname, size_t len );
+	const char *(*pfnFileName)( struct searchpath_s *search, int pack_ind ); // optional, immutable archives only, see fileindex.c
+	file_t *(*pfnFileRange)( struct searchpath_s *search, int pack_ind, fs_offset_t *offset, fs_offset_t *size ); // optional, see filemap.c
 	void    (*pfnSearch)( struct searchpath_s *search, stringlist_t *list, const char *pattern, int caseinsensitive );
 	byte   *(*pfnLoadFile)( struct searchpath_s *search, const char *path, int pack_ind, fs_offset_t *filesize, void *( *pfnAlloc )( size_t ), void ( *pfnFree )( void * ));
 } searchpath_t;
@@ -207,6 +229,7 @@ byte *FS_LoadFileMalloc( const char *path, fs_offset_t *filesizeptr, qboolean ga
 	MALLOC_LIKE( free, 1 ) WARN_UNUSED_RESULT;
 byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr )
 	MALLOC_LIKE( _Mem_Free, 1 ) WARN_UNUSED_RESULT;
+byte *FS_LoadFileFromArchive( searchpath_t *sp, const char *path, int pack_ind, fs_offset_t *filesizeptr, const qboolean sys_malloc );
 qboolean FS_WriteFile( const char *filename, const void *data, fs_offset_t len );
 
 // file hashing
@@ -233,6 +256,7 @@ void     FS_CreatePath( char *path );
 qboolean FS_SysFolderExists( const char *path );
 qboolean FS_SysFileOrFolderExists( const char *path );
 file_t  *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamedironly );
+int      FS_CheckNastyPath( const char *path );
 
 int           FS_SysFileTime( const char *filename );
 file_t       *FS_OpenHandle( searchpath_t *search, int handle, fs_offset_t offset, fs_offset_t len );
@@ -255,6 +279,14 @@ searchpath_t *FS_AddWad_Fullpath( const char *wadfile, int flags );
 // zip.c
 //
 searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags );
+void FS_SetZipCacheSize( size_t size );
+void FS_UnlockZipCache( const byte *data );
+void FS_FreeZipCache( void );
+void FS_PrintZipCacheInfo( void );
+void FS_SaveZipCheckpoint( file_t *file );
+qboolean FS_RestoreZipCheckpoint( file_t *file, fs_offset_t offset );
+void FS_FreeZipCheckpoints( ztoolkit_t *ztk );
+void FS_PrintZipCheckpointsInfo( void );
 
 //
 // dir.c
@@ -263,6 +295,26 @@ searchpath_t *FS_AddDir_Fullpath( const char *path, int flags );
 qboolean FS_FixFileCase( dir_t *dir, const char *path, char *dst, const size_t len, qboolean createpath );
 void FS_InitDirectorySearchpath( searchpath_t *search, const char *path, int flags );
 
+//
+// fileindex.c
+//
+double FS_DoubleTime( void );
+void FS_InvalidateIndex( void );
+void FS_FreeIndex( void );
+searchpath_t *FS_LookupIndex( searchpath_t *searchpaths, const char *name, qboolean gamedironly );
+void FS_CountMount( double time );
+void FS_CountLookup( double time, qboolean found );
+void FS_PrintIndexInfo( void );
+
+//
+// filemap.c
+//
+const byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+void FS_UnmapFile( const byte *data );
+void FS_DetachViews( searchpath_t *search );
+void FS_FreeViews( void );
+void FS_PrintViewsInfo( void );
+
 //
 // android.c
 //
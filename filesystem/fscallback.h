@@ -71,6 +71,8 @@ extern fs_globals_t *FI;
 #define FS_LoadDirectFile (*g_fsapi.LoadDirectFile)
 #endif
 #define FS_WriteFile (*g_fsapi.WriteFile)
+#define FS_MapFile (*g_fsapi.MapFile)
+#define FS_UnmapFile (*g_fsapi.UnmapFile)
 
 // file hashing
 #define CRC32_File (*g_fsapi.CRC32_File)
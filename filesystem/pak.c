@@ -236,6 +236,37 @@ static int FS_FindFile_PAK( searchpath_t *search, const char *path, char *fixedn
 	return -1;
 }
 
+/*
+===========
+FS_FileName_PAK
+
+===========
+*/
+static const char *FS_FileName_PAK( searchpath_t *search, int pack_ind )
+{
+	if( pack_ind < 0 || pack_ind >= search->pack->numfiles )
+		return NULL;
+
+	return search->pack->files[pack_ind].name;
+}
+
+/*
+===========
+FS_FileRange_PAK
+
+pak lumps are never compressed
+===========
+*/
+static file_t *FS_FileRange_PAK( searchpath_t *search, int pack_ind, fs_offset_t *offset, fs_offset_t *size )
+{
+	const dpackfile_t *pfile = &search->pack->files[pack_ind];
+
+	*offset = pfile->filepos;
+	*size = pfile->filelen;
+
+	return search->pack->handle;
+}
+
 /*
 ===========
 FS_Search_PAK
@@ -360,6 +391,8 @@ searchpath_t *FS_AddPak_Fullpath( const char *pakfile, int flags )
 	search->pfnOpenFile = FS_OpenFile_PAK;
 	search->pfnFileTime = FS_FileTime_PAK;
 	search->pfnFindFile = FS_FindFile_PAK;
+	search->pfnFileName = FS_FileName_PAK;
+	search->pfnFileRange = FS_FileRange_PAK;
 	search->pfnSearch = FS_Search_PAK;
 
 	Con_Reportf( "Adding PAK: %s (%i files)\n", pakfile, pak->numfiles );
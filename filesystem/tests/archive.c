@@ -0,0 +1,194 @@
+/*
+archive.c - archive writers shared by filesystem tests
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "archive.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#elif XASH_WIN32
+#include <windows.h>
+#endif
+
+#define MAX_STORED_BLOCK 65535
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+typedef struct
+{
+	char name[56];
+	int  filepos;
+	int  filelen;
+} testpackfile_t;
+
+qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+qboolean WritePak( const char *path, const testfile_t *files, int count )
+{
+	testpackfile_t *dir;
+	int header[3], i, pos = sizeof( header );
+	FILE *f = fopen( path, "wb" );
+
+	if( !f )
+		return false;
+
+	dir = calloc( count, sizeof( *dir ));
+
+	for( i = 0; i < count; i++ )
+		pos += files[i].size;
+
+	header[0] = ( 'K' << 24 ) + ( 'C' << 16 ) + ( 'A' << 8 ) + 'P';
+	header[1] = pos;
+	header[2] = count * sizeof( testpackfile_t );
+	fwrite( header, sizeof( header ), 1, f );
+
+	pos = sizeof( header );
+	for( i = 0; i < count; i++ )
+	{
+		strncpy( dir[i].name, files[i].name, sizeof( dir[i].name ) - 1 );
+		dir[i].filepos = pos;
+		dir[i].filelen = files[i].size;
+
+		fwrite( files[i].data, files[i].size, 1, f );
+		pos += files[i].size;
+	}
+
+	fwrite( dir, sizeof( dir[0] ), count, f );
+	fclose( f );
+	free( dir );
+
+	return true;
+}
+
+static void Put16( FILE *f, int val )
+{
+	fputc( val & 0xff, f );
+	fputc(( val >> 8 ) & 0xff, f );
+}
+
+static void Put32( FILE *f, int val )
+{
+	Put16( f, val & 0xffff );
+	Put16( f, ( val >> 16 ) & 0xffff );
+}
+
+// deflate stream made of stored blocks, so we don't need zlib here
+static int DeflatedSize( int size )
+{
+	return size + 5 * (( size + MAX_STORED_BLOCK - 1 ) / MAX_STORED_BLOCK );
+}
+
+static void WriteDeflated( FILE *f, const testfile_t *file )
+{
+	int pos = 0;
+
+	while( pos < file->size )
+	{
+		int len = file->size - pos;
+
+		if( len > MAX_STORED_BLOCK )
+			len = MAX_STORED_BLOCK;
+
+		fputc( pos + len == file->size ? 1 : 0, f );
+		Put16( f, len );
+		Put16( f, ~len & 0xffff );
+		fwrite( file->data + pos, len, 1, f );
+
+		pos += len;
+	}
+}
+
+static void WriteZipHeader( FILE *f, int signature, const testfile_t *file )
+{
+	Put32( f, signature );
+	if( signature != 0x04034b50 )
+		Put16( f, 20 ); // version made by
+	Put16( f, 20 ); // version needed
+	Put16( f, 0 ); // flags
+	Put16( f, 8 ); // deflated
+	Put32( f, 0 ); // dos time
+	Put32( f, 0 ); // crc32, not checked
+	Put32( f, DeflatedSize( file->size ));
+	Put32( f, file->size );
+	Put16( f, strlen( file->name ));
+	Put16( f, 0 ); // extra field
+}
+
+qboolean WriteZip( const char *path, const testfile_t *files, int count )
+{
+	long *offsets, cdf;
+	int i;
+	FILE *f = fopen( path, "wb" );
+
+	if( !f )
+		return false;
+
+	offsets = calloc( count, sizeof( *offsets ));
+
+	for( i = 0; i < count; i++ )
+	{
+		offsets[i] = ftell( f );
+		WriteZipHeader( f, 0x04034b50, &files[i] );
+		fwrite( files[i].name, strlen( files[i].name ), 1, f );
+		WriteDeflated( f, &files[i] );
+	}
+
+	cdf = ftell( f );
+
+	for( i = 0; i < count; i++ )
+	{
+		WriteZipHeader( f, 0x02014b50, &files[i] );
+		Put16( f, 0 ); // comment
+		Put16( f, 0 ); // disk
+		Put16( f, 0 ); // internal attributes
+		Put32( f, 0 ); // external attributes
+		Put32( f, offsets[i] );
+		fwrite( files[i].name, strlen( files[i].name ), 1, f );
+	}
+
+	Put32( f, 0x06054b50 );
+	Put16( f, 0 );
+	Put16( f, 0 );
+	Put16( f, count );
+	Put16( f, count );
+	Put32( f, ftell( f ) - 12 - cdf );
+	Put32( f, cdf );
+	Put16( f, 0 );
+
+	fclose( f );
+	free( offsets );
+
+	return true;
+}
@@ -0,0 +1,46 @@
+/*
+archive.h - archive writers shared by filesystem tests
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef TESTS_ARCHIVE_H
+#define TESTS_ARCHIVE_H
+
+#include "port.h"
+#include "build.h"
+#include "filesystem.h"
+#if XASH_POSIX
+#include <sys/stat.h>
+#elif XASH_WIN32
+#include <direct.h>
+#define mkdir( x, y ) _mkdir( x )
+#endif
+
+typedef struct testfile_s
+{
+	const char *name;
+	const byte *data;
+	int        size;
+} testfile_t;
+
+extern fs_api_t g_fs;
+
+qboolean LoadFilesystem( void );
+
+// id PAK, entries are stored as is
+qboolean WritePak( const char *path, const testfile_t *files, int count );
+
+// ZIP with deflated entries
+qboolean WriteZip( const char *path, const testfile_t *files, int count );
+
+#endif // TESTS_ARCHIVE_H
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "archive.h"
+
+// every file contains its own pak name, so we know where it came from
+static qboolean WriteSourcePak( const char *path, const char **names, int count )
+{
+	testfile_t files[8];
+	int i;
+
+	for( i = 0; i < count; i++ )
+	{
+		files[i].name = names[i];
+		files[i].data = (const byte *)path;
+		files[i].size = strlen( path );
+	}
+
+	return WritePak( path, files, count );
+}
+
+static qboolean CheckSource( const char *name, const char *expected )
+{
+	fs_offset_t len;
+	byte *data = g_fs.LoadFile( name, &len, false );
+	qboolean ok;
+
+	if( !data )
+	{
+		printf( "LoadFile %s fail\n", name );
+		return false;
+	}
+
+	ok = len == strlen( expected ) && !memcmp( data, expected, len );
+	free( data );
+
+	if( !ok )
+		printf( "%s was loaded from wrong place, expected %s\n", name, expected );
+
+	return ok;
+}
+
+static qboolean TestIndex( void )
+{
+	const char *pak0[] = { "maps/shared.bsp", "sound/only0.wav", "models/Mixed.MDL" };
+	const char *pak1[] = { "maps/shared.bsp", "sound/only1.wav" };
+	const char *pak2[] = { "sound/late.wav" };
+	FILE *f;
+
+	mkdir( "indextest", 0777 );
+	mkdir( "indextest/maps", 0777 );
+	mkdir( "indextest2", 0777 );
+
+	if( !WriteSourcePak( "indextest/pak0.pak", pak0, 3 ) || !WriteSourcePak( "indextest/pak1.pak", pak1, 2 ))
+		return false;
+
+	if( !WriteSourcePak( "indextest2/pak0.pak", pak2, 1 ))
+		return false;
+
+	// loose file takes priority over all archives
+	f = fopen( "indextest/maps/loose.bsp", "wb" );
+	fputs( "loose", f );
+	fclose( f );
+
+	g_fs.AddGameDirectory( "indextest/", FS_GAMEDIR_PATH );
+
+	// pak1 is mounted after pak0 so it wins
+	if( !CheckSource( "maps/shared.bsp", "indextest/pak1.pak" ))
+		return false;
+
+	if( !CheckSource( "SOUND/only0.wav", "indextest/pak0.pak" ))
+		return false;
+
+	if( !CheckSource( "models/mixed.mdl", "indextest/pak0.pak" ))
+		return false;
+
+	if( !CheckSource( "maps/loose.bsp", "loose" ))
+		return false;
+
+	if( g_fs.FileExists( "maps/shared.lit", false ) || g_fs.FileExists( "sound/late.wav", false ))
+	{
+		printf( "FileExists found missing file\n" );
+		return false;
+	}
+
+	// index must be rebuilt after mount
+	g_fs.AddGameDirectory( "indextest2/", FS_GAMEDIR_PATH );
+
+	if( !CheckSource( "sound/late.wav", "indextest2/pak0.pak" ))
+		return false;
+
+	// directory was changed behind our back
+	f = fopen( "indextest/maps/shared.bsp", "wb" );
+	fputs( "external", f );
+	fclose( f );
+
+	if( !CheckSource( "maps/shared.bsp", "external" ))
+		return false;
+
+	g_fs.ClearSearchPath();
+
+	if( g_fs.FileExists( "sound/only0.wav", false ))
+	{
+		printf( "FileExists found file from unmounted archive\n" );
+		return false;
+	}
+
+	remove( "indextest/maps/shared.bsp" );
+	remove( "indextest/maps/loose.bsp" );
+	remove( "indextest/pak0.pak" );
+	remove( "indextest/pak1.pak" );
+	remove( "indextest2/pak0.pak" );
+	rmdir( "indextest/maps" );
+	rmdir( "indextest" );
+	rmdir( "indextest2" );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestIndex())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
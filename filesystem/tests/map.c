@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "archive.h"
+
+// odd sizes and unaligned offsets on purpose
+static const int g_sizes[] = { 100, 70001, 4096, 12345 };
+static const char *g_names[] = { "small.txt", "maps/big.bsp", "page.bin", "sound/mid.wav" };
+#define NUM_FILES ( sizeof( g_sizes ) / sizeof( g_sizes[0] ))
+
+static byte FileByte( int file, int pos )
+{
+	return (byte)(( pos * 31 + file * 7 ) ^ ( pos >> 8 ));
+}
+
+static qboolean WriteTestPak( const char *path )
+{
+	testfile_t files[NUM_FILES];
+	qboolean ok;
+	byte *data;
+	int i, j;
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		data = malloc( g_sizes[i] );
+
+		for( j = 0; j < g_sizes[i]; j++ )
+			data[j] = FileByte( i, j );
+
+		files[i].name = g_names[i];
+		files[i].data = data;
+		files[i].size = g_sizes[i];
+	}
+
+	ok = WritePak( path, files, NUM_FILES );
+
+	for( i = 0; i < NUM_FILES; i++ )
+		free( (void *)files[i].data );
+
+	return ok;
+}
+
+static qboolean CheckContents( const byte *data, fs_offset_t len, int file )
+{
+	int i;
+
+	if( len != g_sizes[file] )
+	{
+		printf( "%s: expected %d bytes, got %d\n", g_names[file], g_sizes[file], (int)len );
+		return false;
+	}
+
+	for( i = 0; i < len; i++ )
+	{
+		if( data[i] != FileByte( file, i ))
+		{
+			printf( "%s: mismatch at %d\n", g_names[file], i );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static qboolean TestMap( void )
+{
+	const byte *views[NUM_FILES], *shared;
+	fs_offset_t len;
+	int i;
+
+	mkdir( "maptest", 0777 );
+
+	if( !WriteTestPak( "maptest/pak0.pak" ))
+		return false;
+
+	g_fs.AddGameDirectory( "maptest/", FS_GAMEDIR_PATH );
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		views[i] = g_fs.MapFile( g_names[i], &len, false );
+
+		if( !views[i] )
+		{
+			printf( "MapFile %s fail\n", g_names[i] );
+			return false;
+		}
+
+		if( !CheckContents( views[i], len, i ))
+			return false;
+	}
+
+	// same entry must give the same view
+	shared = g_fs.MapFile( "MAPS/BIG.BSP", &len, false );
+	if( shared != views[1] || len != g_sizes[1] )
+	{
+		printf( "MapFile didn't share view\n" );
+		return false;
+	}
+
+	// still referenced once
+	g_fs.UnmapFile( shared );
+
+	if( g_fs.MapFile( "maps/missing.bsp", &len, false ) || len != 0 )
+	{
+		printf( "MapFile found missing file\n" );
+		return false;
+	}
+
+	// views outlive the archive
+	g_fs.ClearSearchPath();
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		if( !CheckContents( views[i], g_sizes[i], i ))
+			return false;
+
+		g_fs.UnmapFile( views[i] );
+	}
+
+	remove( "maptest/pak0.pak" );
+	rmdir( "maptest" );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestMap())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "archive.h"
+
+static const int g_sizes[] = { 300, 150000, 70000, 4600000 };
+static const char *g_names[] = { "gfx/small.lmp", "maps/big.bsp", "sound/mid.wav", "maps/huge.bsp" };
+#define NUM_FILES ( sizeof( g_sizes ) / sizeof( g_sizes[0] ))
+
+static byte FileByte( int file, int pos )
+{
+	return (byte)(( pos * 13 + file * 5 ) ^ ( pos >> 9 ));
+}
+
+static qboolean WriteTestZip( const char *path )
+{
+	testfile_t files[NUM_FILES];
+	qboolean ok;
+	byte *data;
+	int i, j;
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		data = malloc( g_sizes[i] );
+
+		for( j = 0; j < g_sizes[i]; j++ )
+			data[j] = FileByte( i, j );
+
+		files[i].name = g_names[i];
+		files[i].data = data;
+		files[i].size = g_sizes[i];
+	}
+
+	ok = WriteZip( path, files, NUM_FILES );
+
+	for( i = 0; i < NUM_FILES; i++ )
+		free( (void *)files[i].data );
+
+	return ok;
+}
+
+static qboolean CheckRange( const byte *data, int len, int file, int start )
+{
+	int i;
+
+	for( i = 0; i < len; i++ )
+	{
+		if( data[i] != FileByte( file, start + i ))
+		{
+			printf( "%s: mismatch at %d\n", g_names[file], start + i );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static qboolean CheckLoad( int file )
+{
+	fs_offset_t len;
+	byte *data = g_fs.LoadFile( g_names[file], &len, false );
+	qboolean ok;
+
+	if( !data || len != g_sizes[file] )
+	{
+		printf( "LoadFile %s fail\n", g_names[file] );
+		return false;
+	}
+
+	ok = CheckRange( data, len, file, 0 ) && data[len] == 0;
+	free( data );
+
+	return ok;
+}
+
+static qboolean CheckSeek( file_t *f, int file )
+{
+	byte buf[1000];
+	int positions[] = { g_sizes[file] - 1000, 100, 70000, 0 };
+	int i;
+
+	for( i = 0; i < sizeof( positions ) / sizeof( positions[0] ); i++ )
+	{
+		if( g_fs.Seek( f, positions[i], SEEK_SET ) != 0 || g_fs.Tell( f ) != positions[i] )
+		{
+			printf( "%s: seek to %d failed\n", g_names[file], positions[i] );
+			return false;
+		}
+
+		if( g_fs.Read( f, buf, sizeof( buf )) != sizeof( buf ))
+		{
+			printf( "%s: short read at %d\n", g_names[file], positions[i] );
+			return false;
+		}
+
+		if( !CheckRange( buf, sizeof( buf ), file, positions[i] ))
+			return false;
+	}
+
+	return true;
+}
+
+// never cached, goes through inflate checkpoints
+static qboolean CheckLongSeek( int file )
+{
+	static byte buf[65536];
+	int positions[] = { 0, 4599000, 300000, 4000000, 2100000, 2100001, 262144, 3000000, 10, 1048576 };
+	file_t *f = g_fs.Open( g_names[file], "rb", false );
+	int i, pos;
+
+	if( !f )
+	{
+		printf( "Open %s fail\n", g_names[file] );
+		return false;
+	}
+
+	for( pos = 0; pos < g_sizes[file]; pos += sizeof( buf ))
+	{
+		int len = g_sizes[file] - pos < (int)sizeof( buf ) ? g_sizes[file] - pos : (int)sizeof( buf );
+
+		if( g_fs.Read( f, buf, len ) != len || !CheckRange( buf, len, file, pos ))
+		{
+			printf( "%s: sequential read failed at %d\n", g_names[file], pos );
+			g_fs.Close( f );
+			return false;
+		}
+	}
+
+	for( i = 0; i < sizeof( positions ) / sizeof( positions[0] ); i++ )
+	{
+		if( g_fs.Seek( f, positions[i], SEEK_SET ) != 0 || g_fs.Read( f, buf, 1000 ) != 1000 )
+		{
+			printf( "%s: seek to %d failed\n", g_names[file], positions[i] );
+			g_fs.Close( f );
+			return false;
+		}
+
+		if( !CheckRange( buf, 1000, file, positions[i] ))
+		{
+			g_fs.Close( f );
+			return false;
+		}
+	}
+
+	g_fs.Close( f );
+
+	return true;
+}
+
+static qboolean TestZipCache( size_t budget )
+{
+	file_t *f;
+	int i, pass;
+
+	g_fs.SetZipCacheSize( budget );
+
+	mkdir( "zipcachetest", 0777 );
+
+	if( !WriteTestZip( "zipcachetest/pak0.pk3" ))
+		return false;
+
+	g_fs.AddGameDirectory( "zipcachetest/", FS_GAMEDIR_PATH );
+
+	// second pass must be served from cache with the same result
+	for( pass = 0; pass < 2; pass++ )
+	{
+		for( i = 0; i < NUM_FILES; i++ )
+		{
+			if( !CheckLoad( i ))
+				return false;
+		}
+	}
+
+	f = g_fs.Open( g_names[1], "rb", false );
+	if( !f || g_fs.FileLength( f ) != g_sizes[1] )
+	{
+		printf( "Open %s fail\n", g_names[1] );
+		return false;
+	}
+
+	if( !CheckSeek( f, 1 ) || !CheckLongSeek( 3 ))
+		return false;
+
+	// open file keeps reading after archive is gone
+	g_fs.ClearSearchPath();
+
+	if( !CheckSeek( f, 1 ))
+		return false;
+
+	g_fs.Close( f );
+
+	remove( "zipcachetest/pak0.pk3" );
+	rmdir( "zipcachetest" );
+
+	return true;
+}
+
+#define MANY_FILES 3000
+#define MANY_SIZE  64
+
+// more entries than hash buckets, and archive remounted with other contents
+// at possibly the same address mustn't be served with stale data
+static qboolean TestManyEntries( void )
+{
+	testfile_t *files = calloc( MANY_FILES, sizeof( *files ));
+	char (*names)[32] = calloc( MANY_FILES, sizeof( *names ));
+	byte *data = malloc( MANY_FILES * MANY_SIZE );
+	qboolean ok = true;
+	int i, j, pass, gen;
+
+	g_fs.SetZipCacheSize( 1024 * 1024 );
+	mkdir( "zipcachemany", 0777 );
+
+	for( gen = 0; gen < 2 && ok; gen++ )
+	{
+		for( i = 0; i < MANY_FILES; i++ )
+		{
+			snprintf( names[i], sizeof( names[i] ), "many/%d.bin", i );
+
+			for( j = 0; j < MANY_SIZE; j++ )
+				data[i * MANY_SIZE + j] = FileByte( i + gen, j );
+
+			files[i].name = names[i];
+			files[i].data = &data[i * MANY_SIZE];
+			files[i].size = MANY_SIZE;
+		}
+
+		if( !WriteZip( "zipcachemany/pak0.pk3", files, MANY_FILES ))
+		{
+			ok = false;
+			break;
+		}
+
+		g_fs.AddGameDirectory( "zipcachemany/", FS_GAMEDIR_PATH );
+
+		for( pass = 0; pass < 2 && ok; pass++ )
+		{
+			for( i = 0; i < MANY_FILES && ok; i++ )
+			{
+				fs_offset_t len;
+				byte *buf = g_fs.LoadFile( names[i], &len, false );
+
+				if( !buf || len != MANY_SIZE || memcmp( buf, &data[i * MANY_SIZE], MANY_SIZE ))
+				{
+					printf( "%s: wrong contents in generation %d, pass %d\n", names[i], gen, pass );
+					ok = false;
+				}
+
+				if( buf )
+					free( buf );
+			}
+		}
+
+		g_fs.ClearSearchPath();
+	}
+
+	remove( "zipcachemany/pak0.pk3" );
+	rmdir( "zipcachemany" );
+	free( data );
+	free( names );
+	free( files );
+
+	return ok;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	// big enough to keep everything, too small for the biggest file, disabled
+	if( !TestZipCache( 1024 * 1024 ) || !TestZipCache( 200000 ) || !TestZipCache( 0 ))
+		return EXIT_FAILURE;
+
+	if( !TestManyEntries( ))
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
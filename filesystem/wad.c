@@ -277,7 +277,14 @@ FS_OpenFile_WAD
 */
 static file_t *FS_OpenFile_WAD( searchpath_t *search, const char *filename, const char *mode, int pack_ind )
 {
-	return NULL;
+	const dlumpinfo_t *lump = &search->wad->lumps[pack_ind];
+	const file_t *handle = search->wad->handle;
+
+	// lumps of wad packed into compressed archive can only be loaded through W_ReadLump
+	if( handle->ztk || handle->cached || handle->handle < 0 )
+		return NULL;
+
+	return FS_OpenHandle( search, handle->handle, handle->offset + lump->filepos, lump->disksize );
 }
 
 /*
@@ -623,6 +630,23 @@ static byte *W_ReadLump( searchpath_t *search, const char *path, int pack_ind, f
 	return buf;
 }
 
+/*
+===========
+W_LumpRange
+
+same bytes as W_ReadLump would return
+===========
+*/
+static file_t *W_LumpRange( searchpath_t *search, int pack_ind, fs_offset_t *offset, fs_offset_t *size )
+{
+	const dlumpinfo_t *lump = &search->wad->lumps[pack_ind];
+
+	*offset = lump->filepos;
+	*size = lump->disksize;
+
+	return search->wad->handle;
+}
+
 /*
 ====================
 FS_AddWad_Fullpath
@@ -656,6 +680,7 @@ searchpath_t *FS_AddWad_Fullpath( const char *wadfile, int flags )
 	search->pfnFindFile = FS_FindFile_WAD;
 	search->pfnSearch = FS_Search_WAD;
 	search->pfnLoadFile = W_ReadLump;
+	search->pfnFileRange = W_LumpRange;
 
 	Con_Reportf( "Adding WAD: %s (%i files)\n", wadfile, wad->numlumps );
 	return search;
@@ -129,6 +129,464 @@ struct zip_s
 
 // #define ENABLE_CRC_CHECK // known to be buggy because of possible libpublic crc32 bug, disabled
 
+/*
+========================================================================
+DECOMPRESSED ENTRIES CACHE
+
+Deflated entries are kept decompressed in LRU order, so reloading
+the same model or sound on every map change doesn't inflate it again.
+Entries are looked up by archive and entry index in hash table, list
+only keeps the order for eviction. Entries that are read through open
+files are locked and can't be evicted, entries of unmounted archives
+are freed once unlocked
+========================================================================
+*/
+#define ZIP_CACHE_HASH_SIZE	1024	// must be power of two
+
+typedef struct zipcache_s
+{
+	searchpath_t	*search;		// NULL if archive was closed
+	int		pack_ind;
+	fs_offset_t	size;
+	int		locks;		// number of open files reading the data
+	struct zipcache_s	*prev, *next;	// head.next is most recently used
+	struct zipcache_s	*hashnext;	// entries of closed archives aren't hashed
+	byte		*data;		// right after the header
+} zipcache_t;
+
+static struct
+{
+	zipcache_t	head;
+	zipcache_t	*hash[ZIP_CACHE_HASH_SIZE];
+	qboolean		initialized;
+	size_t		budget;
+	size_t		used;
+	int		numentries;
+
+	// statistics
+	uint		hits;
+	uint		misses;
+	uint		evictions;
+	size_t		saved;		// decompressed bytes served from cache
+} zcache;
+
+static void FS_InitZipCache( void )
+{
+	if( zcache.initialized )
+		return;
+
+	zcache.head.prev = zcache.head.next = &zcache.head;
+	zcache.initialized = true;
+}
+
+static void FS_UnlinkZipCache( zipcache_t *entry )
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+}
+
+static void FS_LinkZipCache( zipcache_t *entry )
+{
+	entry->next = zcache.head.next;
+	entry->prev = &zcache.head;
+	zcache.head.next->prev = entry;
+	zcache.head.next = entry;
+}
+
+static uint FS_ZipCacheHash( const searchpath_t *search, int pack_ind )
+{
+	return (uint)((size_t)search / sizeof( *search ) + pack_ind ) & ( ZIP_CACHE_HASH_SIZE - 1 );
+}
+
+static void FS_HashZipCache( zipcache_t *entry )
+{
+	uint	hash = FS_ZipCacheHash( entry->search, entry->pack_ind );
+
+	entry->hashnext = zcache.hash[hash];
+	zcache.hash[hash] = entry;
+}
+
+static void FS_UnhashZipCache( zipcache_t *entry )
+{
+	zipcache_t	**prev = &zcache.hash[FS_ZipCacheHash( entry->search, entry->pack_ind )];
+
+	for( ; *prev; prev = &( *prev )->hashnext )
+	{
+		if( *prev == entry )
+		{
+			*prev = entry->hashnext;
+			break;
+		}
+	}
+}
+
+static void FS_FreeZipCacheEntry( zipcache_t *entry )
+{
+	if( entry->search )
+		FS_UnhashZipCache( entry );
+
+	FS_UnlinkZipCache( entry );
+	zcache.used -= entry->size;
+	zcache.numentries--;
+	Mem_Free( entry );
+}
+
+/*
+============
+FS_TrimZipCache
+
+evicts least recently used entries until extra bytes fit into budget
+============
+*/
+static qboolean FS_TrimZipCache( size_t extra )
+{
+	zipcache_t	*entry, *prev;
+
+	FS_InitZipCache();
+
+	for( entry = zcache.head.prev; entry != &zcache.head && zcache.used + extra > zcache.budget; entry = prev )
+	{
+		prev = entry->prev;
+
+		if( entry->locks )
+			continue;
+
+		FS_FreeZipCacheEntry( entry );
+		zcache.evictions++;
+	}
+
+	return zcache.used + extra <= zcache.budget;
+}
+
+/*
+============
+FS_FindZipCache
+
+============
+*/
+static zipcache_t *FS_FindZipCache( searchpath_t *search, int pack_ind )
+{
+	zipcache_t	*entry;
+
+	// cache is disabled
+	if( !zcache.budget && !zcache.numentries )
+		return NULL;
+
+	FS_InitZipCache();
+
+	for( entry = zcache.hash[FS_ZipCacheHash( search, pack_ind )]; entry; entry = entry->hashnext )
+	{
+		if( entry->search != search || entry->pack_ind != pack_ind )
+			continue;
+
+		FS_UnlinkZipCache( entry );
+		FS_LinkZipCache( entry );
+
+		zcache.hits++;
+		zcache.saved += entry->size;
+		return entry;
+	}
+
+	zcache.misses++;
+	return NULL;
+}
+
+/*
+============
+FS_AllocZipCache
+
+returns entry to be filled by caller, NULL if it doesn't fit
+============
+*/
+static zipcache_t *FS_AllocZipCache( searchpath_t *search, int pack_ind, fs_offset_t size )
+{
+	zipcache_t	*entry;
+
+	// don't let single entry flush whole cache
+	if( size <= 0 || (size_t)size > zcache.budget / 2 || !FS_TrimZipCache( size ))
+		return NULL;
+
+	entry = Mem_Malloc( fs_mempool, sizeof( *entry ) + size );
+	entry->search = search;
+	entry->pack_ind = pack_ind;
+	entry->size = size;
+	entry->locks = 0;
+	entry->data = (byte *)( entry + 1 );
+
+	FS_LinkZipCache( entry );
+	FS_HashZipCache( entry );
+	zcache.used += size;
+	zcache.numentries++;
+
+	return entry;
+}
+
+/*
+============
+FS_UnlockZipCache
+
+called when file reading from cached data is closed
+============
+*/
+void FS_UnlockZipCache( const byte *data )
+{
+	zipcache_t	*entry = (zipcache_t *)data - 1;
+
+	entry->locks--;
+
+	if( entry->locks > 0 )
+		return;
+
+	if( !entry->search )
+		FS_FreeZipCacheEntry( entry );
+	else if( zcache.used > zcache.budget )
+		FS_TrimZipCache( 0 );
+}
+
+/*
+============
+FS_DetachZipCache
+
+archive is closed, its entries can't be found anymore
+============
+*/
+static void FS_DetachZipCache( searchpath_t *search )
+{
+	zipcache_t	*entry, *next;
+
+	FS_InitZipCache();
+
+	for( entry = zcache.head.next; entry != &zcache.head; entry = next )
+	{
+		next = entry->next;
+
+		if( entry->search != search )
+			continue;
+
+		if( entry->locks )
+		{
+			FS_UnhashZipCache( entry );
+			entry->search = NULL;
+		}
+		else FS_FreeZipCacheEntry( entry );
+	}
+}
+
+/*
+============
+FS_SetZipCacheSize
+
+============
+*/
+void FS_SetZipCacheSize( size_t size )
+{
+	zcache.budget = size;
+	FS_TrimZipCache( 0 );
+}
+
+/*
+============
+FS_FreeZipCache
+
+filesystem pool is about to be freed
+============
+*/
+void FS_FreeZipCache( void )
+{
+	size_t	budget = zcache.budget;
+
+	if( zcache.initialized )
+	{
+		while( zcache.head.next != &zcache.head )
+			FS_FreeZipCacheEntry( zcache.head.next );
+	}
+
+	memset( &zcache, 0, sizeof( zcache ));
+	zcache.budget = budget;
+}
+
+/*
+============
+FS_PrintZipCacheInfo
+
+============
+*/
+void FS_PrintZipCacheInfo( void )
+{
+	Con_Printf( "zip cache: %i entries, %s of %s, %u hits, %u misses, %u evictions, %s inflated less\n",
+		zcache.numentries, Q_memprint( zcache.used ), Q_memprint( zcache.budget ),
+		zcache.hits, zcache.misses, zcache.evictions, Q_memprint( zcache.saved ));
+}
+
+/*
+========================================================================
+INFLATE CHECKPOINTS
+
+Deflate stream can't be entered in the middle, so backward seek in
+a deflated file used to inflate it again from the start. While file is
+read, a copy of inflate state is saved every checkpoint_spacing bytes,
+seek resumes from the nearest one before the target instead.
+Snapshot holds 32k window, so number of them per file is limited:
+when limit is reached, every other one is dropped and spacing doubles
+========================================================================
+*/
+#define ZIP_CHECKPOINT_SPACING	( 256 * 1024 )
+#define ZIP_MAX_CHECKPOINTS	16
+
+static struct
+{
+	uint		saved;
+	uint		restored;
+	size_t		skipped;		// inflated bytes avoided by restores
+} zseek;
+
+/*
+============
+FS_SaveZipCheckpoint
+
+called by FS_Read after each inflate call, doesn't use
+filesystem pool or global statistics because files can
+be read by worker threads
+============
+*/
+void FS_SaveZipCheckpoint( file_t *file )
+{
+	ztoolkit_t	*ztk = file->ztk;
+	zcheckpoint_t	*cp;
+	int		i;
+
+	if( file->position < ztk->next_checkpoint || file->position >= file->real_length )
+		return;
+
+	if( !ztk->checkpoints )
+		return;
+
+	if( ztk->numcheckpoints == ZIP_MAX_CHECKPOINTS )
+	{
+		for( i = 0; i < ZIP_MAX_CHECKPOINTS; i++ )
+		{
+			if( i & 1 )
+				inflateEnd( &ztk->checkpoints[i].zstream );
+			else ztk->checkpoints[i / 2] = ztk->checkpoints[i];
+		}
+
+		ztk->numcheckpoints = ZIP_MAX_CHECKPOINTS / 2;
+		ztk->checkpoint_spacing *= 2;
+		ztk->next_checkpoint = ztk->checkpoints[ztk->numcheckpoints - 1].position + ztk->checkpoint_spacing;
+
+		if( file->position < ztk->next_checkpoint )
+			return;
+	}
+
+	cp = &ztk->checkpoints[ztk->numcheckpoints];
+
+	if( inflateCopy( &cp->zstream, &ztk->zstream ) != Z_OK )
+	{
+		// not fatal, seeks just get slower
+		ztk->next_checkpoint = file->real_length;
+		return;
+	}
+
+	// unused part of input buffer is read again after restore
+	cp->position = file->position;
+	cp->in_position = ztk->in_position - ( ztk->in_len - ztk->in_ind );
+
+	ztk->numcheckpoints++;
+	ztk->next_checkpoint = file->position + ztk->checkpoint_spacing;
+	ztk->saved++;
+}
+
+/*
+============
+FS_RestoreZipCheckpoint
+
+moves inflate state to the nearest checkpoint before offset, if
+it's closer than current position. Returns false if caller has
+to restart from the beginning of the file
+============
+*/
+qboolean FS_RestoreZipCheckpoint( file_t *file, fs_offset_t offset )
+{
+	ztoolkit_t	*ztk = file->ztk;
+	zcheckpoint_t	*cp = NULL;
+	z_stream		zstream;
+	int		i;
+
+	for( i = 0; i < ztk->numcheckpoints; i++ )
+	{
+		if( ztk->checkpoints[i].position > offset )
+			break;
+
+		cp = &ztk->checkpoints[i];
+	}
+
+	if( !cp )
+		return false;
+
+	// forward seek, already closer than checkpoint
+	if( offset > file->position && cp->position <= file->position )
+		return true;
+
+	if( inflateCopy( &zstream, &cp->zstream ) != Z_OK )
+		return false;
+
+	inflateEnd( &ztk->zstream );
+	ztk->zstream = zstream;
+	ztk->zstream.next_in = ztk->input;
+	ztk->zstream.avail_in = 0;
+	ztk->in_ind = 0;
+	ztk->in_len = 0;
+	ztk->in_position = cp->in_position;
+
+	if( offset <= file->position )
+		ztk->skipped += cp->position;
+	else ztk->skipped += cp->position - file->position;
+
+	file->position = cp->position;
+	ztk->restored++;
+
+	return true;
+}
+
+/*
+============
+FS_FreeZipCheckpoints
+
+called from FS_Close on main thread,
+so file statistics are added here
+============
+*/
+void FS_FreeZipCheckpoints( ztoolkit_t *ztk )
+{
+	int	i;
+
+	zseek.saved += ztk->saved;
+	zseek.restored += ztk->restored;
+	zseek.skipped += ztk->skipped;
+
+	for( i = 0; i < ztk->numcheckpoints; i++ )
+		inflateEnd( &ztk->checkpoints[i].zstream );
+
+	if( ztk->checkpoints )
+		Mem_Free( ztk->checkpoints );
+
+	ztk->checkpoints = NULL;
+	ztk->numcheckpoints = 0;
+}
+
+/*
+============
+FS_PrintZipCheckpointsInfo
+
+============
+*/
+void FS_PrintZipCheckpointsInfo( void )
+{
+	Con_Printf( "zip seeks: %u checkpoints saved, %u restored, %s inflated less\n",
+		zseek.saved, zseek.restored, Q_memprint( zseek.skipped ));
+}
+
+
 /*
 ============
 FS_CloseZIP
@@ -149,6 +607,7 @@ FS_Close_ZIP
 */
 static void FS_Close_ZIP( searchpath_t *search )
 {
+	FS_DetachZipCache( search );
 	FS_CloseZIP( search->zip );
 }
 
@@ -378,6 +837,119 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 	return zip;
 }
 
+/*
+===========
+FS_InflateZIPFile
+
+decompresses whole deflated entry into out buffer
+===========
+*/
+static qboolean FS_InflateZIPFile( searchpath_t *search, const zipfile_t *file, byte *out )
+{
+	byte		*compressed_buffer;
+	int		zlib_result;
+	z_stream	decompress_stream;
+	size_t      c;
+#ifdef ENABLE_CRC_CHECK
+	dword		test_crc, final_crc;
+#endif // ENABLE_CRC_CHECK
+
+	if( FS_Seek( search->zip->handle, file->offset, SEEK_SET ) == -1 )
+		return false;
+
+	compressed_buffer = (byte *)Mem_Malloc( fs_mempool, file->compressed_size + 1 );
+
+	c = FS_Read( search->zip->handle, compressed_buffer, file->compressed_size );
+	if( c != file->compressed_size )
+	{
+		Con_Reportf( S_ERROR "%s: %s compressed size doesn't match\n", __func__, file->name );
+		Mem_Free( compressed_buffer );
+		return false;
+	}
+
+	memset( &decompress_stream, 0, sizeof( decompress_stream ) );
+
+	decompress_stream.total_in = decompress_stream.avail_in = file->compressed_size;
+	decompress_stream.next_in = (Bytef *)compressed_buffer;
+	decompress_stream.total_out = decompress_stream.avail_out = file->size;
+	decompress_stream.next_out = (Bytef *)out;
+
+	decompress_stream.zalloc = Z_NULL;
+	decompress_stream.zfree = Z_NULL;
+	decompress_stream.opaque = Z_NULL;
+
+	if( inflateInit2( &decompress_stream, -MAX_WBITS ) != Z_OK )
+	{
+		Con_Printf( S_ERROR "%s: inflateInit2 failed\n", __func__ );
+		Mem_Free( compressed_buffer );
+		return false;
+	}
+
+	zlib_result = inflate( &decompress_stream, Z_NO_FLUSH );
+	inflateEnd( &decompress_stream );
+	Mem_Free( compressed_buffer ); // finaly free compressed buffer
+
+	if( zlib_result != Z_OK && zlib_result != Z_STREAM_END )
+	{
+		Con_Reportf( S_ERROR "%s: %s: error while file decompressing. Zlib return code %d.\n", __func__, file->name, zlib_result );
+		return false;
+	}
+
+#ifdef ENABLE_CRC_CHECK
+	CRC32_Init( &test_crc );
+	CRC32_ProcessBuffer( &test_crc, out, file->size );
+
+	final_crc = CRC32_Final( test_crc );
+
+	if( final_crc != file->crc32 )
+	{
+		Con_Reportf( S_ERROR "%s: %s file crc32 mismatch\n", __func__, file->name );
+		return false;
+	}
+#endif // ENABLE_CRC_CHECK
+
+	return true;
+}
+
+/*
+===========
+FS_OpenCachedZIPFile
+
+deflated entry that fits into cache is decompressed once
+and then read from memory, which also makes seeking cheap
+===========
+*/
+static file_t *FS_OpenCachedZIPFile( searchpath_t *search, const zipfile_t *pfile, int pack_ind )
+{
+	zipcache_t	*entry = FS_FindZipCache( search, pack_ind );
+	file_t		*f;
+
+	if( !entry )
+	{
+		entry = FS_AllocZipCache( search, pack_ind, pfile->size );
+
+		if( !entry )
+			return NULL;
+
+		if( !FS_InflateZIPFile( search, pfile, entry->data ))
+		{
+			FS_FreeZipCacheEntry( entry );
+			return NULL;
+		}
+	}
+
+	entry->locks++;
+
+	f = (file_t *)Mem_Calloc( fs_mempool, sizeof( *f ));
+	f->handle = -1;
+	f->ungetc = EOF;
+	f->real_length = entry->size;
+	f->searchpath = search;
+	f->cached = entry->data;
+
+	return f;
+}
+
 /*
 ===========
 FS_OpenZipFile
@@ -388,7 +960,17 @@ Open a packed file using its package file descriptor
 static file_t *FS_OpenFile_ZIP( searchpath_t *search, const char *filename, const char *mode, int pack_ind )
 {
 	zipfile_t *pfile = &search->zip->files[pack_ind];
-	file_t *f = FS_OpenHandle( search, search->zip->handle->handle, pfile->offset, pfile->size );
+	file_t *f;
+
+	// 'p' is for files read by prefetch threads, these inflate
+	// on their own instead of on main thread at open time
+	if( pfile->flags == ZIP_COMPRESSION_DEFLATED && !Q_strchr( mode, 'p' ))
+	{
+		if(( f = FS_OpenCachedZIPFile( search, pfile, pack_ind )) != NULL )
+			return f;
+	}
+
+	f = FS_OpenHandle( search, search->zip->handle->handle, pfile->offset, pfile->size );
 
 	if( !f )
 		return NULL;
@@ -414,6 +996,11 @@ static file_t *FS_OpenFile_ZIP( searchpath_t *search, const char *filename, cons
 
 		ztk->zstream.next_out = f->buff;
 		ztk->zstream.avail_out = sizeof( f->buff );
+		ztk->checkpoint_spacing = ZIP_CHECKPOINT_SPACING;
+		ztk->next_checkpoint = ZIP_CHECKPOINT_SPACING;
+
+		if( pfile->size > ZIP_CHECKPOINT_SPACING )
+			ztk->checkpoints = Mem_Calloc( fs_mempool, sizeof( *ztk->checkpoints ) * ZIP_MAX_CHECKPOINTS );
 
 		f->ztk = ztk;
 	}
@@ -436,9 +1023,7 @@ FS_LoadZIPFile
 static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_ind, fs_offset_t *sizeptr, void *( *pfnAlloc )( size_t ), void ( *pfnFree )( void * ))
 {
 	zipfile_t *file;
-	byte		*compressed_buffer = NULL, *decompressed_buffer = NULL;
-	int		zlib_result = 0;
-	z_stream	decompress_stream;
+	byte		*decompressed_buffer = NULL;
 	size_t      c;
 #ifdef ENABLE_CRC_CHECK
 	dword		test_crc, final_crc;
@@ -474,6 +1059,7 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 		if( c != file->size )
 		{
 			Con_Reportf( S_ERROR "%s: %s size doesn't match\n", __func__, file->name );
+			pfnFree( decompressed_buffer );
 			return NULL;
 		}
 
@@ -497,65 +1083,27 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 	}
 	else if( file->flags == ZIP_COMPRESSION_DEFLATED )
 	{
-		compressed_buffer = (byte *)Mem_Malloc( fs_mempool, file->compressed_size + 1 );
-
-		c = FS_Read( search->zip->handle, compressed_buffer, file->compressed_size );
-		if( c != file->compressed_size )
-		{
-			Con_Reportf( S_ERROR "%s: %s compressed size doesn't match\n", __func__, file->name );
-			return NULL;
-		}
-
-		memset( &decompress_stream, 0, sizeof( decompress_stream ) );
+		zipcache_t *entry = FS_FindZipCache( search, pack_ind );
 
-		decompress_stream.total_in = decompress_stream.avail_in = file->compressed_size;
-		decompress_stream.next_in = (Bytef *)compressed_buffer;
-		decompress_stream.total_out = decompress_stream.avail_out = file->size;
-		decompress_stream.next_out = (Bytef *)decompressed_buffer;
-
-		decompress_stream.zalloc = Z_NULL;
-		decompress_stream.zfree = Z_NULL;
-		decompress_stream.opaque = Z_NULL;
-
-		if( inflateInit2( &decompress_stream, -MAX_WBITS ) != Z_OK )
+		if( entry )
 		{
-			Con_Printf( S_ERROR "%s: inflateInit2 failed\n", __func__ );
-			Mem_Free( compressed_buffer );
-			Mem_Free( decompressed_buffer );
-			return NULL;
+			memcpy( decompressed_buffer, entry->data, file->size );
 		}
-
-		zlib_result = inflate( &decompress_stream, Z_NO_FLUSH );
-		inflateEnd( &decompress_stream );
-
-		if( zlib_result == Z_OK || zlib_result == Z_STREAM_END )
+		else
 		{
-			Mem_Free( compressed_buffer ); // finaly free compressed buffer
-#if ENABLE_CRC_CHECK
-			CRC32_Init( &test_crc );
-			CRC32_ProcessBuffer( &test_crc, decompressed_buffer, file->size );
-
-			final_crc = CRC32_Final( test_crc );
-
-			if( final_crc != file->crc32 )
+			if( !FS_InflateZIPFile( search, file, decompressed_buffer ))
 			{
-				Con_Reportf( S_ERROR "%s: %s file crc32 mismatch\n", __func__, file->name );
 				pfnFree( decompressed_buffer );
 				return NULL;
 			}
-#endif
-			if( sizeptr ) *sizeptr = file->size;
 
-			return decompressed_buffer;
-		}
-		else
-		{
-			Con_Reportf( S_ERROR "%s: %s: error while file decompressing. Zlib return code %d.\n", __func__, file->name, zlib_result );
-			Mem_Free( compressed_buffer );
-			pfnFree( decompressed_buffer );
-			return NULL;
+			if(( entry = FS_AllocZipCache( search, pack_ind, file->size )) != NULL )
+				memcpy( entry->data, decompressed_buffer, file->size );
 		}
 
+		if( sizeptr ) *sizeptr = file->size;
+
+		return decompressed_buffer;
 	}
 	else
 	{
@@ -628,6 +1176,40 @@ static int FS_FindFile_ZIP( searchpath_t *search, const char *path, char *fixedn
 	return -1;
 }
 
+/*
+===========
+FS_FileName_ZIP
+
+===========
+*/
+static const char *FS_FileName_ZIP( searchpath_t *search, int pack_ind )
+{
+	if( pack_ind < 0 || pack_ind >= search->zip->numfiles )
+		return NULL;
+
+	return search->zip->files[pack_ind].name;
+}
+
+/*
+===========
+FS_FileRange_ZIP
+
+only stored entries can be accessed directly
+===========
+*/
+static file_t *FS_FileRange_ZIP( searchpath_t *search, int pack_ind, fs_offset_t *offset, fs_offset_t *size )
+{
+	const zipfile_t *pfile = &search->zip->files[pack_ind];
+
+	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION || pfile->compressed_size != pfile->size )
+		return NULL;
+
+	*offset = pfile->offset;
+	*size = pfile->size;
+
+	return search->zip->handle;
+}
+
 /*
 ===========
 FS_Search_ZIP
@@ -706,6 +1288,8 @@ searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags )
 	search->pfnOpenFile = FS_OpenFile_ZIP;
 	search->pfnFileTime = FS_FileTime_ZIP;
 	search->pfnFindFile = FS_FindFile_ZIP;
+	search->pfnFileName = FS_FileName_ZIP;
+	search->pfnFileRange = FS_FileRange_ZIP;
 	search->pfnSearch = FS_Search_ZIP;
 	search->pfnLoadFile = FS_LoadZIPFile;
 
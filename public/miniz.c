@@ -436,6 +436,24 @@ int mz_inflateReset(mz_streamp pStream)
     return MZ_OK;
 }
 
+int mz_inflateCopy(mz_streamp pDest, mz_streamp pSource)
+{
+    inflate_state *pDecomp;
+    if ((!pDest) || (!pSource) || (!pSource->state))
+        return MZ_STREAM_ERROR;
+
+    pDecomp = (inflate_state *)pSource->zalloc(pSource->opaque, 1, sizeof(inflate_state));
+    if (!pDecomp)
+        return MZ_MEM_ERROR;
+
+    /* decompressor and dictionary don't hold any pointers, plain copy is enough */
+    memcpy(pDecomp, pSource->state, sizeof(inflate_state));
+    memcpy(pDest, pSource, sizeof(mz_stream));
+    pDest->state = (struct mz_internal_state *)pDecomp;
+
+    return MZ_OK;
+}
+
 int mz_inflate(mz_streamp pStream, int flush)
 {
     inflate_state *pState;